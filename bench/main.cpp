@@ -0,0 +1,816 @@
+// chora-bench: headless performance benchmarks for the editor.
+//
+// Generates C++ and log corpora of the requested sizes, then drives the real
+// CodeEditor, highlighter, writer and terminal on the offscreen platform and
+// prints one JSON document with the results, so numbers can be compared from
+// release to release.
+//
+//   chora-bench [--sizes 1M,100M,1G] [--corpora cpp,log] [--dir DIR]
+//               [--output FILE] [--frames N] [--timeout SECONDS]
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QLineEdit>
+#include <QScrollBar>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QTextBlock>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+#include "core/codeeditor.h"
+#include "core/documentwriter.h"
+#include "core/findinfiles.h"
+#include "core/mappedfile.h"
+#include "core/pathindex.h"
+#include "core/symbolindex.h"
+#include "core/highlighter/cpp.h"
+#include "core/highlighter/highlightcache.h"
+#include "core/highlighter/lexer.h"
+#include "core/terminalbuffer.h"
+#include "core/terminalscreen.h"
+#include "core/terminalsession.h"
+#include "ui/TerminalView.h"
+#include "ui/TerminalWidget.h"
+
+namespace {
+
+// Same default as MainWindow::largeFileThreshold; files at least this big
+// are opened paged instead of loaded.
+const qint64 LargeFileThreshold = 64 * 1024 * 1024;
+
+struct Options {
+    QList<qint64> sizes;
+    QStringList corpora;
+    int frames = 200;
+    qint64 timeoutMs = 120 * 1000;
+};
+
+double milliseconds(const QElapsedTimer &clock) {
+    return double(clock.nsecsElapsed()) / 1e6;
+}
+
+double megabytesPerSecond(qint64 bytes, double ms) {
+    return ms > 0 ? (double(bytes) / (1024.0 * 1024.0)) / (ms / 1000.0) : 0.0;
+}
+
+// Runs the event loop until done() holds. The timer makes sure done() is
+// checked regularly even when nothing else wakes the loop up.
+template <typename Done>
+bool waitUntil(Done done, qint64 timeoutMs) {
+    QElapsedTimer clock;
+    clock.start();
+    QTimer wake;
+    wake.start(10);
+
+    while (!done()) {
+        if (clock.elapsed() > timeoutMs) return false;
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+qint64 parseSize(QString text) {
+    text = text.trimmed().toUpper();
+    qint64 unit = 1;
+    if (text.endsWith('K')) unit = 1024;
+    else if (text.endsWith('M')) unit = 1024 * 1024;
+    else if (text.endsWith('G')) unit = 1024 * 1024 * 1024;
+    if (unit != 1) text.chop(1);
+
+    bool ok = false;
+    const qint64 value = text.toLongLong(&ok);
+    return ok && value > 0 ? value * unit : -1;
+}
+
+QString sizeLabel(qint64 bytes) {
+    if (bytes % (1024 * 1024 * 1024) == 0) return QString::number(bytes >> 30) + "G";
+    if (bytes % (1024 * 1024) == 0) return QString::number(bytes >> 20) + "M";
+    if (bytes % 1024 == 0) return QString::number(bytes >> 10) + "K";
+    return QString::number(bytes);
+}
+
+// One unit of the C++ corpus. It mixes everything the lexer knows about,
+// including a block comment spanning lines, so the highlighter has to carry
+// state from block to block.
+QByteArray cppUnit(qint64 index) {
+    return QString(
+        "#include <vector>\n"
+        "#define LIMIT_%1 %1\n"
+        "\n"
+        "/* Accumulates the weights of node %1.\n"
+        "   Spans two lines on purpose. */\n"
+        "class Node%1 : public QObject {\n"
+        "public:\n"
+        "    static int weight(const std::vector<int> &values, double scale = 0.5) {\n"
+        "        int total = 0;\n"
+        "        for (int value : values) {\n"
+        "            if (value > LIMIT_%1 && scale != 1.25e3) total += value; // clamp\n"
+        "        }\n"
+        "        QString label = \"node %1 \\\"weighted\\\"\";\n"
+        "        return total + qHash(label) % 0x7F;\n"
+        "    }\n"
+        "};\n"
+        "\n").arg(index).toUtf8();
+}
+
+QByteArray logUnit(qint64 index) {
+    static const char *const levels[] = {"INFO ", "DEBUG", "WARN ", "ERROR"};
+    const QDateTime time = QDateTime::fromSecsSinceEpoch(1700000000 + index / 8).toUTC();
+    return QString("%1.%2Z %3 [worker-%4] request %5 completed in %6 ms status=%7 path=/api/v1/items/%8\n")
+        .arg(time.toString(Qt::ISODate).chopped(1))
+        .arg(index % 1000, 3, 10, QChar('0'))
+        .arg(QLatin1String(levels[index % 4]))
+        .arg(index % 16)
+        .arg(index)
+        .arg((index * 37) % 2000)
+        .arg(index % 4 == 3 ? 500 : 200)
+        .arg((index * 7919) % 100000)
+        .toUtf8();
+}
+
+// Writes a corpus of (slightly less than) size bytes, ending on a line
+// break. An existing file of the right size is reused.
+QString generateCorpus(const QString &dir, const QString &kind, qint64 size) {
+    const QString path = QDir(dir).filePath(QString("%1-%2.%3")
+        .arg(kind, sizeLabel(size), kind == "cpp" ? "cpp" : "log"));
+
+    QFile file(path);
+    if (file.exists() && file.size() > size - 4096 && file.size() <= size) {
+        return path;
+    }
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return QString();
+    }
+
+    QByteArray chunk;
+    qint64 written = 0;
+    for (qint64 index = 0;; ++index) {
+        const QByteArray unit = kind == "cpp" ? cppUnit(index) : logUnit(index);
+        if (written + chunk.size() + unit.size() > size) break;
+        chunk += unit;
+        if (chunk.size() >= 1024 * 1024) {
+            file.write(chunk);
+            written += chunk.size();
+            chunk.clear();
+        }
+    }
+    file.write(chunk);
+    return path;
+}
+
+QJsonObject frameStatistics(QVector<double> frames) {
+    QJsonObject stats;
+    if (frames.isEmpty()) return stats;
+
+    std::sort(frames.begin(), frames.end());
+    double total = 0;
+    int over16 = 0;
+    for (double frame : frames) {
+        total += frame;
+        if (frame > 16.0) ++over16;
+    }
+
+    auto percentile = [&](double p) {
+        const qsizetype index = qMin(frames.size() - 1, qsizetype(p * double(frames.size())));
+        return frames[index];
+    };
+
+    stats["frames"] = int(frames.size());
+    stats["mean_ms"] = total / double(frames.size());
+    stats["p50_ms"] = percentile(0.50);
+    stats["p95_ms"] = percentile(0.95);
+    stats["p99_ms"] = percentile(0.99);
+    stats["max_ms"] = frames.last();
+    stats["frames_over_16ms"] = over16;
+    return stats;
+}
+
+// Opens path the way MainWindow does: loaded on a worker below the large
+// file threshold, paged from a mapping above it.
+QJsonObject benchOpen(CodeEditor *editor, const QString &path, qint64 timeoutMs) {
+    QJsonObject result;
+    const qint64 size = QFileInfo(path).size();
+    QElapsedTimer clock;
+
+    if (size >= LargeFileThreshold) {
+        result["mode"] = "paged";
+        clock.start();
+        auto mappedFile = std::make_shared<MappedFile>(path);
+        if (!mappedFile->open()) {
+            result["ok"] = false;
+            return result;
+        }
+        editor->openPagedFile(mappedFile);
+        editor->viewport()->repaint();
+        result["first_screen_ms"] = milliseconds(clock);
+
+        const bool indexed = waitUntil([&] { return !editor->isReadOnly(); }, timeoutMs);
+        result["ok"] = indexed;
+        result["complete_ms"] = milliseconds(clock);
+        return result;
+    }
+
+    result["mode"] = "loaded";
+    double firstChunk = -1;
+    bool finished = false;
+    bool ok = false;
+
+    QObject context;
+    QObject::connect(editor, &CodeEditor::loadProgress, &context, [&] {
+        if (firstChunk < 0) {
+            editor->viewport()->repaint();
+            firstChunk = milliseconds(clock);
+        }
+    });
+    QObject::connect(editor, &CodeEditor::loadFinished, &context, [&](bool success) {
+        finished = true;
+        ok = success;
+    });
+
+    clock.start();
+    editor->loadFile(path);
+    const bool done = waitUntil([&] { return finished; }, timeoutMs);
+    if (!done) editor->cancelLoading();
+
+    result["ok"] = done && ok;
+    result["first_screen_ms"] = firstChunk;
+    result["complete_ms"] = milliseconds(clock);
+    return result;
+}
+
+// Highlights everything that is in the document, through the same
+// time-sliced path the UI uses, plus the bare lexer over the same text.
+QJsonObject benchHighlight(CodeEditor *editor, qint64 timeoutMs) {
+    QJsonObject result;
+    QTextDocument *document = editor->document();
+    const qint64 bytes = qint64(document->characterCount()) * qint64(sizeof(QChar));
+
+    QElapsedTimer clock;
+    clock.start();
+    auto *highlighter = new CppHighlighter(document);
+    editor->setSyntaxHighlighter(highlighter);
+    const bool finished = waitUntil([&] { return highlighter->isFinished(); }, timeoutMs);
+    const double elapsed = milliseconds(clock);
+
+    result["ok"] = finished;
+    result["blocks"] = document->blockCount();
+    result["characters"] = document->characterCount();
+    result["ms"] = elapsed;
+    result["utf16_mb_per_s"] = megabytesPerSecond(bytes, elapsed);
+
+    const Lexer::Rules &rules = CppHighlighter::definition().rules;
+    qint64 tokens = 0;
+    Lexer::State state = Lexer::Normal;
+    clock.restart();
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+        state = Lexer::lexBlock(block.text(), state, rules,
+            [&](qsizetype, qsizetype, Lexer::Token) { ++tokens; });
+    }
+    const double lexed = milliseconds(clock);
+    result["lexer_ms"] = lexed;
+    result["lexer_tokens"] = tokens;
+    result["lexer_utf16_mb_per_s"] = megabytesPerSecond(bytes, lexed);
+    return result;
+}
+
+// Pages down from the top, one synchronous repaint per step. For C++ a
+// fresh highlighter is attached first so the frames include the slices a
+// real user would be scrolling through.
+QJsonObject benchScroll(CodeEditor *editor, bool highlight, int frameCount) {
+    if (highlight) {
+        editor->setSyntaxHighlighter(new CppHighlighter(editor->document()));
+    }
+    editor->moveCursor(QTextCursor::Start);
+    editor->verticalScrollBar()->setValue(0);
+    QCoreApplication::processEvents();
+
+    QVector<double> frames;
+    frames.reserve(frameCount);
+    QElapsedTimer clock;
+    for (int i = 0; i < frameCount; ++i) {
+        clock.start();
+        QKeyEvent press(QEvent::KeyPress, Qt::Key_PageDown, Qt::NoModifier);
+        QApplication::sendEvent(editor, &press);
+        QCoreApplication::processEvents();
+        editor->viewport()->repaint();
+        frames.append(milliseconds(clock));
+    }
+
+    QJsonObject result = frameStatistics(frames);
+    result["highlighted"] = highlight;
+    result["top_line"] = qint64(editor->lineNumberOffset() + editor->firstVisibleBlock().blockNumber());
+    return result;
+}
+
+// Opens path twice in fresh tabs, highlighting everything each time: once
+// lexing and leaving an entry in the highlight cache, once from the entry.
+QJsonObject benchReopen(const QString &path, const QString &dir, qint64 timeoutMs) {
+    QJsonObject result;
+    HighlightCache cache;
+    QDir(dir + "/highlight-cache").removeRecursively();
+    cache.setCacheDirectory(dir + "/highlight-cache");
+
+    auto open = [&](const char *name) {
+        CodeEditor editor;
+        editor.resize(1200, 800);
+        editor.show();
+        editor.setHighlightCache(&cache);
+        editor.detectAndApplySyntaxHighlighting(path);
+
+        bool finished = false;
+        QObject::connect(&editor, &CodeEditor::loadFinished, &editor, [&] { finished = true; });
+        QElapsedTimer clock;
+        clock.start();
+        editor.loadFile(path);
+        const bool done = waitUntil([&] { return finished; }, timeoutMs)
+            && waitUntil([&] {
+                const SyntaxHighlighter *highlighter = editor.document()->findChild<SyntaxHighlighter*>();
+                return highlighter && highlighter->isFinished();
+            }, timeoutMs);
+        result[name] = milliseconds(clock);
+        return done;
+    };
+
+    bool ok = open("cold_ms");
+    // The entry is written on the cache's worker after the first load.
+    ok = ok && waitUntil([&] { return cache.find(path) != nullptr; }, timeoutMs);
+    ok = ok && open("warm_ms");
+    result["ok"] = ok;
+    return result;
+}
+
+QJsonObject benchSave(CodeEditor *editor, const QString &dir) {
+    QJsonObject result;
+    const QString target = QDir(dir).filePath("chora-bench-save.out");
+    const TextBuffer &buffer = editor->textBuffer();
+    const qint64 bytes = buffer.size();
+    result["bytes"] = bytes;
+
+    QElapsedTimer clock;
+    clock.start();
+    QString error;
+    const bool ok = DocumentWriter::writeFile(target, buffer, DocumentWriter::SyncFile, &error);
+    const double written = milliseconds(clock);
+    result["ok"] = ok;
+    if (!ok) result["error"] = error;
+    result["save_ms"] = written;
+    result["save_mb_per_s"] = megabytesPerSecond(bytes, written);
+
+    // An autosave costs the UI thread only the snapshot and the enqueue;
+    // the rest happens on the writer thread and is timed by the flush.
+    DocumentWriter writer;
+    writer.setSyncPolicy(DocumentWriter::SyncFile);
+
+    clock.restart();
+    writer.save(target, buffer, true);
+    result["autosave_ui_us"] = milliseconds(clock) * 1000.0;
+    writer.flush();
+    result["autosave_total_ms"] = milliseconds(clock);
+
+    // The same snapshot again is only hashed and then skipped.
+    clock.restart();
+    writer.save(target, buffer);
+    writer.flush();
+    result["autosave_unchanged_ms"] = milliseconds(clock);
+
+    QFile::remove(target);
+    return result;
+}
+
+// Counts every match of a plain and of a regular expression query the way
+// the find bar does, in slices from the event loop, then replaces all of
+// the plain matches and undoes that again.
+QJsonObject benchFind(CodeEditor *editor, const QString &kind, qint64 timeoutMs) {
+    QJsonObject result;
+    const qint64 bytes = editor->textBuffer().size();
+
+    auto count = [&](const TextSearch::Query &query, const QString &prefix) {
+        QElapsedTimer clock;
+        clock.start();
+        editor->setSearchQuery(query);
+        const bool done = waitUntil([&] { return editor->isSearchComplete(); }, timeoutMs);
+        const double elapsed = milliseconds(clock);
+        result[prefix + "_ok"] = done;
+        result[prefix + "_matches"] = editor->searchMatchCount();
+        result[prefix + "_truncated"] = editor->isSearchTruncated();
+        result[prefix + "_ms"] = elapsed;
+        result[prefix + "_mb_per_s"] = megabytesPerSecond(bytes, elapsed);
+    };
+
+    TextSearch::Query literal;
+    literal.pattern = kind == "cpp" ? "weight" : "ERROR";
+    literal.caseSensitive = true;
+    count(literal, "literal");
+
+    TextSearch::Query folded = literal;
+    folded.caseSensitive = false;
+    count(folded, "literal_nocase");
+
+    TextSearch::Query expression;
+    expression.pattern = kind == "cpp" ? "Node\\d+" : "status=5\\d\\d";
+    expression.regularExpression = true;
+    count(expression, "regex");
+
+    if (!editor->isReadOnly()) {
+        editor->setSearchQuery(literal);
+        QElapsedTimer clock;
+        clock.start();
+        const qint64 replaced = editor->replaceAll(literal.pattern.toLower());
+        result["replace_all_count"] = replaced;
+        result["replace_all_ms"] = milliseconds(clock);
+
+        clock.restart();
+        QKeyEvent undo(QEvent::KeyPress, Qt::Key_Z, Qt::ControlModifier);
+        QApplication::sendEvent(editor, &undo);
+        result["replace_all_undo_ms"] = milliseconds(clock);
+    }
+
+    editor->clearSearch();
+    return result;
+}
+
+// Searches the whole corpus directory with every core, the way the find in
+// files panel does, and times the first hit as well as the whole search.
+QJsonObject benchFindInFiles(const QString &dir, const QString &pattern, qint64 timeoutMs) {
+    QJsonObject result;
+    TextSearch::Query query;
+    query.pattern = pattern;
+    query.caseSensitive = true;
+
+    FindInFiles search(dir, query);
+    qint64 hits = 0;
+    double firstHit = -1;
+    bool finished = false;
+
+    QElapsedTimer clock;
+    QObject::connect(&search, &FindInFiles::hitsFound, [&](const QVector<FindInFiles::Hit> &found) {
+        if (firstHit < 0) firstHit = milliseconds(clock);
+        hits += found.size();
+    });
+    QObject::connect(&search, &FindInFiles::finished, [&] { finished = true; });
+
+    clock.start();
+    search.start();
+    const bool done = waitUntil([&] { return finished; }, timeoutMs);
+    const double elapsed = milliseconds(clock);
+    if (!done) search.cancel();
+
+    result["ok"] = done;
+    result["pattern"] = pattern;
+    result["threads"] = QThread::idealThreadCount();
+    result["files"] = search.filesSearched();
+    result["bytes"] = search.bytesSearched();
+    result["hits"] = hits;
+    result["truncated"] = search.isTruncated();
+    result["first_hit_ms"] = firstHit;
+    result["ms"] = elapsed;
+    result["mb_per_s"] = megabytesPerSecond(search.bytesSearched(), elapsed);
+    return result;
+}
+
+// Fills a path index with a synthetic tree of a million files and types a
+// query one character at a time, the way the quick open box sees it.
+QJsonObject benchQuickOpen() {
+    QJsonObject result;
+    const int fileCount = 1000000;
+    QStringList paths;
+    paths.reserve(fileCount);
+    for (int i = 0; i < fileCount; ++i) {
+        paths.append(QString("src/module%1/part%2/source_file_%3.cpp").arg(i % 97).arg(i % 1013).arg(i));
+    }
+    paths[fileCount / 2] = "src/ui/mainwindow/MainWindow.cpp";
+
+    PathIndex index;
+    QElapsedTimer clock;
+    clock.start();
+    index.insert(paths);
+    result["files"] = index.count();
+    result["insert_ms"] = milliseconds(clock);
+
+    const QString typed = "mainwindow";
+    QJsonArray keystrokes;
+    double worst = 0;
+    bool found = false;
+    for (int length = 1; length <= typed.size(); ++length) {
+        clock.restart();
+        const QVector<PathIndex::Result> matches = index.query(typed.left(length), 50);
+        const double elapsed = milliseconds(clock);
+        worst = std::max(worst, elapsed);
+        keystrokes.append(elapsed);
+        found = !matches.isEmpty() && matches.first().path.endsWith("MainWindow.cpp");
+    }
+    result["ok"] = found;
+    result["query"] = typed;
+    result["keystroke_ms"] = keystrokes;
+    result["worst_keystroke_ms"] = worst;
+    return result;
+}
+
+// Indexes a synthetic tree of twenty thousand C++ files from scratch, looks
+// symbols up, then edits one file and times the incremental pass.
+QJsonObject benchSymbols(const QString &dir, qint64 timeoutMs) {
+    QJsonObject result;
+    const int fileCount = 20000;
+    // A directory of its own, removed on return, so a reused --dir is not
+    // left with the tree for the next run's find in files to search.
+    QTemporaryDir work(dir + "/symbols-XXXXXX");
+    if (!work.isValid()) {
+        result["ok"] = false;
+        return result;
+    }
+    const QString root = work.path() + "/tree";
+    for (int i = 0; i < fileCount; ++i) {
+        const QString directory = QString("%1/module%2").arg(root).arg(i % 100);
+        if (i < 100) QDir().mkpath(directory);
+        QFile file(QString("%1/widget%2.cpp").arg(directory).arg(i));
+        if (!file.open(QIODevice::WriteOnly)) {
+            result["ok"] = false;
+            return result;
+        }
+        file.write(QString("#include \"module.h\"\n"
+                           "namespace bench%1 {\n"
+                           "class Widget%2 {\n"
+                           "public:\n"
+                           "    int value() const;\n"
+                           "    void setValue(int v);\n"
+                           "private:\n"
+                           "    int m_value = 0;\n"
+                           "};\n"
+                           "int Widget%2::value() const { return m_value; }\n"
+                           "void Widget%2::setValue(int v) { m_value = v; }\n"
+                           "static int helper%2(int x) { return x * 2; }\n"
+                           "}\n").arg(i % 100).arg(i).toUtf8());
+    }
+
+    SymbolIndex index;
+    index.setCacheDirectory(work.path() + "/cache");
+    QElapsedTimer clock;
+    clock.start();
+    index.setRoot(root);
+    bool done = waitUntil([&] { return !index.isIndexing(); }, timeoutMs);
+    result["full_ms"] = milliseconds(clock);
+    result["files"] = index.fileCount();
+
+    // Best of many, since a single lookup is below the clock's resolution.
+    const int lookups = 1000;
+    clock.restart();
+    qint64 found = 0;
+    for (int i = 0; i < lookups; ++i) {
+        found += index.definitions(QString("Widget%1").arg(i * 17 % fileCount)).size();
+    }
+    result["lookup_us"] = milliseconds(clock) * 1000 / lookups;
+    clock.restart();
+    const qint64 common = index.definitions("setValue").size();
+    result["common_lookup_ms"] = milliseconds(clock);
+    result["common_definitions"] = common;
+
+    QFile edited(root + "/module7/widget7.cpp");
+    if (edited.open(QIODevice::Append)) edited.write("int addedLater = 1;\n");
+    edited.close();
+    clock.restart();
+    index.refresh();
+    done = waitUntil([&] { return !index.definitions("addedLater").isEmpty(); }, timeoutMs) && done;
+    // Includes the delay refresh() waits for more saves.
+    result["incremental_ms"] = milliseconds(clock);
+
+    result["ok"] = done && found == lookups;
+    return result;
+}
+
+// Prints the file through the terminal panel's shell and times until a
+// marker echoed after it has been drawn, i.e. all of the output has gone
+// through the parser and onto the screen.
+QJsonObject benchTerminal(const QString &path, qint64 timeoutMs) {
+    QJsonObject result;
+    TerminalWidget terminal;
+    terminal.resize(1200, 300);
+    terminal.setWorkingDirectory(QFileInfo(path).absolutePath());
+    terminal.show();
+
+    QLineEdit *input = terminal.findChild<QLineEdit*>();
+    TerminalView *output = terminal.findChild<TerminalView*>();
+    if (!input || !output) {
+        result["ok"] = false;
+        return result;
+    }
+
+    // The marker is split in the command so the echoed command line never
+    // matches it; only the printed one does.
+    const QString marker = "__chora_bench_done__";
+#ifdef Q_OS_WIN
+    input->setText("type \"" + QDir::toNativeSeparators(path) + "\" & echo __chora_bench^_done__");
+#else
+    input->setText("cat '" + path + "'; echo __chora_bench''_done__");
+#endif
+
+    auto markerShown = [&] {
+        const TerminalScreen *screen = output->screen();
+        for (int row = 0; row < screen->rows(); ++row) {
+            if (screen->rowText(row) == marker) return true;
+        }
+        return false;
+    };
+
+    QElapsedTimer clock;
+    clock.start();
+    QKeyEvent press(QEvent::KeyPress, Qt::Key_Return, Qt::NoModifier);
+    QApplication::sendEvent(input, &press);
+
+    const bool finished = waitUntil(markerShown, timeoutMs);
+    QCoreApplication::processEvents();
+    const double elapsed = milliseconds(clock);
+
+    const qint64 bytes = QFileInfo(path).size();
+    result["ok"] = finished;
+    result["timed_out"] = !finished;
+    result["ms"] = elapsed;
+    result["retained_lines"] = output->buffer()->lineCount();
+    result["total_lines"] = output->buffer()->droppedLines() + output->buffer()->lineCount();
+    if (finished) result["mb_per_s"] = megabytesPerSecond(bytes, elapsed);
+    return result;
+}
+
+// Prints the file from several background jobs at once; they all share the
+// one reader thread. Timed until every job has exited and been drawn.
+QJsonObject benchTerminalJobs(const QString &path, int jobs, qint64 timeoutMs) {
+    QJsonObject result;
+    TerminalWidget terminal;
+    terminal.resize(1200, 300);
+    terminal.setWorkingDirectory(QFileInfo(path).absolutePath());
+    terminal.show();
+
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < jobs; ++i) {
+#ifdef Q_OS_WIN
+        terminal.runJob("type \"" + QDir::toNativeSeparators(path) + "\"");
+#else
+        terminal.runJob("cat '" + path + "'");
+#endif
+    }
+
+    auto allDone = [&] {
+        for (TerminalSession *session : terminal.findChildren<TerminalSession*>()) {
+            if (session->kind() == TerminalSession::Job && session->isRunning()) return false;
+        }
+        return true;
+    };
+    const bool finished = waitUntil(allDone, timeoutMs);
+    QCoreApplication::processEvents();
+    const double elapsed = milliseconds(clock);
+
+    result["ok"] = finished;
+    result["timed_out"] = !finished;
+    result["jobs"] = jobs;
+    result["ms"] = elapsed;
+    if (finished) result["mb_per_s"] = megabytesPerSecond(QFileInfo(path).size() * jobs, elapsed);
+    return result;
+}
+
+QJsonObject runCorpus(const QString &path, const QString &kind, const Options &options) {
+    QJsonObject result;
+    result["corpus"] = kind;
+    result["file"] = QFileInfo(path).fileName();
+    result["bytes"] = QFileInfo(path).size();
+
+    auto editor = std::make_unique<CodeEditor>();
+    editor->resize(1200, 800);
+    editor->show();
+    QCoreApplication::processEvents();
+
+    const QJsonObject open = benchOpen(editor.get(), path, options.timeoutMs);
+    result["open"] = open;
+    if (!open["ok"].toBool()) return result;
+
+    if (kind == "cpp") {
+        result["highlight"] = benchHighlight(editor.get(), options.timeoutMs);
+        if (open["mode"].toString() == "loaded") {
+            result["reopen"] = benchReopen(path, QFileInfo(path).absolutePath(), options.timeoutMs);
+        }
+    }
+    result["scroll"] = benchScroll(editor.get(), kind == "cpp", options.frames);
+    result["save"] = benchSave(editor.get(), QFileInfo(path).absolutePath());
+    result["find"] = benchFind(editor.get(), kind, options.timeoutMs);
+
+    if (kind == "log") {
+        result["terminal"] = benchTerminal(path, options.timeoutMs);
+        result["terminal_jobs"] = benchTerminalJobs(path, 4, options.timeoutMs);
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    // Headless unless a platform was asked for explicitly.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("chora-bench");
+    QCoreApplication::setApplicationVersion(CHORA_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless performance benchmarks for Chora Spatium.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    QCommandLineOption sizesOption("sizes", "Corpus sizes, e.g. 1M,100M,1G.", "list", "1M,100M,1G");
+    QCommandLineOption corporaOption("corpora", "Corpora to run: cpp, log.", "list", "cpp,log");
+    QCommandLineOption dirOption("dir", "Directory for the generated corpora; reused between runs.", "path");
+    QCommandLineOption outputOption("output", "Write the JSON results to file instead of stdout.", "file");
+    QCommandLineOption framesOption("frames", "Scroll frames per corpus.", "count", "200");
+    QCommandLineOption timeoutOption("timeout", "Per-step timeout in seconds.", "seconds", "120");
+    parser.addOptions({sizesOption, corporaOption, dirOption, outputOption, framesOption, timeoutOption});
+    parser.process(app);
+
+    Options options;
+    for (const QString &text : parser.value(sizesOption).split(',', Qt::SkipEmptyParts)) {
+        const qint64 size = parseSize(text);
+        if (size < 0) {
+            std::fprintf(stderr, "chora-bench: invalid size '%s'\n", qPrintable(text));
+            return 2;
+        }
+        options.sizes.append(size);
+    }
+    for (const QString &kind : parser.value(corporaOption).split(',', Qt::SkipEmptyParts)) {
+        if (kind != "cpp" && kind != "log") {
+            std::fprintf(stderr, "chora-bench: unknown corpus '%s'\n", qPrintable(kind));
+            return 2;
+        }
+        options.corpora.append(kind);
+    }
+    options.frames = qMax(1, parser.value(framesOption).toInt());
+    options.timeoutMs = qMax(1LL, parser.value(timeoutOption).toLongLong()) * 1000;
+
+    QTemporaryDir temporaryDir;
+    QString dir = parser.value(dirOption);
+    if (dir.isEmpty()) {
+        if (!temporaryDir.isValid()) {
+            std::fprintf(stderr, "chora-bench: cannot create a temporary directory\n");
+            return 1;
+        }
+        dir = temporaryDir.path();
+    } else {
+        QDir().mkpath(dir);
+    }
+
+    QJsonArray results;
+    for (const QString &kind : options.corpora) {
+        for (qint64 size : options.sizes) {
+            std::fprintf(stderr, "chora-bench: %s %s\n", qPrintable(kind), qPrintable(sizeLabel(size)));
+            const QString path = generateCorpus(dir, kind, size);
+            if (path.isEmpty()) {
+                std::fprintf(stderr, "chora-bench: cannot write corpus to %s\n", qPrintable(dir));
+                return 1;
+            }
+            results.append(runCorpus(path, kind, options));
+        }
+    }
+
+    const QString folderPattern = options.corpora.contains("log") ? "ERROR" : "weight";
+    const QJsonObject findInFiles = benchFindInFiles(dir, folderPattern, options.timeoutMs);
+    const QJsonObject quickOpen = benchQuickOpen();
+    const QJsonObject symbols = benchSymbols(dir, options.timeoutMs);
+
+    QJsonObject report;
+    report["benchmark"] = "chora-bench";
+    report["version"] = QCoreApplication::applicationVersion();
+    report["qt"] = qVersion();
+    report["platform"] = QGuiApplication::platformName();
+    report["os"] = QSysInfo::prettyProductName();
+    report["cpu"] = QSysInfo::currentCpuArchitecture();
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["results"] = results;
+    report["find_in_files"] = findInFiles;
+    report["quick_open"] = quickOpen;
+    report["symbols"] = symbols;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    const QString outputPath = parser.value(outputOption);
+    if (outputPath.isEmpty()) {
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+        return 0;
+    }
+
+    QFile output(outputPath);
+    if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate) || output.write(json) != json.size()) {
+        std::fprintf(stderr, "chora-bench: cannot write %s\n", qPrintable(outputPath));
+        return 1;
+    }
+    return 0;
+}
@@ -2,26 +2,91 @@
 #include <QTextBlock>
 #include <QScrollBar>
 #include <QKeyEvent>
+#include <QFile>
 #include <QFileInfo>
+#include <QTimer>
+#include <QtMath>
+
+#include <limits>
 
 #include "codeeditor.h"
 #include "linenum.h"
+#include "minimap.h"
+#include "mappedfile.h"
+#include "fileloader.h"
+#include "filefollower.h"
 #include "highlighter/cpp.h"
 #include "highlighter/c.h"
 
+static const qint64 PageLines = 4000;
+static const qint64 PageMargin = 500;
+static const qint64 PageMaxBytes = 8 * 1024 * 1024;
+static const qint64 IndexSliceBytes = 32 * 1024 * 1024;
+static const qint64 FollowTailBytes = 4 * 1024 * 1024;
+static const qint64 SearchSliceBytes = 32 * 1024 * 1024;
+static const qint64 ExpressionSliceBytes = 4 * 1024 * 1024;
+static const qint64 FindBackwardBytes = 1024 * 1024;
+static const int MaxMatchSelections = 2000;
+// What a block costs beyond its text: the block itself, its layout and
+// formats. Measured roughly; only used to weigh tabs against each other.
+static const qint64 BlockOverheadBytes = 256;
+// A savedRevision no buffer ever has.
+static const quint64 NeverSaved = std::numeric_limits<quint64>::max();
+
+// UTF-16 units the editor shows for the bytes in [from, to) of one line.
+static qint64 utf16Length(const TextBuffer &buffer, qint64 from, qint64 to) {
+    QString text = QString::fromUtf8(buffer.read(from, to - from));
+    TextBuffer::foldLineEndings(text);
+    return text.size();
+}
+
 CodeEditor::CodeEditor(QWidget *parent)
     : QPlainTextEdit(parent)
     , lineNumberArea(new LineNumberArea(this))
     , lineNumbersVisible(true)
+    , gutterCurrentBlock(-1)
+    , minimap(new Minimap(document(), this))
+    , minimapVisible(true)
     , syntaxHighlighter(nullptr)
+    , highlightLanguage(nullptr)
+    , highlightCache(nullptr)
     , lineNumberAreaColor(QColor(40, 44, 52))
     , lineNumberTextColor(QColor(128, 128, 128))
     , currentLineColor(QColor(45, 49, 57))
+    , matchColor(QColor(97, 84, 38))
+    , bufferReady(true)
+    , savedRevision(0)
+    , history(std::make_unique<UndoHistory>())
+    , applyingHistory(false)
+    , pendingHistoryHash(0)
+    , searchTimer(new QTimer(this))
+    , pageFirstLine(0)
+    , pageLineCount(0)
+    , pageLoading(false)
+    , pageScrollBar(nullptr)
+    , indexTimer(nullptr)
+    , loadUnsaved(false)
+    , loadBytesRead(0)
+    , loadBytesTotal(0)
+    , follower(nullptr)
+    , pendingLine(-1)
+    , pendingColumn(0)
+    , pendingLength(0)
+    , pendingTopLine(-1)
 {
     connect(this, &QPlainTextEdit::blockCountChanged, this, &CodeEditor::updateLineNumberAreaWidth);
     connect(this, &QPlainTextEdit::updateRequest, this, &CodeEditor::updateLineNumberArea);
     connect(this, &QPlainTextEdit::cursorPositionChanged, this, &CodeEditor::highlightCurrentLine);
+    connect(document(), &QTextDocument::contentsChange, this, &CodeEditor::onContentsChange);
+    document()->setUndoRedoEnabled(false);
+    history->markClean();
+    connect(minimap, &Minimap::lineRequested, this, &CodeEditor::centerOnBlock);
+
+    searchTimer->setInterval(0);
+    connect(searchTimer, &QTimer::timeout, this, &CodeEditor::searchNextSlice);
 
+    gutter.setFont(font());
+    gutter.setColors(lineNumberTextColor, QColor(200, 200, 200));
     updateLineNumberAreaWidth(0);
     highlightCurrentLine();
 
@@ -33,57 +98,51 @@ CodeEditor::CodeEditor(QWidget *parent)
     setTabStopDistance(fontMetrics().horizontalAdvance(' ') * 4);
 }
 
+CodeEditor::~CodeEditor() {
+    cancelLoading();
+}
+
 void CodeEditor::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
     QPainter painter(lineNumberArea);
-    painter.fillRect(event->rect(), lineNumberAreaColor);
+    const QRect area = event->rect();
+    painter.fillRect(area, lineNumberAreaColor);
+    gutter.begin();
 
     QTextBlock block = firstVisibleBlock();
     int blockNumber = block.blockNumber();
     int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
-    int bottom = top + qRound(blockBoundingRect(block).height());
-
-    const int areaWidth = lineNumberArea->width();
-    const int fontHeight = fontMetrics().height();
-
-    int currentLine = textCursor().blockNumber();
-
-    while (block.isValid() && top <= event->rect().bottom()) {
-        if (block.isVisible() && bottom >= event->rect().top()) {
-            QString number = QString::number(blockNumber + 1);
-
-            if (blockNumber == currentLine) {
-                painter.setPen(QColor(200, 200, 200));
-                QFont boldFont = painter.font();
-                boldFont.setBold(true);
-                painter.setFont(boldFont);
-            } else {
-                painter.setPen(lineNumberTextColor);
-                QFont normalFont = painter.font();
-                normalFont.setBold(false);
-                painter.setFont(normalFont);
-            }
+    const int right = lineNumberArea->width() - 5;
 
-            painter.drawText(0, top, areaWidth - 5, fontHeight,
-                             Qt::AlignRight, number);
+    while (block.isValid() && top <= area.bottom()) {
+        const int height = qRound(blockBoundingRect(block).height());
+
+        if (block.isVisible() && top + height >= area.top()) {
+            const qint64 line = pageFirstLine + blockNumber;
+            if (!markers.isEmpty()) {
+                const auto marker = markers.constFind(line);
+                if (marker != markers.constEnd()) {
+                    gutter.drawMarkers(&painter, marker.value(), top, height);
+                }
+            }
+            gutter.drawLineNumber(&painter, line + 1, right, top, blockNumber == gutterCurrentBlock);
         }
 
         block = block.next();
-        top = bottom;
-        bottom = top + qRound(blockBoundingRect(block).height());
+        top += height;
         ++blockNumber;
     }
 }
 
 int CodeEditor::lineNumberAreaWidth() {
     int digits = 1;
-    int max = qMax(1, blockCount());
+    qint64 max = qMax<qint64>(1, isPaged() ? totalLineCount() : blockCount());
     while (max >= 10) {
         max /= 10;
         ++digits;
     }
 
-    int space = 10 + fontMetrics().horizontalAdvance(QLatin1Char('9')) * (digits + 1);
+    int space = 10 + gutter.digitWidth() * (digits + 1);
     return space;
 }
 
@@ -97,24 +156,928 @@ bool CodeEditor::areLineNumbersVisible() const {
     return lineNumbersVisible;
 }
 
-void CodeEditor::setSyntaxHighlighter(QSyntaxHighlighter *highlighter) {
+void CodeEditor::setMinimapVisible(bool visible) {
+    minimapVisible = visible;
+    minimap->setVisible(visible);
+    updateLineNumberAreaWidth(0);
+}
+
+bool CodeEditor::isMinimapVisible() const {
+    return minimapVisible;
+}
+
+void CodeEditor::centerOnBlock(int blockNumber) {
+    const QTextBlock block = document()->findBlockByNumber(blockNumber);
+    if (!block.isValid()) return;
+
+    // Scroll bar values count layout lines, which differ from block numbers
+    // once lines wrap.
+    verticalScrollBar()->setValue(qMax(0, block.firstLineNumber() - visibleLineCount() / 2));
+}
+
+void CodeEditor::setLineMarkers(qint64 line, int lineMarkers) {
+    if (lineMarkers == GutterRenderer::NoMarker) {
+        if (markers.remove(line) == 0) return;
+    } else {
+        int &stored = markers[line];
+        if (stored == lineMarkers) return;
+        stored = lineMarkers;
+    }
+
+    const qint64 blockNumber = line - pageFirstLine;
+    if (blockNumber >= 0 && blockNumber < blockCount()) {
+        updateGutterRow(int(blockNumber));
+    }
+}
+
+int CodeEditor::lineMarkers(qint64 line) const {
+    return markers.value(line, GutterRenderer::NoMarker);
+}
+
+void CodeEditor::clearLineMarkers() {
+    if (markers.isEmpty()) return;
+    markers.clear();
+    lineNumberArea->update();
+}
+
+void CodeEditor::setSyntaxHighlighter(SyntaxHighlighter *highlighter) {
     if (syntaxHighlighter) {
         delete syntaxHighlighter;
     }
     syntaxHighlighter = highlighter;
+    updateVisibleBlocks();
 }
 
 void CodeEditor::detectAndApplySyntaxHighlighting(const QString &filePath) {
-    QFileInfo fileInfo(filePath);
-    QString extension = fileInfo.suffix().toLower();
-
-    if (extension == "cpp" || extension == "hpp" || extension == "h") {
+    switch (Lexer::dialectOf(QFileInfo(filePath).fileName())) {
+    case Lexer::Cpp:
         setSyntaxHighlighter(new CppHighlighter(document()));
-    } else if (extension == "c" || extension == "h") {
+        highlightLanguage = &CppHighlighter::definition();
+        break;
+    case Lexer::C:
         setSyntaxHighlighter(new CHighlighter(document()));
+        highlightLanguage = &CHighlighter::definition();
+        break;
+    case Lexer::Plain:
+        break;
+    }
+}
+
+void CodeEditor::setHighlightCache(HighlightCache *cache) {
+    highlightCache = cache;
+}
+
+
+const TextBuffer &CodeEditor::textBuffer() const {
+    return buffer;
+}
+
+qint64 CodeEditor::totalLineCount() const {
+    if (isPaged() && !bufferReady) {
+        return pagedFile->lineCount();
+    }
+    return buffer.lineCount();
+}
+
+bool CodeEditor::hasUnsavedChanges() const {
+    return bufferReady && buffer.revision() != savedRevision;
+}
+
+void CodeEditor::markSaved(quint64 revision) {
+    savedRevision = revision;
+    if (buffer.revision() == revision) {
+        document()->setModified(false);
+        history->markClean();
+    }
+}
+
+void CodeEditor::onContentsChange(int position, int charsRemoved, int charsAdded) {
+    if (!bufferReady || pageLoading || applyingHistory) return;
+    if (syntaxHighlighter && syntaxHighlighter->isApplyingFormats()) return;
+
+    // Everything before position is unchanged, so its byte offset can be
+    // found in the buffer before the edit is applied to it.
+    QTextBlock block = document()->findBlock(position);
+    const qint64 lineStart = buffer.lineStart(pageFirstLine + block.blockNumber());
+    const qint64 offset = buffer.advanceUtf16(lineStart, position - block.position());
+
+    // Qt may report the trailing paragraph separator as part of the change.
+    const int end = qMin(position + charsAdded, document()->characterCount() - 1);
+    const qint64 removedEnd = buffer.advanceUtf16(offset, charsRemoved);
+
+    // Highlighters report format changes as a same-length replacement; leave
+    // the buffer alone when the text did not actually change.
+    if (charsRemoved == charsAdded) {
+        QTextCursor cursor(document());
+        cursor.setPosition(position);
+        cursor.setPosition(qMax(position, end), QTextCursor::KeepAnchor);
+        QString text = cursor.selectedText();
+        text.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+
+        QString current = QString::fromUtf8(buffer.read(offset, removedEnd - offset));
+        TextBuffer::foldLineEndings(current);
+        if (current == text) return;
+    }
+
+    const QByteArray removed = buffer.read(offset, removedEnd - offset);
+    buffer.remove(offset, removedEnd - offset);
+
+    // The inserted text is encoded block by block through the encoder's
+    // small buffer, so a large paste is never copied into one QString plus
+    // one QByteArray.
+    qint64 insertAt = offset;
+    auto sink = [this, &insertAt](const char *data, qint64 length) {
+        buffer.insert(insertAt, data, length);
+        insertAt += length;
+    };
+
+    for (QTextBlock textBlock = block; textBlock.isValid() && textBlock.position() < end; textBlock = textBlock.next()) {
+        const int blockStart = textBlock.position();
+        const int blockEnd = blockStart + textBlock.length() - 1;
+        const int from = qMax(position, blockStart);
+        const int to = qMin(end, blockEnd);
+
+        if (from == blockStart && to == blockEnd) {
+            encoder.encode(textBlock.text(), sink);
+        } else if (to > from) {
+            QTextCursor cursor(document());
+            cursor.setPosition(from);
+            cursor.setPosition(to, QTextCursor::KeepAnchor);
+            encoder.encode(cursor.selectedText(), sink);
+        }
+
+        if (blockEnd < end) {
+            encoder.encode(u"\n", sink);
+        }
+    }
+    encoder.finish(sink);
+
+    if (isPaged()) {
+        pageLineCount = blockCount();
+    }
+
+    history->recordEdit(offset, removed, buffer.read(offset, insertAt - offset));
+    updateSearchAfterEdit(offset, removedEnd - offset, insertAt - offset);
+}
+
+void CodeEditor::updateSearchAfterEdit(qint64 offset, qint64 removedLength, qint64 insertedLength) {
+    if (!searchMatches) return;
+    searchMatches->update(buffer, offset, removedLength, insertedLength);
+    if (!searchMatches->isComplete()) {
+        searchTimer->start();
+    }
+    emit searchResultsChanged();
+}
+
+void CodeEditor::openPagedFile(std::shared_ptr<MappedFile> file) {
+    pagedFile = std::move(file);
+    bufferReady = false;
+
+    setReadOnly(true);
+    history->clear();
+    setLineWrapMode(QPlainTextEdit::NoWrap);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+
+    if (!pageScrollBar) {
+        pageScrollBar = new QScrollBar(Qt::Vertical, this);
+        connect(pageScrollBar, &QScrollBar::valueChanged, this, &CodeEditor::onPageScrollBarMoved);
+        connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &CodeEditor::onViewScrolled);
+
+        indexTimer = new QTimer(this);
+        indexTimer->setInterval(0);
+        connect(indexTimer, &QTimer::timeout, this, &CodeEditor::indexNextChunk);
+    }
+    pageScrollBar->show();
+
+    // Index just enough for the first window; the rest is indexed in slices
+    // from the event loop so the first paint does not depend on file size.
+    pagedFile->buildLineIndex(PageMaxBytes);
+    loadPage(0);
+
+    if (pagedFile->isIndexed()) {
+        onIndexComplete();
+    } else {
+        indexTimer->start();
+    }
+
+    updateLineNumberAreaWidth(0);
+    updatePageScrollBarGeometry();
+}
+
+bool CodeEditor::isPaged() const {
+    return pagedFile != nullptr;
+}
+
+qint64 CodeEditor::lineNumberOffset() const {
+    return pageFirstLine;
+}
+
+void CodeEditor::loadFile(const QString &filePath, bool unsaved) {
+    cancelLoading();
+    loadUnsaved = unsaved;
+
+    bufferReady = false;
+    setReadOnly(true);
+    history->clear();
+
+    loadBytesRead = 0;
+    loadBytesTotal = QFileInfo(filePath).size();
+
+    // The text arrives in chunks; blocks the cache has are colored as they
+    // come in instead of being lexed. A snapshot is named for no file the
+    // cache could ever match.
+    highlightEntry.reset();
+    if (highlightCache && syntaxHighlighter && highlightLanguage && !unsaved) {
+        highlightEntry = highlightCache->find(filePath);
+        if (highlightEntry) syntaxHighlighter->setCache(highlightEntry, *highlightLanguage);
+    }
+
+    loader = new FileLoader(filePath);
+    connect(loader, &FileLoader::chunkLoaded, this, &CodeEditor::onChunkLoaded);
+    connect(loader, &FileLoader::progressChanged, this, &CodeEditor::onLoaderProgress);
+    connect(loader, &FileLoader::finished, this, &CodeEditor::onLoaderFinished);
+    loader->start();
+}
+
+bool CodeEditor::isLoading() const {
+    return !loader.isNull();
+}
+
+void CodeEditor::cancelLoading() {
+    if (loader) {
+        loader->cancel();
+    }
+}
+
+qint64 CodeEditor::loadedBytes() const {
+    return loadBytesRead;
+}
+
+qint64 CodeEditor::totalLoadBytes() const {
+    return loadBytesTotal;
+}
+
+qint64 CodeEditor::memoryUsage() const {
+    qint64 usage = qint64(document()->characterCount()) * qint64(sizeof(QChar))
+                 + qint64(document()->blockCount()) * BlockOverheadBytes;
+    if (!isPaged() && bufferReady) {
+        usage += buffer.size();
+    }
+    return usage + history->residentBytes();
+}
+
+std::unique_ptr<UndoHistory> CodeEditor::takeUndoHistory(quint64 *contentHash) {
+    if (!bufferReady || (!history->canUndo() && !history->canRedo())) return nullptr;
+
+    *contentHash = buffer.contentHash();
+    history->release();
+    std::unique_ptr<UndoHistory> taken = std::move(history);
+    history = std::make_unique<UndoHistory>();
+    return taken;
+}
+
+void CodeEditor::setUndoHistory(std::unique_ptr<UndoHistory> released, quint64 contentHash) {
+    pendingHistory = std::move(released);
+    pendingHistoryHash = contentHash;
+}
+
+void CodeEditor::followFile(const QString &filePath, int maxLines) {
+    cancelLoading();
+
+    // Nothing is mirrored into the buffer, so there is never anything to
+    // save; the text on screen is only a tail of the file.
+    bufferReady = false;
+    setReadOnly(true);
+    history->clear();
+    setMaximumBlockCount(maxLines);
+    pageFirstLine = 0;
+
+    if (!follower) {
+        follower = new FileFollower(filePath, this);
+        connect(follower, &FileFollower::appended, this, &CodeEditor::onFollowerAppended);
+        connect(follower, &FileFollower::restarted, this, &CodeEditor::onFollowerRestarted);
+    }
+    follower->setMaximumLines(maxLines);
+
+    // Only the last lines are ever shown, so reading starts near the end,
+    // at the beginning of a line.
+    qint64 start = qMax<qint64>(0, QFileInfo(filePath).size() - FollowTailBytes);
+    if (start > 0) {
+        QFile file(filePath);
+        if (file.open(QIODevice::ReadOnly) && file.seek(start)) {
+            const qsizetype newline = file.read(64 * 1024).indexOf('\n');
+            if (newline >= 0) start += newline + 1;
+        }
+    }
+    follower->start(start);
+}
+
+bool CodeEditor::isFollowing() const {
+    return follower != nullptr;
+}
+
+void CodeEditor::onFollowerAppended(const QString &text, qint64 skippedLines) {
+    QScrollBar *bar = verticalScrollBar();
+    const bool pinned = bar->value() >= bar->maximum();
+
+    // Line numbers keep counting from where following started even though
+    // the oldest blocks are dropped, both here and by the block limit.
+    const int blocksBefore = blockCount();
+    const int blocksAdded = int(text.count(QLatin1Char('\n')));
+
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+
+    pageFirstLine += skippedLines + qMax(0, blocksBefore + blocksAdded - blockCount());
+    if (skippedLines > 0) {
+        lineNumberArea->update();
+    }
+
+    if (pinned) {
+        bar->setValue(bar->maximum());
+    }
+}
+
+void CodeEditor::onFollowerRestarted() {
+    // The file was truncated or replaced.
+    clear();
+    pageFirstLine = 0;
+    lineNumberArea->update();
+}
+
+void CodeEditor::goToLine(qint64 line, int column, int length) {
+    pendingLine = qMax<qint64>(0, line);
+    pendingColumn = qMax(0, column);
+    pendingLength = qMax(0, length);
+    pendingTopLine = -1;
+    applyPendingLine();
+}
+
+void CodeEditor::restoreView(qint64 line, int column, qint64 firstVisibleLine) {
+    pendingLine = qMax<qint64>(0, line);
+    pendingColumn = qMax(0, column);
+    pendingLength = 0;
+    pendingTopLine = firstVisibleLine;
+    applyPendingLine();
+}
+
+qint64 CodeEditor::firstVisibleLine() const {
+    return pageFirstLine + firstVisibleBlock().blockNumber();
+}
+
+void CodeEditor::applyPendingLine() {
+    if (pendingLine < 0) return;
+
+    const qint64 knownLines = isPaged() ? totalLineCount() : blockCount();
+    const bool growing = isLoading() || (isPaged() && !bufferReady);
+    if (pendingLine >= knownLines && growing) return;
+
+    const qint64 line = qMin(pendingLine, knownLines - 1);
+    const qint64 topLine = pendingTopLine;
+    pendingLine = -1;
+    pendingTopLine = -1;
+    if (isPaged() && (line < pageFirstLine || line >= pageFirstLine + pageLineCount)) {
+        repage(line - visibleLineCount() / 2);
+    }
+
+    const QTextBlock block = document()->findBlockByNumber(int(line - pageFirstLine));
+    if (!block.isValid()) return;
+
+    const int last = block.length() - 1;
+    QTextCursor cursor(block);
+    cursor.setPosition(block.position() + qMin(pendingColumn, last));
+    cursor.setPosition(block.position() + qMin(pendingColumn + pendingLength, last), QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+
+    // A top line outside the loaded page falls back to centering.
+    if (topLine >= pageFirstLine && topLine - pageFirstLine < blockCount()) {
+        const QTextBlock top = document()->findBlockByNumber(int(topLine - pageFirstLine));
+        verticalScrollBar()->setValue(top.firstLineNumber());
+    } else {
+        centerCursor();
+    }
+}
+
+void CodeEditor::setSearchQuery(const TextSearch::Query &query) {
+    if (searchMatches && searchMatches->search().query() == query) return;
+
+    searchMatches = std::make_unique<SearchMatches>(query);
+    matchView = MatchView();
+    restartSearch();
+}
+
+void CodeEditor::clearSearch() {
+    if (!searchMatches) return;
+
+    searchMatches.reset();
+    searchTimer->stop();
+    updateMatchSelections();
+    emit searchResultsChanged();
+}
+
+bool CodeEditor::hasSearch() const {
+    return searchMatches != nullptr;
+}
+
+QString CodeEditor::searchError() const {
+    return searchMatches ? searchMatches->search().errorString() : QString();
+}
+
+qint64 CodeEditor::searchMatchCount() const {
+    return searchMatches ? searchMatches->count() : 0;
+}
+
+bool CodeEditor::isSearchComplete() const {
+    return !searchMatches || searchMatches->isComplete();
+}
+
+bool CodeEditor::isSearchTruncated() const {
+    return searchMatches && searchMatches->isTruncated();
+}
+
+bool CodeEditor::findNext(bool backward) {
+    if (!searchMatches || !bufferReady || !searchMatches->search().isValid()) return false;
+
+    const TextSearch &search = searchMatches->search();
+    const QTextCursor cursor = textCursor();
+    TextSearch::Match match;
+    bool found = false;
+
+    if (backward) {
+        const qint64 start = offsetAt(cursor.selectionStart());
+        found = findBefore(start, &match) || findBefore(buffer.size(), &match);
+    } else {
+        const qint64 start = offsetAt(cursor.selectionEnd());
+        TextSearch::Scanner after(search, buffer, start, buffer.size());
+        found = after.next(&match);
+        if (!found) {
+            TextSearch::Scanner wrapped(search, buffer, 0, start);
+            found = wrapped.next(&match);
+        }
+    }
+
+    if (found) {
+        selectBufferRange(match.offset, match.length);
+    }
+    return found;
+}
+
+bool CodeEditor::findBefore(qint64 offset, TextSearch::Match *match) const {
+    // Matches are only found walking forward, so the text before offset is
+    // searched in windows that grow towards the start of the buffer.
+    qint64 window = FindBackwardBytes;
+    for (qint64 end = offset; end > 0; window *= 2) {
+        const qint64 start = qMax<qint64>(0, end - window);
+        TextSearch::Scanner scanner(searchMatches->search(), buffer, start, end);
+        TextSearch::Match candidate;
+        bool found = false;
+        while (scanner.next(&candidate)) {
+            *match = candidate;
+            found = true;
+        }
+        if (found) return true;
+        end = start;
+    }
+    return false;
+}
+
+bool CodeEditor::replaceNext(const QString &replacement) {
+    if (!searchMatches || !bufferReady || isReadOnly()) return false;
+
+    QTextCursor cursor = textCursor();
+    if (cursor.hasSelection()) {
+        const qint64 start = offsetAt(cursor.selectionStart());
+        const qint64 end = offsetAt(cursor.selectionEnd());
+
+        TextSearch::Scanner scanner(searchMatches->search(), buffer, start, start + 1);
+        TextSearch::Match match;
+        if (scanner.next(&match) && match.offset == start && match.offset + match.length == end) {
+            cursor.insertText(QString::fromUtf8(scanner.replacement(replacement)));
+            setTextCursor(cursor);
+        }
+    }
+    return findNext();
+}
+
+qint64 CodeEditor::replaceAll(const QString &replacement) {
+    if (!searchMatches || !bufferReady || isReadOnly() || !searchMatches->search().isValid()) return 0;
+
+    // Matches are read from a snapshot while the buffer is rebuilt in one
+    // pass, rather than edited one match at a time through the document.
+    const TextBuffer before = buffer;
+    TextSearch::Scanner scanner(searchMatches->search(), before, 0, before.size());
+    qint64 count = 0;
+    buffer.replace([&](TextBuffer::Replacement *edit) {
+        TextSearch::Match match;
+        if (!scanner.next(&match)) return false;
+        edit->offset = match.offset;
+        edit->length = match.length;
+        edit->text = scanner.replacement(replacement);
+        ++count;
+        return true;
+    });
+    if (count == 0) return 0;
+
+    // The history works on the buffer, so typing before and after the
+    // rebuild stays in order with it.
+    history->recordSwap(before, buffer);
+
+    reloadFromBuffer();
+    return count;
+}
+
+bool CodeEditor::applyHistory(bool redo) {
+    if (!bufferReady || isReadOnly()) return false;
+
+    UndoHistory::Step step;
+    if (!(redo ? history->redo(&step) : history->undo(&step))) return false;
+
+    if (step.isSwap) {
+        buffer = redo ? step.after : step.before;
+        reloadFromBuffer();
+    } else if (redo) {
+        replaceBufferRange(step.offset, step.removed.size(), step.inserted);
+    } else {
+        replaceBufferRange(step.offset, step.inserted.size(), step.removed);
+    }
+
+    // Back at the text that was saved, even though the buffer has a new
+    // revision.
+    if (history->isClean()) {
+        savedRevision = buffer.revision();
+    }
+    document()->setModified(hasUnsavedChanges());
+    return true;
+}
+
+void CodeEditor::replaceBufferRange(qint64 offset, qint64 length, const QByteArray &text) {
+    // The buffer gets the exact bytes, which the document's text would not
+    // give back for line endings it folds.
+    const int from = positionAt(offset);
+    const int to = positionAt(offset + length);
+    buffer.remove(offset, length);
+    buffer.insert(offset, text.constData(), text.size());
+
+    if (isPaged() || from < 0 || to < 0) {
+        reloadFromBuffer();
+    } else {
+        QString shown = QString::fromUtf8(text);
+        TextBuffer::foldLineEndings(shown);
+        QTextCursor cursor(document());
+        cursor.setPosition(from);
+        cursor.setPosition(to, QTextCursor::KeepAnchor);
+        applyingHistory = true;
+        cursor.insertText(shown);
+        applyingHistory = false;
+        updateSearchAfterEdit(offset, length, text.size());
+    }
+    selectBufferRange(offset + text.size(), 0);
+}
+
+void CodeEditor::reloadFromBuffer() {
+    if (isPaged()) {
+        repage(pageFirstLine + verticalScrollBar()->value());
+    } else {
+        const QTextCursor cursor = textCursor();
+        const int cursorBlock = cursor.blockNumber();
+        const int cursorColumn = cursor.positionInBlock();
+        const int scroll = verticalScrollBar()->value();
+
+        qint64 lines = 0;
+        pageLoading = true;
+        setPlainText(readBufferLines(0, buffer.lineCount(), buffer.size(), &lines));
+
+        const QTextBlock block = document()->findBlockByNumber(qMin(cursorBlock, blockCount() - 1));
+        QTextCursor restored(block);
+        restored.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor,
+                              qMin(cursorColumn, block.length() - 1));
+        setTextCursor(restored);
+        verticalScrollBar()->setValue(scroll);
+        pageLoading = false;
     }
+
+    document()->setModified(hasUnsavedChanges());
+    updateLineNumberAreaWidth(0);
+    restartSearch();
+}
+
+qint64 CodeEditor::offsetAt(int position) const {
+    const QTextBlock block = document()->findBlock(position);
+    const qint64 lineStart = buffer.lineStart(pageFirstLine + block.blockNumber());
+    return buffer.advanceUtf16(lineStart, position - block.position());
 }
 
+int CodeEditor::positionAt(qint64 offset) const {
+    const qint64 line = buffer.lineAt(offset);
+    const qint64 blockNumber = line - pageFirstLine;
+    if (blockNumber < 0 || blockNumber >= blockCount()) return -1;
+
+    const QTextBlock block = document()->findBlockByNumber(int(blockNumber));
+    const qint64 column = utf16Length(buffer, buffer.lineStart(line), offset);
+    return block.position() + int(qMin<qint64>(column, block.length() - 1));
+}
+
+void CodeEditor::selectBufferRange(qint64 offset, qint64 length) {
+    const qint64 line = buffer.lineAt(offset);
+    if (isPaged() && (line < pageFirstLine || line >= pageFirstLine + pageLineCount)) {
+        repage(line - visibleLineCount() / 2);
+    }
+
+    const int anchor = positionAt(offset);
+    const int position = positionAt(offset + length);
+    if (anchor < 0 || position < 0) return;
+
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(anchor);
+    cursor.setPosition(position, QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+    ensureCursorVisible();
+}
+
+void CodeEditor::restartSearch() {
+    if (!searchMatches) return;
+
+    searchMatches->reset();
+    if (bufferReady) {
+        searchTimer->start();
+    } else {
+        searchTimer->stop();
+    }
+    updateMatchSelections();
+    emit searchResultsChanged();
+}
+
+void CodeEditor::searchNextSlice() {
+    if (!searchMatches || !bufferReady) {
+        searchTimer->stop();
+        return;
+    }
+
+    // Regular expressions go through QString windows and cost several
+    // times more per byte than the literal kernel.
+    const qint64 budget = searchMatches->search().isLiteral() ? SearchSliceBytes : ExpressionSliceBytes;
+    if (searchMatches->scan(buffer, budget)) {
+        searchTimer->stop();
+    }
+    updateMatchSelections();
+    emit searchResultsChanged();
+}
+
+void CodeEditor::updateMatchSelections() {
+    MatchView view;
+    if (searchMatches && bufferReady) {
+        view.firstBlock = firstVisibleBlock().blockNumber();
+        view.blockCount = visibleLineCount() + 1;
+        view.firstLine = pageFirstLine;
+        view.matchRevision = searchMatches->revision();
+        view.bufferRevision = buffer.revision();
+    }
+    if (view == matchView) return;
+    matchView = view;
+
+    matchSelections.clear();
+    if (view.firstBlock >= 0) {
+        const int lastBlock = qMin(view.firstBlock + view.blockCount, blockCount());
+        const qint64 from = buffer.lineStart(pageFirstLine + view.firstBlock);
+        const qint64 to = buffer.lineStart(pageFirstLine + lastBlock);
+
+        // Columns are counted on from the previous match on the same line,
+        // so a long line full of matches is decoded once.
+        qint64 line = -1;
+        qint64 counted = 0;
+        qint64 column = 0;
+        QTextBlock block;
+
+        searchMatches->forEachIn(from, to, [&](const TextSearch::Match &match) {
+            const qint64 matchLine = buffer.lineAt(match.offset);
+            if (matchLine != line) {
+                line = matchLine;
+                counted = buffer.lineStart(line);
+                column = 0;
+                block = document()->findBlockByNumber(int(line - pageFirstLine));
+            }
+            column += utf16Length(buffer, counted, match.offset);
+            const qint64 start = column;
+            column += utf16Length(buffer, match.offset, match.offset + match.length);
+            counted = match.offset + match.length;
+
+            const qint64 last = block.length() - 1;
+            QTextEdit::ExtraSelection selection;
+            selection.format.setBackground(matchColor);
+            selection.cursor = QTextCursor(document());
+            selection.cursor.setPosition(block.position() + int(qMin(start, last)));
+            selection.cursor.setPosition(block.position() + int(qMin(column, last)), QTextCursor::KeepAnchor);
+            matchSelections.append(selection);
+            return matchSelections.size() < MaxMatchSelections;
+        });
+    }
+
+    applyExtraSelections();
+}
+
+void CodeEditor::onChunkLoaded(const QString &text) {
+    QTextCursor cursor(document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertText(text);
+    applyPendingLine();
+}
+
+void CodeEditor::onLoaderProgress(qint64 bytesRead, qint64 totalBytes) {
+    loadBytesRead = bytesRead;
+    loadBytesTotal = totalBytes;
+    emit loadProgress(bytesRead, totalBytes);
+}
+
+void CodeEditor::onLoaderFinished(bool ok) {
+    FileLoader *finishedLoader = qobject_cast<FileLoader*>(sender());
+    loader = nullptr;
+
+    if (ok && finishedLoader) {
+        buffer = finishedLoader->buffer();
+        bufferReady = true;
+        savedRevision = loadUnsaved ? NeverSaved : buffer.revision();
+        setReadOnly(false);
+        document()->setModified(loadUnsaved);
+        // A released tab's history only fits the text it was taken from.
+        if (pendingHistory && pendingHistoryHash == finishedLoader->contentHash()) {
+            history = std::move(pendingHistory);
+        } else if (!loadUnsaved) {
+            history->markClean();
+        }
+        highlightCurrentLine();
+        restartSearch();
+        if (!loadUnsaved) {
+            updateHighlightCache(finishedLoader->filePath(), finishedLoader->contentHash());
+        }
+    } else if (syntaxHighlighter && highlightEntry) {
+        syntaxHighlighter->dropCache();
+        syntaxHighlighter->rehighlight();
+    }
+    highlightEntry.reset();
+    pendingHistory.reset();
+    applyPendingLine();
+
+    emit loadFinished(ok);
+}
+
+void CodeEditor::updateHighlightCache(const QString &filePath, quint64 contentHash) {
+    if (!highlightCache || !syntaxHighlighter || !highlightLanguage) return;
+
+    // Size and mtime matched when loading started; the hash settles it. A
+    // file changed behind them is highlighted over and the entry replaced.
+    if (highlightEntry) {
+        if (highlightEntry->contentHash() == contentHash) return;
+        syntaxHighlighter->dropCache();
+        syntaxHighlighter->rehighlight();
+    }
+    highlightCache->store(filePath, buffer);
+}
+
+void CodeEditor::loadPage(qint64 firstLine) {
+    firstLine = qBound<qint64>(0, firstLine, totalLineCount() - 1);
+
+    qint64 lines = 0;
+    QString text = bufferReady
+        ? readBufferLines(firstLine, PageLines, PageMaxBytes, &lines)
+        : pagedFile->readLines(firstLine, PageLines, PageMaxBytes, &lines);
+
+    pageLoading = true;
+    pageFirstLine = firstLine;
+    pageLineCount = lines;
+    setPlainText(text);
+    pageLoading = false;
+
+    lineNumberArea->update();
+}
+
+QString CodeEditor::readBufferLines(qint64 firstLine, qint64 count, qint64 maxBytes, qint64 *linesRead) const {
+    const qint64 start = buffer.lineStart(firstLine);
+    const qint64 lastLine = qMin(firstLine + count, buffer.lineCount()) - 1;
+    qint64 end = lastLine + 1 < buffer.lineCount() ? buffer.lineStart(lastLine + 1) - 1 : buffer.size();
+
+    if (end - start > maxBytes) {
+        const qint64 cutLine = buffer.lineAt(start + maxBytes);
+        if (cutLine > firstLine) {
+            end = buffer.lineStart(cutLine) - 1;
+        } else {
+            // A single huge line: cut it, but not inside a UTF-8 sequence.
+            end = start + maxBytes;
+            while (end > start && (uchar(buffer.read(end, 1).at(0)) & 0xC0) == 0x80) {
+                --end;
+            }
+        }
+    }
+
+    *linesRead = buffer.lineAt(end) - firstLine + 1;
+
+    QByteArray bytes = buffer.read(start, end - start);
+    if (bytes.endsWith('\r') && buffer.read(end, 1) == "\n") {
+        bytes.chop(1);
+    }
+
+    QString text = QString::fromUtf8(bytes);
+    TextBuffer::foldLineEndings(text);
+    return text;
+}
+
+void CodeEditor::onIndexComplete() {
+    indexTimer->stop();
+
+    buffer = TextBuffer(pagedFile);
+    bufferReady = true;
+    savedRevision = buffer.revision();
+
+    setReadOnly(false);
+    history->clear();
+    history->markClean();
+    highlightCurrentLine();
+    updateLineNumberAreaWidth(0);
+    restartSearch();
+}
+
+void CodeEditor::repage(qint64 topLine) {
+    QTextCursor cursor = textCursor();
+    const qint64 cursorLine = pageFirstLine + cursor.blockNumber();
+    const int cursorColumn = cursor.positionInBlock();
+
+    loadPage(topLine - PageLines / 2);
+
+    pageLoading = true;
+    const qint64 cursorBlock = cursorLine - pageFirstLine;
+    if (cursorBlock >= 0 && cursorBlock < pageLineCount) {
+        QTextBlock block = document()->findBlockByNumber(int(cursorBlock));
+        cursor = QTextCursor(block);
+        cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor,
+                            qMin(cursorColumn, block.length() - 1));
+        setTextCursor(cursor);
+    }
+    verticalScrollBar()->setValue(int(topLine - pageFirstLine));
+    pageLoading = false;
+
+    updatePageScrollBar();
+}
+
+void CodeEditor::onViewScrolled(int value) {
+    if (!isPaged() || pageLoading) return;
+
+    const qint64 topLine = pageFirstLine + value;
+    const qint64 visible = visibleLineCount();
+
+    const bool nearTop = value < PageMargin && pageFirstLine > 0;
+    const bool nearBottom = value + visible > pageLineCount - PageMargin
+                            && pageFirstLine + pageLineCount < totalLineCount();
+
+    if (nearTop || nearBottom) {
+        repage(topLine);
+    } else {
+        updatePageScrollBar();
+    }
+}
+
+void CodeEditor::onPageScrollBarMoved(int value) {
+    if (!isPaged() || pageLoading) return;
+
+    const qint64 visible = visibleLineCount();
+    if (value >= pageFirstLine && value + visible <= pageFirstLine + pageLineCount) {
+        verticalScrollBar()->setValue(int(value - pageFirstLine));
+    } else {
+        repage(value);
+    }
+}
+
+void CodeEditor::indexNextChunk() {
+    if (pagedFile->buildLineIndex(IndexSliceBytes)) {
+        onIndexComplete();
+    }
+    updatePageScrollBar();
+    applyPendingLine();
+}
+
+void CodeEditor::updatePageScrollBar() {
+    if (!pageScrollBar) return;
+
+    const qint64 visible = visibleLineCount();
+    const qint64 maximum = qMax<qint64>(0, totalLineCount() - visible);
+
+    QSignalBlocker blocker(pageScrollBar);
+    pageScrollBar->setRange(0, int(qMin<qint64>(maximum, std::numeric_limits<int>::max())));
+    pageScrollBar->setPageStep(int(visible));
+    pageScrollBar->setValue(int(pageFirstLine + verticalScrollBar()->value()));
+}
+
+void CodeEditor::updatePageScrollBarGeometry() {
+    if (!pageScrollBar) return;
+
+    QRect cr = contentsRect();
+    const int width = pageScrollBar->sizeHint().width();
+    pageScrollBar->setGeometry(QRect(cr.right() - width + 1, cr.top(), width, cr.height()));
+    updatePageScrollBar();
+}
+
+int CodeEditor::visibleLineCount() const {
+    return qMax(1, viewport()->height() / qMax(1, fontMetrics().height()));
+}
 
 void CodeEditor::resizeEvent(QResizeEvent *e) {
     QPlainTextEdit::resizeEvent(e);
@@ -123,9 +1086,27 @@ void CodeEditor::resizeEvent(QResizeEvent *e) {
     lineNumberArea->setGeometry(QRect(cr.left(), cr.top(),
                                       lineNumbersVisible ? lineNumberAreaWidth() : 0,
                                       cr.height()));
+
+    updatePageScrollBarGeometry();
+    updateMinimapGeometry();
+}
+
+void CodeEditor::changeEvent(QEvent *e) {
+    QPlainTextEdit::changeEvent(e);
+
+    if (e->type() == QEvent::FontChange) {
+        gutter.setFont(font());
+        updateLineNumberAreaWidth(0);
+        lineNumberArea->update();
+    }
 }
 
 void CodeEditor::keyPressEvent(QKeyEvent *e) {
+    if (e == QKeySequence::Undo || e == QKeySequence::Redo) {
+        applyHistory(e == QKeySequence::Redo);
+        return;
+    }
+
     if (e->key() == Qt::Key_Return || e->key() == Qt::Key_Enter) {
         QTextCursor cursor = textCursor();
         QString currentLineText = cursor.block().text();
@@ -150,21 +1131,82 @@ void CodeEditor::keyPressEvent(QKeyEvent *e) {
 }
 
 void CodeEditor::updateLineNumberAreaWidth(int) {
-    setViewportMargins(lineNumbersVisible ? lineNumberAreaWidth() : 0, 0, 0, 0);
+    int rightMargin = pageScrollBar ? pageScrollBar->sizeHint().width() : 0;
+    if (minimapVisible) rightMargin += Minimap::Width;
+    setViewportMargins(lineNumbersVisible ? lineNumberAreaWidth() : 0, 0, rightMargin, 0);
+    updateMinimapGeometry();
+}
+
+void CodeEditor::updateMinimapGeometry() {
+    // Between the text and whichever scroll bar is shown.
+    const QRect view = viewport()->geometry();
+    minimap->setGeometry(QRect(view.right() + 1, view.top(), Minimap::Width, view.height()));
 }
 
 void CodeEditor::updateLineNumberArea(const QRect &rect, int dy)
 {
+    // Typing, cursor blinks and highlighting repaint parts of the viewport
+    // without moving any row, so the gutter is left alone for those. An
+    // update reaching the bottom may come from a block changing height,
+    // which shifts every row below it.
+    const GutterState state = currentGutterState();
+    const bool rowsMoved = state != gutterState || rect.bottom() >= viewport()->rect().bottom();
+    gutterState = state;
+
     if (dy)
         lineNumberArea->scroll(0, dy);
-    else
+    else if (rowsMoved)
         lineNumberArea->update(0, rect.y(), lineNumberArea->width(), rect.height());
 
     if (rect.contains(viewport()->rect()))
         updateLineNumberAreaWidth(0);
+
+    updateVisibleBlocks();
+}
+
+CodeEditor::GutterState CodeEditor::currentGutterState() const {
+    GutterState state;
+    state.firstBlock = firstVisibleBlock().blockNumber();
+    state.offset = qRound(contentOffset().y());
+    state.blockCount = blockCount();
+    state.firstLine = pageFirstLine;
+    return state;
+}
+
+void CodeEditor::updateGutterRow(int blockNumber) {
+    const QTextBlock block = document()->findBlockByNumber(blockNumber);
+    if (!block.isValid() || !block.isVisible()) return;
+
+    const QRectF rect = blockBoundingGeometry(block).translated(contentOffset());
+    if (rect.bottom() < 0 || rect.top() > viewport()->height()) return;
+
+    lineNumberArea->update(0, qFloor(rect.top()), lineNumberArea->width(), qCeil(rect.height()) + 1);
+}
+
+void CodeEditor::updateVisibleBlocks() {
+    const int first = firstVisibleBlock().blockNumber();
+    const int count = visibleLineCount() + 1;
+    if (syntaxHighlighter) {
+        syntaxHighlighter->setVisibleBlocks(first, count);
+    }
+    minimap->setVisibleRange(first, count);
+    updateMatchSelections();
 }
 
 void CodeEditor::highlightCurrentLine() {
+    // Only the rows losing and gaining the bold number are repainted.
+    const int currentBlock = textCursor().blockNumber();
+    if (currentBlock != gutterCurrentBlock) {
+        const int previousBlock = gutterCurrentBlock;
+        gutterCurrentBlock = currentBlock;
+        updateGutterRow(previousBlock);
+        updateGutterRow(currentBlock);
+    }
+
+    applyExtraSelections();
+}
+
+void CodeEditor::applyExtraSelections() {
     QList<QTextEdit::ExtraSelection> extraSelections;
 
     if (!isReadOnly()) {
@@ -176,5 +1218,6 @@ void CodeEditor::highlightCurrentLine() {
         extraSelections.append(selection);
     }
 
+    extraSelections += matchSelections;
     setExtraSelections(extraSelections);
 }
\ No newline at end of file
@@ -5,15 +5,34 @@
 #include <QPlainTextEdit>
 #include <QRect>
 #include <QTextBlock>
-#include <QSyntaxHighlighter>
+#include <QPointer>
+#include <QHash>
+#include <QVector>
+#include <memory>
+
+#include "gutterrenderer.h"
+#include "highlighter/highlightcache.h"
+#include "searchmatches.h"
+#include "textbuffer.h"
+#include "undohistory.h"
+#include "utf8encoder.h"
 
 class LineNumberArea;
+class Minimap;
+class SyntaxHighlighter;
+struct Language;
+class MappedFile;
+class FileLoader;
+class FileFollower;
+class QScrollBar;
+class QTimer;
 
 class CodeEditor : public QPlainTextEdit {
     Q_OBJECT
 
 public:
     explicit CodeEditor(QWidget *parent = nullptr);
+    ~CodeEditor() override;
 
     void lineNumberAreaPaintEvent(QPaintEvent *event);
     int lineNumberAreaWidth();
@@ -21,25 +40,232 @@ public:
     void setLineNumbersVisible(bool visible);
     bool areLineNumbersVisible() const;
 
-    void setSyntaxHighlighter(QSyntaxHighlighter *highlighter);
+    void setMinimapVisible(bool visible);
+    bool isMinimapVisible() const;
+
+    // Gutter markers (GutterRenderer::Marker flags) for 0-based lines of the
+    // file. Markers stay on their line number; whoever sets them (a debugger,
+    // a diff view) refreshes them after edits.
+    void setLineMarkers(qint64 line, int markers);
+    int lineMarkers(qint64 line) const;
+    void clearLineMarkers();
+
+    void setSyntaxHighlighter(SyntaxHighlighter *highlighter);
     void detectAndApplySyntaxHighlighting(const QString &filePath);
+    // Where loadFile() takes highlighting from when the file was open
+    // before, and leaves it for next time. Not owned.
+    void setHighlightCache(HighlightCache *cache);
+
+    // The piece table is the source of truth for the tab's contents; the
+    // QTextDocument only holds what is on screen and every edit made to it
+    // is mirrored into the buffer.
+    const TextBuffer &textBuffer() const;
+    qint64 totalLineCount() const;
+
+    // True when the buffer has changed since the revision last written to
+    // disk (or since the file was loaded).
+    bool hasUnsavedChanges() const;
+    void markSaved(quint64 revision);
+
+    // Paged mode shows a window of a memory mapped file and moves the window
+    // as the user scrolls, so only a few thousand lines are ever materialized
+    // in the document. The tab is read-only until the line index is complete.
+    void openPagedFile(std::shared_ptr<MappedFile> file);
+    bool isPaged() const;
+    qint64 lineNumberOffset() const;
+
+    // Loads filePath on a worker thread. The editor stays read-only and grows
+    // chunk by chunk until loadFinished() is emitted. With unsaved set the
+    // text counts as not yet written to the tab's file, as when a snapshot
+    // of a released tab is read back.
+    void loadFile(const QString &filePath, bool unsaved = false);
+    bool isLoading() const;
+    void cancelLoading();
+    qint64 loadedBytes() const;
+    qint64 totalLoadBytes() const;
+
+    // Estimate of what the tab keeps resident: the document's text and
+    // layout, the undo history, and the buffer unless it reads from a
+    // mapping.
+    qint64 memoryUsage() const;
+
+    // Hands over the undo history, with its text moved out of memory, for a
+    // tab that is being released; null when there is none. contentHash is
+    // set to what it applies to.
+    std::unique_ptr<UndoHistory> takeUndoHistory(quint64 *contentHash);
+    // Makes released the editor's undo history once the load in progress
+    // finishes, if the text loaded hashes to contentHash.
+    void setUndoHistory(std::unique_ptr<UndoHistory> released, quint64 contentHash);
+
+    // Follow mode shows the end of a growing file such as a log. Only bytes
+    // appended since the last read are read, at most once per frame, and
+    // lines beyond maxLines are dropped from the top. The view stays pinned
+    // to the bottom unless the user scrolls away. The tab is read-only.
+    void followFile(const QString &filePath, int maxLines);
+    bool isFollowing() const;
+
+    // Moves the cursor to a 0-based line of the file, selecting length
+    // units from column. While the file is still loading or being indexed
+    // the move waits until the line is there.
+    void goToLine(qint64 line, int column = 0, int length = 0);
+    // goToLine() that scrolls firstVisibleLine to the top instead of
+    // centering, to put a tab back the way it was left.
+    void restoreView(qint64 line, int column, qint64 firstVisibleLine);
+    // 0-based line of the file at the top of the view.
+    qint64 firstVisibleLine() const;
+
+    // Find and replace over the whole buffer, not just the loaded page.
+    // Matches are counted in slices from the event loop and kept up to date
+    // as the text is edited; only the ones on screen are highlighted.
+    void setSearchQuery(const TextSearch::Query &query);
+    void clearSearch();
+    bool hasSearch() const;
+    QString searchError() const;
+    qint64 searchMatchCount() const;
+    bool isSearchComplete() const;
+    bool isSearchTruncated() const;
+    // Selects the first match after the selection, or the last one before
+    // it, wrapping around the ends of the buffer.
+    bool findNext(bool backward = false);
+    // Replaces the selection if it is a match and selects the next one.
+    bool replaceNext(const QString &replacement);
+    // Replaces every match as a single edit, which one undo reverts.
+    // Returns the number of matches replaced.
+    qint64 replaceAll(const QString &replacement);
+
+signals:
+    void loadProgress(qint64 bytesRead, qint64 totalBytes);
+    void loadFinished(bool ok);
+    void searchResultsChanged();
 
 protected:
     void resizeEvent(QResizeEvent *e) override;
+    void changeEvent(QEvent *e) override;
     void keyPressEvent(QKeyEvent *e) override;
 
 private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void updateLineNumberArea(const QRect &rect, int dy);
     void highlightCurrentLine();
+    void onViewScrolled(int value);
+    void onPageScrollBarMoved(int value);
+    void indexNextChunk();
+    void onChunkLoaded(const QString &text);
+    void onLoaderProgress(qint64 bytesRead, qint64 totalBytes);
+    void onLoaderFinished(bool ok);
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void centerOnBlock(int blockNumber);
+    void onFollowerAppended(const QString &text, qint64 skippedLines);
+    void onFollowerRestarted();
+    void searchNextSlice();
 
 private:
+    void updateHighlightCache(const QString &filePath, quint64 contentHash);
+    void loadPage(qint64 firstLine);
+    QString readBufferLines(qint64 firstLine, qint64 count, qint64 maxBytes, qint64 *linesRead) const;
+    void onIndexComplete();
+    void repage(qint64 topLine);
+    void updatePageScrollBar();
+    void updatePageScrollBarGeometry();
+    int visibleLineCount() const;
+    void updateVisibleBlocks();
+    void updateMinimapGeometry();
+    void updateGutterRow(int blockNumber);
+
+    qint64 offsetAt(int position) const;
+    // Document position of a buffer offset, or -1 when its line is not on
+    // the page.
+    int positionAt(qint64 offset) const;
+    void selectBufferRange(qint64 offset, qint64 length);
+    void applyPendingLine();
+    bool findBefore(qint64 offset, TextSearch::Match *match) const;
+    // Rebuilds the document from the buffer after the buffer was changed
+    // behind its back, keeping the cursor and scroll position.
+    void reloadFromBuffer();
+    // Reverts or repeats a step of the undo history.
+    bool applyHistory(bool redo);
+    // Replaces length bytes at offset in the buffer and the same text in the
+    // document, leaving the cursor after it.
+    void replaceBufferRange(qint64 offset, qint64 length, const QByteArray &text);
+    void updateSearchAfterEdit(qint64 offset, qint64 removedLength, qint64 insertedLength);
+    void restartSearch();
+    void updateMatchSelections();
+    void applyExtraSelections();
+
+    // What the gutter rows depend on besides markers and the current line.
+    // While it is unchanged, text updates need no gutter repaint.
+    struct GutterState {
+        int firstBlock = -1;
+        int offset = 0;
+        int blockCount = 0;
+        qint64 firstLine = 0;
+        bool operator==(const GutterState &) const = default;
+    };
+    GutterState currentGutterState() const;
+
+    // What the match highlights were built for.
+    struct MatchView {
+        int firstBlock = -1;
+        int blockCount = 0;
+        qint64 firstLine = 0;
+        quint64 matchRevision = 0;
+        quint64 bufferRevision = 0;
+        bool operator==(const MatchView &) const = default;
+    };
+
     LineNumberArea *lineNumberArea;
     bool lineNumbersVisible;
-    QSyntaxHighlighter *syntaxHighlighter;
+    GutterRenderer gutter;
+    GutterState gutterState;
+    QHash<qint64, int> markers;
+    int gutterCurrentBlock;
+    Minimap *minimap;
+    bool minimapVisible;
+    SyntaxHighlighter *syntaxHighlighter;
+    const Language *highlightLanguage;
+    HighlightCache *highlightCache;
+    // What the highlighter was given when loading started.
+    std::shared_ptr<const HighlightCache::Entry> highlightEntry;
     QColor lineNumberAreaColor;
     QColor lineNumberTextColor;
     QColor currentLineColor;
+    QColor matchColor;
+
+    TextBuffer buffer;
+    bool bufferReady;
+    quint64 savedRevision;
+    Utf8Encoder encoder;
+    // Replaces the document's undo stack, which is kept disabled.
+    std::unique_ptr<UndoHistory> history;
+    bool applyingHistory;
+    // Waiting for the load in progress; see setUndoHistory().
+    std::unique_ptr<UndoHistory> pendingHistory;
+    quint64 pendingHistoryHash;
+
+    std::unique_ptr<SearchMatches> searchMatches;
+    QTimer *searchTimer;
+    QList<QTextEdit::ExtraSelection> matchSelections;
+    MatchView matchView;
+
+    std::shared_ptr<MappedFile> pagedFile;
+    qint64 pageFirstLine;
+    qint64 pageLineCount;
+    bool pageLoading;
+    QScrollBar *pageScrollBar;
+    QTimer *indexTimer;
+
+    QPointer<FileLoader> loader;
+    bool loadUnsaved;
+    qint64 loadBytesRead;
+    qint64 loadBytesTotal;
+
+    FileFollower *follower;
+
+    // Where goToLine() is waiting to go; -1 for nowhere.
+    qint64 pendingLine;
+    int pendingColumn;
+    int pendingLength;
+    qint64 pendingTopLine;
 };
 
 #endif // CODEEDITOR_H
\ No newline at end of file
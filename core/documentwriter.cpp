@@ -0,0 +1,196 @@
+#include "documentwriter.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QTemporaryFile>
+#include <QThread>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#include <windows.h>
+#else
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+DocumentWriter::DocumentWriter(QObject *parent)
+    : QObject(parent)
+    , busy(false)
+    , stopping(false)
+    , policy(SyncFile)
+{
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("DocumentWriter");
+    thread->start(QThread::LowPriority);
+}
+
+DocumentWriter::~DocumentWriter() {
+    // Pending jobs are still written: this runs on quit and losing the last
+    // autosave there would defeat its purpose.
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        jobAvailable.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+}
+
+void DocumentWriter::setSyncPolicy(SyncPolicy syncPolicy) {
+    policy = syncPolicy;
+}
+
+DocumentWriter::SyncPolicy DocumentWriter::syncPolicy() const {
+    return SyncPolicy(policy.load());
+}
+
+void DocumentWriter::save(const QString &filePath, const TextBuffer &snapshot, bool force) {
+    enqueue(Job{filePath, snapshot, force ? Write : WriteIfChanged});
+}
+
+void DocumentWriter::remember(const QString &filePath, const TextBuffer &snapshot) {
+    enqueue(Job{filePath, snapshot, HashOnly});
+}
+
+void DocumentWriter::enqueue(const Job &newJob) {
+    QMutexLocker locker(&mutex);
+
+    if (newJob.kind != HashOnly) {
+        for (Job &job : jobs) {
+            if (job.kind != HashOnly && job.filePath == newJob.filePath) {
+                job.snapshot = newJob.snapshot;
+                job.kind = qMax(job.kind, newJob.kind);
+                return;
+            }
+        }
+    }
+
+    jobs.append(newJob);
+    jobAvailable.wakeOne();
+}
+
+void DocumentWriter::flush() {
+    QMutexLocker locker(&mutex);
+    while (busy || !jobs.isEmpty()) {
+        jobsDone.wait(&mutex);
+    }
+}
+
+void DocumentWriter::run() {
+    QMutexLocker locker(&mutex);
+
+    forever {
+        while (jobs.isEmpty() && !stopping) {
+            jobAvailable.wait(&mutex);
+        }
+        if (jobs.isEmpty()) break;
+
+        Job job = jobs.takeFirst();
+        busy = true;
+        locker.unlock();
+
+        const quint64 hash = job.snapshot.contentHash();
+        auto written = writtenHashes.constFind(job.filePath);
+        const bool unchanged = written != writtenHashes.cend() && *written == hash;
+
+        if (job.kind == HashOnly) {
+            writtenHashes.insert(job.filePath, hash);
+        } else if (job.kind == WriteIfChanged && unchanged) {
+            emit saved(job.filePath, job.snapshot.revision(), true, false, QString());
+        } else {
+            QString errorString;
+            const bool ok = writeFile(job.filePath, job.snapshot, syncPolicy(), &errorString);
+            if (ok) {
+                writtenHashes.insert(job.filePath, hash);
+            } else {
+                writtenHashes.remove(job.filePath);
+            }
+            emit saved(job.filePath, job.snapshot.revision(), ok, ok, errorString);
+        }
+
+        locker.relock();
+        busy = false;
+        if (jobs.isEmpty()) {
+            jobsDone.wakeAll();
+        }
+    }
+
+    jobsDone.wakeAll();
+}
+
+static bool syncHandle(int handle) {
+#if defined(Q_OS_WIN)
+    return _commit(handle) == 0;
+#else
+    return ::fsync(handle) == 0;
+#endif
+}
+
+static void syncDirectory(const QString &path) {
+#if defined(Q_OS_UNIX)
+    const int handle = ::open(QFile::encodeName(path).constData(), O_RDONLY);
+    if (handle >= 0) {
+        ::fsync(handle);
+        ::close(handle);
+    }
+#else
+    // Directory entries cannot be flushed separately on this platform; the
+    // rename below is already requested as write-through.
+    Q_UNUSED(path);
+#endif
+}
+
+static bool replaceFile(const QString &from, const QString &to) {
+#if defined(Q_OS_WIN)
+    return MoveFileExW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(from).utf16()),
+                       reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(to).utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return std::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+bool DocumentWriter::writeFile(const QString &filePath, const TextBuffer &buffer,
+                               SyncPolicy policy, QString *errorString) {
+    // Replace the file a symlink points to, not the link itself.
+    QFileInfo targetInfo(filePath);
+    const QString target = targetInfo.isSymLink() ? targetInfo.canonicalFilePath() : filePath;
+    const QFileInfo info(target);
+
+    QTemporaryFile temp(info.absolutePath() + "/." + info.fileName() + ".XXXXXX");
+    temp.setAutoRemove(false);
+    if (!temp.open()) {
+        if (errorString) *errorString = temp.errorString();
+        return false;
+    }
+    temp.setTextModeEnabled(true);
+
+    if (info.exists()) {
+        temp.setPermissions(info.permissions());
+    }
+
+    bool ok = buffer.writeTo(&temp) && temp.flush();
+    if (ok && policy != NoSync) {
+        ok = syncHandle(temp.handle());
+    }
+    if (errorString && !ok) *errorString = temp.errorString();
+    temp.close();
+
+    if (ok && !replaceFile(temp.fileName(), target)) {
+        if (errorString) *errorString = QString("Could not replace %1").arg(target);
+        ok = false;
+    }
+
+    if (!ok) {
+        QFile::remove(temp.fileName());
+        return false;
+    }
+
+    if (policy == SyncFileAndDirectory) {
+        syncDirectory(info.absolutePath());
+    }
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef DOCUMENTWRITER_H
+#define DOCUMENTWRITER_H
+
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+#include "textbuffer.h"
+
+class QThread;
+
+// Writes documents to disk on a dedicated thread. Callers hand over a
+// TextBuffer snapshot, which is O(1) to take, so the UI thread never waits
+// for encoding or disk I/O.
+//
+// Every write goes to a temporary file next to the target which is then
+// renamed over it, so a crash mid-write leaves the old file intact.
+class DocumentWriter : public QObject {
+    Q_OBJECT
+
+public:
+    enum SyncPolicy {
+        NoSync,               // Leave flushing to the OS.
+        SyncFile,             // fsync the file before the rename.
+        SyncFileAndDirectory  // Also fsync the directory after the rename.
+    };
+
+    explicit DocumentWriter(QObject *parent = nullptr);
+    ~DocumentWriter() override;
+
+    void setSyncPolicy(SyncPolicy policy);
+    SyncPolicy syncPolicy() const;
+
+    // Queues snapshot to be written to filePath. A job for the same path that
+    // has not started yet is replaced, so only the newest snapshot is written.
+    // Unless force is set, the write is skipped when the snapshot hashes the
+    // same as what was last written to or read from that path.
+    void save(const QString &filePath, const TextBuffer &snapshot, bool force = false);
+
+    // Records snapshot as the current contents of filePath without writing,
+    // e.g. right after the file was loaded.
+    void remember(const QString &filePath, const TextBuffer &snapshot);
+
+    // Blocks until every queued job has been written.
+    void flush();
+
+    // The write itself, usable from any thread.
+    static bool writeFile(const QString &filePath, const TextBuffer &buffer,
+                          SyncPolicy policy, QString *errorString = nullptr);
+
+signals:
+    // revision is the TextBuffer revision of the snapshot that is now on disk.
+    // written is false when the write was skipped because the file already
+    // held that text.
+    void saved(const QString &filePath, quint64 revision, bool ok, bool written, const QString &errorString);
+
+private:
+    enum JobKind {
+        HashOnly,
+        WriteIfChanged,
+        Write
+    };
+
+    struct Job {
+        QString filePath;
+        TextBuffer snapshot;
+        JobKind kind;
+    };
+
+    void enqueue(const Job &job);
+
+    void run();
+
+    QThread *thread;
+    QMutex mutex;
+    QWaitCondition jobAvailable;
+    QWaitCondition jobsDone;
+    QList<Job> jobs;
+    bool busy;
+    bool stopping;
+    std::atomic_int policy;
+
+    // Only touched by the writer thread.
+    QHash<QString, quint64> writtenHashes;
+};
+
+#endif // DOCUMENTWRITER_H
@@ -0,0 +1,152 @@
+#include "filefollower.h"
+#include "textbuffer.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDateTime>
+
+#if !defined(Q_OS_WIN)
+#include <sys/stat.h>
+#endif
+
+// Tells a file from the one that replaced it at the same path; 0 when it
+// cannot be told.
+static quint64 identityOf(const QString &path) {
+#if !defined(Q_OS_WIN)
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) != 0) return 0;
+    return (quint64(info.st_dev) << 48) ^ quint64(info.st_ino);
+#else
+    const QDateTime created = QFileInfo(path).birthTime();
+    return created.isValid() ? quint64(created.toMSecsSinceEpoch()) : 0;
+#endif
+}
+
+FileFollower::FileFollower(const QString &filePath, QObject *parent)
+    : QObject(parent)
+    , path(filePath)
+    , watcher(new QFileSystemWatcher(this))
+    , frameTimer(new QTimer(this))
+    , pollTimer(new QTimer(this))
+    , decoder(QStringConverter::Utf8)
+    , offset(0)
+    , identity(0)
+    , maxLines(0)
+    , pendingCarriageReturn(false)
+{
+    frameTimer->setSingleShot(true);
+    frameTimer->setInterval(FrameMilliseconds);
+    connect(frameTimer, &QTimer::timeout, this, &FileFollower::readAppended);
+
+    // Some file systems (network mounts in particular) never report a
+    // change, so the size is also checked every now and then.
+    pollTimer->setInterval(PollMilliseconds);
+    connect(pollTimer, &QTimer::timeout, this, &FileFollower::onFileChanged);
+
+    connect(watcher, &QFileSystemWatcher::fileChanged, this, &FileFollower::onFileChanged);
+}
+
+QString FileFollower::filePath() const {
+    return path;
+}
+
+void FileFollower::start(qint64 from) {
+    offset = from;
+    identity = identityOf(path);
+    decoder.resetState();
+    pendingCarriageReturn = false;
+
+    if (!watcher->files().contains(path)) {
+        watcher->addPath(path);
+    }
+    pollTimer->start();
+    frameTimer->start();
+}
+
+void FileFollower::stop() {
+    if (!watcher->files().isEmpty()) {
+        watcher->removePaths(watcher->files());
+    }
+    pollTimer->stop();
+    frameTimer->stop();
+}
+
+void FileFollower::setMaximumLines(int lines) {
+    maxLines = lines;
+}
+
+void FileFollower::onFileChanged() {
+    // A file that was replaced drops out of the watch list.
+    if (!watcher->files().contains(path) && QFileInfo::exists(path)) {
+        watcher->addPath(path);
+    }
+
+    // Everything that arrives before the timer fires is read in one go.
+    if (!frameTimer->isActive()) {
+        frameTimer->start();
+    }
+}
+
+void FileFollower::readAppended() {
+    // A rotated file may already have grown past the old offset, so it is
+    // told apart by identity as well as by size.
+    const qint64 size = QFileInfo(path).size();
+    const quint64 current = identityOf(path);
+    const bool replaced = current != 0 && identity != 0 && current != identity;
+    if (current != 0) identity = current;
+    if (size < offset || replaced) {
+        offset = 0;
+        decoder.resetState();
+        pendingCarriageReturn = false;
+        emit restarted();
+    }
+    if (size == offset) return;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(offset)) return;
+
+    const QByteArray bytes = file.read(qMin(size - offset, MaxBatchBytes));
+    offset += bytes.size();
+
+    QString text;
+    if (pendingCarriageReturn) {
+        text += QLatin1Char('\r');
+        pendingCarriageReturn = false;
+    }
+    text += decoder.decode(bytes);
+
+    // A "\r\n" may be split between two reads, so a trailing '\r' waits for
+    // the next one before line endings are folded.
+    if (text.endsWith(QLatin1Char('\r'))) {
+        text.chop(1);
+        pendingCarriageReturn = true;
+    }
+    TextBuffer::foldLineEndings(text);
+
+    qint64 skippedLines = 0;
+    keepLastLines(text, &skippedLines);
+    if (!text.isEmpty() || skippedLines > 0) {
+        emit appended(text, skippedLines);
+    }
+
+    // More was waiting than one batch takes; the rest comes next frame.
+    if (offset < size) {
+        frameTimer->start();
+    }
+}
+
+void FileFollower::keepLastLines(QString &text, qint64 *skippedLines) const {
+    *skippedLines = 0;
+    if (maxLines <= 0) return;
+
+    int found = 0;
+    for (qsizetype i = text.size() - 1; i >= 0; --i) {
+        if (text.at(i) == QLatin1Char('\n') && ++found == maxLines) {
+            *skippedLines = QStringView(text).left(i + 1).count(QLatin1Char('\n'));
+            text.remove(0, i + 1);
+            return;
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef FILEFOLLOWER_H
+#define FILEFOLLOWER_H
+
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QStringDecoder>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// Watches a growing file (typically a log) and reports what is appended to
+// it. Only the bytes past the last read offset are read. Change
+// notifications are coalesced so text is delivered at most once per frame,
+// however fast the writer is.
+//
+// A file that shrinks or is replaced, as with log rotation, is read again
+// from the start.
+class FileFollower : public QObject {
+    Q_OBJECT
+
+public:
+    explicit FileFollower(const QString &filePath, QObject *parent = nullptr);
+
+    QString filePath() const;
+
+    // Starts reporting everything after offset.
+    void start(qint64 offset);
+    void stop();
+
+    // Only the last maxLines lines of a batch are delivered; the rest are
+    // counted as skipped. 0 delivers everything.
+    void setMaximumLines(int maxLines);
+
+signals:
+    // skippedLines complete lines that arrived in the same batch were
+    // dropped in front of text.
+    void appended(const QString &text, qint64 skippedLines);
+    void restarted();
+
+private slots:
+    void onFileChanged();
+    void readAppended();
+
+private:
+    void keepLastLines(QString &text, qint64 *skippedLines) const;
+
+    QString path;
+    QFileSystemWatcher *watcher;
+    QTimer *frameTimer;
+    QTimer *pollTimer;
+    QStringDecoder decoder;
+    qint64 offset;
+    // Device and inode of the file being read, to notice it was replaced.
+    quint64 identity;
+    int maxLines;
+    bool pendingCarriageReturn;
+
+    static constexpr int FrameMilliseconds = 16;
+    static constexpr int PollMilliseconds = 1000;
+    static constexpr qint64 MaxBatchBytes = 8 * 1024 * 1024;
+};
+
+#endif // FILEFOLLOWER_H
@@ -0,0 +1,100 @@
+#include "fileloader.h"
+
+#include <QFile>
+#include <QStringDecoder>
+#include <QThreadPool>
+
+static const qint64 FirstChunkSize = 64 * 1024;
+static const qint64 ChunkSize = 1024 * 1024;
+
+FileLoader::FileLoader(const QString &filePath)
+    : path(filePath)
+    , cancelled(false)
+    , resultHash(0)
+{
+}
+
+void FileLoader::start() {
+    // deleteLater() is thread-safe; posting it only after run() returns
+    // guarantees no signal emission is still in flight when we go away.
+    QThreadPool::globalInstance()->start([this]() {
+        run();
+        deleteLater();
+    });
+}
+
+void FileLoader::cancel() {
+    cancelled = true;
+}
+
+bool FileLoader::isCancelled() const {
+    return cancelled;
+}
+
+QString FileLoader::filePath() const {
+    return path;
+}
+
+TextBuffer FileLoader::buffer() const {
+    return result;
+}
+
+quint64 FileLoader::contentHash() const {
+    return resultHash;
+}
+
+void FileLoader::run() {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit finished(false);
+        return;
+    }
+
+    const qint64 totalBytes = file.size();
+    qint64 bytesRead = 0;
+    qint64 chunkSize = FirstChunkSize;
+    bool pendingCarriageReturn = false;
+    QStringDecoder decoder(QStringDecoder::Utf8);
+    QByteArray original;
+    original.reserve(totalBytes);
+
+    while (!cancelled) {
+        QByteArray bytes = file.read(chunkSize);
+        if (bytes.isEmpty()) break;
+
+        bytesRead += bytes.size();
+        chunkSize = ChunkSize;
+        original.append(bytes);
+
+        QString text = decoder.decode(bytes);
+        if (pendingCarriageReturn) {
+            text.prepend(QLatin1Char('\r'));
+            pendingCarriageReturn = false;
+        }
+        // Keep a trailing '\r' back so a "\r\n" split across chunks still
+        // folds into a single '\n'.
+        if (text.endsWith(QLatin1Char('\r'))) {
+            text.chop(1);
+            pendingCarriageReturn = true;
+        }
+        TextBuffer::foldLineEndings(text);
+
+        if (!text.isEmpty()) {
+            emit chunkLoaded(text);
+        }
+        emit progressChanged(bytesRead, totalBytes);
+    }
+
+    if (pendingCarriageReturn && !cancelled) {
+        QString text(QLatin1Char('\r'));
+        TextBuffer::foldLineEndings(text);
+        emit chunkLoaded(text);
+    }
+
+    const bool ok = !cancelled && file.error() == QFileDevice::NoError;
+    if (ok) {
+        result = TextBuffer(original);
+        resultHash = result.contentHash();
+    }
+    emit finished(ok);
+}
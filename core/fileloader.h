@@ -0,0 +1,53 @@
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#pragma once
+#include <QObject>
+#include <QString>
+#include <atomic>
+
+#include "textbuffer.h"
+
+// Reads and decodes a file on a QThreadPool worker and hands the text back in
+// chunks through queued signals. The first chunk is small so the first screen
+// can be shown right away; later chunks are larger to keep the number of
+// document inserts low.
+//
+// The loader deletes itself once the worker is done, so callers only ever
+// need to hold a QPointer to it.
+class FileLoader : public QObject {
+    Q_OBJECT
+
+public:
+    explicit FileLoader(const QString &filePath);
+
+    void start();
+    void cancel();
+    bool isCancelled() const;
+    QString filePath() const;
+
+    // The raw file contents as a piece table. Valid once finished(true) has
+    // been received. The bytes read are the buffer's original, shared rather
+    // than copied, but not mapped: the tab may be saved over the file, which
+    // a mapping could not outlive. So the text is held twice, as UTF-8 here
+    // and as UTF-16 in the document, about three times the file size for
+    // ASCII. Files over the large-file threshold are paged instead.
+    TextBuffer buffer() const;
+    // TextBuffer::contentHash() of buffer(), taken on the worker.
+    quint64 contentHash() const;
+
+signals:
+    void chunkLoaded(const QString &text);
+    void progressChanged(qint64 bytesRead, qint64 totalBytes);
+    void finished(bool ok);
+
+private:
+    void run();
+
+    QString path;
+    std::atomic_bool cancelled;
+    TextBuffer result;
+    quint64 resultHash;
+};
+
+#endif // FILELOADER_H
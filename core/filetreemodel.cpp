@@ -0,0 +1,428 @@
+#include "filetreemodel.h"
+#include "pathfilter.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileIconProvider>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+
+// Entries per batch inserted into the view while a directory is listed.
+static const qsizetype InsertBatchItems = 512;
+// Directory change notifications come in bursts, e.g. during a build.
+static const int RefreshDelayMilliseconds = 200;
+
+// The same entries QFileSystemModel showed: no hidden ones, links included.
+static const QDir::Filters ListFilters = QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot;
+
+FileTreeModel::FileTreeModel(QObject *parent)
+    : QAbstractItemModel(parent)
+    , watchedCount(0)
+    , stopping(false)
+    , generation(0)
+{
+    QFileIconProvider icons;
+    folderIcon = icons.icon(QAbstractFileIconProvider::Folder);
+    fileIcon = icons.icon(QAbstractFileIconProvider::File);
+
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, &FileTreeModel::onDirectoryChanged);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(RefreshDelayMilliseconds);
+    connect(refreshTimer, &QTimer::timeout, this, &FileTreeModel::refreshChanged);
+
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("FileTreeModel");
+    thread->start(QThread::LowPriority);
+}
+
+FileTreeModel::~FileTreeModel() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        ++generation;
+        jobs.clear();
+        jobAvailable.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+}
+
+void FileTreeModel::setRootPath(const QString &path) {
+    const QString cleaned = QDir::cleanPath(QDir(path).absolutePath());
+    if (rootNode && cleaned == root) return;
+
+    beginResetModel();
+    {
+        QMutexLocker locker(&mutex);
+        ++generation;
+        jobs.clear();
+    }
+    if (watchedCount > 0) {
+        watcher->removePaths(watcher->directories());
+        watchedCount = 0;
+    }
+    refreshTimer->stop();
+    changedDirectories.clear();
+
+    root = cleaned;
+    rootNode = std::make_unique<Node>();
+    rootNode->directory = true;
+    endResetModel();
+
+    enqueue(rootNode.get(), false);
+}
+
+QString FileTreeModel::rootPath() const {
+    return root;
+}
+
+QString FileTreeModel::filePath(const QModelIndex &index) const {
+    const Node *node = nodeOf(index);
+    if (!node) return QString();
+    const QString relative = relativePathOf(node);
+    return relative.isEmpty() ? root : root + QLatin1Char('/') + relative;
+}
+
+bool FileTreeModel::isDir(const QModelIndex &index) const {
+    const Node *node = nodeOf(index);
+    return node && node->directory;
+}
+
+void FileTreeModel::setExpanded(const QModelIndex &index, bool expanded) {
+    Node *node = nodeOf(index);
+    if (!node || !node->directory || node == rootNode.get()) return;
+
+    if (!expanded) {
+        if (node->watched && watcher->removePath(filePath(index))) {
+            --watchedCount;
+        }
+        node->watched = false;
+        return;
+    }
+
+    // Whatever changed while nobody was watching shows up now.
+    if (node->state == State::Listed && !node->watched) {
+        watch(node);
+        enqueue(node, true);
+    }
+}
+
+QModelIndex FileTreeModel::index(int row, int column, const QModelIndex &parent) const {
+    const Node *node = nodeOf(parent);
+    if (!node || column != 0 || row < 0 || size_t(row) >= node->children.size()) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, node->children[size_t(row)].get());
+}
+
+QModelIndex FileTreeModel::parent(const QModelIndex &child) const {
+    if (!child.isValid()) return QModelIndex();
+    return indexOf(static_cast<Node*>(child.internalPointer())->parent);
+}
+
+int FileTreeModel::rowCount(const QModelIndex &parent) const {
+    if (parent.column() > 0) return 0;
+    const Node *node = nodeOf(parent);
+    return node ? int(node->children.size()) : 0;
+}
+
+int FileTreeModel::columnCount(const QModelIndex &) const {
+    return 1;
+}
+
+bool FileTreeModel::hasChildren(const QModelIndex &parent) const {
+    const Node *node = nodeOf(parent);
+    if (!node || !node->directory) return false;
+    // Directories that were never listed get an arrow to open them by.
+    return node->state != State::Listed || !node->children.empty();
+}
+
+bool FileTreeModel::canFetchMore(const QModelIndex &parent) const {
+    const Node *node = nodeOf(parent);
+    return node && node->directory && node->state == State::Unlisted;
+}
+
+void FileTreeModel::fetchMore(const QModelIndex &parent) {
+    Node *node = nodeOf(parent);
+    if (node && node->directory && node->state == State::Unlisted) {
+        enqueue(node, false);
+    }
+}
+
+QVariant FileTreeModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid()) return QVariant();
+    const Node *node = static_cast<Node*>(index.internalPointer());
+    switch (role) {
+    case Qt::DisplayRole:
+        return node->name;
+    case Qt::DecorationRole:
+        return node->directory ? folderIcon : fileIcon;
+    default:
+        return QVariant();
+    }
+}
+
+Qt::ItemFlags FileTreeModel::flags(const QModelIndex &index) const {
+    if (!index.isValid()) return Qt::NoItemFlags;
+    Qt::ItemFlags result = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+    if (!static_cast<Node*>(index.internalPointer())->directory) {
+        result |= Qt::ItemNeverHasChildren;
+    }
+    return result;
+}
+
+bool FileTreeModel::lessThan(const QString &a, bool aDirectory, const QString &b, bool bDirectory) {
+    if (aDirectory != bDirectory) return aDirectory;
+    // Case only breaks ties, so the order is total.
+    const int folded = QString::compare(a, b, Qt::CaseInsensitive);
+    return (folded != 0 ? folded : QString::compare(a, b, Qt::CaseSensitive)) < 0;
+}
+
+void FileTreeModel::run() {
+    QMutexLocker locker(&mutex);
+
+    forever {
+        while (jobs.isEmpty() && !stopping) {
+            jobAvailable.wait(&mutex);
+        }
+        if (stopping) break;
+
+        const Job job = jobs.takeFirst();
+        locker.unlock();
+        list(job);
+        locker.relock();
+    }
+}
+
+void FileTreeModel::list(const Job &job) {
+    const QString path = job.relativePath.isEmpty()
+        ? job.root
+        : job.root + QLatin1Char('/') + job.relativePath;
+
+    QVector<Item> items;
+    QDirIterator entries(path, ListFilters);
+    while (entries.hasNext()) {
+        if (generation != job.generation) return;
+
+        entries.next();
+        const QFileInfo info = entries.fileInfo();
+        const bool directory = info.isDir();
+        if (directory && PathFilter::isIgnoredDirectory(info)) continue;
+        items.append(Item{info.fileName(), directory});
+    }
+    std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+        return lessThan(a.name, a.directory, b.name, b.directory);
+    });
+
+    // Sorted first, so every batch goes after the ones before it.
+    qsizetype from = 0;
+    do {
+        auto listing = std::make_shared<Listing>();
+        listing->generation = job.generation;
+        listing->relativePath = job.relativePath;
+        listing->refresh = job.refresh;
+        const qsizetype count = job.refresh ? items.size() : qMin(InsertBatchItems, items.size() - from);
+        listing->items = items.mid(from, count);
+        from += count;
+        listing->complete = from >= items.size();
+        post(listing);
+    } while (from < items.size());
+}
+
+void FileTreeModel::post(std::shared_ptr<Listing> listing) {
+    QMetaObject::invokeMethod(this, [this, listing]() { applyListing(listing); }, Qt::QueuedConnection);
+}
+
+void FileTreeModel::enqueue(Node *node, bool refresh) {
+    if (!refresh) node->state = State::Listing;
+    QMutexLocker locker(&mutex);
+    jobs.append(Job{root, relativePathOf(node), generation, refresh});
+    jobAvailable.wakeOne();
+}
+
+void FileTreeModel::applyListing(const std::shared_ptr<Listing> &listing) {
+    if (listing->generation != generation) return;
+
+    // The directory may have gone since it was listed.
+    Node *node = find(listing->relativePath);
+    if (!node) return;
+
+    if (listing->refresh) {
+        if (node->state == State::Listed) update(node, listing->items);
+        return;
+    }
+
+    if (node->state != State::Listing) return;
+    append(node, listing->items);
+    if (listing->complete) {
+        node->state = State::Listed;
+        watch(node);
+    }
+}
+
+void FileTreeModel::append(Node *node, const QVector<Item> &items) {
+    if (items.isEmpty()) return;
+    insertItems(node, int(node->children.size()), items, 0, items.size());
+}
+
+void FileTreeModel::update(Node *node, const QVector<Item> &items) {
+    QHash<QString, bool> listed;
+    listed.reserve(items.size());
+    for (const Item &item : items) {
+        listed.insert(item.name, item.directory);
+    }
+
+    auto stays = [&](int row) {
+        const Node &child = *node->children[size_t(row)];
+        auto found = listed.constFind(child.name);
+        return found != listed.cend() && *found == child.directory;
+    };
+
+    // Rows that are gone go in runs, from the bottom up.
+    const QModelIndex parentIndex = indexOf(node);
+    for (int last = int(node->children.size()) - 1; last >= 0; --last) {
+        if (stays(last)) continue;
+
+        int first = last;
+        while (first > 0 && !stays(first - 1)) --first;
+
+        beginRemoveRows(parentIndex, first, last);
+        for (int row = first; row <= last; ++row) {
+            release(node->children[size_t(row)].get());
+        }
+        node->children.erase(node->children.begin() + first, node->children.begin() + last + 1);
+        renumber(node, first);
+        endRemoveRows();
+        last = first;
+    }
+
+    // What is left is in the same order as items, so anything between two
+    // rows that are kept is new.
+    size_t row = 0;
+    qsizetype from = 0;
+    auto kept = [&](qsizetype i) {
+        if (row >= node->children.size()) return false;
+        const Node &child = *node->children[row];
+        return child.directory == items[i].directory && child.name == items[i].name;
+    };
+    while (from < items.size()) {
+        if (kept(from)) {
+            ++row;
+            ++from;
+            continue;
+        }
+
+        qsizetype to = from + 1;
+        while (to < items.size() && !kept(to)) ++to;
+        insertItems(node, int(row), items, from, to);
+        row += size_t(to - from);
+        from = to;
+    }
+}
+
+void FileTreeModel::insertItems(Node *node, int row, const QVector<Item> &items, qsizetype from, qsizetype to) {
+    beginInsertRows(indexOf(node), row, row + int(to - from) - 1);
+    std::vector<std::unique_ptr<Node>> added;
+    added.reserve(size_t(to - from));
+    for (qsizetype i = from; i < to; ++i) {
+        auto child = std::make_unique<Node>();
+        child->name = items[i].name;
+        child->parent = node;
+        child->directory = items[i].directory;
+        added.push_back(std::move(child));
+    }
+    node->children.insert(node->children.begin() + row,
+                          std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+    renumber(node, row);
+    endInsertRows();
+}
+
+void FileTreeModel::renumber(Node *node, int from) {
+    for (size_t i = size_t(from); i < node->children.size(); ++i) {
+        node->children[i]->row = int(i);
+    }
+}
+
+void FileTreeModel::watch(Node *node) {
+    if (node->watched || watchedCount >= MaxWatchedDirectories) return;
+    const QString relative = relativePathOf(node);
+    if (watcher->addPath(relative.isEmpty() ? root : root + QLatin1Char('/') + relative)) {
+        node->watched = true;
+        ++watchedCount;
+    }
+}
+
+void FileTreeModel::release(Node *node) {
+    if (node->watched) {
+        const QString relative = relativePathOf(node);
+        if (watcher->removePath(root + QLatin1Char('/') + relative)) {
+            --watchedCount;
+        }
+        node->watched = false;
+    }
+    for (const std::unique_ptr<Node> &child : node->children) {
+        release(child.get());
+    }
+}
+
+void FileTreeModel::onDirectoryChanged(const QString &path) {
+    changedDirectories.insert(path);
+    refreshTimer->start();
+}
+
+void FileTreeModel::refreshChanged() {
+    const QDir rootDir(root);
+    for (const QString &path : std::as_const(changedDirectories)) {
+        QString relative = rootDir.relativeFilePath(path);
+        if (relative == QLatin1String(".")) relative.clear();
+        if (relative.startsWith(QLatin1String(".."))) continue;
+
+        Node *node = find(relative);
+        if (node && node->state == State::Listed) {
+            enqueue(node, true);
+        }
+    }
+    changedDirectories.clear();
+}
+
+FileTreeModel::Node *FileTreeModel::nodeOf(const QModelIndex &index) const {
+    return index.isValid() ? static_cast<Node*>(index.internalPointer()) : rootNode.get();
+}
+
+FileTreeModel::Node *FileTreeModel::find(const QString &relativePath) const {
+    Node *node = rootNode.get();
+    if (!node || relativePath.isEmpty()) return node;
+
+    // Children are sorted, so each step is a binary search.
+    for (const QString &name : relativePath.split(QLatin1Char('/'))) {
+        auto it = std::lower_bound(node->children.begin(), node->children.end(), name,
+            [](const std::unique_ptr<Node> &child, const QString &key) {
+                return lessThan(child->name, child->directory, key, true);
+            });
+        if (it == node->children.end() || !(*it)->directory || (*it)->name != name) return nullptr;
+        node = it->get();
+    }
+    return node;
+}
+
+QModelIndex FileTreeModel::indexOf(Node *node) const {
+    if (!node || node == rootNode.get()) return QModelIndex();
+    return createIndex(node->row, 0, node);
+}
+
+QString FileTreeModel::relativePathOf(const Node *node) const {
+    QStringList parts;
+    for (; node && node != rootNode.get(); node = node->parent) {
+        parts.prepend(node->name);
+    }
+    return parts.join(QLatin1Char('/'));
+}
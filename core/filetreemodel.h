@@ -0,0 +1,143 @@
+#ifndef FILETREEMODEL_H
+#define FILETREEMODEL_H
+
+#pragma once
+#include <QAbstractItemModel>
+#include <QIcon>
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class QThread;
+class QTimer;
+class QFileSystemWatcher;
+
+// The folder tree next to the editor.
+//
+// Only the root and the directories the user expands are listed, on a
+// worker thread, and their entries reach the view in batches, so neither a
+// huge directory nor a slow mount holds up the GUI. Hidden entries and the
+// directories PathFilter ignores are left out. Listed directories that are
+// expanded are watched, up to MaxWatchedDirectories; a change lists just
+// that directory again and only the difference is applied to the view.
+class FileTreeModel : public QAbstractItemModel {
+    Q_OBJECT
+
+public:
+    explicit FileTreeModel(QObject *parent = nullptr);
+    // Stops listing and waits for the worker.
+    ~FileTreeModel() override;
+
+    // Shows the contents of path; the folder itself has no row.
+    void setRootPath(const QString &path);
+    QString rootPath() const;
+
+    // The absolute path of index, the root path for an invalid one.
+    QString filePath(const QModelIndex &index) const;
+    bool isDir(const QModelIndex &index) const;
+
+    // Follows the view: expanded directories are watched, collapsed ones are
+    // not, and one that was not watched is listed again when it opens.
+    void setExpanded(const QModelIndex &index, bool expanded);
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    // Only expanded directories are watched, and collapsing one lets its
+    // watch go, so this is far more than a tree shows at once. Past it a
+    // directory is listed again when it is next expanded instead.
+    static constexpr int MaxWatchedDirectories = 256;
+
+private:
+    enum class State { Unlisted, Listing, Listed };
+
+    struct Node {
+        QString name;
+        Node *parent = nullptr;
+        std::vector<std::unique_ptr<Node>> children;
+        int row = 0;
+        bool directory = false;
+        State state = State::Unlisted;
+        bool watched = false;
+    };
+
+    struct Item {
+        QString name;
+        bool directory;
+    };
+
+    struct Job {
+        QString root;
+        // "" for the root itself, otherwise "dir/sub".
+        QString relativePath;
+        quint64 generation;
+        // Lists again a directory the view already shows.
+        bool refresh;
+    };
+
+    // Part of a directory listing, sorted the way the view shows it. A
+    // refresh arrives whole, since it is compared against the rows shown.
+    struct Listing {
+        quint64 generation = 0;
+        QString relativePath;
+        QVector<Item> items;
+        bool refresh = false;
+        bool complete = false;
+    };
+
+    // The order rows are shown in: directories first, then by name.
+    static bool lessThan(const QString &a, bool aDirectory, const QString &b, bool bDirectory);
+
+    void run();
+    void list(const Job &job);
+    void post(std::shared_ptr<Listing> listing);
+    void enqueue(Node *node, bool refresh);
+
+    void applyListing(const std::shared_ptr<Listing> &listing);
+    void append(Node *node, const QVector<Item> &items);
+    void update(Node *node, const QVector<Item> &items);
+    void insertItems(Node *node, int row, const QVector<Item> &items, qsizetype from, qsizetype to);
+    void renumber(Node *node, int from);
+    void watch(Node *node);
+    void release(Node *node);
+    void onDirectoryChanged(const QString &path);
+    void refreshChanged();
+
+    Node *nodeOf(const QModelIndex &index) const;
+    Node *find(const QString &relativePath) const;
+    QModelIndex indexOf(Node *node) const;
+    QString relativePathOf(const Node *node) const;
+
+    QString root;
+    std::unique_ptr<Node> rootNode;
+    QIcon folderIcon;
+    QIcon fileIcon;
+
+    QFileSystemWatcher *watcher;
+    int watchedCount;
+    QTimer *refreshTimer;
+    QSet<QString> changedDirectories;
+
+    QThread *thread;
+    QMutex mutex;
+    QWaitCondition jobAvailable;
+    QList<Job> jobs;
+    bool stopping;
+    // Bumped by setRootPath; listings of an older root are dropped.
+    std::atomic<quint64> generation;
+};
+
+#endif // FILETREEMODEL_H
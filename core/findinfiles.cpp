@@ -0,0 +1,327 @@
+#include "findinfiles.h"
+#include "pathfilter.h"
+#include "textbuffer.h"
+
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+
+// A NUL byte this close to the start marks a file as binary.
+static const qint64 BinaryProbeBytes = 8 * 1024;
+// Bytes read from a file at a time.
+static const qint64 ChunkBytes = 4 * 1024 * 1024;
+// A line longer than this is searched in pieces; its columns then count
+// from where it was cut.
+static const qint64 MaxLineBytes = 16 * 1024 * 1024;
+// Text shown per hit; longer lines are cut around the match.
+static const qint64 HitTextBytes = 240;
+// How long an idle worker sleeps before it looks for work to steal again.
+static const unsigned long IdleWaitMilliseconds = 5;
+
+// UTF-16 units the editor shows for [from, to) of one line.
+static int utf16Length(const TextBuffer &buffer, qint64 from, qint64 to) {
+    QString text = QString::fromUtf8(buffer.read(from, to - from));
+    TextBuffer::foldLineEndings(text);
+    return int(text.size());
+}
+
+FindInFiles::FindInFiles(const QString &rootPath, const TextSearch::Query &query, QObject *parent)
+    : QObject(parent)
+    , root(rootPath)
+    , search(query)
+    , pending(0)
+    , cancelled(false)
+    , truncated(false)
+    , running(0)
+    , hitCount(0)
+    , files(0)
+    , bytes(0)
+    , deliveryQueued(false)
+{
+}
+
+FindInFiles::~FindInFiles() {
+    cancel();
+    for (const std::unique_ptr<Worker> &worker : workers) {
+        worker->thread->wait();
+        delete worker->thread;
+    }
+}
+
+void FindInFiles::setFiles(const QStringList &paths) {
+    onlyFiles = paths;
+}
+
+void FindInFiles::start() {
+    if (!workers.empty() || !search.isValid()) {
+        QMetaObject::invokeMethod(this, &FindInFiles::finished, Qt::QueuedConnection);
+        return;
+    }
+
+    const int count = qMax(1, QThread::idealThreadCount());
+    for (int i = 0; i < count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    running = count;
+    if (onlyFiles.isEmpty()) {
+        push(0, Task{root, true});
+    } else {
+        for (qsizetype i = 0; i < onlyFiles.size(); ++i) {
+            push(int(i % count), Task{onlyFiles[i], false});
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        QThread *thread = QThread::create([this, i]() { run(i); });
+        thread->setObjectName("FindInFiles");
+        workers[size_t(i)]->thread = thread;
+        thread->start(QThread::LowPriority);
+    }
+}
+
+void FindInFiles::cancel() {
+    cancelled = true;
+    QMutexLocker locker(&idleMutex);
+    workAvailable.wakeAll();
+}
+
+bool FindInFiles::isRunning() const {
+    return running > 0;
+}
+
+bool FindInFiles::isTruncated() const {
+    return truncated;
+}
+
+qint64 FindInFiles::filesSearched() const {
+    return files;
+}
+
+qint64 FindInFiles::bytesSearched() const {
+    return bytes;
+}
+
+void FindInFiles::run(int index) {
+    Task task;
+    while (!cancelled) {
+        if (!takeTask(index, &task)) {
+            if (pending == 0) break;
+
+            // Someone else is still listing or searching and may push more.
+            QMutexLocker locker(&idleMutex);
+            if (pending > 0 && !cancelled) {
+                workAvailable.wait(&idleMutex, IdleWaitMilliseconds);
+            }
+            continue;
+        }
+
+        if (task.directory) {
+            listDirectory(index, task.path);
+        } else {
+            searchFile(task.path);
+        }
+
+        if (--pending == 0) {
+            QMutexLocker locker(&idleMutex);
+            workAvailable.wakeAll();
+        }
+    }
+
+    // The last worker out hands over what is left, then reports the end.
+    if (--running == 0) {
+        QMetaObject::invokeMethod(this, [this]() {
+            deliver();
+            emit finished();
+        }, Qt::QueuedConnection);
+    }
+}
+
+bool FindInFiles::takeTask(int index, Task *task) {
+    // Own work is taken newest first, which walks the tree depth first;
+    // stolen work is the oldest, usually a whole directory.
+    {
+        Worker &own = *workers[size_t(index)];
+        QMutexLocker locker(&own.mutex);
+        if (!own.tasks.empty()) {
+            *task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    const int count = int(workers.size());
+    for (int i = 1; i < count; ++i) {
+        Worker &victim = *workers[size_t((index + i) % count)];
+        QMutexLocker locker(&victim.mutex);
+        if (!victim.tasks.empty()) {
+            *task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void FindInFiles::push(int index, const Task &task) {
+    ++pending;
+    Worker &worker = *workers[size_t(index)];
+    QMutexLocker locker(&worker.mutex);
+    worker.tasks.push_back(task);
+}
+
+void FindInFiles::listDirectory(int index, const QString &path) {
+    // Symbolic links are not followed, so a link back up the tree cannot
+    // send the search around in circles.
+    QDirIterator entries(path, QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+    bool pushed = false;
+    while (entries.hasNext() && !cancelled) {
+        entries.next();
+        const QFileInfo info = entries.fileInfo();
+        if (info.isDir()) {
+            if (PathFilter::isIgnoredDirectory(info)) continue;
+            push(index, Task{info.filePath(), true});
+        } else {
+            push(index, Task{info.filePath(), false});
+        }
+        pushed = true;
+    }
+
+    if (pushed) {
+        QMutexLocker locker(&idleMutex);
+        workAvailable.wakeAll();
+    }
+}
+
+void FindInFiles::searchFile(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return;
+    ++files;
+
+    // window holds what is read but not yet searched, from the start of a
+    // line; lineBase is that line's number.
+    const qint64 overlap = search.isLiteral() ? search.literalLength() - 1 : 0;
+    QByteArray window;
+    qint64 lineBase = 0;
+    qint64 scanFrom = 0;
+    bool first = true;
+    QVector<Hit> hits;
+
+    while (!cancelled) {
+        const QByteArray chunk = file.read(ChunkBytes);
+        const bool atEnd = chunk.size() < ChunkBytes;
+        bytes += chunk.size();
+        if (first) {
+            if (chunk.isEmpty()) return;
+            if (std::memchr(chunk.constData(), 0, size_t(qMin<qint64>(chunk.size(), BinaryProbeBytes)))) return;
+            first = false;
+        }
+        window += chunk;
+
+        qint64 acceptEnd = window.size();
+        if (!atEnd) {
+            acceptEnd = search.isLiteral() ? window.size() - overlap : window.lastIndexOf('\n') + 1;
+            if (acceptEnd <= scanFrom) {
+                // No whole line yet; one longer than MaxLineBytes is cut.
+                if (window.size() < MaxLineBytes) continue;
+                acceptEnd = window.size() - overlap;
+            }
+        }
+
+        qint64 scanned = acceptEnd;
+        const qint64 probeEnd = qMin<qint64>(window.size(), acceptEnd + overlap);
+        if (acceptEnd > scanFrom && search.mayMatch(window.constData() + scanFrom, probeEnd - scanFrom)) {
+            scanned = qMax(scanned, searchWindow(window, scanFrom, acceptEnd, lineBase, path, &hits));
+        }
+        if (atEnd) break;
+
+        // What follows acceptEnd carries over, from the start of its line
+        // so columns still count from there.
+        qint64 keep = window.lastIndexOf('\n', acceptEnd - 1) + 1;
+        if (keep == 0 && window.size() >= MaxLineBytes) keep = acceptEnd;
+        lineBase += std::count(window.constBegin(), window.constBegin() + keep, '\n');
+        scanFrom = scanned - keep;
+        window.remove(0, keep);
+    }
+
+    if (hits.isEmpty()) return;
+
+    QMutexLocker locker(&hitsMutex);
+    pendingHits += hits;
+    if (!deliveryQueued) {
+        deliveryQueued = true;
+        QMetaObject::invokeMethod(this, &FindInFiles::deliver, Qt::QueuedConnection);
+    }
+}
+
+qint64 FindInFiles::searchWindow(const QByteArray &window, qint64 from, qint64 to, qint64 firstLine,
+                                 const QString &path, QVector<Hit> *hits) {
+    const TextBuffer buffer(window);
+    const qint64 size = window.size();
+    TextSearch::Scanner scanner(search, buffer, from, to);
+    TextSearch::Match match;
+    qint64 scanned = from;
+
+    // Columns are counted on from the previous hit on the same line, so a
+    // long line full of hits is decoded once.
+    qint64 line = -1;
+    qint64 lineStart = 0;
+    qint64 lineEnd = 0;
+    qint64 counted = 0;
+    int column = 0;
+
+    while (!cancelled && scanner.next(&match)) {
+        if (hitCount++ >= MaxHits) {
+            truncated = true;
+            cancel();
+            break;
+        }
+        scanned = match.offset + match.length;
+
+        const qint64 matchLine = buffer.lineAt(match.offset);
+        if (matchLine != line) {
+            line = matchLine;
+            lineStart = buffer.lineStart(line);
+            lineEnd = line + 1 < buffer.lineCount() ? buffer.lineStart(line + 1) - 1 : size;
+            counted = lineStart;
+            column = 0;
+        }
+        column += utf16Length(buffer, counted, match.offset);
+        counted = match.offset;
+
+        Hit hit;
+        hit.filePath = path;
+        hit.line = firstLine + line;
+        hit.column = column;
+        hit.length = utf16Length(buffer, match.offset, match.offset + match.length);
+
+        qint64 textStart = lineStart;
+        if (match.offset - lineStart > HitTextBytes / 2) {
+            textStart = match.offset - HitTextBytes / 4;
+            while (textStart < match.offset && (uchar(window.at(textStart)) & 0xC0) == 0x80) {
+                ++textStart;
+            }
+        }
+        hit.text = QString::fromUtf8(window.mid(textStart, qMin(lineEnd, textStart + HitTextBytes) - textStart));
+        if (hit.text.endsWith(QLatin1Char('\r'))) hit.text.chop(1);
+        if (textStart > lineStart) hit.text.prepend(QChar(0x2026));
+        hits->append(hit);
+    }
+    return scanned;
+}
+
+void FindInFiles::deliver() {
+    QVector<Hit> hits;
+    {
+        QMutexLocker locker(&hitsMutex);
+        hits.swap(pendingHits);
+        deliveryQueued = false;
+    }
+    if (!hits.isEmpty()) {
+        emit hitsFound(hits);
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef FINDINFILES_H
+#define FINDINFILES_H
+
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <memory>
+
+#include "textsearch.h"
+
+class QThread;
+
+// Searches every text file under a folder on a pool of worker threads.
+//
+// Each worker owns a deque of directories and files to visit. It takes work
+// from the back of its own deque and, once that is empty, steals from the
+// front of another's, so one deep directory does not leave the other
+// workers idle. Binary files (a NUL byte near the start) and hidden,
+// dependency and build directories are skipped.
+//
+// Files are read a chunk at a time, never mapped: a file rewritten in place
+// while it is searched (a log being rotated) only ends the read early. A
+// chunk is searched up to its last whole line, or for plain patterns up to
+// where a match would run past its end, and the rest carries over.
+//
+// Hits are collected per file and handed to the GUI thread with at most
+// one queued call in flight, however fast they are found.
+class FindInFiles : public QObject {
+    Q_OBJECT
+
+public:
+    struct Hit {
+        QString filePath;
+        // 0-based; column counts UTF-16 units the way the editor does.
+        qint64 line = 0;
+        int column = 0;
+        int length = 0;
+        QString text;
+    };
+
+    FindInFiles(const QString &rootPath, const TextSearch::Query &query, QObject *parent = nullptr);
+    // Cancels and waits for the workers.
+    ~FindInFiles() override;
+
+    // Searches only these files instead of walking the folder. Before start().
+    void setFiles(const QStringList &paths);
+    void start();
+    void cancel();
+    bool isRunning() const;
+    // True when the search stopped at MaxHits.
+    bool isTruncated() const;
+
+    qint64 filesSearched() const;
+    qint64 bytesSearched() const;
+
+    static constexpr qint64 MaxHits = 100000;
+
+signals:
+    void hitsFound(const QVector<FindInFiles::Hit> &hits);
+    void finished();
+
+private:
+    struct Task {
+        QString path;
+        bool directory = false;
+    };
+
+    struct Worker {
+        QMutex mutex;
+        std::deque<Task> tasks;
+        QThread *thread = nullptr;
+    };
+
+    void run(int index);
+    bool takeTask(int index, Task *task);
+    void push(int index, const Task &task);
+    void listDirectory(int index, const QString &path);
+    void searchFile(const QString &path);
+    // Adds the hits starting in [from, to) of window, whose first line is
+    // firstLine of the file. Returns where the last one ends, or from.
+    qint64 searchWindow(const QByteArray &window, qint64 from, qint64 to, qint64 firstLine,
+                        const QString &path, QVector<Hit> *hits);
+    void deliver();
+
+    QString root;
+    QStringList onlyFiles;
+    TextSearch search;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Tasks queued or running; the workers stop when it drops to zero.
+    std::atomic<qint64> pending;
+    std::atomic_bool cancelled;
+    std::atomic_bool truncated;
+    std::atomic_int running;
+    std::atomic<qint64> hitCount;
+    std::atomic<qint64> files;
+    std::atomic<qint64> bytes;
+
+    // Idle workers sleep here until a task is pushed or the search ends.
+    QMutex idleMutex;
+    QWaitCondition workAvailable;
+
+    QMutex hitsMutex;
+    QVector<Hit> pendingHits;
+    bool deliveryQueued;
+};
+
+#endif // FINDINFILES_H
@@ -0,0 +1,105 @@
+#include "gutterrenderer.h"
+
+#include <QFontMetricsF>
+#include <QPainter>
+
+#include <cmath>
+
+GutterRenderer::GutterRenderer()
+    : activeStyle(-1)
+    , widestDigit(0)
+    , noPen(Qt::NoPen)
+    , breakpointBrush(QColor(224, 82, 82))
+    , addedColor(QColor(98, 160, 84))
+    , modifiedColor(QColor(76, 132, 204))
+    , removedColor(QColor(224, 82, 82))
+{
+    setColors(QColor(128, 128, 128), QColor(200, 200, 200));
+    setFont(QFont());
+}
+
+void GutterRenderer::setFont(const QFont &font) {
+    styles[0].font = font;
+    styles[0].font.setBold(false);
+    styles[1].font = font;
+    styles[1].font.setBold(true);
+
+    prepare(styles[0]);
+    prepare(styles[1]);
+
+    qreal widest = 0;
+    for (qreal advance : styles[0].advances) {
+        widest = qMax(widest, advance);
+    }
+    widestDigit = int(std::ceil(widest));
+}
+
+void GutterRenderer::setColors(const QColor &text, const QColor &currentText) {
+    styles[0].pen = QPen(text);
+    styles[1].pen = QPen(currentText);
+}
+
+int GutterRenderer::digitWidth() const {
+    return widestDigit;
+}
+
+void GutterRenderer::prepare(Style &style) {
+    const QFontMetricsF metrics(style.font);
+    for (int digit = 0; digit < 10; ++digit) {
+        const QChar character('0' + digit);
+        QStaticText &text = style.digits[digit];
+        text.setText(QString(character));
+        text.setTextFormat(Qt::PlainText);
+        text.setPerformanceHint(QStaticText::AggressiveCaching);
+        text.prepare(QTransform(), style.font);
+        style.advances[digit] = metrics.horizontalAdvance(character);
+    }
+}
+
+void GutterRenderer::begin() {
+    activeStyle = -1;
+}
+
+void GutterRenderer::drawLineNumber(QPainter *painter, qint64 number, int right, int top, bool current) {
+    const int styleIndex = current ? 1 : 0;
+    const Style &style = styles[styleIndex];
+    if (activeStyle != styleIndex) {
+        painter->setFont(style.font);
+        painter->setPen(style.pen);
+        activeStyle = styleIndex;
+    }
+
+    // Least significant digit first, walking left from the right edge.
+    qreal x = right;
+    do {
+        const int digit = int(number % 10);
+        x -= style.advances[digit];
+        painter->drawStaticText(QPointF(x, top), style.digits[digit]);
+        number /= 10;
+    } while (number > 0);
+}
+
+void GutterRenderer::drawMarkers(QPainter *painter, int markers, int top, int height) {
+    if (markers == NoMarker) return;
+
+    // Diff marks are a thin bar along the left edge; a removal sits between
+    // rows, so it is drawn as a short bar at the top of the following one.
+    if (markers & DiffAdded) {
+        painter->fillRect(0, top, 3, height, addedColor);
+    } else if (markers & DiffModified) {
+        painter->fillRect(0, top, 3, height, modifiedColor);
+    }
+    if (markers & DiffRemoved) {
+        painter->fillRect(0, top, 6, 2, removedColor);
+    }
+
+    if (markers & Breakpoint) {
+        const int size = qMax(4, qMin(height, widestDigit) - 2);
+        painter->setPen(noPen);
+        painter->setBrush(breakpointBrush);
+        painter->setRenderHint(QPainter::Antialiasing, true);
+        painter->drawEllipse(QRect(5, top + (height - size) / 2, size, size));
+        painter->setRenderHint(QPainter::Antialiasing, false);
+        activeStyle = -1;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef GUTTERRENDERER_H
+#define GUTTERRENDERER_H
+
+#pragma once
+#include <QBrush>
+#include <QColor>
+#include <QFont>
+#include <QPen>
+#include <QStaticText>
+
+class QPainter;
+
+// Paints the rows of the line number area. Digits are laid out once per
+// font as QStaticText and line numbers are put together from them, and the
+// fonts, pens and brushes are built up front, so painting a row allocates
+// nothing no matter how fast the view scrolls.
+class GutterRenderer {
+public:
+    // Flags for the markers shown in front of a line number.
+    enum Marker {
+        NoMarker = 0x0,
+        Breakpoint = 0x1,
+        DiffAdded = 0x2,
+        DiffModified = 0x4,
+        DiffRemoved = 0x8
+    };
+
+    GutterRenderer();
+
+    void setFont(const QFont &font);
+    void setColors(const QColor &text, const QColor &currentText);
+
+    // Widest digit of the regular font, in pixels.
+    int digitWidth() const;
+
+    // Call once per paint event before drawing any rows.
+    void begin();
+
+    // Draws number so that its last digit ends at right. The current line
+    // is drawn bold.
+    void drawLineNumber(QPainter *painter, qint64 number, int right, int top, bool current);
+
+    // Draws the markers for a row of the given height starting at top.
+    void drawMarkers(QPainter *painter, int markers, int top, int height);
+
+private:
+    struct Style {
+        QFont font;
+        QPen pen;
+        QStaticText digits[10];
+        qreal advances[10];
+    };
+
+    void prepare(Style &style);
+
+    Style styles[2];
+    int activeStyle;
+    int widestDigit;
+
+    QPen noPen;
+    QBrush breakpointBrush;
+    QColor addedColor;
+    QColor modifiedColor;
+    QColor removedColor;
+};
+
+#endif // GUTTERRENDERER_H
@@ -2,15 +2,47 @@
 #define C_H
 
 #pragma once
-#include <QSyntaxHighlighter>
 #include <QTextCharFormat>
-#include <QRegularExpression>
 
-class CHighlighter : public QSyntaxHighlighter {
+#include "syntaxhighlighter.h"
+
+class CHighlighter : public SyntaxHighlighter {
     Q_OBJECT
 public:
-    CHighlighter(QTextDocument *parent) : QSyntaxHighlighter(parent) {
-        HighlightingRule rule;
+    CHighlighter(QTextDocument *parent)
+        : SyntaxHighlighter(parent)
+        , language(definition())
+    {
+    }
+
+    // Built on first use and shared by every C tab.
+    static const Language &definition() {
+        static const Language shared = build();
+        return shared;
+    }
+
+protected:
+    int highlightBlock(const QString &text, int previousState,
+                       QVector<QTextLayout::FormatRange> &ranges) override {
+        return lexBlock(text, previousState, language, ranges);
+    }
+
+private:
+    static Language build() {
+        Language language{Lexer::Rules{Lexer::KeywordTable{
+            {"if", Lexer::Keyword}, {"else", Lexer::Keyword}, {"for", Lexer::Keyword},
+            {"while", Lexer::Keyword}, {"do", Lexer::Keyword}, {"switch", Lexer::Keyword},
+            {"case", Lexer::Keyword}, {"default", Lexer::Keyword}, {"break", Lexer::Keyword},
+            {"continue", Lexer::Keyword}, {"return", Lexer::Keyword}, {"sizeof", Lexer::Keyword},
+            {"typedef", Lexer::Keyword}, {"struct", Lexer::Keyword}, {"enum", Lexer::Keyword},
+            {"union", Lexer::Keyword}, {"static", Lexer::Keyword}, {"extern", Lexer::Keyword},
+            {"volatile", Lexer::Keyword}, {"const", Lexer::Keyword}, {"register", Lexer::Keyword},
+            {"auto", Lexer::Keyword},
+            {"int", Lexer::Type}, {"float", Lexer::Type}, {"double", Lexer::Type},
+            {"char", Lexer::Type}, {"short", Lexer::Type}, {"long", Lexer::Type},
+            {"void", Lexer::Type}, {"bool", Lexer::Type}, {"signed", Lexer::Type},
+            {"unsigned", Lexer::Type}
+        }, false}, {}};
 
         QColor keywordColor(209, 154, 102);
         QColor typeColor(209, 154, 102);
@@ -20,118 +52,25 @@ public:
         QColor commentColor(92, 99, 112);
         QColor preprocessorColor(229, 192, 123);
 
-        keywordFormat.setForeground(keywordColor);
-        keywordFormat.setFontWeight(QFont::Bold);
-        QStringList keywordPatterns = {
-            "\\bif\\b", "\\belse\\b", "\\bfor\\b", "\\bwhile\\b",
-            "\\bdo\\b", "\\bswitch\\b", "\\bcase\\b", "\\bdefault\\b",
-            "\\bbreak\\b", "\\bcontinue\\b", "\\breturn\\b", "\\bsizeof\\b",
-            "\\btypedef\\b", "\\bstruct\\b", "\\benum\\b", "\\bunion\\b",
-            "\\bstatic\\b", "\\bextern\\b", "\\bvolatile\\b", "\\bconst\\b",
-            "\\bregister\\b", "\\bauto\\b"
-        };
-        for (const QString &pattern : keywordPatterns) {
-            rule.pattern = QRegularExpression(pattern);
-            rule.format = keywordFormat;
-            highlightingRules.append(rule);
-        }
-
-        typeFormat.setForeground(typeColor);
-        typeFormat.setFontWeight(QFont::Bold);
-        QStringList typePatterns = {"\\bint\\b", "\\bfloat\\b", "\\bdouble\\b",
-                                    "\\bchar\\b", "\\bshort\\b", "\\blong\\b",
-                                    "\\bvoid\\b", "\\bbool\\b", "\\bsigned\\b",
-                                    "\\bunsigned\\b"};
-        for (const QString &pattern : typePatterns) {
-            rule.pattern = QRegularExpression(pattern);
-            rule.format = typeFormat;
-            highlightingRules.append(rule);
-        }
+        language.formats[Lexer::Keyword].setForeground(keywordColor);
+        language.formats[Lexer::Keyword].setFontWeight(QFont::Bold);
 
-        preprocessorFormat.setForeground(preprocessorColor);
-        rule.pattern = QRegularExpression("^\\s*#[^\n]*");
-        rule.format = preprocessorFormat;
-        highlightingRules.append(rule);
+        language.formats[Lexer::Type].setForeground(typeColor);
+        language.formats[Lexer::Type].setFontWeight(QFont::Bold);
 
-        singleLineCommentFormat.setForeground(commentColor);
-        singleLineCommentFormat.setFontItalic(true);
-        rule.pattern = QRegularExpression("//[^\n]*");
-        rule.format = singleLineCommentFormat;
-        highlightingRules.append(rule);
+        language.formats[Lexer::Preprocessor].setForeground(preprocessorColor);
 
-        multiLineCommentFormat.setForeground(commentColor);
-        multiLineCommentFormat.setFontItalic(true);
-        commentStartExpression = QRegularExpression("/\\*");
-        commentEndExpression = QRegularExpression("\\*/");
+        language.formats[Lexer::Comment].setForeground(commentColor);
+        language.formats[Lexer::Comment].setFontItalic(true);
 
-        quotationFormat.setForeground(stringColor);
-        rule.pattern = QRegularExpression("\"([^\"\\\\]|\\\\.)*\"");
-        rule.format = quotationFormat;
-        highlightingRules.append(rule);
+        language.formats[Lexer::String].setForeground(stringColor);
+        language.formats[Lexer::Function].setForeground(functionColor);
+        language.formats[Lexer::Number].setForeground(numberColor);
 
-        rule.pattern = QRegularExpression("'([^'\\\\]|\\\\.)*'");
-        rule.format = quotationFormat;
-        highlightingRules.append(rule);
-
-        functionFormat.setForeground(functionColor);
-        rule.pattern = QRegularExpression("\\b[A-Za-z0-9_]+(?=\\()");
-        rule.format = functionFormat;
-        highlightingRules.append(rule);
-
-        numberFormat.setForeground(numberColor);
-        rule.pattern = QRegularExpression("\\b[0-9]+\\.?[0-9]*\\b");
-        rule.format = numberFormat;
-        highlightingRules.append(rule);
-    }
-
-protected:
-    void highlightBlock(const QString &text) override {
-        for (const HighlightingRule &rule : qAsConst(highlightingRules)) {
-            QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-            while (matchIterator.hasNext()) {
-                QRegularExpressionMatch match = matchIterator.next();
-                setFormat(match.capturedStart(), match.capturedLength(), rule.format);
-            }
-        }
-
-        setCurrentBlockState(0);
-        int startIndex = 0;
-        if (previousBlockState() != 1)
-            startIndex = text.indexOf(commentStartExpression);
-
-        while (startIndex >= 0) {
-            QRegularExpressionMatch match = commentEndExpression.match(text, startIndex);
-            int endIndex = match.capturedStart();
-            int commentLength = 0;
-            if (endIndex == -1) {
-                setCurrentBlockState(1);
-                commentLength = text.length() - startIndex;
-            } else {
-                commentLength = endIndex - startIndex + match.capturedLength();
-            }
-            setFormat(startIndex, commentLength, multiLineCommentFormat);
-            startIndex = text.indexOf(commentStartExpression, startIndex + commentLength);
-        }
+        return language;
     }
 
-private:
-    struct HighlightingRule {
-        QRegularExpression pattern;
-        QTextCharFormat format;
-    };
-    QVector<HighlightingRule> highlightingRules;
-
-    QRegularExpression commentStartExpression;
-    QRegularExpression commentEndExpression;
-
-    QTextCharFormat keywordFormat;
-    QTextCharFormat typeFormat;
-    QTextCharFormat singleLineCommentFormat;
-    QTextCharFormat multiLineCommentFormat;
-    QTextCharFormat quotationFormat;
-    QTextCharFormat functionFormat;
-    QTextCharFormat preprocessorFormat;
-    QTextCharFormat numberFormat;
+    const Language &language;
 };
 
 #endif //C_H
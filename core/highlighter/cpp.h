@@ -2,16 +2,54 @@
 #define CPP_H
 
 #pragma once
-#include <QSyntaxHighlighter>
 #include <QTextCharFormat>
-#include <QRegularExpression>
-#include <QPlainTextEdit>
 
-class CppHighlighter : public QSyntaxHighlighter {
+#include "syntaxhighlighter.h"
+
+class CppHighlighter : public SyntaxHighlighter {
     Q_OBJECT
 public:
-    CppHighlighter(QTextDocument *parent) : QSyntaxHighlighter(parent) {
-        HighlightingRule rule;
+    CppHighlighter(QTextDocument *parent)
+        : SyntaxHighlighter(parent)
+        , language(definition())
+    {
+    }
+
+    // Built on first use and shared by every C++ tab.
+    static const Language &definition() {
+        static const Language shared = build();
+        return shared;
+    }
+
+protected:
+    int highlightBlock(const QString &text, int previousState,
+                       QVector<QTextLayout::FormatRange> &ranges) override {
+        return lexBlock(text, previousState, language, ranges);
+    }
+
+private:
+    static Language build() {
+        Language language{Lexer::Rules{Lexer::KeywordTable{
+            {"char", Lexer::Keyword}, {"class", Lexer::Keyword}, {"const", Lexer::Keyword},
+            {"double", Lexer::Keyword}, {"enum", Lexer::Keyword}, {"explicit", Lexer::Keyword},
+            {"friend", Lexer::Keyword}, {"inline", Lexer::Keyword}, {"int", Lexer::Keyword},
+            {"long", Lexer::Keyword}, {"namespace", Lexer::Keyword}, {"operator", Lexer::Keyword},
+            {"private", Lexer::Keyword}, {"protected", Lexer::Keyword}, {"public", Lexer::Keyword},
+            {"short", Lexer::Keyword}, {"signals", Lexer::Keyword}, {"signed", Lexer::Keyword},
+            {"slots", Lexer::Keyword}, {"static", Lexer::Keyword}, {"struct", Lexer::Keyword},
+            {"template", Lexer::Keyword}, {"typedef", Lexer::Keyword}, {"typename", Lexer::Keyword},
+            {"union", Lexer::Keyword}, {"unsigned", Lexer::Keyword}, {"virtual", Lexer::Keyword},
+            {"void", Lexer::Keyword}, {"volatile", Lexer::Keyword}, {"bool", Lexer::Keyword},
+            {"if", Lexer::Keyword}, {"else", Lexer::Keyword}, {"for", Lexer::Keyword},
+            {"while", Lexer::Keyword}, {"do", Lexer::Keyword}, {"switch", Lexer::Keyword},
+            {"case", Lexer::Keyword}, {"default", Lexer::Keyword}, {"break", Lexer::Keyword},
+            {"continue", Lexer::Keyword}, {"return", Lexer::Keyword}, {"try", Lexer::Keyword},
+            {"catch", Lexer::Keyword}, {"throw", Lexer::Keyword}, {"new", Lexer::Keyword},
+            {"delete", Lexer::Keyword}, {"this", Lexer::Keyword}, {"auto", Lexer::Keyword},
+            {"constexpr", Lexer::Keyword}, {"decltype", Lexer::Keyword}, {"noexcept", Lexer::Keyword},
+            {"int", Lexer::Type}, {"float", Lexer::Type}, {"double", Lexer::Type},
+            {"char", Lexer::Type}, {"bool", Lexer::Type}, {"void", Lexer::Type}
+        }, true}, {}};
 
         QColor keywordColor(198, 120, 221);
         QColor typeColor(209, 154, 102);
@@ -21,129 +59,28 @@ public:
         QColor commentColor(92, 99, 112);
         QColor preprocessorColor(229, 192, 123);
 
-        keywordFormat.setForeground(keywordColor);
-        keywordFormat.setFontWeight(QFont::Bold);
-        QStringList keywordPatterns = {
-            "\\bchar\\b", "\\bclass\\b", "\\bconst\\b", "\\bdouble\\b",
-            "\\benum\\b", "\\bexplicit\\b", "\\bfriend\\b", "\\binline\\b",
-            "\\bint\\b", "\\blong\\b", "\\bnamespace\\b", "\\boperator\\b",
-            "\\bprivate\\b", "\\bprotected\\b", "\\bpublic\\b", "\\bshort\\b",
-            "\\bsignals\\b", "\\bsigned\\b", "\\bslots\\b", "\\bstatic\\b",
-            "\\bstruct\\b", "\\btemplate\\b", "\\btypedef\\b", "\\btypename\\b",
-            "\\bunion\\b", "\\bunsigned\\b", "\\bvirtual\\b", "\\bvoid\\b",
-            "\\bvolatile\\b", "\\bbool\\b", "\\bif\\b", "\\belse\\b",
-            "\\bfor\\b", "\\bwhile\\b", "\\bdo\\b", "\\bswitch\\b",
-            "\\bcase\\b", "\\bdefault\\b", "\\bbreak\\b", "\\bcontinue\\b",
-            "\\breturn\\b", "\\btry\\b", "\\bcatch\\b", "\\bthrow\\b",
-            "\\bnew\\b", "\\bdelete\\b", "\\bthis\\b", "\\bauto\\b",
-            "\\bconstexpr\\b", "\\bdecltype\\b", "\\bnoexcept\\b"
-        };
-        for (const QString &pattern : keywordPatterns) {
-            rule.pattern = QRegularExpression(pattern);
-            rule.format = keywordFormat;
-            highlightingRules.append(rule);
-        }
-
-        typeFormat.setForeground(typeColor);
-        typeFormat.setFontWeight(QFont::Bold);
-        QStringList typePatterns = {"\\bint\\b", "\\bfloat\\b", "\\bdouble\\b", "\\bchar\\b", "\\bbool\\b", "\\bvoid\\b"};
-        for (const QString &pattern : typePatterns) {
-            rule.pattern = QRegularExpression(pattern);
-            rule.format = typeFormat;
-            highlightingRules.append(rule);
-        }
-
-        classFormat.setForeground(typeColor);
-        classFormat.setFontWeight(QFont::Bold);
-        rule.pattern = QRegularExpression("\\bQ[A-Z][A-Za-z0-9_]+\\b");
-        rule.format = classFormat;
-        highlightingRules.append(rule);
-
-        preprocessorFormat.setForeground(preprocessorColor);
-        rule.pattern = QRegularExpression("^\\s*#[^\n]*");
-        rule.format = preprocessorFormat;
-        highlightingRules.append(rule);
-
-        singleLineCommentFormat.setForeground(commentColor);
-        singleLineCommentFormat.setFontItalic(true);
-        rule.pattern = QRegularExpression("//[^\n]*");
-        rule.format = singleLineCommentFormat;
-        highlightingRules.append(rule);
-
-        multiLineCommentFormat.setForeground(commentColor);
-        multiLineCommentFormat.setFontItalic(true);
-        commentStartExpression = QRegularExpression("/\\*");
-        commentEndExpression = QRegularExpression("\\*/");
-
-        quotationFormat.setForeground(stringColor);
-        rule.pattern = QRegularExpression("\"([^\"\\\\]|\\\\.)*\"");
-        rule.format = quotationFormat;
-        highlightingRules.append(rule);
-
-        rule.pattern = QRegularExpression("'([^'\\\\]|\\\\.)*'");
-        rule.format = quotationFormat;
-        highlightingRules.append(rule);
-
-        functionFormat.setForeground(functionColor);
-        rule.pattern = QRegularExpression("\\b[A-Za-z0-9_]+(?=\\()");
-        rule.format = functionFormat;
-        highlightingRules.append(rule);
-
-        numberFormat.setForeground(numberColor);
-        rule.pattern = QRegularExpression("\\b[0-9]+\\.?[0-9]*\\b");
-        rule.format = numberFormat;
-        highlightingRules.append(rule);
-    }
+        language.formats[Lexer::Keyword].setForeground(keywordColor);
+        language.formats[Lexer::Keyword].setFontWeight(QFont::Bold);
 
-protected:
-    void highlightBlock(const QString &text) override {
-        for (const HighlightingRule &rule : qAsConst(highlightingRules)) {
-            QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-            while (matchIterator.hasNext()) {
-                QRegularExpressionMatch match = matchIterator.next();
-                setFormat(match.capturedStart(), match.capturedLength(), rule.format);
-            }
-        }
-
-        setCurrentBlockState(0);
-        int startIndex = 0;
-        if (previousBlockState() != 1)
-            startIndex = text.indexOf(commentStartExpression);
-
-        while (startIndex >= 0) {
-            QRegularExpressionMatch match = commentEndExpression.match(text, startIndex);
-            int endIndex = match.capturedStart();
-            int commentLength = 0;
-            if (endIndex == -1) {
-                setCurrentBlockState(1);
-                commentLength = text.length() - startIndex;
-            } else {
-                commentLength = endIndex - startIndex + match.capturedLength();
-            }
-            setFormat(startIndex, commentLength, multiLineCommentFormat);
-            startIndex = text.indexOf(commentStartExpression, startIndex + commentLength);
-        }
+        language.formats[Lexer::Type].setForeground(typeColor);
+        language.formats[Lexer::Type].setFontWeight(QFont::Bold);
+
+        language.formats[Lexer::Class].setForeground(typeColor);
+        language.formats[Lexer::Class].setFontWeight(QFont::Bold);
+
+        language.formats[Lexer::Preprocessor].setForeground(preprocessorColor);
+
+        language.formats[Lexer::Comment].setForeground(commentColor);
+        language.formats[Lexer::Comment].setFontItalic(true);
+
+        language.formats[Lexer::String].setForeground(stringColor);
+        language.formats[Lexer::Function].setForeground(functionColor);
+        language.formats[Lexer::Number].setForeground(numberColor);
+
+        return language;
     }
 
-private:
-    struct HighlightingRule {
-        QRegularExpression pattern;
-        QTextCharFormat format;
-    };
-    QVector<HighlightingRule> highlightingRules;
-
-    QRegularExpression commentStartExpression;
-    QRegularExpression commentEndExpression;
-
-    QTextCharFormat keywordFormat;
-    QTextCharFormat typeFormat;
-    QTextCharFormat classFormat;
-    QTextCharFormat singleLineCommentFormat;
-    QTextCharFormat multiLineCommentFormat;
-    QTextCharFormat quotationFormat;
-    QTextCharFormat functionFormat;
-    QTextCharFormat preprocessorFormat;
-    QTextCharFormat numberFormat;
+    const Language &language;
 };
 
 #endif // CPP_H
@@ -0,0 +1,320 @@
+#include "highlightcache.h"
+#include "c.h"
+#include "cpp.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+
+#include <cstring>
+
+namespace {
+
+// A cache file: the header, blockCount + 1 BlockRecords (the last one only
+// marks where the runs end), then the runs. Numbers are in the byte order of
+// the machine that wrote them; another one fails the magic check.
+const char Magic[8] = {'C', 'H', 'O', 'R', 'A', 'H', 'L', 'C'};
+const quint32 FormatVersion = 1;
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 dialect;
+    qint64 size;
+    qint64 modified;
+    quint64 hash;
+    quint32 blockCount;
+    quint32 runBytes;
+};
+
+struct BlockRecord {
+    // Where the block's runs start, from the start of the runs.
+    quint32 offset;
+    // The user state SyntaxHighlighter gives the block.
+    quint32 state;
+};
+
+static_assert(sizeof(Header) == 48, "highlight cache header layout");
+static_assert(sizeof(BlockRecord) == 8, "highlight cache block layout");
+
+// A block's runs are its length in UTF-16 units, the number of runs, and for
+// each run the gap since the previous one ended and its length and token,
+// all as LEB128 varints. Most runs take two bytes.
+void appendVarint(QByteArray &out, quint64 value) {
+    while (value >= 0x80) {
+        out.append(char(uchar(value) | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+bool readVarint(const uchar *&p, const uchar *end, quint64 *value) {
+    quint64 result = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const uchar byte = *p++;
+        result |= quint64(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+const Language *languageFor(Lexer::Dialect dialect) {
+    switch (dialect) {
+    case Lexer::Cpp: return &CppHighlighter::definition();
+    case Lexer::C: return &CHighlighter::definition();
+    case Lexer::Plain: break;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+bool HighlightCache::Entry::open(const QString &path) {
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    size = file.size();
+    if (size < qint64(sizeof(Header))) return false;
+    data = file.map(0, size);
+    if (!data) return false;
+
+    const Header &header = *reinterpret_cast<const Header*>(data);
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != FormatVersion) {
+        return false;
+    }
+    const qint64 expected = qint64(sizeof(Header)) + (qint64(header.blockCount) + 1) * qint64(sizeof(BlockRecord))
+                          + qint64(header.runBytes);
+    return header.blockCount < 0x7fffffffu && size == expected;
+}
+
+Lexer::Dialect HighlightCache::Entry::dialect() const {
+    return Lexer::Dialect(reinterpret_cast<const Header*>(data)->dialect);
+}
+
+qint64 HighlightCache::Entry::fileSize() const {
+    return reinterpret_cast<const Header*>(data)->size;
+}
+
+qint64 HighlightCache::Entry::modified() const {
+    return reinterpret_cast<const Header*>(data)->modified;
+}
+
+quint64 HighlightCache::Entry::contentHash() const {
+    return reinterpret_cast<const Header*>(data)->hash;
+}
+
+int HighlightCache::Entry::blockCount() const {
+    return int(reinterpret_cast<const Header*>(data)->blockCount);
+}
+
+bool HighlightCache::Entry::block(int number, int textLength, int *state, QVector<Lexer::Run> *runs) const {
+    const Header &header = *reinterpret_cast<const Header*>(data);
+    if (number < 0 || quint32(number) >= header.blockCount) return false;
+
+    const BlockRecord *records = reinterpret_cast<const BlockRecord*>(data + sizeof(Header));
+    const quint32 from = records[number].offset;
+    const quint32 to = records[number + 1].offset;
+    if (from > to || to > header.runBytes) return false;
+
+    const uchar *p = data + sizeof(Header) + (qint64(header.blockCount) + 1) * sizeof(BlockRecord) + from;
+    const uchar *end = p + (to - from);
+
+    quint64 length = 0;
+    quint64 count = 0;
+    if (!readVarint(p, end, &length) || length != quint64(textLength)) return false;
+    if (!readVarint(p, end, &count) || count > quint64(end - p) / 2) return false;
+
+    runs->clear();
+    runs->reserve(int(count));
+    quint64 covered = 0;
+    for (quint64 i = 0; i < count; ++i) {
+        quint64 gap = 0;
+        quint64 packed = 0;
+        if (!readVarint(p, end, &gap) || !readVarint(p, end, &packed)) return false;
+
+        const quint64 runLength = packed >> 3;
+        const int token = int(packed & 7);
+        if (token >= Lexer::TokenCount || gap > length - covered || runLength > length - covered - gap) {
+            return false;
+        }
+        runs->append({int(covered + gap), int(runLength), Lexer::Token(token)});
+        covered += gap + runLength;
+    }
+
+    *state = int(records[number].state);
+    return true;
+}
+
+HighlightCache::HighlightCache(QObject *parent)
+    : QObject(parent)
+    , cacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/highlight")
+    , stopping(false)
+{
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("HighlightCache");
+    thread->start(QThread::LowPriority);
+}
+
+HighlightCache::~HighlightCache() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        jobs.clear();
+        jobAvailable.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+}
+
+void HighlightCache::setCacheDirectory(const QString &path) {
+    cacheDirectory = path;
+}
+
+QString HighlightCache::cacheFileFor(const QString &filePath) const {
+    const QString absolutePath = QFileInfo(filePath).absoluteFilePath();
+    const QByteArray key = QCryptographicHash::hash(absolutePath.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    return cacheDirectory + QLatin1Char('/') + QString::fromLatin1(key) + QLatin1String(".hlc");
+}
+
+std::shared_ptr<const HighlightCache::Entry> HighlightCache::find(const QString &filePath) const {
+    const Lexer::Dialect dialect = Lexer::dialectOf(filePath);
+    if (dialect == Lexer::Plain) return nullptr;
+
+    const QFileInfo info(filePath);
+    if (info.size() < MinFileSize) return nullptr;
+
+    auto entry = std::make_shared<Entry>();
+    if (!entry->open(cacheFileFor(filePath))
+        || entry->dialect() != dialect
+        || entry->fileSize() != info.size()
+        || entry->modified() != info.lastModified().toMSecsSinceEpoch()) {
+        return nullptr;
+    }
+    return entry;
+}
+
+void HighlightCache::store(const QString &filePath, const TextBuffer &buffer) {
+    if (Lexer::dialectOf(filePath) == Lexer::Plain || buffer.size() < MinFileSize) return;
+
+    QMutexLocker locker(&mutex);
+    // Only the latest contents of a file are worth writing.
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (jobs[i].filePath == filePath) {
+            jobs.removeAt(i);
+            break;
+        }
+    }
+    jobs.append(Job{filePath, cacheFileFor(filePath), buffer});
+    jobAvailable.wakeOne();
+}
+
+void HighlightCache::run() {
+    QMutexLocker locker(&mutex);
+
+    forever {
+        while (jobs.isEmpty() && !stopping) {
+            jobAvailable.wait(&mutex);
+        }
+        if (stopping) break;
+
+        const Job job = jobs.takeFirst();
+        locker.unlock();
+        write(job);
+        locker.relock();
+    }
+}
+
+void HighlightCache::write(const Job &job) {
+    const Lexer::Dialect dialect = Lexer::dialectOf(job.filePath);
+    const Language *language = languageFor(dialect);
+    if (!language) return;
+
+    // The buffer has to be what is on disk, or the entry would never match.
+    const QFileInfo info(job.filePath);
+    if (!info.exists() || info.size() != job.buffer.size()) return;
+
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.dialect = quint32(dialect);
+    header.size = info.size();
+    header.modified = info.lastModified().toMSecsSinceEpoch();
+    header.hash = job.buffer.contentHash();
+
+    {
+        Entry existing;
+        if (existing.open(job.cacheFile) && existing.dialect() == dialect
+            && existing.fileSize() == header.size && existing.modified() == header.modified
+            && existing.contentHash() == header.hash) {
+            return;
+        }
+    }
+
+    // Blocks are lexed from the bytes the same way FileLoader turns them
+    // into text, so lengths and offsets match what the document holds.
+    const qint64 lineCount = job.buffer.lineCount();
+    if (lineCount >= 0x7fffffff) return;
+
+    QVector<BlockRecord> records;
+    records.reserve(int(lineCount) + 1);
+    QByteArray runBytes;
+    QVector<Lexer::Run> runs;
+    int next = Lexer::Normal;
+
+    for (qint64 line = 0; line < lineCount; ++line) {
+        if (stopping) return;
+
+        const qint64 start = job.buffer.lineStart(line);
+        QByteArray bytes = job.buffer.read(start, job.buffer.lineStart(line + 1) - start);
+        if (bytes.endsWith('\n')) bytes.chop(1);
+        if (bytes.endsWith('\r')) bytes.chop(1);
+        QString text = QString::fromUtf8(bytes);
+        TextBuffer::foldLineEndings(text);
+
+        const int input = next;
+        runs.clear();
+        next = Lexer::lexRuns(text, Lexer::State(input), language->rules, runs);
+
+        if (runBytes.size() >= 0x7fffffff) return;
+        records.append({quint32(runBytes.size()), quint32((input << 15) | (next & 0x7FFF))});
+        appendVarint(runBytes, quint64(text.size()));
+        appendVarint(runBytes, quint64(runs.size()));
+        int covered = 0;
+        for (const Lexer::Run &run : runs) {
+            appendVarint(runBytes, quint64(run.start - covered));
+            appendVarint(runBytes, (quint64(run.length) << 3) | quint64(run.token));
+            covered = run.start + run.length;
+        }
+    }
+    records.append({quint32(runBytes.size()), 0});
+    header.blockCount = quint32(lineCount);
+    header.runBytes = quint32(runBytes.size());
+
+    QSaveFile output(job.cacheFile);
+    const bool saved = QDir().mkpath(QFileInfo(job.cacheFile).absolutePath())
+        && output.open(QIODevice::WriteOnly)
+        && output.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header))
+        && output.write(reinterpret_cast<const char*>(records.constData()),
+                        qint64(records.size()) * qint64(sizeof(BlockRecord)))
+               == qint64(records.size()) * qint64(sizeof(BlockRecord))
+        && output.write(runBytes) == runBytes.size()
+        && output.commit();
+    if (saved) prune(QFileInfo(job.cacheFile).absolutePath());
+}
+
+void HighlightCache::prune(const QString &directory) {
+    const QFileInfoList entries = QDir(directory).entryInfoList({QStringLiteral("*.hlc")}, QDir::Files, QDir::Time);
+    qint64 total = 0;
+    for (const QFileInfo &entry : entries) {
+        total += entry.size();
+        // Newest first, so whatever no longer fits is the oldest.
+        if (total > MaxCacheBytes) QFile::remove(entry.filePath());
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef HIGHLIGHTCACHE_H
+#define HIGHLIGHTCACHE_H
+
+#pragma once
+#include <QObject>
+#include <QFile>
+#include <QString>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+#include "lexer.h"
+#include "../textbuffer.h"
+
+class QThread;
+
+// Highlighting of files that were open before, so reopening one colors it
+// without lexing it again.
+//
+// Each file gets one cache file: a table with the state of every block and
+// where its runs start, followed by the runs themselves, varint packed. It
+// is memory mapped and read one block at a time as the highlighter gets to
+// it. An entry is only used for a file of the same size and mtime, and the
+// editor drops it once loading shows the contents hash differently.
+//
+// Entries are written on a worker thread, which lexes a snapshot of the
+// buffer once a file has been loaded or saved.
+class HighlightCache : public QObject {
+    Q_OBJECT
+
+public:
+    class Entry {
+    public:
+        Entry() : data(nullptr), size(0) {}
+
+        Entry(const Entry &) = delete;
+        Entry &operator=(const Entry &) = delete;
+
+        // Maps path; false when it is missing, damaged or of another version.
+        bool open(const QString &path);
+
+        Lexer::Dialect dialect() const;
+        qint64 fileSize() const;
+        qint64 modified() const;
+        // TextBuffer::contentHash() of the text it was made from.
+        quint64 contentHash() const;
+        int blockCount() const;
+
+        // The runs and the state (as SyntaxHighlighter keeps it) of block
+        // number; false when the entry does not cover a block of textLength
+        // UTF-16 units there.
+        bool block(int number, int textLength, int *state, QVector<Lexer::Run> *runs) const;
+
+    private:
+        QFile file;
+        const uchar *data;
+        qint64 size;
+    };
+
+    explicit HighlightCache(QObject *parent = nullptr);
+    // Abandons the entry being written and waits for the worker.
+    ~HighlightCache() override;
+
+    // The entry for filePath as it is on disk now, or null.
+    std::shared_ptr<const Entry> find(const QString &filePath) const;
+    // Writes buffer's highlighting as the entry for filePath, which must
+    // hold the same contents, unless it is already there.
+    void store(const QString &filePath, const TextBuffer &buffer);
+
+    // Defaults to a "highlight" directory under the application cache.
+    void setCacheDirectory(const QString &path);
+
+    // Small files highlight faster than their entry would load.
+    static constexpr qint64 MinFileSize = 256 * 1024;
+    // The oldest entries go once the directory grows past this.
+    static constexpr qint64 MaxCacheBytes = 256 * 1024 * 1024;
+
+private:
+    struct Job {
+        QString filePath;
+        QString cacheFile;
+        TextBuffer buffer;
+    };
+
+    QString cacheFileFor(const QString &filePath) const;
+    void run();
+    void write(const Job &job);
+    void prune(const QString &directory);
+
+    QString cacheDirectory;
+
+    QThread *thread;
+    QMutex mutex;
+    QWaitCondition jobAvailable;
+    QList<Job> jobs;
+    std::atomic_bool stopping;
+};
+
+#endif // HIGHLIGHTCACHE_H
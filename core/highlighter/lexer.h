@@ -0,0 +1,290 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#pragma once
+#include <QChar>
+#include <QByteArray>
+#include <QStringView>
+#include <QVector>
+#include <initializer_list>
+
+// Single-pass tokenizer shared by the C-family highlighters. One left to
+// right scan per block replaces the old list of regular expressions, which
+// ran one full scan per keyword.
+
+namespace Lexer {
+
+enum Token {
+    Keyword,
+    Type,
+    Class,
+    Function,
+    Number,
+    String,
+    Comment,
+    Preprocessor,
+    TokenCount
+};
+
+// Block states, kept compatible with the values the regex highlighters used.
+enum State {
+    Normal = 0,
+    InComment = 1
+};
+
+// Keyword lookup through a perfect hash built once when the table is
+// constructed: the seed is searched until no two words share a slot, so a
+// lookup is one hash, one slot and at most one comparison.
+class KeywordTable {
+public:
+    struct Entry {
+        const char *word;
+        Token token;
+    };
+
+    // When a word is listed twice the later entry wins.
+    KeywordTable(std::initializer_list<Entry> entries) {
+        for (const Entry &entry : entries) {
+            const int length = int(qstrlen(entry.word));
+            int existing = -1;
+            for (int i = 0; i < words.size(); ++i) {
+                if (qstrcmp(words[i].word, entry.word) == 0) existing = i;
+            }
+            if (existing >= 0) {
+                words[existing].token = entry.token;
+            } else {
+                words.append(entry);
+            }
+            minLength = qMin(minLength, length);
+            maxLength = qMax(maxLength, length);
+        }
+
+        int size = 1;
+        while (size < words.size() * 2) size <<= 1;
+
+        for (seed = 1;; ++seed) {
+            if (seed % 256 == 0) size <<= 1;
+            table.fill(-1, size);
+            mask = quint32(size - 1);
+
+            bool collision = false;
+            for (int i = 0; i < words.size() && !collision; ++i) {
+                const char *word = words[i].word;
+                const qsizetype length = qstrlen(word);
+                qint16 &slot = table[hash(word, length) & mask];
+                collision = slot >= 0;
+                slot = qint16(i);
+            }
+            if (!collision) break;
+        }
+    }
+
+    // Returns the token for the word at text, or -1. Text is UTF-16 when
+    // highlighting and UTF-8 when indexing.
+    template <typename Char>
+    int lookup(const Char *text, qsizetype length) const {
+        if (length < minLength || length > maxLength) return -1;
+
+        const int index = table[hash(text, length) & mask];
+        if (index < 0) return -1;
+
+        const char *word = words[index].word;
+        for (qsizetype i = 0; i < length; ++i) {
+            if (quint32(uchar(word[i])) != quint32(text[i])) return -1;
+        }
+        return word[length] == '\0' ? int(words[index].token) : -1;
+    }
+
+private:
+    template <typename Char>
+    quint32 hash(const Char *text, qsizetype length) const {
+        quint32 value = seed ^ (quint32(length) * 0x9E3779B1u);
+        for (qsizetype i = 0; i < length; ++i) {
+            value = (value ^ quint32(text[i])) * 0x01000193u;
+        }
+        return value ^ (value >> 15);
+    }
+
+    QVector<Entry> words;
+    QVector<qint16> table;
+    quint32 seed = 0;
+    quint32 mask = 0;
+    int minLength = 0x7FFF;
+    int maxLength = 0;
+};
+
+// Which rules a file is read with, by the suffix of its name.
+enum Dialect {
+    Plain,
+    C,
+    Cpp
+};
+
+inline Dialect dialectOf(QStringView fileName) {
+    const qsizetype dot = fileName.lastIndexOf(u'.');
+    if (dot < 0) return Plain;
+    const QStringView suffix = fileName.mid(dot + 1);
+    auto is = [suffix](const char16_t *name) {
+        return suffix.compare(QStringView(name), Qt::CaseInsensitive) == 0;
+    };
+    // Headers are read as C++; the C rules are a subset.
+    if (is(u"cpp") || is(u"hpp") || is(u"h")) return Cpp;
+    if (is(u"c")) return C;
+    return Plain;
+}
+
+struct Rules {
+    KeywordTable keywords;
+    // Qt class names (QString, QWidget, ...) are shown as types.
+    bool qtClasses;
+};
+
+inline bool isWordChar(char16_t c) {
+    if (c < 0x80) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+    return QChar::isLetterOrNumber(c);
+}
+
+inline bool isDigit(char16_t c) {
+    return c >= '0' && c <= '9';
+}
+
+inline qsizetype findCommentEnd(const char16_t *text, qsizetype from, qsizetype length) {
+    for (qsizetype i = from; i + 1 < length; ++i) {
+        if (text[i] == '*' && text[i + 1] == '/') return i;
+    }
+    return -1;
+}
+
+// Scans one block starting in state and calls sink(start, length, token) for
+// every highlighted range. A preprocessor line is emitted as a whole first;
+// strings, comments, calls and numbers inside it follow and take precedence.
+// Returns the state the next block starts in.
+template <typename Emit>
+State lexBlock(QStringView block, State state, const Rules &rules, Emit &&sink) {
+    const char16_t *text = block.utf16();
+    const qsizetype length = block.size();
+    qsizetype i = 0;
+
+    qsizetype indent = 0;
+    while (indent < length && QChar::isSpace(text[indent])) ++indent;
+    const bool preprocessor = indent < length && text[indent] == '#';
+    if (preprocessor) {
+        sink(0, length, Preprocessor);
+    }
+
+    if (state == InComment) {
+        const qsizetype end = findCommentEnd(text, 0, length);
+        if (end < 0) {
+            sink(0, length, Comment);
+            return InComment;
+        }
+        sink(0, end + 2, Comment);
+        i = end + 2;
+    }
+
+    while (i < length) {
+        const char16_t c = text[i];
+
+        if (c == '/' && i + 1 < length) {
+            if (text[i + 1] == '/') {
+                sink(i, length - i, Comment);
+                return Normal;
+            }
+            if (text[i + 1] == '*') {
+                const qsizetype end = findCommentEnd(text, i + 2, length);
+                if (end < 0) {
+                    sink(i, length - i, Comment);
+                    return InComment;
+                }
+                sink(i, end + 2 - i, Comment);
+                i = end + 2;
+                continue;
+            }
+        }
+
+        if (c == '"' || c == '\'') {
+            qsizetype j = i + 1;
+            while (j < length && text[j] != c) {
+                j += text[j] == '\\' ? 2 : 1;
+            }
+            // An unterminated quote is left uncoloured.
+            if (j < length) {
+                sink(i, j + 1 - i, String);
+                i = j + 1;
+            } else {
+                ++i;
+            }
+            continue;
+        }
+
+        if (isDigit(c)) {
+            qsizetype j = i + 1;
+            while (j < length && (isWordChar(text[j]) || text[j] == '.')) ++j;
+            sink(i, j - i, Number);
+            i = j;
+            continue;
+        }
+
+        if (isWordChar(c)) {
+            qsizetype j = i + 1;
+            while (j < length && isWordChar(text[j])) ++j;
+
+            if (j < length && text[j] == '(') {
+                sink(i, j - i, Function);
+            } else if (!preprocessor) {
+                const int token = rules.keywords.lookup(text + i, j - i);
+                if (token >= 0) {
+                    sink(i, j - i, Token(token));
+                } else if (rules.qtClasses && j - i >= 3 && c == 'Q'
+                           && text[i + 1] >= 'A' && text[i + 1] <= 'Z') {
+                    sink(i, j - i, Class);
+                }
+            }
+            i = j;
+            continue;
+        }
+
+        ++i;
+    }
+
+    return Normal;
+}
+
+// One highlighted range of a block.
+struct Run {
+    int start;
+    int length;
+    Token token;
+};
+
+// lexBlock() as ranges that never overlap: a preprocessor line is split
+// around the tokens inside it. Returns the state the next block starts in.
+inline State lexRuns(QStringView block, State state, const Rules &rules, QVector<Run> &runs) {
+    const int length = int(block.size());
+    bool preprocessor = false;
+    int covered = 0;
+
+    const State next = lexBlock(block, state, rules,
+        [&](qsizetype start, qsizetype tokenLength, Token token) {
+            if (token == Preprocessor) {
+                preprocessor = true;
+                return;
+            }
+            if (preprocessor && start > covered) {
+                runs.append({covered, int(start) - covered, Preprocessor});
+            }
+            runs.append({int(start), int(tokenLength), token});
+            covered = int(start + tokenLength);
+        });
+
+    if (preprocessor && covered < length) {
+        runs.append({covered, length - covered, Preprocessor});
+    }
+    return next;
+}
+
+} // namespace Lexer
+
+#endif // LEXER_H
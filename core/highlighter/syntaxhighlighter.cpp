@@ -0,0 +1,209 @@
+#include "syntaxhighlighter.h"
+
+#include <QElapsedTimer>
+#include <QTextDocument>
+#include <QTimer>
+
+#include <limits>
+
+static const int NothingDirty = std::numeric_limits<int>::max();
+
+SyntaxHighlighter::SyntaxHighlighter(QTextDocument *document)
+    : QObject(document)
+    , doc(document)
+    , timer(new QTimer(this))
+    , dirtyFrom(NothingDirty)
+    , dirtyUntil(-1)
+    , blockCount(document->blockCount())
+    , visibleFirst(0)
+    , visibleCount(0)
+    , applying(false)
+    , cacheLanguage(nullptr)
+{
+    timer->setInterval(0);
+    connect(timer, &QTimer::timeout, this, &SyntaxHighlighter::processSlice);
+    connect(doc, &QTextDocument::contentsChange, this, &SyntaxHighlighter::onContentsChange);
+
+    rehighlight();
+}
+
+QTextDocument *SyntaxHighlighter::document() const {
+    return doc;
+}
+
+void SyntaxHighlighter::setVisibleBlocks(int first, int count) {
+    if (first == visibleFirst && count == visibleCount) return;
+
+    visibleFirst = first;
+    visibleCount = count;
+    timer->start();
+}
+
+bool SyntaxHighlighter::isApplyingFormats() const {
+    return applying;
+}
+
+bool SyntaxHighlighter::isFinished() const {
+    return dirtyFrom == NothingDirty;
+}
+
+void SyntaxHighlighter::rehighlight() {
+    for (QTextBlock block = doc->begin(); block.isValid(); block = block.next()) {
+        block.setUserState(-1);
+    }
+
+    blockCount = doc->blockCount();
+    dirtyFrom = 0;
+    dirtyUntil = blockCount - 1;
+    timer->start();
+}
+
+void SyntaxHighlighter::setCache(std::shared_ptr<const HighlightCache::Entry> entry, const Language &language) {
+    cache = std::move(entry);
+    cacheLanguage = cache ? &language : nullptr;
+}
+
+void SyntaxHighlighter::dropCache() {
+    cache.reset();
+    cacheLanguage = nullptr;
+}
+
+void SyntaxHighlighter::onContentsChange(int position, int charsRemoved, int charsAdded) {
+    if (applying) return;
+
+    // Loading appends; anything else may change text the cache still has.
+    // The first insert into an empty document is reported as replacing it.
+    const int characters = doc->characterCount();
+    if (cache && (position + charsAdded < characters - 1
+                  || (charsRemoved > 0 && charsAdded < characters - 1))) {
+        dropCache();
+    }
+
+    QTextBlock first = doc->findBlock(position);
+    QTextBlock last = doc->findBlock(position + charsAdded);
+    if (!first.isValid()) first = doc->lastBlock();
+    if (!last.isValid()) last = doc->lastBlock();
+
+    // Block numbers after the edit moved by the change in block count.
+    const int firstNumber = first.blockNumber();
+    const int delta = doc->blockCount() - blockCount;
+    blockCount = doc->blockCount();
+    if (dirtyUntil >= firstNumber) {
+        dirtyUntil = qMax(firstNumber, dirtyUntil + delta);
+    }
+    dirtyUntil = qMax(dirtyUntil, last.blockNumber());
+    dirtyFrom = qMin(dirtyFrom, firstNumber);
+
+    int changed = 0;
+    for (QTextBlock block = first; block.isValid(); block = block.next()) {
+        block.setUserState(-1);
+        ++changed;
+        if (block == last) break;
+    }
+
+    // Ordinary typing is highlighted right away so the edited line is never
+    // painted unformatted; anything that follows is left to the slices.
+    if (changed <= SynchronousBlocks) {
+        for (QTextBlock block = first; block.isValid(); block = block.next()) {
+            highlight(block);
+            if (block == last) break;
+        }
+    }
+
+    timer->start();
+}
+
+void SyntaxHighlighter::processSlice() {
+    QElapsedTimer clock;
+    clock.start();
+
+    // The visible blocks use whatever state precedes them right now; if that
+    // turns out to be wrong the pass below fixes them when it gets there.
+    QTextBlock block = doc->findBlockByNumber(visibleFirst);
+    for (int i = 0; i < visibleCount && block.isValid(); ++i, block = block.next()) {
+        if (!isValid(block, inputState(block))) {
+            highlight(block);
+        }
+    }
+
+    block = doc->findBlockByNumber(dirtyFrom);
+    while (block.isValid()) {
+        if (!isValid(block, inputState(block))) {
+            highlight(block);
+        } else if (block.blockNumber() > dirtyUntil) {
+            // Nothing after this point was touched and the state chain has
+            // caught up, so every remaining block is already correct.
+            block = QTextBlock();
+            break;
+        }
+
+        block = block.next();
+        if (clock.elapsed() >= SliceMilliseconds) break;
+    }
+
+    if (block.isValid()) {
+        dirtyFrom = block.blockNumber();
+    } else {
+        dirtyFrom = NothingDirty;
+        dirtyUntil = -1;
+        timer->stop();
+    }
+}
+
+bool SyntaxHighlighter::isValid(const QTextBlock &block, int input) const {
+    const int state = block.userState();
+    return state >= 0 && (state >> 15) == input;
+}
+
+int SyntaxHighlighter::inputState(const QTextBlock &block) const {
+    const QTextBlock previous = block.previous();
+    if (!previous.isValid()) return 0;
+
+    const int state = previous.userState();
+    return state < 0 ? 0 : (state & 0x7FFF);
+}
+
+void SyntaxHighlighter::highlight(QTextBlock block) {
+    QVector<QTextLayout::FormatRange> formats;
+    const int input = inputState(block);
+    const QString text = block.text();
+
+    int output = -1;
+    if (cache) {
+        int state = 0;
+        QVector<Lexer::Run> runs;
+        if (cache->block(block.blockNumber(), int(text.size()), &state, &runs) && (state >> 15) == input) {
+            appendRanges(runs, *cacheLanguage, formats);
+            output = state & 0x7FFF;
+        }
+    }
+    if (output < 0) {
+        output = highlightBlock(text, input, formats);
+    }
+    block.setUserState((input << 15) | (output & 0x7FFF));
+
+    QTextLayout *layout = block.layout();
+    if (layout->formats() == formats) return;
+
+    applying = true;
+    layout->setFormats(formats);
+    doc->markContentsDirty(block.position(), block.length());
+    applying = false;
+}
+
+int SyntaxHighlighter::lexBlock(const QString &text, int previousState, const Language &language,
+                                QVector<QTextLayout::FormatRange> &ranges) {
+    QVector<Lexer::Run> runs;
+    const Lexer::State state = previousState == Lexer::InComment ? Lexer::InComment : Lexer::Normal;
+    const Lexer::State next = Lexer::lexRuns(text, state, language.rules, runs);
+    appendRanges(runs, language, ranges);
+    return next;
+}
+
+void SyntaxHighlighter::appendRanges(const QVector<Lexer::Run> &runs, const Language &language,
+                                     QVector<QTextLayout::FormatRange> &ranges) {
+    ranges.reserve(ranges.size() + runs.size());
+    for (const Lexer::Run &run : runs) {
+        ranges.append({run.start, run.length, language.formats[run.token]});
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef SYNTAXHIGHLIGHTER_H
+#define SYNTAXHIGHLIGHTER_H
+
+#pragma once
+#include <QObject>
+#include <QTextBlock>
+#include <QTextCharFormat>
+#include <QTextLayout>
+#include <QVector>
+#include <memory>
+
+#include "highlightcache.h"
+#include "lexer.h"
+
+class QTextDocument;
+class QTimer;
+
+// Everything a lexer based highlighter needs for one language. Instances
+// are built once per process, never modified, and shared by all tabs.
+struct Language {
+    Lexer::Rules rules;
+    QTextCharFormat formats[Lexer::TokenCount];
+};
+
+// Incremental replacement for QSyntaxHighlighter. Changed blocks are only
+// marked; the work is done from the event loop in slices of a few
+// milliseconds, visible blocks first, so opening or editing a large file
+// never blocks the UI on a full rehighlight.
+//
+// Each block's user state records the state it was highlighted with and the
+// state it ended in. A block whose text is unchanged and whose input state
+// still matches is skipped without being lexed again.
+class SyntaxHighlighter : public QObject {
+    Q_OBJECT
+
+public:
+    explicit SyntaxHighlighter(QTextDocument *document);
+
+    QTextDocument *document() const;
+
+    // Blocks in [first, first + count) are highlighted before the rest.
+    void setVisibleBlocks(int first, int count);
+
+    // True while formats are being applied; the resulting contentsChange
+    // signals do not describe text changes.
+    bool isApplyingFormats() const;
+    bool isFinished() const;
+
+    void rehighlight();
+
+    // Takes the highlighting of blocks from entry, read with language, for
+    // as long as the document holds what it was made from. Blocks it does
+    // not match are lexed as usual. Any edit other than appending text at
+    // the end drops it.
+    void setCache(std::shared_ptr<const HighlightCache::Entry> entry, const Language &language);
+    void dropCache();
+
+protected:
+    // Fills formats for one block and returns the state the next block
+    // starts in. States must fit in 15 bits.
+    virtual int highlightBlock(const QString &text, int previousState,
+                               QVector<QTextLayout::FormatRange> &formats) = 0;
+
+    // highlightBlock() for lexer based languages.
+    static int lexBlock(const QString &text, int previousState, const Language &language,
+                        QVector<QTextLayout::FormatRange> &ranges);
+    static void appendRanges(const QVector<Lexer::Run> &runs, const Language &language,
+                             QVector<QTextLayout::FormatRange> &ranges);
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void processSlice();
+
+private:
+    bool isValid(const QTextBlock &block, int input) const;
+    int inputState(const QTextBlock &block) const;
+    void highlight(QTextBlock block);
+
+    QTextDocument *doc;
+    QTimer *timer;
+
+    // Blocks before dirtyFrom have been checked in document order; no block
+    // after dirtyUntil has been edited since.
+    int dirtyFrom;
+    int dirtyUntil;
+    int blockCount;
+    int visibleFirst;
+    int visibleCount;
+    bool applying;
+
+    std::shared_ptr<const HighlightCache::Entry> cache;
+    const Language *cacheLanguage;
+
+    static constexpr int SliceMilliseconds = 4;
+    static constexpr int SynchronousBlocks = 32;
+};
+
+#endif // SYNTAXHIGHLIGHTER_H
@@ -0,0 +1,190 @@
+#include "mappedfile.h"
+#include "textbuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+MappedFile::MappedFile(const QString &filePath)
+    : file(filePath)
+    , mapping(nullptr)
+    , opened(false)
+    , fileSize(0)
+    , indexedSize(0)
+    , indexedNewlines(0)
+{
+}
+
+MappedFile::~MappedFile() {
+    if (mapping) {
+        file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(mapping)));
+    }
+}
+
+bool MappedFile::open() {
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    fileSize = file.size();
+    if (fileSize > 0) {
+        uchar *address = file.map(0, fileSize);
+        if (!address) {
+            file.close();
+            return false;
+        }
+        mapping = reinterpret_cast<const char*>(address);
+    }
+
+    // The descriptor is no longer needed once the mapping exists.
+    file.close();
+    opened = true;
+    return true;
+}
+
+bool MappedFile::isOpen() const {
+    return opened;
+}
+
+QString MappedFile::filePath() const {
+    return file.fileName();
+}
+
+qint64 MappedFile::size() const {
+    return fileSize;
+}
+
+const char *MappedFile::data() const {
+    return mapping;
+}
+
+bool MappedFile::buildLineIndex(qint64 maxBytes) {
+    qint64 budget = maxBytes;
+
+    while (indexedSize < fileSize && budget > 0) {
+        const qint64 blockLength = qMin(IndexBlockSize, fileSize - indexedSize);
+        newlinesBefore.append(indexedNewlines);
+
+        const char *begin = mapping + indexedSize;
+        const char *end = begin + blockLength;
+        while (begin < end) {
+            const char *hit = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+            if (!hit) break;
+            ++indexedNewlines;
+            begin = hit + 1;
+        }
+
+        indexedSize += blockLength;
+        budget -= blockLength;
+    }
+
+    return isIndexed();
+}
+
+bool MappedFile::isIndexed() const {
+    return indexedSize >= fileSize;
+}
+
+qint64 MappedFile::indexedBytes() const {
+    return indexedSize;
+}
+
+qint64 MappedFile::lineCount() const {
+    return indexedNewlines + 1;
+}
+
+qint64 MappedFile::lineOffset(qint64 line) const {
+    if (line <= 0) return 0;
+    if (line > indexedNewlines) return -1;
+
+    // Find the block holding the line-th newline, then scan inside it.
+    auto it = std::upper_bound(newlinesBefore.cbegin(), newlinesBefore.cend(), line - 1);
+    const qint64 block = (it - newlinesBefore.cbegin()) - 1;
+
+    qint64 remaining = line - newlinesBefore[block];
+    const char *begin = mapping + block * IndexBlockSize;
+    const char *end = mapping + fileSize;
+    while (begin < end) {
+        const char *hit = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        if (!hit) break;
+        if (--remaining == 0) {
+            return (hit - mapping) + 1;
+        }
+        begin = hit + 1;
+    }
+    return -1;
+}
+
+qint64 MappedFile::countNewlines(qint64 from, qint64 to) const {
+    return newlinesBeforeOffset(to) - newlinesBeforeOffset(from);
+}
+
+qint64 MappedFile::newlinesBeforeOffset(qint64 offset) const {
+    if (offset >= indexedSize) return indexedNewlines;
+
+    const qint64 block = offset / IndexBlockSize;
+    qint64 count = newlinesBefore[block];
+
+    const char *begin = mapping + block * IndexBlockSize;
+    const char *end = mapping + offset;
+    while (begin < end) {
+        const char *hit = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        if (!hit) break;
+        ++count;
+        begin = hit + 1;
+    }
+    return count;
+}
+
+QString MappedFile::readLines(qint64 firstLine, qint64 count, qint64 maxBytes, qint64 *linesRead) const {
+    if (linesRead) *linesRead = 0;
+
+    const qint64 start = lineOffset(firstLine);
+    if (start < 0 || count <= 0 || !mapping) {
+        return QString();
+    }
+
+    const qint64 limit = qMin(fileSize, start + maxBytes);
+    qint64 end = start;
+    qint64 lines = 0;
+
+    while (lines < count) {
+        const char *hit = static_cast<const char*>(
+            std::memchr(mapping + end, '\n', limit - end));
+        if (!hit) {
+            if (limit == fileSize) {
+                end = limit;
+                ++lines;
+            } else if (lines == 0) {
+                // A single line longer than maxBytes is cut, but never inside
+                // a UTF-8 sequence.
+                end = limit;
+                while (end > start && (static_cast<uchar>(mapping[end]) & 0xC0) == 0x80) {
+                    --end;
+                }
+                lines = 1;
+            } else {
+                // Drop the partial line instead of showing half of it.
+                --end;
+            }
+            break;
+        }
+
+        ++lines;
+        if (lines == count) {
+            end = hit - mapping;
+            break;
+        }
+        end = (hit - mapping) + 1;
+    }
+
+    if (linesRead) *linesRead = lines;
+
+    // The '\r' of a "\r\n" whose '\n' falls outside the window is dropped.
+    if (end > start && mapping[end - 1] == '\r' && end < fileSize && mapping[end] == '\n') {
+        --end;
+    }
+
+    QString text = QString::fromUtf8(mapping + start, end - start);
+    TextBuffer::foldLineEndings(text);
+    return text;
+}
@@ -0,0 +1,62 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#pragma once
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// Read-only view of a file on disk. The contents are memory mapped so only the
+// pages that are actually touched become resident, and a sparse line index
+// (one entry per 64 KiB block) lets callers seek to any line without keeping
+// per-line offsets around.
+class MappedFile {
+public:
+    explicit MappedFile(const QString &filePath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open();
+    bool isOpen() const;
+
+    QString filePath() const;
+    qint64 size() const;
+    const char *data() const;
+
+    // Extends the line index by at most maxBytes. Returns true once the whole
+    // file has been indexed.
+    bool buildLineIndex(qint64 maxBytes);
+    bool isIndexed() const;
+    qint64 indexedBytes() const;
+
+    // Number of lines in the indexed part of the file. Matches the block count
+    // a QTextDocument would have for the same text.
+    qint64 lineCount() const;
+    qint64 lineOffset(qint64 line) const;
+    // Newlines in [from, to); both ends must lie inside the indexed part.
+    qint64 countNewlines(qint64 from, qint64 to) const;
+
+    // Decodes up to count lines starting at firstLine, stopping early once
+    // maxBytes have been consumed. Line endings are folded the same way as
+    // TextBuffer::foldLineEndings.
+    QString readLines(qint64 firstLine, qint64 count, qint64 maxBytes, qint64 *linesRead = nullptr) const;
+
+    static constexpr qint64 IndexBlockSize = 64 * 1024;
+
+private:
+    qint64 newlinesBeforeOffset(qint64 offset) const;
+
+    QFile file;
+    const char *mapping;
+    bool opened;
+    qint64 fileSize;
+
+    // newlinesBefore[i] is the number of '\n' bytes in [0, i * IndexBlockSize).
+    QVector<qint64> newlinesBefore;
+    qint64 indexedSize;
+    qint64 indexedNewlines;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,190 @@
+#include "minimap.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <QVarLengthArray>
+
+#include <algorithm>
+
+// Enough tiles for several screens of a tall window, about 8 MiB.
+static const int TileCacheBytes = 8 * 1024 * 1024;
+
+Minimap::Minimap(QTextDocument *document, QWidget *parent)
+    : QWidget(parent)
+    , doc(document)
+    , tiles(TileCacheBytes)
+    , blockCount(document->blockCount())
+    , visibleFirst(0)
+    , visibleCount(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setCursor(Qt::PointingHandCursor);
+    connect(doc, &QTextDocument::contentsChange, this, &Minimap::onContentsChange);
+}
+
+QSize Minimap::sizeHint() const {
+    return QSize(Width, 0);
+}
+
+void Minimap::setVisibleRange(int first, int count) {
+    if (first == visibleFirst && count == visibleCount) return;
+
+    visibleFirst = first;
+    visibleCount = count;
+    update();
+}
+
+int Minimap::topLine() const {
+    const int rows = height() / RowHeight;
+    if (blockCount <= rows) return 0;
+
+    // Scrolled in proportion to the editor, so the first line is shown when
+    // the editor is at the top and the last when it is at the bottom.
+    const int editorRange = qMax(1, blockCount - visibleCount);
+    const double fraction = qBound(0.0, double(visibleFirst) / double(editorRange), 1.0);
+    return int(fraction * double(blockCount - rows));
+}
+
+void Minimap::onContentsChange(int position, int charsRemoved, int charsAdded) {
+    Q_UNUSED(charsRemoved);
+
+    if (!isVisible()) {
+        // Hidden minimaps (background tabs) keep nothing around.
+        tiles.clear();
+        blockCount = doc->blockCount();
+        return;
+    }
+
+    QTextBlock first = doc->findBlock(position);
+    if (!first.isValid()) first = doc->lastBlock();
+    const int firstLine = first.blockNumber();
+
+    if (doc->blockCount() != blockCount) {
+        // Every line after the edit moved, so the tiles from the edited one
+        // on are stale; the ones before it are still right.
+        blockCount = doc->blockCount();
+        const QList<int> cached = tiles.keys();
+        for (int index : cached) {
+            if (index >= firstLine / TileLines) tiles.remove(index);
+        }
+        update();
+        return;
+    }
+
+    QTextBlock last = doc->findBlock(position + charsAdded);
+    if (!last.isValid()) last = doc->lastBlock();
+
+    for (QTextBlock block = first; block.isValid(); block = block.next()) {
+        const int line = block.blockNumber();
+        if (QImage *image = tiles.object(line / TileLines)) {
+            renderLine(*image, line % TileLines, block);
+        }
+        if (block == last) break;
+    }
+
+    const int top = topLine();
+    const int bottom = top + height() / RowHeight;
+    if (last.blockNumber() >= top && firstLine <= bottom) {
+        update(0, (firstLine - top) * RowHeight, width(),
+               (last.blockNumber() - firstLine + 1) * RowHeight);
+    }
+}
+
+const QImage *Minimap::tile(int index) {
+    if (QImage *cached = tiles.object(index)) return cached;
+
+    auto *image = new QImage(Width, TileLines * RowHeight, QImage::Format_ARGB32_Premultiplied);
+    image->fill(Qt::transparent);
+
+    QTextBlock block = doc->findBlockByNumber(index * TileLines);
+    for (int row = 0; row < TileLines && block.isValid(); ++row, block = block.next()) {
+        renderLine(*image, row, block);
+    }
+
+    const QImage *result = image;
+    tiles.insert(index, image, int(image->sizeInBytes()));
+    return result;
+}
+
+void Minimap::renderLine(QImage &image, int row, const QTextBlock &block) const {
+    auto *top = reinterpret_cast<QRgb*>(image.scanLine(row * RowHeight));
+    auto *bottom = reinterpret_cast<QRgb*>(image.scanLine(row * RowHeight + 1));
+    std::fill(top, top + Width, QRgb(0));
+    std::fill(bottom, bottom + Width, QRgb(0));
+
+    const QString text = block.text();
+    const QList<QTextLayout::FormatRange> ranges = block.layout()->formats();
+
+    // Characters are drawn dimmed so the minimap does not compete with the
+    // text; anything without a format uses the editor's text colour.
+    auto dim = [](const QColor &color) {
+        return qPremultiply(qRgba(color.red(), color.green(), color.blue(), 150));
+    };
+    const QRgb plain = dim(palette().color(QPalette::Text));
+    QVarLengthArray<QRgb, 32> colors;
+    for (const QTextLayout::FormatRange &range : ranges) {
+        colors.append(range.format.hasProperty(QTextFormat::ForegroundBrush)
+                      ? dim(range.format.foreground().color()) : plain);
+    }
+
+    // The highlighters emit ranges in order and without overlaps, so one
+    // cursor walking along with the text finds each character's range.
+    qsizetype current = 0;
+    int column = 0;
+    for (qsizetype i = 0; i < text.size() && column < Width; ++i) {
+        const QChar c = text.at(i);
+        if (c == QLatin1Char('\t')) {
+            column = (column / TabWidth + 1) * TabWidth;
+            continue;
+        }
+
+        while (current < ranges.size() && ranges[current].start + ranges[current].length <= i) {
+            ++current;
+        }
+        if (!c.isSpace()) {
+            const bool formatted = current < ranges.size() && ranges[current].start <= i;
+            top[column] = bottom[column] = formatted ? colors[current] : plain;
+        }
+        ++column;
+    }
+}
+
+void Minimap::paintEvent(QPaintEvent *event) {
+    QPainter painter(this);
+    const QRect area = event->rect();
+    painter.fillRect(area, palette().color(QPalette::Base).darker(115));
+
+    const int top = topLine();
+    const int firstRow = area.top() / RowHeight;
+    const int lastRow = qMin(area.bottom() / RowHeight, blockCount - top - 1);
+
+    for (int row = firstRow; row <= lastRow;) {
+        const int line = top + row;
+        const int index = line / TileLines;
+        const int offset = line % TileLines;
+        const int rows = qMin(TileLines - offset, lastRow - row + 1);
+
+        painter.drawImage(QPoint(0, row * RowHeight), *tile(index),
+                          QRect(0, offset * RowHeight, Width, rows * RowHeight));
+        row += rows;
+    }
+
+    const QRect visible(0, (visibleFirst - top) * RowHeight, width(), visibleCount * RowHeight);
+    painter.fillRect(visible, QColor(255, 255, 255, 24));
+}
+
+void Minimap::mousePressEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton) {
+        emit lineRequested(qMin(blockCount - 1, topLine() + int(event->position().y()) / RowHeight));
+    }
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *event) {
+    if (event->buttons() & Qt::LeftButton) {
+        const int y = qBound(0, int(event->position().y()), height() - 1);
+        emit lineRequested(qMin(blockCount - 1, topLine() + y / RowHeight));
+    }
+}
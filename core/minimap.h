@@ -0,0 +1,64 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#pragma once
+#include <QCache>
+#include <QImage>
+#include <QWidget>
+
+class QTextBlock;
+class QTextDocument;
+
+// Overview of the document beside the editor: one pixel per character and
+// two per line, coloured with whatever formats the highlighter has applied.
+//
+// The picture is cut into tiles of TileLines lines which are rendered on
+// demand and kept in a cache of fixed size, so memory and the cost of a
+// repaint depend on the widget's height, not on the document's. Edits
+// re-render the touched lines of cached tiles in place; only a change in
+// line count drops the tiles after it, since their lines have moved.
+//
+// When the document is taller than the widget the minimap scrolls along
+// with the editor, keeping the visible lines in view.
+class Minimap : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit Minimap(QTextDocument *document, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+    // Lines [first, first + count) are what the editor shows.
+    void setVisibleRange(int first, int count);
+
+    static constexpr int Width = 96;
+
+signals:
+    // The user clicked or dragged over line blockNumber.
+    void lineRequested(int blockNumber);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+    int topLine() const;
+    const QImage *tile(int index);
+    void renderLine(QImage &image, int row, const QTextBlock &block) const;
+
+    QTextDocument *doc;
+    QCache<int, QImage> tiles;
+    int blockCount;
+    int visibleFirst;
+    int visibleCount;
+
+    static constexpr int RowHeight = 2;
+    static constexpr int TileLines = 256;
+    static constexpr int TabWidth = 4;
+};
+
+#endif // MINIMAP_H
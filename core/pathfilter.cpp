@@ -0,0 +1,12 @@
+#include "pathfilter.h"
+
+#include <QStringList>
+
+bool PathFilter::isIgnoredDirectory(const QFileInfo &info) {
+    static const QStringList ignored = {"node_modules", "bower_components", "__pycache__"};
+    const QString name = info.fileName();
+    if (name.startsWith(QLatin1Char('.')) || ignored.contains(name)) return true;
+
+    // CMake build trees are mostly generated files and copies of the sources.
+    return QFileInfo::exists(info.filePath() + "/CMakeCache.txt");
+}
@@ -0,0 +1,15 @@
+#ifndef PATHFILTER_H
+#define PATHFILTER_H
+
+#pragma once
+#include <QFileInfo>
+
+// Which directories the folder-wide features (find in files, quick open)
+// leave out: hidden ones, dependency caches and build trees. They are
+// large, generated and rarely what anyone is looking for.
+class PathFilter {
+public:
+    static bool isIgnoredDirectory(const QFileInfo &info);
+};
+
+#endif // PATHFILTER_H
@@ -0,0 +1,615 @@
+#include "pathindex.h"
+#include "pathfilter.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <deque>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PATHINDEX_SSE2
+#endif
+
+// Paths per batch handed from the crawler to the GUI thread.
+static const size_t BatchPaths = 32 * 1024;
+// Directory change notifications come in bursts, e.g. during a build.
+static const int RescanDelayMilliseconds = 200;
+// Zero bytes after the last name and directory in the arenas.
+static const qsizetype Padding = 16;
+
+// Any match inside the file name ranks above every match that needs the
+// directories.
+static const int NameTier = 1 << 16;
+static const int BoundaryBonus = 8;
+static const int ConsecutiveBonus = 6;
+static const int MaxGapPenalty = 4;
+
+static const QDir::Filters ListFilters = QDir::Dirs | QDir::Files | QDir::Hidden
+                                       | QDir::NoDotAndDotDot | QDir::NoSymLinks;
+
+static inline uchar foldAscii(uchar c) {
+    return c >= 'A' && c <= 'Z' ? uchar(c | 0x20) : c;
+}
+
+static inline uchar upperAscii(uchar c) {
+    return c >= 'a' && c <= 'z' ? uchar(c & ~0x20) : c;
+}
+
+// Letters and digits get a bit each; everything else shares the rest.
+static inline quint64 maskBit(uchar c) {
+    c = foldAscii(c);
+    if (c >= 'a' && c <= 'z') return quint64(1) << (c - 'a');
+    if (c >= '0' && c <= '9') return quint64(1) << (26 + c - '0');
+    if (c >= 0x80) return quint64(1) << 63;
+    return quint64(1) << (36 + c % 27);
+}
+
+// Matches at the start of a path segment, a word or a camelCase hump count
+// for more, since that is where people start typing.
+static inline bool isBoundary(const char *text, quint32 i) {
+    if (i == 0) return true;
+    const uchar previous = uchar(text[i - 1]);
+    const uchar current = uchar(text[i]);
+    if (previous == '/' || previous == '_' || previous == '-' || previous == '.' || previous == ' ') {
+        return true;
+    }
+    return previous >= 'a' && previous <= 'z' && current >= 'A' && current <= 'Z';
+}
+
+namespace {
+
+struct Needle {
+    QByteArray lower;
+    QByteArray upper;
+    quint64 mask = 0;
+};
+
+// The first position in [from, length) holding either case of byte n of the
+// needle, or length. May read up to Padding bytes past length.
+inline quint32 findByte(const char *text, quint32 from, quint32 length, const Needle &needle, qsizetype n) {
+#ifdef PATHINDEX_SSE2
+    const __m128i lower = _mm_set1_epi8(needle.lower.at(n));
+    const __m128i upper = _mm_set1_epi8(needle.upper.at(n));
+    for (quint32 i = from; i < length; i += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        const quint32 hits = quint32(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, lower),
+                                                                    _mm_cmpeq_epi8(chunk, upper))));
+        if (hits) return qMin(length, i + quint32(qCountTrailingZeroBits(hits)));
+    }
+    return length;
+#else
+    const char lower = needle.lower.at(n);
+    const char upper = needle.upper.at(n);
+    for (quint32 i = from; i < length; ++i) {
+        if (text[i] == lower || text[i] == upper) return i;
+    }
+    return length;
+#endif
+}
+
+// The needle matched across the pieces of one path, each of its bytes at
+// the first place it fits.
+struct Greedy {
+    qsizetype matched = 0;
+    qint64 last = -1;
+    int score = 0;
+
+    bool complete(const Needle &needle) const {
+        return matched == needle.lower.size();
+    }
+
+    // base is where text starts within the whole path.
+    void advance(const char *text, quint32 length, qint64 base, const Needle &needle) {
+        quint32 i = 0;
+        while (matched < needle.lower.size()) {
+            i = findByte(text, i, length, needle, matched);
+            if (i >= length) return;
+
+            const qint64 position = base + i;
+            score += 1;
+            if (isBoundary(text, i)) score += BoundaryBonus;
+            if (last >= 0) {
+                if (position == last + 1) {
+                    score += ConsecutiveBonus;
+                } else {
+                    score -= int(qMin<qint64>(position - last - 1, MaxGapPenalty));
+                }
+            }
+            last = position;
+            ++matched;
+            ++i;
+        }
+    }
+};
+
+} // namespace
+
+PathIndex::PathIndex(QObject *parent)
+    : QObject(parent)
+    , names(Padding, '\0')
+    , directoryNames(Padding, '\0')
+    , removedCount(0)
+    , truncated(false)
+    , watchedCount(0)
+    , version(0)
+    , cachedVersion(0)
+    , stopping(false)
+    , generation(0)
+{
+    watcher = new QFileSystemWatcher(this);
+    connect(watcher, &QFileSystemWatcher::directoryChanged, this, &PathIndex::onDirectoryChanged);
+
+    rescanTimer = new QTimer(this);
+    rescanTimer->setSingleShot(true);
+    rescanTimer->setInterval(RescanDelayMilliseconds);
+    connect(rescanTimer, &QTimer::timeout, this, &PathIndex::rescanChanged);
+
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("PathIndex");
+    thread->start(QThread::LowPriority);
+}
+
+PathIndex::~PathIndex() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        ++generation;
+        jobs.clear();
+        jobAvailable.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+}
+
+void PathIndex::setRoot(const QString &path) {
+    const QString root = QDir::cleanPath(QDir(path).absolutePath());
+    if (root == rootPath) return;
+
+    {
+        QMutexLocker locker(&mutex);
+        ++generation;
+        jobs.clear();
+    }
+
+    if (watchedCount > 0) {
+        watcher->removePaths(watcher->directories());
+        watchedCount = 0;
+    }
+    rescanTimer->stop();
+    changedDirectories.clear();
+
+    rootPath = root;
+    names = QByteArray(Padding, '\0');
+    directoryNames = QByteArray(Padding, '\0');
+    entries.clear();
+    entries.shrink_to_fit();
+    directoryList.clear();
+    directoryIndex.clear();
+    removedCount = 0;
+    truncated = false;
+    crawling.clear();
+    touch();
+
+    enqueue(QByteArray());
+}
+
+QString PathIndex::root() const {
+    return rootPath;
+}
+
+bool PathIndex::isIndexing() const {
+    return !crawling.isEmpty();
+}
+
+bool PathIndex::isTruncated() const {
+    return truncated;
+}
+
+qint64 PathIndex::count() const {
+    return qint64(entries.size()) - removedCount;
+}
+
+void PathIndex::insert(const QStringList &relativePaths) {
+    Batch batch;
+    QHash<QByteArray, int> directories;
+    for (const QString &path : relativePaths) {
+        const QByteArray utf8 = QDir::fromNativeSeparators(path).toUtf8();
+        const qsizetype nameStart = utf8.lastIndexOf('/') + 1;
+        const QByteArray prefix = utf8.left(nameStart);
+        auto directory = directories.constFind(prefix);
+        if (directory == directories.cend()) {
+            directory = directories.insert(prefix, int(batch.directories.size()));
+            batch.directories.append(prefix);
+        }
+        append(&batch, *directory, maskOf(prefix), utf8.mid(nameStart));
+    }
+    merge(batch);
+    touch();
+}
+
+QVector<PathIndex::Result> PathIndex::query(const QString &text, int limit) {
+    Needle needle;
+    for (char c : text.toUtf8()) {
+        if (c == ' ') continue;
+        if (c == '\\') c = '/';
+        needle.lower.append(char(foldAscii(uchar(c))));
+        needle.upper.append(char(upperAscii(uchar(c))));
+        needle.mask |= maskBit(uchar(c));
+    }
+
+    QVector<Result> results;
+    if (needle.lower.isEmpty() || limit <= 0) return results;
+
+    std::vector<quint32> candidates;
+    std::vector<quint32> pathOnly;
+    std::vector<std::pair<int, quint32>> scored;
+
+    auto consider = [&](quint32 index) {
+        const Entry &entry = entries[index];
+        if ((entry.mask & needle.mask) != needle.mask) return;
+
+        // Whether the path matches across its directories is only worked
+        // out when it is needed, below.
+        candidates.push_back(index);
+        Greedy match;
+        match.advance(names.constData() + entry.name, nameLength(index), 0, needle);
+        if (match.complete(needle)) {
+            scored.emplace_back(NameTier + match.score, index);
+        } else {
+            pathOnly.push_back(index);
+        }
+    };
+
+    if (cachedVersion == version && !cachedNeedle.isEmpty() && needle.lower.startsWith(cachedNeedle)) {
+        for (quint32 index : cachedCandidates) consider(index);
+    } else {
+        const quint32 total = quint32(entries.size());
+        for (quint32 index = 0; index < total; ++index) consider(index);
+    }
+    cachedVersion = version;
+    cachedNeedle = needle.lower;
+    cachedCandidates.swap(candidates);
+
+    if (scored.size() < size_t(limit)) {
+        for (quint32 index : pathOnly) {
+            const Entry &entry = entries[index];
+            const Directory &directory = directoryList[entry.directory];
+            Greedy match;
+            match.advance(directoryNames.constData() + directory.offset, directory.length, 0, needle);
+            match.advance(names.constData() + entry.name, nameLength(index), directory.length, needle);
+            if (match.complete(needle)) {
+                scored.emplace_back(match.score, index);
+            }
+        }
+    }
+
+    // Ties go to the shorter name, then to the path found first.
+    auto better = [this](const std::pair<int, quint32> &a, const std::pair<int, quint32> &b) {
+        if (a.first != b.first) return a.first > b.first;
+        const quint32 lengthA = nameLength(a.second);
+        const quint32 lengthB = nameLength(b.second);
+        if (lengthA != lengthB) return lengthA < lengthB;
+        return a.second < b.second;
+    };
+    if (scored.size() > size_t(limit)) {
+        std::nth_element(scored.begin(), scored.begin() + limit, scored.end(), better);
+        scored.resize(size_t(limit));
+    }
+    std::sort(scored.begin(), scored.end(), better);
+
+    results.reserve(qsizetype(scored.size()));
+    for (const std::pair<int, quint32> &match : scored) {
+        results.append(Result{QString::fromUtf8(pathOf(match.second)), match.first});
+    }
+    return results;
+}
+
+quint64 PathIndex::maskOf(const QByteArray &text) {
+    quint64 mask = 0;
+    for (char c : text) mask |= maskBit(uchar(c));
+    return mask;
+}
+
+void PathIndex::append(Batch *batch, int directory, quint64 directoryMask, const QByteArray &name) {
+    Entry entry;
+    entry.mask = directoryMask | maskOf(name);
+    entry.name = quint32(batch->names.size());
+    entry.directory = quint32(directory);
+    batch->names.append(name);
+    batch->entries.push_back(entry);
+}
+
+quint32 PathIndex::nameLength(size_t index) const {
+    const quint32 end = index + 1 < entries.size()
+        ? entries[index + 1].name
+        : quint32(names.size() - Padding);
+    return end - entries[index].name;
+}
+
+QByteArray PathIndex::pathOf(size_t index) const {
+    const Entry &entry = entries[index];
+    const Directory &directory = directoryList[entry.directory];
+    QByteArray path(directoryNames.constData() + directory.offset, directory.length);
+    path.append(names.constData() + entry.name, nameLength(index));
+    return path;
+}
+
+void PathIndex::run() {
+    QMutexLocker locker(&mutex);
+
+    forever {
+        while (jobs.isEmpty() && !stopping) {
+            jobAvailable.wait(&mutex);
+        }
+        if (stopping) break;
+
+        const Job job = jobs.takeFirst();
+        locker.unlock();
+        crawl(job);
+        locker.relock();
+    }
+}
+
+void PathIndex::crawl(const Job &job) {
+    auto batch = std::make_shared<Batch>();
+    batch->generation = job.generation;
+
+    // Breadth first, so the directories handed over first, and watched
+    // first, are the shallow ones. A directory and its files always go in
+    // the same batch.
+    std::deque<QByteArray> pending{job.prefix};
+    qint64 found = 0;
+    while (!pending.empty() && found < MaxPaths) {
+        if (generation != job.generation) return;
+
+        const QByteArray prefix = pending.front();
+        pending.pop_front();
+        const int directory = int(batch->directories.size());
+        const quint64 directoryMask = maskOf(prefix);
+        batch->directories.append(prefix);
+
+        QDirIterator items(job.root + QLatin1Char('/') + QString::fromUtf8(prefix), ListFilters);
+        while (items.hasNext()) {
+            items.next();
+            const QFileInfo info = items.fileInfo();
+            const QByteArray name = info.fileName().toUtf8();
+            if (info.isDir()) {
+                if (!PathFilter::isIgnoredDirectory(info)) {
+                    pending.push_back(prefix + name + '/');
+                }
+            } else {
+                append(batch.get(), directory, directoryMask, name);
+                ++found;
+            }
+        }
+
+        if (batch->entries.size() >= BatchPaths) {
+            post(batch);
+            batch = std::make_shared<Batch>();
+            batch->generation = job.generation;
+        }
+    }
+
+    batch->prefix = job.prefix;
+    batch->done = true;
+    post(batch);
+}
+
+void PathIndex::post(std::shared_ptr<Batch> batch) {
+    QMetaObject::invokeMethod(this, [this, batch]() { applyBatch(batch); }, Qt::QueuedConnection);
+}
+
+void PathIndex::enqueue(const QByteArray &prefix) {
+    crawling.insert(prefix);
+    QMutexLocker locker(&mutex);
+    jobs.append(Job{rootPath, prefix, generation});
+    jobAvailable.wakeOne();
+}
+
+void PathIndex::applyBatch(const std::shared_ptr<Batch> &batch) {
+    if (batch->generation != generation) return;
+
+    merge(*batch);
+    if (batch->done) {
+        crawling.remove(batch->prefix);
+    }
+    touch();
+}
+
+void PathIndex::merge(const Batch &batch) {
+    std::vector<quint32> directories;
+    directories.reserve(size_t(batch.directories.size()));
+    for (const QByteArray &prefix : batch.directories) {
+        directories.push_back(addDirectory(prefix));
+    }
+
+    const qint64 room = MaxPaths - count();
+    size_t taken = batch.entries.size();
+    if (qint64(taken) > room) {
+        taken = size_t(qMax<qint64>(0, room));
+        truncated = true;
+    }
+    if (taken == 0) return;
+
+    if (removedCount > 0 && removedCount >= qint64(entries.size()) / 2) {
+        compact();
+    }
+
+    const quint32 base = quint32(names.size() - Padding);
+    const qsizetype used = taken == batch.entries.size() ? batch.names.size() : batch.entries[taken].name;
+    names.insert(names.size() - Padding, batch.names.constData(), used);
+    entries.reserve(entries.size() + taken);
+    for (size_t i = 0; i < taken; ++i) {
+        Entry entry = batch.entries[i];
+        entry.name += base;
+        entry.directory = directories[entry.directory];
+        entries.push_back(entry);
+    }
+}
+
+quint32 PathIndex::addDirectory(const QByteArray &prefix) {
+    auto known = directoryIndex.constFind(prefix);
+    if (known != directoryIndex.cend()) return *known;
+
+    const quint32 index = quint32(directoryList.size());
+    directoryList.push_back(Directory{quint32(directoryNames.size() - Padding), quint32(prefix.size())});
+    directoryNames.insert(directoryNames.size() - Padding, prefix);
+    directoryIndex.insert(prefix, index);
+
+    if (!rootPath.isEmpty() && watchedCount < MaxWatchedDirectories
+        && watcher->addPath(rootPath + QLatin1Char('/') + QString::fromUtf8(prefix))) {
+        ++watchedCount;
+    }
+    return index;
+}
+
+void PathIndex::onDirectoryChanged(const QString &path) {
+    changedDirectories.insert(path);
+    rescanTimer->start();
+}
+
+void PathIndex::rescanChanged() {
+    const QDir root(rootPath);
+    QHash<quint32, QSet<QByteArray>> listed;
+    QList<QByteArray> vanished;
+
+    for (const QString &path : std::as_const(changedDirectories)) {
+        QString relative = root.relativeFilePath(path);
+        if (relative == QLatin1String(".")) relative.clear();
+        if (relative.startsWith(QLatin1String(".."))) continue;
+
+        const QByteArray prefix = relative.isEmpty() ? QByteArray() : relative.toUtf8() + '/';
+        auto known = directoryIndex.constFind(prefix);
+        if (known == directoryIndex.cend()) continue;
+        if (!QFileInfo(path).isDir()) {
+            vanished.append(prefix);
+            continue;
+        }
+
+        QSet<QByteArray> &files = listed[*known];
+        QSet<QByteArray> subdirectories;
+        QDirIterator items(path, ListFilters);
+        while (items.hasNext()) {
+            items.next();
+            const QFileInfo info = items.fileInfo();
+            const QByteArray name = info.fileName().toUtf8();
+            if (!info.isDir()) {
+                files.insert(name);
+            } else if (!PathFilter::isIgnoredDirectory(info)) {
+                subdirectories.insert(prefix + name + '/');
+            }
+        }
+
+        // New subdirectories are crawled on the worker; ones that are gone
+        // take everything under them along.
+        for (const QByteArray &subdirectory : std::as_const(subdirectories)) {
+            if (!directoryIndex.contains(subdirectory) && !crawling.contains(subdirectory)) {
+                enqueue(subdirectory);
+            }
+        }
+        for (auto it = directoryIndex.cbegin(); it != directoryIndex.cend(); ++it) {
+            const QByteArray &other = it.key();
+            if (other.size() > prefix.size() && other.startsWith(prefix)
+                && other.indexOf('/', prefix.size()) == other.size() - 1
+                && !subdirectories.contains(other)) {
+                vanished.append(other);
+            }
+        }
+    }
+    changedDirectories.clear();
+
+    std::vector<bool> gone(directoryList.size(), false);
+    bool anyGone = false;
+    for (const QByteArray &prefix : std::as_const(vanished)) {
+        for (auto it = directoryIndex.begin(); it != directoryIndex.end();) {
+            if (it.key().startsWith(prefix)) {
+                if (watcher->removePath(rootPath + QLatin1Char('/') + QString::fromUtf8(it.key()))) {
+                    --watchedCount;
+                }
+                gone[it.value()] = true;
+                anyGone = true;
+                it = directoryIndex.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (listed.isEmpty() && !anyGone) return;
+
+    // One pass over the entries settles which files are gone; whatever is
+    // left in listed afterwards is new.
+    bool modified = false;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry &entry = entries[i];
+        if (entry.mask == 0) continue;
+
+        bool removed = gone[entry.directory];
+        if (!removed) {
+            auto files = listed.find(entry.directory);
+            removed = files != listed.end()
+                && !files->remove(QByteArray::fromRawData(names.constData() + entry.name,
+                                                          qsizetype(nameLength(i))));
+        }
+        if (removed) {
+            entry.mask = 0;
+            ++removedCount;
+            modified = true;
+        }
+    }
+
+    Batch added;
+    for (auto it = listed.cbegin(); it != listed.cend(); ++it) {
+        if (it.value().isEmpty()) continue;
+
+        const Directory &directory = directoryList[it.key()];
+        const QByteArray prefix(directoryNames.constData() + directory.offset, directory.length);
+        const int index = int(added.directories.size());
+        added.directories.append(prefix);
+        for (const QByteArray &name : it.value()) {
+            append(&added, index, maskOf(prefix), name);
+        }
+    }
+    if (!added.entries.empty()) {
+        merge(added);
+        modified = true;
+    }
+
+    if (modified) {
+        touch();
+        emit filesChanged();
+    }
+}
+
+void PathIndex::compact() {
+    QByteArray packed;
+    std::vector<Entry> kept;
+    packed.reserve(names.size());
+    kept.reserve(entries.size() - size_t(removedCount));
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].mask == 0) continue;
+        Entry moved = entries[i];
+        moved.name = quint32(packed.size());
+        packed.append(names.constData() + entries[i].name, nameLength(i));
+        kept.push_back(moved);
+    }
+    packed.append(Padding, '\0');
+
+    names.swap(packed);
+    entries.swap(kept);
+    removedCount = 0;
+    ++version;
+}
+
+void PathIndex::touch() {
+    ++version;
+    emit changed();
+}
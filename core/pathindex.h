@@ -0,0 +1,164 @@
+#ifndef PATHINDEX_H
+#define PATHINDEX_H
+
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class QThread;
+class QTimer;
+class QFileSystemWatcher;
+
+// Every file path under a folder, for quick open.
+//
+// File names are kept UTF-8 encoded, back to back in one arena, and each
+// directory is stored once in another. A file is a 16-byte entry: a bitmask
+// of the characters in its whole path, where its name starts and which
+// directory it is in. A query walks the entries in order, drops every one
+// whose mask lacks one of its characters with a single AND, and only scores
+// the rest, file name first.
+//
+// The tree is crawled breadth first on a worker thread and handed over in
+// batches. Afterwards the shallowest directories are watched; a change lists
+// just that directory again, and a new subdirectory is crawled on the worker.
+class PathIndex : public QObject {
+    Q_OBJECT
+
+public:
+    struct Result {
+        // Relative to the root, '/' separated.
+        QString path;
+        int score = 0;
+    };
+
+    explicit PathIndex(QObject *parent = nullptr);
+    // Stops the crawl and waits for the worker.
+    ~PathIndex() override;
+
+    // Forgets the current paths and indexes rootPath in the background.
+    void setRoot(const QString &rootPath);
+    QString root() const;
+
+    bool isIndexing() const;
+    // True when the folder holds more than MaxPaths files.
+    bool isTruncated() const;
+    qint64 count() const;
+
+    // Adds paths relative to the root that are not indexed yet, e.g. a file
+    // just saved into a directory that is not watched.
+    void insert(const QStringList &relativePaths);
+
+    // The limit best matches for text, best first. Characters have to appear
+    // in order; ASCII letters match either case. Paths whose file name alone
+    // matches rank above those that need their directories to. A query that
+    // extends the previous one only looks at what that one could match.
+    QVector<Result> query(const QString &text, int limit);
+
+    static constexpr qint64 MaxPaths = 2000000;
+    // inotify watches are a per-user resource shared with every other program.
+    static constexpr int MaxWatchedDirectories = 2048;
+
+signals:
+    // Paths were added or removed.
+    void changed();
+    // The watcher saw files come or go after the folder was crawled.
+    void filesChanged();
+
+private:
+    struct Entry {
+        // Characters in the whole path; 0 once the file is gone.
+        quint64 mask;
+        // Offset into names; the name runs up to where the next one starts.
+        quint32 name;
+        quint32 directory;
+    };
+
+    struct Directory {
+        quint32 offset;
+        quint32 length;
+    };
+
+    struct Job {
+        QString root;
+        // "" for the root itself, otherwise "dir/sub/".
+        QByteArray prefix;
+        quint64 generation;
+    };
+
+    // Files on their way into the index; entries refer to directories and
+    // names of the batch itself.
+    struct Batch {
+        quint64 generation = 0;
+        QList<QByteArray> directories;
+        QByteArray names;
+        std::vector<Entry> entries;
+        // Set on the last batch of the crawl of prefix.
+        QByteArray prefix;
+        bool done = false;
+    };
+
+    static quint64 maskOf(const QByteArray &text);
+    static void append(Batch *batch, int directory, quint64 directoryMask, const QByteArray &name);
+
+    void run();
+    void crawl(const Job &job);
+    void post(std::shared_ptr<Batch> batch);
+    void enqueue(const QByteArray &prefix);
+
+    void applyBatch(const std::shared_ptr<Batch> &batch);
+    void merge(const Batch &batch);
+    quint32 addDirectory(const QByteArray &prefix);
+    quint32 nameLength(size_t index) const;
+    QByteArray pathOf(size_t index) const;
+    void onDirectoryChanged(const QString &path);
+    void rescanChanged();
+    void compact();
+    void touch();
+
+    QString rootPath;
+    // Both arenas end in a few zero bytes, so scoring may read whole
+    // vectors past the last name.
+    QByteArray names;
+    QByteArray directoryNames;
+    std::vector<Entry> entries;
+    std::vector<Directory> directoryList;
+    // Directories still on disk by prefix.
+    QHash<QByteArray, quint32> directoryIndex;
+    qint64 removedCount;
+    bool truncated;
+    // Prefixes queued or being crawled.
+    QSet<QByteArray> crawling;
+
+    QFileSystemWatcher *watcher;
+    qsizetype watchedCount;
+    QTimer *rescanTimer;
+    QSet<QString> changedDirectories;
+
+    // The last query and every entry it could match, valid while version
+    // is unchanged.
+    quint64 version;
+    quint64 cachedVersion;
+    QByteArray cachedNeedle;
+    std::vector<quint32> cachedCandidates;
+
+    QThread *thread;
+    QMutex mutex;
+    QWaitCondition jobAvailable;
+    QList<Job> jobs;
+    bool stopping;
+    // Bumped by setRoot; crawls of an older root stop early and their
+    // batches are dropped.
+    std::atomic<quint64> generation;
+};
+
+#endif // PATHINDEX_H
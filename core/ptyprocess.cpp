@@ -0,0 +1,258 @@
+#include "ptyprocess.h"
+#include "ptyreader.h"
+
+#include <QFile>
+#include <QProcessEnvironment>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include <vector>
+
+#if defined(Q_OS_WIN)
+#include <QProcess>
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#if defined(Q_OS_MACOS)
+#include <util.h>
+#elif defined(Q_OS_FREEBSD)
+#include <libutil.h>
+#else
+#include <pty.h>
+#endif
+#endif
+
+// How long a program whose terminal hung up gets to exit before it is
+// checked again.
+static const int ReapRetryMilliseconds = 10;
+
+PtyProcess::PtyProcess(QObject *parent)
+    : QObject(parent)
+    , pid(-1)
+    , masterFd(-1)
+    , running(false)
+#ifdef Q_OS_WIN
+    , fallback(nullptr)
+#endif
+{
+}
+
+PtyProcess::~PtyProcess() {
+#if defined(Q_OS_WIN)
+    if (fallback && fallback->state() != QProcess::NotRunning) {
+        fallback->kill();
+        fallback->waitForFinished();
+    }
+#else
+    if (running) {
+        ::kill(pid_t(-pid), SIGHUP);
+        PtyReader::instance().remove(this);
+
+        // Closing the master side hangs up anything that ignored the signal.
+        ::close(masterFd);
+        int status = 0;
+        if (::waitpid(pid_t(pid), &status, WNOHANG) == 0) {
+            ::kill(pid_t(pid), SIGKILL);
+            ::waitpid(pid_t(pid), &status, 0);
+        }
+    }
+#endif
+}
+
+bool PtyProcess::start(const QString &program, const QStringList &arguments,
+                       const QString &workingDirectory, int columns, int rows) {
+    if (running) return false;
+
+#if defined(Q_OS_WIN)
+    Q_UNUSED(columns);
+    Q_UNUSED(rows);
+
+    if (!fallback) {
+        fallback = new QProcess(this);
+        fallback->setProcessChannelMode(QProcess::MergedChannels);
+        connect(fallback, &QProcess::readyRead, this, [this]() {
+            emit dataReceived(fallback->readAll());
+        });
+        connect(fallback, &QProcess::finished, this, [this](int exitCode, QProcess::ExitStatus status) {
+            running = false;
+            emit finished(exitCode, status == QProcess::CrashExit);
+        });
+    }
+    fallback->setWorkingDirectory(workingDirectory);
+    fallback->start(program, arguments);
+    running = fallback->waitForStarted();
+    return running;
+#else
+    // Everything the child needs is prepared before fork(): between fork()
+    // and exec() only async-signal-safe calls are allowed.
+    const QString executable = program.contains(QLatin1Char('/'))
+        ? program : QStandardPaths::findExecutable(program);
+    if (executable.isEmpty()) return false;
+    const QByteArray path = QFile::encodeName(executable);
+    const QByteArray directory = QFile::encodeName(workingDirectory);
+
+    QList<QByteArray> argumentBytes{QFile::encodeName(program)};
+    for (const QString &argument : arguments) {
+        argumentBytes.append(argument.toLocal8Bit());
+    }
+    std::vector<char*> argv;
+    for (QByteArray &argument : argumentBytes) argv.push_back(argument.data());
+    argv.push_back(nullptr);
+
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("TERM", "xterm-256color");
+    environment.insert("COLORTERM", "truecolor");
+    QList<QByteArray> environmentBytes;
+    for (const QString &entry : environment.toStringList()) {
+        environmentBytes.append(entry.toLocal8Bit());
+    }
+    std::vector<char*> envp;
+    for (QByteArray &entry : environmentBytes) envp.push_back(entry.data());
+    envp.push_back(nullptr);
+
+    winsize size{};
+    size.ws_col = (unsigned short)qBound(1, columns, 0xffff);
+    size.ws_row = (unsigned short)qBound(1, rows, 0xffff);
+
+    int fd = -1;
+    const pid_t child = ::forkpty(&fd, nullptr, nullptr, &size);
+    if (child < 0) return false;
+
+    if (child == 0) {
+        sigset_t none;
+        sigemptyset(&none);
+        ::sigprocmask(SIG_SETMASK, &none, nullptr);
+        ::signal(SIGPIPE, SIG_DFL);
+        if (!directory.isEmpty() && ::chdir(directory.constData()) != 0) {
+            // Stay where we are; the shell still works.
+        }
+        ::execve(path.constData(), argv.data(), envp.data());
+        ::_exit(127);
+    }
+
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    pid = child;
+    masterFd = fd;
+    running = true;
+    PtyReader::instance().add(this, fd);
+    return true;
+#endif
+}
+
+bool PtyProcess::isRunning() const {
+    return running;
+}
+
+qint64 PtyProcess::processId() const {
+#if defined(Q_OS_WIN)
+    return fallback ? fallback->processId() : -1;
+#else
+    return running ? pid : -1;
+#endif
+}
+
+void PtyProcess::write(const QByteArray &data) {
+    if (!running || data.isEmpty()) return;
+
+#if defined(Q_OS_WIN)
+    fallback->write(data);
+#else
+    PtyReader::instance().write(this, data);
+#endif
+}
+
+void PtyProcess::resize(int columns, int rows) {
+#if defined(Q_OS_WIN)
+    Q_UNUSED(columns);
+    Q_UNUSED(rows);
+#else
+    if (!running) return;
+
+    winsize size{};
+    size.ws_col = (unsigned short)qBound(1, columns, 0xffff);
+    size.ws_row = (unsigned short)qBound(1, rows, 0xffff);
+    ::ioctl(masterFd, TIOCSWINSZ, &size);
+#endif
+}
+
+void PtyProcess::terminate() {
+    if (!running) return;
+
+#if defined(Q_OS_WIN)
+    fallback->kill();
+#else
+    ::kill(pid_t(-pid), SIGHUP);
+#endif
+}
+
+bool PtyProcess::isBusy() const {
+#if defined(Q_OS_WIN)
+    return running;
+#else
+    if (!running) return false;
+    const pid_t group = ::tcgetpgrp(masterFd);
+    return group > 0 && group != pid_t(pid);
+#endif
+}
+
+QString PtyProcess::foregroundCommand() const {
+#if defined(Q_OS_LINUX)
+    if (!isBusy()) return QString();
+
+    QFile comm(QString("/proc/%1/comm").arg(::tcgetpgrp(masterFd)));
+    if (!comm.open(QIODevice::ReadOnly)) return QString();
+    return QString::fromLocal8Bit(comm.readAll()).trimmed();
+#else
+    return QString();
+#endif
+}
+
+void PtyProcess::deliver() {
+#if !defined(Q_OS_WIN)
+    const QByteArray data = PtyReader::instance().take(this);
+    if (!data.isEmpty()) {
+        emit dataReceived(data);
+    }
+#endif
+}
+
+void PtyProcess::hangUp() {
+#if !defined(Q_OS_WIN)
+    if (!running) return;
+
+    // Whatever was read before the hangup still goes out first.
+    deliver();
+    PtyReader::instance().remove(this);
+    reap();
+#endif
+}
+
+void PtyProcess::reap() {
+#if !defined(Q_OS_WIN)
+    // The terminal can hang up a moment before the program has exited;
+    // the reader thread is never blocked waiting for it.
+    int status = 0;
+    if (::waitpid(pid_t(pid), &status, WNOHANG) == 0) {
+        QTimer::singleShot(ReapRetryMilliseconds, this, &PtyProcess::reap);
+        return;
+    }
+
+    ::close(masterFd);
+    masterFd = -1;
+    pid = -1;
+    running = false;
+
+    if (WIFSIGNALED(status)) {
+        emit finished(128 + WTERMSIG(status), true);
+    } else {
+        emit finished(WEXITSTATUS(status), false);
+    }
+#endif
+}
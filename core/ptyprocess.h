@@ -0,0 +1,64 @@
+#ifndef PTYPROCESS_H
+#define PTYPROCESS_H
+
+#pragma once
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class QProcess;
+
+// A program running on a pseudo-terminal, so it sees a real tty: line
+// editing, job control, colours and full-screen tools all work.
+//
+// The master side is serviced by the shared PtyReader thread; output
+// arrives here on the GUI thread through dataReceived().
+//
+// Windows has no forkpty(); there the program runs over plain pipes.
+class PtyProcess : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PtyProcess(QObject *parent = nullptr);
+    ~PtyProcess() override;
+
+    bool start(const QString &program, const QStringList &arguments,
+               const QString &workingDirectory, int columns, int rows);
+    bool isRunning() const;
+    qint64 processId() const;
+
+    // Whether a job other than the program itself holds the terminal, as
+    // when a shell is running a command.
+    bool isBusy() const;
+    // Name of the job holding the terminal, where the system tells.
+    QString foregroundCommand() const;
+
+    // Queued and written by the reader thread; never blocks.
+    void write(const QByteArray &data);
+    // Tells the program about a new window size (SIGWINCH).
+    void resize(int columns, int rows);
+    // Hangs up on the program, as closing a terminal window does.
+    void terminate();
+
+signals:
+    void dataReceived(const QByteArray &data);
+    void finished(int exitCode, bool crashed);
+
+private:
+    friend class PtyReader;
+
+    void deliver();
+    void hangUp();
+    void reap();
+
+    qint64 pid;
+    int masterFd;
+    bool running;
+
+#ifdef Q_OS_WIN
+    QProcess *fallback;
+#endif
+};
+
+#endif // PTYPROCESS_H
@@ -0,0 +1,194 @@
+#include "ptyreader.h"
+#include "ptyprocess.h"
+
+#include <QMutexLocker>
+#include <QThread>
+
+#include <vector>
+
+#if !defined(Q_OS_WIN)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+static const qsizetype ReadChunk = 64 * 1024;
+
+PtyReader &PtyReader::instance() {
+    static PtyReader reader;
+    return reader;
+}
+
+PtyReader::PtyReader()
+    : thread(nullptr)
+    , iteration(0)
+    , wakeFds{-1, -1}
+    , stopping(false)
+{
+#if !defined(Q_OS_WIN)
+    if (::pipe(wakeFds) == 0) {
+        for (int fd : wakeFds) {
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("PtyReader");
+    thread->start();
+#endif
+}
+
+PtyReader::~PtyReader() {
+#if !defined(Q_OS_WIN)
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+    }
+    wake();
+    thread->wait();
+    delete thread;
+
+    qDeleteAll(channels);
+    ::close(wakeFds[0]);
+    ::close(wakeFds[1]);
+#endif
+}
+
+void PtyReader::add(PtyProcess *process, int fd) {
+    QMutexLocker locker(&mutex);
+    channels.append(new Channel{process, fd});
+    locker.unlock();
+    wake();
+}
+
+void PtyReader::remove(PtyProcess *process) {
+    QMutexLocker locker(&mutex);
+    Channel *channel = find(process);
+    if (!channel) return;
+    channels.removeOne(channel);
+
+    // The thread may be using the channel in the current round; the next
+    // round is built from the list without it.
+    const quint64 target = iteration + 1;
+    locker.unlock();
+    wake();
+    locker.relock();
+    while (iteration < target && !stopping) {
+        passed.wait(&mutex);
+    }
+    delete channel;
+}
+
+void PtyReader::write(PtyProcess *process, const QByteArray &data) {
+    {
+        QMutexLocker locker(&mutex);
+        Channel *channel = find(process);
+        if (!channel || channel->hungUp) return;
+        channel->outgoing.append(data);
+    }
+    wake();
+}
+
+QByteArray PtyReader::take(PtyProcess *process) {
+    QByteArray data;
+    {
+        QMutexLocker locker(&mutex);
+        Channel *channel = find(process);
+        if (!channel) return data;
+        data.swap(channel->incoming);
+        channel->deliveryQueued = false;
+    }
+
+    // The thread stops reading a full channel; it is empty now.
+    if (data.size() >= MaxPendingBytes) {
+        wake();
+    }
+    return data;
+}
+
+PtyReader::Channel *PtyReader::find(PtyProcess *process) const {
+    for (Channel *channel : channels) {
+        if (channel->process == process) return channel;
+    }
+    return nullptr;
+}
+
+void PtyReader::wake() {
+#if !defined(Q_OS_WIN)
+    const char byte = 0;
+    if (::write(wakeFds[1], &byte, 1) < 0) {
+        // The pipe is full, so the thread is due to wake anyway.
+    }
+#endif
+}
+
+void PtyReader::run() {
+#if !defined(Q_OS_WIN)
+    QByteArray buffer(ReadChunk, Qt::Uninitialized);
+    std::vector<pollfd> fds;
+    std::vector<Channel*> polled;
+
+    for (;;) {
+        fds.clear();
+        polled.clear();
+        {
+            QMutexLocker locker(&mutex);
+            ++iteration;
+            passed.wakeAll();
+            if (stopping) return;
+
+            fds.push_back({wakeFds[0], POLLIN, 0});
+            for (Channel *channel : channels) {
+                if (channel->hungUp) continue;
+                const bool wantRead = channel->incoming.size() < MaxPendingBytes;
+                const bool wantWrite = !channel->outgoing.isEmpty();
+                fds.push_back({channel->fd, short((wantRead ? POLLIN : 0) | (wantWrite ? POLLOUT : 0)), 0});
+                polled.push_back(channel);
+            }
+        }
+
+        if (::poll(fds.data(), nfds_t(fds.size()), -1) < 0) {
+            if (errno == EINTR) continue;
+            qWarning("PtyReader: poll failed (%d)", errno);
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (::read(wakeFds[0], drain, sizeof(drain)) > 0) {}
+        }
+
+        // Channels removed meanwhile are still alive: remove() waits for
+        // the next round, which starts only after this one.
+        QMutexLocker locker(&mutex);
+        for (size_t i = 0; i < polled.size(); ++i) {
+            Channel *channel = polled[i];
+            const short revents = fds[i + 1].revents;
+
+            if (revents & POLLOUT) {
+                const ssize_t written = ::write(channel->fd, channel->outgoing.constData(),
+                                                size_t(channel->outgoing.size()));
+                if (written > 0) channel->outgoing.remove(0, written);
+            }
+
+            // A hangup is read too, even while paused, so the remaining
+            // output is drained and the loop cannot spin on it.
+            if (!(revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            const ssize_t count = ::read(channel->fd, buffer.data(), size_t(buffer.size()));
+            if (count > 0) {
+                channel->incoming.append(buffer.constData(), count);
+                if (!channel->deliveryQueued) {
+                    channel->deliveryQueued = true;
+                    QMetaObject::invokeMethod(channel->process, &PtyProcess::deliver, Qt::QueuedConnection);
+                }
+            } else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+                // EIO: the last process holding the terminal has gone.
+                channel->hungUp = true;
+                QMetaObject::invokeMethod(channel->process, &PtyProcess::hangUp, Qt::QueuedConnection);
+            }
+        }
+    }
+#endif
+}
@@ -0,0 +1,64 @@
+#ifndef PTYREADER_H
+#define PTYREADER_H
+
+#pragma once
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+class PtyProcess;
+class QThread;
+
+// The one I/O thread behind every PtyProcess. It sleeps in a single poll()
+// on all master sides at once, so a dozen terminals running builds cost
+// one thread, not a dozen.
+//
+// Output is kept per process and handed over with at most one queued call
+// in flight per process, so a flood of small reads never floods the event
+// queue. A process whose GUI side falls behind by more than
+// MaxPendingBytes is no longer read from, which in turn blocks its program
+// on write: flow control rather than unbounded buffering.
+//
+// Not used on Windows, which has no pseudo-terminals to poll.
+class PtyReader {
+public:
+    static PtyReader &instance();
+    ~PtyReader();
+
+    // fd must be non-blocking. Once remove() returns, the reader no longer
+    // touches the process or its descriptor.
+    void add(PtyProcess *process, int fd);
+    void remove(PtyProcess *process);
+
+    void write(PtyProcess *process, const QByteArray &data);
+    // Everything read for process since the last call.
+    QByteArray take(PtyProcess *process);
+
+    static constexpr qsizetype MaxPendingBytes = 8 * 1024 * 1024;
+
+private:
+    struct Channel {
+        PtyProcess *process;
+        int fd;
+        QByteArray incoming;
+        QByteArray outgoing;
+        bool deliveryQueued = false;
+        bool hungUp = false;
+    };
+
+    PtyReader();
+    void run();
+    void wake();
+    Channel *find(PtyProcess *process) const;
+
+    QThread *thread;
+    QMutex mutex;
+    QWaitCondition passed;
+    QList<Channel*> channels;
+    quint64 iteration;
+    int wakeFds[2];
+    bool stopping;
+};
+
+#endif // PTYREADER_H
@@ -0,0 +1,238 @@
+#include "searchmatches.h"
+#include "textbuffer.h"
+
+SearchMatches::SearchMatches(const TextSearch::Query &query)
+    : textSearch(query)
+    , total(0)
+    , scanned(0)
+    , complete(false)
+    , truncated(false)
+    , changes(0)
+{
+}
+
+const TextSearch &SearchMatches::search() const {
+    return textSearch;
+}
+
+void SearchMatches::reset() {
+    chunks.clear();
+    total = 0;
+    scanned = 0;
+    complete = false;
+    truncated = false;
+    ++changes;
+}
+
+bool SearchMatches::scan(const TextBuffer &buffer, qint64 budget) {
+    if (complete) return true;
+    if (!textSearch.isValid()) {
+        complete = true;
+        return true;
+    }
+
+    const qint64 to = qMin(buffer.size(), scanned + budget);
+    TextSearch::Scanner scanner(textSearch, buffer, qMax(scanned, endBefore(scanned)), to);
+    TextSearch::Match match;
+    ++changes;
+
+    while (scanner.next(&match)) {
+        append(match);
+        if (total >= MaxMatches) {
+            // Edits keep the matches found so far up to date; the rest of
+            // the buffer is not scanned.
+            truncated = true;
+            complete = true;
+            scanned = buffer.size();
+            return true;
+        }
+    }
+
+    scanned = to;
+    complete = scanned >= buffer.size();
+    return complete;
+}
+
+bool SearchMatches::isComplete() const {
+    return complete;
+}
+
+bool SearchMatches::isTruncated() const {
+    return truncated;
+}
+
+qint64 SearchMatches::count() const {
+    return total;
+}
+
+quint64 SearchMatches::revision() const {
+    return changes;
+}
+
+void SearchMatches::update(const TextBuffer &buffer, qint64 offset, qint64 removed, qint64 added) {
+    if (!textSearch.isValid()) return;
+    ++changes;
+
+    // Matches starting in [from, to) of the new contents may have changed.
+    // A plain match has to overlap the edit; a regular expression match
+    // can depend on anything on its line.
+    const qint64 delta = added - removed;
+    qint64 from;
+    qint64 to;
+    if (textSearch.isLiteral()) {
+        from = qMax<qint64>(0, offset - textSearch.literalLength() + 1);
+        to = offset + added;
+    } else {
+        from = buffer.lineStart(buffer.lineAt(offset));
+        to = qMin(buffer.size(), buffer.lineStart(buffer.lineAt(offset + added) + 1));
+    }
+
+    std::vector<TextSearch::Match> found;
+    TextSearch::Match match;
+    qint64 scanFrom = qMax(from, endBefore(from));
+    for (;;) {
+        TextSearch::Scanner scanner(textSearch, buffer, scanFrom, to);
+        while (scanner.next(&match)) {
+            found.push_back(match);
+        }
+
+        // Matches do not overlap, so a match running past to can hide one
+        // that used to start there, and a match that used to run past it can
+        // have hidden one that starts there now. The range grows until the
+        // old and the new matches end at the same place.
+        const qint64 newEnd = found.empty() ? to : qMax(to, found.back().offset + found.back().length);
+        qint64 oldEnd = to;
+        if (lastBefore(to - delta, &match) && match.offset >= from) {
+            oldEnd = qMax(to, match.offset + match.length + delta);
+        }
+        if (newEnd == oldEnd) break;
+
+        scanFrom = newEnd;
+        to = qMax(newEnd, oldEnd);
+    }
+
+    if (to - delta > scanned) {
+        // The edit reaches past what has been scanned; scanning goes on
+        // from the edit instead.
+        truncate(from);
+        scanned = qMin(scanned, from);
+        complete = false;
+        return;
+    }
+
+    scanned += delta;
+    splice(from, to - delta, delta, found);
+}
+
+size_t SearchMatches::chunkFor(qint64 offset) const {
+    auto chunk = std::partition_point(chunks.begin(), chunks.end(),
+        [offset](const Chunk &candidate) { return candidate.last() < offset; });
+    return size_t(chunk - chunks.begin());
+}
+
+bool SearchMatches::lastBefore(qint64 offset, TextSearch::Match *match) const {
+    const size_t index = chunkFor(offset);
+    if (index < chunks.size()) {
+        const Chunk &chunk = chunks[index];
+        auto candidate = std::lower_bound(chunk.matches.begin(), chunk.matches.end(), offset - chunk.shift,
+            [](const TextSearch::Match &stored, qint64 value) { return stored.offset < value; });
+        if (candidate != chunk.matches.begin()) {
+            --candidate;
+            *match = {candidate->offset + chunk.shift, candidate->length};
+            return true;
+        }
+    }
+    if (index > 0) {
+        const Chunk &chunk = chunks[index - 1];
+        *match = {chunk.last(), chunk.matches.back().length};
+        return true;
+    }
+    return false;
+}
+
+qint64 SearchMatches::endBefore(qint64 offset) const {
+    TextSearch::Match match;
+    return lastBefore(offset, &match) ? match.offset + match.length : 0;
+}
+
+void SearchMatches::append(const TextSearch::Match &match) {
+    if (chunks.empty() || chunks.back().matches.size() >= ChunkSize) {
+        chunks.emplace_back();
+    }
+    Chunk &chunk = chunks.back();
+    chunk.matches.push_back({match.offset - chunk.shift, match.length});
+    ++total;
+}
+
+void SearchMatches::splice(qint64 from, qint64 to, qint64 delta, const std::vector<TextSearch::Match> &found) {
+    // Old matches start in [from, to) and are replaced by found; the ones
+    // after move by delta, except any that found now overlaps.
+    size_t first = chunkFor(from);
+    if (first > 0 && chunks[first - 1].matches.size() < ChunkSize / 2) {
+        // Folds small chunks left behind by earlier edits into this one.
+        --first;
+    }
+
+    const qint64 foundEnd = found.empty() ? 0 : found.back().offset + found.back().length - delta;
+    const qint64 limit = qMax(to, foundEnd);
+    size_t last = first;
+    while (last < chunks.size() && chunks[last].first() < limit) {
+        ++last;
+    }
+
+    std::vector<TextSearch::Match> merged;
+    qint64 removed = 0;
+    for (size_t i = first; i < last; ++i) {
+        removed += qint64(chunks[i].matches.size());
+        for (const TextSearch::Match &match : chunks[i].matches) {
+            const qint64 offset = match.offset + chunks[i].shift;
+            if (offset >= from) break;
+            merged.push_back({offset, match.length});
+        }
+    }
+    merged.insert(merged.end(), found.begin(), found.end());
+    for (size_t i = first; i < last; ++i) {
+        for (const TextSearch::Match &match : chunks[i].matches) {
+            const qint64 offset = match.offset + chunks[i].shift;
+            if (offset < to) continue;
+            const TextSearch::Match moved{offset + delta, match.length};
+            if (!merged.empty() && moved.offset < merged.back().offset + merged.back().length) continue;
+            merged.push_back(moved);
+        }
+    }
+
+    for (size_t i = last; i < chunks.size(); ++i) {
+        chunks[i].shift += delta;
+    }
+
+    std::vector<Chunk> rebuilt;
+    for (size_t i = 0; i < merged.size(); i += ChunkSize) {
+        Chunk chunk;
+        chunk.matches.assign(merged.begin() + qsizetype(i),
+                             merged.begin() + qsizetype(qMin(merged.size(), i + ChunkSize)));
+        rebuilt.push_back(std::move(chunk));
+    }
+
+    total += qint64(merged.size()) - removed;
+    chunks.erase(chunks.begin() + qsizetype(first), chunks.begin() + qsizetype(last));
+    chunks.insert(chunks.begin() + qsizetype(first),
+                  std::make_move_iterator(rebuilt.begin()), std::make_move_iterator(rebuilt.end()));
+}
+
+void SearchMatches::truncate(qint64 from) {
+    const size_t index = chunkFor(from);
+    if (index >= chunks.size()) return;
+
+    Chunk &chunk = chunks[index];
+    auto match = std::lower_bound(chunk.matches.begin(), chunk.matches.end(), from - chunk.shift,
+        [](const TextSearch::Match &candidate, qint64 offset) { return candidate.offset < offset; });
+    chunk.matches.erase(match, chunk.matches.end());
+
+    chunks.erase(chunks.begin() + qsizetype(chunk.matches.empty() ? index : index + 1), chunks.end());
+
+    total = 0;
+    for (const Chunk &remaining : chunks) {
+        total += qint64(remaining.matches.size());
+    }
+    truncated = false;
+}
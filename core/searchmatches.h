@@ -0,0 +1,95 @@
+#ifndef SEARCHMATCHES_H
+#define SEARCHMATCHES_H
+
+#pragma once
+#include <QtGlobal>
+#include <algorithm>
+#include <vector>
+
+#include "textsearch.h"
+
+class TextBuffer;
+
+// Every match of a search in one TextBuffer, for highlighting and counting.
+//
+// The buffer is scanned in slices from the event loop and then kept in step
+// with edits: an edit rescans only the bytes (plain patterns) or the lines
+// (regular expressions) it can have changed, and moves the matches after it.
+// Matches are stored in chunks that each carry an offset shift, so moving
+// them costs one addition per chunk rather than one per match.
+class SearchMatches {
+public:
+    explicit SearchMatches(const TextSearch::Query &query);
+
+    const TextSearch &search() const;
+
+    // Forgets every match and starts scanning from the top again, e.g.
+    // after the whole buffer was replaced.
+    void reset();
+    // Scans about budget more bytes. Returns true once the whole buffer has
+    // been scanned.
+    bool scan(const TextBuffer &buffer, qint64 budget);
+    bool isComplete() const;
+    // Scanning stops after MaxMatches; count() is then a lower bound.
+    bool isTruncated() const;
+    qint64 count() const;
+    // Changes whenever matches are found, dropped or moved.
+    quint64 revision() const;
+
+    // buffer holds the contents after the edit: removed bytes at offset
+    // were replaced by added bytes.
+    void update(const TextBuffer &buffer, qint64 offset, qint64 removed, qint64 added);
+
+    // Calls function(const TextSearch::Match &) for each match starting in
+    // [from, to), in order. Returning false stops.
+    template <typename Function>
+    void forEachIn(qint64 from, qint64 to, Function function) const;
+
+    static constexpr qint64 MaxMatches = 1000000;
+
+private:
+    struct Chunk {
+        // Added to every offset in matches.
+        qint64 shift = 0;
+        std::vector<TextSearch::Match> matches;
+
+        qint64 first() const { return matches.front().offset + shift; }
+        qint64 last() const { return matches.back().offset + shift; }
+    };
+
+    // The first chunk whose last match starts at or after offset.
+    size_t chunkFor(qint64 offset) const;
+    // The last match starting before offset.
+    bool lastBefore(qint64 offset, TextSearch::Match *match) const;
+    // Where the last match starting before offset ends, or 0.
+    qint64 endBefore(qint64 offset) const;
+    void append(const TextSearch::Match &match);
+    void splice(qint64 from, qint64 to, qint64 delta, const std::vector<TextSearch::Match> &found);
+    void truncate(qint64 from);
+
+    static constexpr size_t ChunkSize = 4096;
+
+    TextSearch textSearch;
+    std::vector<Chunk> chunks;
+    qint64 total;
+    qint64 scanned;
+    bool complete;
+    bool truncated;
+    quint64 changes;
+};
+
+template <typename Function>
+void SearchMatches::forEachIn(qint64 from, qint64 to, Function function) const {
+    for (size_t i = chunkFor(from); i < chunks.size(); ++i) {
+        const Chunk &chunk = chunks[i];
+        auto match = std::lower_bound(chunk.matches.begin(), chunk.matches.end(), from - chunk.shift,
+            [](const TextSearch::Match &candidate, qint64 offset) { return candidate.offset < offset; });
+
+        for (; match != chunk.matches.end(); ++match) {
+            const TextSearch::Match shifted{match->offset + chunk.shift, match->length};
+            if (shifted.offset >= to || !function(shifted)) return;
+        }
+    }
+}
+
+#endif // SEARCHMATCHES_H
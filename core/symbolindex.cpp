@@ -0,0 +1,830 @@
+#include "symbolindex.h"
+#include "pathfilter.h"
+#include "textbuffer.h"
+#include "highlighter/lexer.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <numeric>
+#include <vector>
+
+// Saves come in bursts when autosave writes every tab at once.
+static const int RefreshDelayMilliseconds = 500;
+
+static const QDir::Filters ListFilters = QDir::Dirs | QDir::Files | QDir::Hidden
+                                       | QDir::NoDotAndDotDot | QDir::NoSymLinks;
+
+namespace {
+
+// The index file: a header, then the sections it points to. Every number is
+// in the byte order of the machine that wrote it; another one just fails the
+// magic check and indexes from scratch.
+const char Magic[8] = {'C', 'H', 'O', 'R', 'A', 'S', 'Y', 'M'};
+const quint32 FormatVersion = 2;
+const quint32 NoSymbol = 0xffffffffu;
+const quint32 NoFile = 0xffffffffu;
+const quint8 DeclarationFlag = 0x01;
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 fileCount;
+    quint32 symbolCount;
+    quint32 definitionCount;
+    quint32 referenceCount;
+    // The folder that was indexed, in the strings.
+    quint32 root;
+    quint32 rootLength;
+    // Byte offsets of the sections.
+    quint32 files;
+    quint32 symbols;
+    quint32 symbolDefinitions;
+    quint32 definitions;
+    quint32 references;
+    quint32 strings;
+    quint32 stringsSize;
+};
+
+// Sorted by path; each file's definitions are consecutive, in source order.
+struct FileRecord {
+    qint64 modified;
+    quint64 hash;
+    qint64 size;
+    quint32 path;
+    quint32 pathLength;
+    quint32 firstDefinition;
+    quint32 definitionCount;
+};
+
+// Sorted by name. Its definitions are listed in symbolDefinitions, the
+// files that mention it in references.
+struct SymbolRecord {
+    quint32 name;
+    quint32 nameLength;
+    quint32 firstDefinition;
+    quint32 definitionCount;
+    quint32 firstReference;
+    quint32 referenceCount;
+};
+
+struct DefinitionRecord {
+    quint32 symbol;
+    quint32 file;
+    quint32 line;
+    quint32 column;
+    // NoSymbol at file scope.
+    quint32 scope;
+    quint8 kind;
+    quint8 flags;
+    quint16 reserved;
+};
+
+static_assert(sizeof(Header) == 64, "index header layout");
+static_assert(sizeof(FileRecord) == 40, "index file layout");
+static_assert(sizeof(SymbolRecord) == 24, "index symbol layout");
+static_assert(sizeof(DefinitionRecord) == 24, "index definition layout");
+
+// Plain byte order, the same when the index is written and searched.
+inline int compareBytes(const char *a, quint32 aLength, const char *b, quint32 bLength) {
+    const int order = std::memcmp(a, b, qMin(aLength, bLength));
+    if (order != 0) return order;
+    return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+inline bool lessBytes(const QByteArray &a, const QByteArray &b) {
+    return compareBytes(a.constData(), quint32(a.size()), b.constData(), quint32(b.size())) < 0;
+}
+
+inline quint32 align(quint32 offset, quint32 alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+// One index file, mapped read-only, or the same bytes in memory when the
+// file could not be written. Never changes once open, so the GUI thread and
+// the worker can share it.
+class SymbolIndex::Snapshot {
+public:
+    Snapshot() : data(nullptr), size(0) {}
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    bool map(const QString &path) {
+        file.setFileName(path);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        size = file.size();
+        if (size < qint64(sizeof(Header)) || size > qint64(0xffffffffu)) return false;
+        data = reinterpret_cast<const char*>(file.map(0, size));
+        return data && validate();
+    }
+
+    bool adopt(const QByteArray &image) {
+        bytes = image;
+        data = bytes.constData();
+        size = bytes.size();
+        return size >= qint64(sizeof(Header)) && validate();
+    }
+
+    const Header &header() const { return *reinterpret_cast<const Header*>(data); }
+    const FileRecord *files() const { return section<FileRecord>(header().files); }
+    const SymbolRecord *symbols() const { return section<SymbolRecord>(header().symbols); }
+    const quint32 *symbolDefinitions() const { return section<quint32>(header().symbolDefinitions); }
+    const DefinitionRecord *definitions() const { return section<DefinitionRecord>(header().definitions); }
+    const quint32 *references() const { return section<quint32>(header().references); }
+
+    const char *string(quint32 offset) const { return data + header().strings + offset; }
+    QByteArray bytesOf(quint32 offset, quint32 length) const { return QByteArray(string(offset), length); }
+
+    QString root() const {
+        return QString::fromUtf8(string(header().root), header().rootLength);
+    }
+
+    // Index of the symbol called name, or -1.
+    qint64 findSymbol(const QByteArray &name) const {
+        const SymbolRecord *first = symbols();
+        const SymbolRecord *last = first + header().symbolCount;
+        const SymbolRecord *found = std::lower_bound(first, last, name,
+            [this](const SymbolRecord &symbol, const QByteArray &key) {
+                return compareBytes(string(symbol.name), symbol.nameLength,
+                                    key.constData(), quint32(key.size())) < 0;
+            });
+        if (found == last || compareBytes(string(found->name), found->nameLength,
+                                          name.constData(), quint32(name.size())) != 0) {
+            return -1;
+        }
+        return found - first;
+    }
+
+    // Index of the file at path relative to the root, or -1.
+    qint64 findFile(const QByteArray &path) const {
+        const FileRecord *first = files();
+        const FileRecord *last = first + header().fileCount;
+        const FileRecord *found = std::lower_bound(first, last, path,
+            [this](const FileRecord &record, const QByteArray &key) {
+                return compareBytes(string(record.path), record.pathLength,
+                                    key.constData(), quint32(key.size())) < 0;
+            });
+        if (found == last || compareBytes(string(found->path), found->pathLength,
+                                          path.constData(), quint32(path.size())) != 0) {
+            return -1;
+        }
+        return found - first;
+    }
+
+private:
+    template <typename T>
+    const T *section(quint32 offset) const {
+        return reinterpret_cast<const T*>(data + offset);
+    }
+
+    bool fits(quint32 offset, quint64 count, quint64 itemSize, quint32 alignment) const {
+        return offset % alignment == 0 && quint64(offset) + count * itemSize <= quint64(size);
+    }
+
+    // A damaged or foreign file is thrown away rather than trusted: every
+    // offset a lookup could follow is checked once here.
+    bool validate() const {
+        if (quintptr(data) % alignof(FileRecord) != 0) return false;
+        const Header &h = header();
+        if (std::memcmp(h.magic, Magic, sizeof(Magic)) != 0 || h.version != FormatVersion) return false;
+        if (!fits(h.files, h.fileCount, sizeof(FileRecord), alignof(FileRecord))
+            || !fits(h.symbols, h.symbolCount, sizeof(SymbolRecord), 4)
+            || !fits(h.symbolDefinitions, h.definitionCount, sizeof(quint32), 4)
+            || !fits(h.definitions, h.definitionCount, sizeof(DefinitionRecord), 4)
+            || !fits(h.references, h.referenceCount, sizeof(quint32), 4)
+            || !fits(h.strings, h.stringsSize, 1, 1)) {
+            return false;
+        }
+
+        auto inStrings = [&h](quint32 offset, quint32 length) {
+            return quint64(offset) + length <= h.stringsSize;
+        };
+        if (!inStrings(h.root, h.rootLength)) return false;
+
+        const FileRecord *fileRecords = files();
+        for (quint32 i = 0; i < h.fileCount; ++i) {
+            const FileRecord &f = fileRecords[i];
+            if (!inStrings(f.path, f.pathLength)
+                || quint64(f.firstDefinition) + f.definitionCount > h.definitionCount) {
+                return false;
+            }
+        }
+        const SymbolRecord *symbolRecords = symbols();
+        for (quint32 i = 0; i < h.symbolCount; ++i) {
+            const SymbolRecord &s = symbolRecords[i];
+            if (!inStrings(s.name, s.nameLength)
+                || quint64(s.firstDefinition) + s.definitionCount > h.definitionCount
+                || quint64(s.firstReference) + s.referenceCount > h.referenceCount) {
+                return false;
+            }
+        }
+        const DefinitionRecord *definitionRecords = definitions();
+        const quint32 *bySymbol = symbolDefinitions();
+        for (quint32 i = 0; i < h.definitionCount; ++i) {
+            const DefinitionRecord &d = definitionRecords[i];
+            if (d.symbol >= h.symbolCount || d.file >= h.fileCount
+                || (d.scope != NoSymbol && d.scope >= h.symbolCount)
+                || d.kind > SymbolScanner::Variable || bySymbol[i] >= h.definitionCount) {
+                return false;
+            }
+        }
+        const quint32 *fileIds = references();
+        for (quint32 i = 0; i < h.referenceCount; ++i) {
+            if (fileIds[i] >= h.fileCount) return false;
+        }
+        return true;
+    }
+
+    QFile file;
+    QByteArray bytes;
+    const char *data;
+    qint64 size;
+};
+
+namespace {
+
+// One index being put together on the worker before it is laid out.
+class Builder {
+public:
+    struct File {
+        QByteArray path;
+        qint64 modified;
+        quint64 hash;
+        qint64 size;
+        quint32 firstDefinition;
+        quint32 definitionCount;
+    };
+
+    quint32 symbol(const QByteArray &name) {
+        auto known = ids.constFind(name);
+        if (known != ids.cend()) return *known;
+        const quint32 id = quint32(names.size());
+        ids.insert(name, id);
+        names.append(name);
+        references.emplace_back();
+        return id;
+    }
+
+    quint32 addFile(const QByteArray &path, qint64 modified, quint64 hash, qint64 size) {
+        files.push_back(File{path, modified, hash, size, quint32(definitions.size()), 0});
+        return quint32(files.size() - 1);
+    }
+
+    void addDefinition(const DefinitionRecord &definition) {
+        definitions.push_back(definition);
+        ++files.back().definitionCount;
+    }
+
+    void addReference(quint32 symbolId, quint32 file) {
+        references[symbolId].push_back(file);
+    }
+
+    void addScan(quint32 file, const SymbolScanner::Result &result) {
+        for (const SymbolScanner::Definition &found : result.definitions) {
+            DefinitionRecord definition = {};
+            definition.symbol = symbol(found.name);
+            definition.file = file;
+            definition.line = found.line;
+            definition.column = found.column;
+            definition.scope = found.scope.isEmpty() ? NoSymbol : symbol(found.scope);
+            definition.kind = found.kind;
+            definition.flags = found.declaration ? DeclarationFlag : 0;
+            addDefinition(definition);
+        }
+        for (const QByteArray &identifier : result.identifiers) {
+            addReference(symbol(identifier), file);
+        }
+    }
+
+    QByteArray image(const QString &root) {
+        const quint32 symbolCount = quint32(names.size());
+        const quint32 definitionCount = quint32(definitions.size());
+
+        // Symbols are renumbered in name order, the order lookups search.
+        std::vector<quint32> order(symbolCount);
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(), [this](quint32 a, quint32 b) {
+            return lessBytes(names[a], names[b]);
+        });
+        std::vector<quint32> rank(symbolCount);
+        for (quint32 i = 0; i < symbolCount; ++i) rank[order[i]] = i;
+
+        // Each symbol's definitions: definitions before declarations, then
+        // by file and line.
+        std::vector<quint32> bySymbol(definitionCount);
+        std::iota(bySymbol.begin(), bySymbol.end(), 0u);
+        std::sort(bySymbol.begin(), bySymbol.end(), [&](quint32 a, quint32 b) {
+            const DefinitionRecord &x = definitions[a];
+            const DefinitionRecord &y = definitions[b];
+            if (x.symbol != y.symbol) return rank[x.symbol] < rank[y.symbol];
+            if ((x.flags & DeclarationFlag) != (y.flags & DeclarationFlag)) {
+                return (x.flags & DeclarationFlag) == 0;
+            }
+            if (x.file != y.file) return x.file < y.file;
+            return x.line < y.line;
+        });
+
+        quint64 referenceCount = 0;
+        for (std::vector<quint32> &fileIds : references) {
+            std::sort(fileIds.begin(), fileIds.end());
+            fileIds.erase(std::unique(fileIds.begin(), fileIds.end()), fileIds.end());
+            referenceCount += fileIds.size();
+        }
+
+        const QByteArray rootBytes = root.toUtf8();
+        quint64 stringsSize = quint64(rootBytes.size());
+        for (const QByteArray &name : std::as_const(names)) stringsSize += quint64(name.size());
+        for (const File &file : files) stringsSize += quint64(file.path.size());
+
+        Header header = {};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = FormatVersion;
+        header.fileCount = quint32(files.size());
+        header.symbolCount = symbolCount;
+        header.definitionCount = definitionCount;
+        header.referenceCount = quint32(referenceCount);
+        header.files = quint32(sizeof(Header));
+        header.symbols = header.files + header.fileCount * quint32(sizeof(FileRecord));
+        header.symbolDefinitions = header.symbols + symbolCount * quint32(sizeof(SymbolRecord));
+        header.definitions = header.symbolDefinitions + definitionCount * quint32(sizeof(quint32));
+        header.references = header.definitions + definitionCount * quint32(sizeof(DefinitionRecord));
+        header.strings = header.references + header.referenceCount * quint32(sizeof(quint32));
+        header.stringsSize = quint32(stringsSize);
+
+        const quint64 total = quint64(header.strings) + stringsSize;
+        if (total > quint64(0xffffffffu)) return QByteArray();
+
+        QByteArray image(qsizetype(align(quint32(total), 8)), '\0');
+        char *out = image.data();
+        char *strings = out + header.strings;
+        quint32 used = 0;
+        auto addString = [&](const QByteArray &text) {
+            std::memcpy(strings + used, text.constData(), size_t(text.size()));
+            used += quint32(text.size());
+            return used - quint32(text.size());
+        };
+
+        header.root = addString(rootBytes);
+        header.rootLength = quint32(rootBytes.size());
+        std::memcpy(out, &header, sizeof(header));
+
+        FileRecord *fileRecords = reinterpret_cast<FileRecord*>(out + header.files);
+        for (size_t i = 0; i < files.size(); ++i) {
+            const File &file = files[i];
+            FileRecord &record = fileRecords[i];
+            record.modified = file.modified;
+            record.hash = file.hash;
+            record.size = file.size;
+            record.pathLength = quint32(file.path.size());
+            record.path = addString(file.path);
+            record.firstDefinition = file.firstDefinition;
+            record.definitionCount = file.definitionCount;
+        }
+
+        SymbolRecord *symbolRecords = reinterpret_cast<SymbolRecord*>(out + header.symbols);
+        quint32 *symbolDefinitions = reinterpret_cast<quint32*>(out + header.symbolDefinitions);
+        quint32 *fileIds = reinterpret_cast<quint32*>(out + header.references);
+        quint32 nextDefinition = 0;
+        quint32 nextReference = 0;
+        for (quint32 i = 0; i < symbolCount; ++i) {
+            const quint32 id = order[i];
+            SymbolRecord &record = symbolRecords[i];
+            record.nameLength = quint32(names[id].size());
+            record.name = addString(names[id]);
+
+            record.firstDefinition = nextDefinition;
+            while (nextDefinition < definitionCount && definitions[bySymbol[nextDefinition]].symbol == id) {
+                symbolDefinitions[nextDefinition] = bySymbol[nextDefinition];
+                ++nextDefinition;
+            }
+            record.definitionCount = nextDefinition - record.firstDefinition;
+
+            record.firstReference = nextReference;
+            for (quint32 file : references[id]) fileIds[nextReference++] = file;
+            record.referenceCount = nextReference - record.firstReference;
+        }
+
+        DefinitionRecord *definitionRecords = reinterpret_cast<DefinitionRecord*>(out + header.definitions);
+        for (quint32 i = 0; i < definitionCount; ++i) {
+            DefinitionRecord record = definitions[i];
+            record.symbol = rank[record.symbol];
+            if (record.scope != NoSymbol) record.scope = rank[record.scope];
+            definitionRecords[i] = record;
+        }
+        return image;
+    }
+
+    std::vector<File> files;
+
+private:
+    QHash<QByteArray, quint32> ids;
+    QVector<QByteArray> names;
+    // Per symbol, the files that mention it.
+    std::vector<std::vector<quint32>> references;
+    std::vector<DefinitionRecord> definitions;
+};
+
+struct Source {
+    QByteArray path;
+    QString absolutePath;
+    qint64 modified;
+    qint64 size;
+    Lexer::Dialect dialect;
+};
+
+} // namespace
+
+SymbolIndex::SymbolIndex(QObject *parent)
+    : QObject(parent)
+    , cacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/symbols")
+    , passes(0)
+    , refreshAll(false)
+    , stopping(false)
+    , generation(0)
+{
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(RefreshDelayMilliseconds);
+    connect(refreshTimer, &QTimer::timeout, this, &SymbolIndex::enqueue);
+
+    thread = QThread::create([this]() { run(); });
+    thread->setObjectName("SymbolIndex");
+    thread->start(QThread::LowPriority);
+}
+
+SymbolIndex::~SymbolIndex() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        ++generation;
+        jobs.clear();
+        jobAvailable.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+}
+
+void SymbolIndex::setRoot(const QString &path) {
+    const QString root = QDir::cleanPath(QDir(path).absolutePath());
+    if (root == rootPath) return;
+
+    {
+        QMutexLocker locker(&mutex);
+        ++generation;
+        jobs.clear();
+    }
+    refreshTimer->stop();
+    passes = 0;
+    rootPath = root;
+    snapshot.reset();
+    emit changed();
+
+    refreshAll = true;
+    changedFiles.clear();
+    enqueue();
+}
+
+QString SymbolIndex::root() const {
+    return rootPath;
+}
+
+void SymbolIndex::refresh() {
+    if (rootPath.isEmpty()) return;
+    refreshAll = true;
+    refreshTimer->start();
+}
+
+void SymbolIndex::refreshFile(const QString &filePath) {
+    if (rootPath.isEmpty()) return;
+    const QString relativePath = QDir(rootPath).relativeFilePath(filePath);
+    if (relativePath.startsWith(QLatin1String("..")) || QDir::isAbsolutePath(relativePath)) return;
+
+    changedFiles.append(QDir::fromNativeSeparators(relativePath).toUtf8());
+    refreshTimer->start();
+}
+
+bool SymbolIndex::isIndexing() const {
+    return passes > 0;
+}
+
+qint64 SymbolIndex::fileCount() const {
+    return snapshot ? snapshot->header().fileCount : 0;
+}
+
+void SymbolIndex::setCacheDirectory(const QString &path) {
+    cacheDirectory = path;
+}
+
+QString SymbolIndex::cacheFileFor(const QString &path) const {
+    const QByteArray key = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    return cacheDirectory + QLatin1Char('/') + QString::fromLatin1(key) + QLatin1String(".idx");
+}
+
+QVector<SymbolIndex::Definition> SymbolIndex::definitions(const QString &name) const {
+    QVector<Definition> found;
+    if (!snapshot) return found;
+
+    const qint64 symbol = snapshot->findSymbol(name.toUtf8());
+    if (symbol < 0) return found;
+
+    const SymbolRecord &record = snapshot->symbols()[symbol];
+    found.reserve(qsizetype(record.definitionCount));
+    for (quint32 i = 0; i < record.definitionCount; ++i) {
+        found.append(definitionAt(snapshot->symbolDefinitions()[record.firstDefinition + i]));
+    }
+    return found;
+}
+
+QVector<SymbolIndex::Definition> SymbolIndex::outline(const QString &filePath) const {
+    QVector<Definition> found;
+    if (!snapshot) return found;
+
+    const QString relativePath = QDir(rootPath).relativeFilePath(filePath);
+    if (relativePath.startsWith(QLatin1String(".."))) return found;
+    const qint64 file = snapshot->findFile(QDir::fromNativeSeparators(relativePath).toUtf8());
+    if (file < 0) return found;
+
+    const FileRecord &record = snapshot->files()[file];
+    found.reserve(qsizetype(record.definitionCount));
+    for (quint32 i = 0; i < record.definitionCount; ++i) {
+        found.append(definitionAt(record.firstDefinition + i));
+    }
+    return found;
+}
+
+QStringList SymbolIndex::filesReferencing(const QString &name) const {
+    QStringList found;
+    if (!snapshot) return found;
+
+    const qint64 symbol = snapshot->findSymbol(name.toUtf8());
+    if (symbol < 0) return found;
+
+    const SymbolRecord &record = snapshot->symbols()[symbol];
+    for (quint32 i = 0; i < record.referenceCount; ++i) {
+        const FileRecord &file = snapshot->files()[snapshot->references()[record.firstReference + i]];
+        found.append(rootPath + QLatin1Char('/')
+                     + QString::fromUtf8(snapshot->string(file.path), file.pathLength));
+    }
+    return found;
+}
+
+SymbolIndex::Definition SymbolIndex::definitionAt(quint32 index) const {
+    const DefinitionRecord &record = snapshot->definitions()[index];
+    const SymbolRecord &symbol = snapshot->symbols()[record.symbol];
+    const FileRecord &file = snapshot->files()[record.file];
+
+    Definition definition;
+    definition.name = QString::fromUtf8(snapshot->string(symbol.name), symbol.nameLength);
+    if (record.scope != NoSymbol) {
+        const SymbolRecord &scope = snapshot->symbols()[record.scope];
+        definition.scope = QString::fromUtf8(snapshot->string(scope.name), scope.nameLength);
+    }
+    definition.filePath = rootPath + QLatin1Char('/')
+                        + QString::fromUtf8(snapshot->string(file.path), file.pathLength);
+    definition.line = record.line;
+    definition.column = int(record.column);
+    definition.kind = SymbolScanner::Kind(record.kind);
+    definition.declaration = record.flags & DeclarationFlag;
+    return definition;
+}
+
+void SymbolIndex::enqueue() {
+    if (rootPath.isEmpty()) return;
+
+    // An empty list walks the folder.
+    QList<QByteArray> changed;
+    if (!refreshAll) changed = changedFiles;
+    refreshAll = false;
+    changedFiles.clear();
+
+    QMutexLocker locker(&mutex);
+    // A pass that has not started yet takes these files as well, or walks
+    // the folder if either one would.
+    if (!jobs.isEmpty()) {
+        Job &waiting = jobs.last();
+        if (changed.isEmpty()) {
+            waiting.changedFiles.clear();
+        } else if (!waiting.changedFiles.isEmpty()) {
+            waiting.changedFiles += changed;
+        }
+        return;
+    }
+    ++passes;
+    jobs.append(Job{rootPath, cacheFileFor(rootPath), generation, changed});
+    jobAvailable.wakeOne();
+}
+
+void SymbolIndex::run() {
+    QMutexLocker locker(&mutex);
+
+    forever {
+        while (jobs.isEmpty() && !stopping) {
+            jobAvailable.wait(&mutex);
+        }
+        if (stopping) break;
+
+        const Job job = jobs.takeFirst();
+        locker.unlock();
+        build(job);
+        locker.relock();
+    }
+    previous.reset();
+}
+
+void SymbolIndex::build(const Job &job) {
+    // The index written last time lets the GUI answer lookups straight
+    // away, while this pass checks it against the folder.
+    if (!previous || previous->root() != job.root) {
+        auto stored = std::make_shared<Snapshot>();
+        previous.reset();
+        if (stored->map(job.cacheFile) && stored->root() == job.root) {
+            previous = stored;
+            post(job.generation, previous, false);
+        }
+    }
+
+    std::vector<Source> sources;
+    if (!job.changedFiles.isEmpty() && previous) {
+        // After a save only the saved files are looked at again; the rest
+        // are taken as the last pass found them, without a stat each.
+        const QSet<QByteArray> changed(job.changedFiles.cbegin(), job.changedFiles.cend());
+        const FileRecord *records = previous->files();
+        for (quint32 i = 0; i < previous->header().fileCount; ++i) {
+            const QByteArray path = previous->bytesOf(records[i].path, records[i].pathLength);
+            if (changed.contains(path)) continue;
+            const QString relativePath = QString::fromUtf8(path);
+            sources.push_back(Source{path, job.root + QLatin1Char('/') + relativePath,
+                                     records[i].modified, records[i].size, Lexer::dialectOf(relativePath)});
+        }
+        for (const QByteArray &path : changed) {
+            const QFileInfo info(job.root + QLatin1Char('/') + QString::fromUtf8(path));
+            const Lexer::Dialect dialect = Lexer::dialectOf(info.fileName());
+            if (!info.isFile() || dialect == Lexer::Plain || info.size() > MaxFileSize) continue;
+            sources.push_back(Source{path, info.filePath(),
+                                     info.lastModified().toMSecsSinceEpoch(), info.size(), dialect});
+        }
+    }
+
+    // Breadth first, like PathIndex, so a huge tree runs into MaxFiles deep
+    // down rather than near the top.
+    std::deque<QByteArray> pending{QByteArray()};
+    if (!job.changedFiles.isEmpty() && previous) pending.clear();
+    while (!pending.empty() && qint64(sources.size()) < MaxFiles) {
+        if (generation != job.generation) return;
+
+        const QByteArray prefix = pending.front();
+        pending.pop_front();
+        QDirIterator items(job.root + QLatin1Char('/') + QString::fromUtf8(prefix), ListFilters);
+        while (items.hasNext()) {
+            items.next();
+            const QFileInfo info = items.fileInfo();
+            if (info.isDir()) {
+                if (!PathFilter::isIgnoredDirectory(info)) {
+                    pending.push_back(prefix + info.fileName().toUtf8() + '/');
+                }
+                continue;
+            }
+            const Lexer::Dialect dialect = Lexer::dialectOf(info.fileName());
+            if (dialect == Lexer::Plain || info.size() > MaxFileSize) continue;
+            sources.push_back(Source{prefix + info.fileName().toUtf8(), info.filePath(),
+                                     info.lastModified().toMSecsSinceEpoch(), info.size(), dialect});
+        }
+    }
+    std::sort(sources.begin(), sources.end(), [](const Source &a, const Source &b) {
+        return lessBytes(a.path, b.path);
+    });
+
+    Builder builder;
+    // Files of the previous index that are carried over, by their old
+    // number, and the symbols they use, renumbered for the builder.
+    std::vector<quint32> reused(previous ? previous->header().fileCount : 0, NoFile);
+    std::vector<quint32> symbolIds(previous ? previous->header().symbolCount : 0, NoSymbol);
+    auto carry = [&](quint32 oldSymbol) {
+        if (symbolIds[oldSymbol] == NoSymbol) {
+            const SymbolRecord &record = previous->symbols()[oldSymbol];
+            symbolIds[oldSymbol] = builder.symbol(previous->bytesOf(record.name, record.nameLength));
+        }
+        return symbolIds[oldSymbol];
+    };
+
+    bool modified = !previous || qint64(previous->header().fileCount) != qint64(sources.size());
+    for (const Source &source : sources) {
+        if (generation != job.generation) return;
+
+        const qint64 old = previous ? previous->findFile(source.path) : -1;
+        const FileRecord *oldRecord = old >= 0 ? &previous->files()[old] : nullptr;
+        if (oldRecord && oldRecord->modified == source.modified && oldRecord->size == source.size) {
+            reused[old] = builder.addFile(source.path, source.modified, oldRecord->hash, source.size);
+        } else {
+            QFile file(source.absolutePath);
+            if (!file.open(QIODevice::ReadOnly)) {
+                modified = true;
+                continue;
+            }
+            const QByteArray contents = file.readAll();
+            const quint64 hash = TextBuffer::hashOf(contents.constData(), contents.size());
+            // Touched but not changed, e.g. by a checkout: only the mtime
+            // in the index is updated.
+            if (oldRecord && oldRecord->hash == hash && oldRecord->size == contents.size()) {
+                reused[old] = builder.addFile(source.path, source.modified, hash, contents.size());
+            } else {
+                const quint32 added = builder.addFile(source.path, source.modified, hash, contents.size());
+                builder.addScan(added, SymbolScanner::scan(contents.constData(), contents.size(),
+                                                           source.dialect));
+                oldRecord = nullptr;
+            }
+            modified = true;
+        }
+
+        if (oldRecord && reused[old] != NoFile) {
+            const DefinitionRecord *records = previous->definitions() + oldRecord->firstDefinition;
+            for (quint32 i = 0; i < oldRecord->definitionCount; ++i) {
+                DefinitionRecord definition = records[i];
+                definition.symbol = carry(definition.symbol);
+                definition.file = reused[old];
+                if (definition.scope != NoSymbol) definition.scope = carry(definition.scope);
+                builder.addDefinition(definition);
+            }
+        }
+    }
+    if (!modified) {
+        post(job.generation, previous, true);
+        return;
+    }
+
+    // References are stored per symbol; those of carried files are taken
+    // over in one pass.
+    if (previous) {
+        const quint32 symbolCount = previous->header().symbolCount;
+        for (quint32 oldSymbol = 0; oldSymbol < symbolCount; ++oldSymbol) {
+            const SymbolRecord &record = previous->symbols()[oldSymbol];
+            const quint32 *fileIds = previous->references() + record.firstReference;
+            for (quint32 i = 0; i < record.referenceCount; ++i) {
+                const quint32 file = reused[fileIds[i]];
+                if (file != NoFile) builder.addReference(carry(oldSymbol), file);
+            }
+        }
+    }
+    if (generation != job.generation) return;
+
+    const QByteArray image = builder.image(job.root);
+    if (image.isEmpty()) {
+        post(job.generation, previous, true);
+        return;
+    }
+
+    // Written next to the old index and renamed over it; a mapping of the
+    // old one stays valid until it is dropped.
+    auto written = std::make_shared<Snapshot>();
+    QSaveFile output(job.cacheFile);
+    const bool saved = QDir().mkpath(QFileInfo(job.cacheFile).absolutePath())
+        && output.open(QIODevice::WriteOnly)
+        && output.write(image) == image.size()
+        && output.commit();
+    if (!saved || !written->map(job.cacheFile)) {
+        // Still useful for this session.
+        written = std::make_shared<Snapshot>();
+        if (!written->adopt(image)) {
+            post(job.generation, previous, true);
+            return;
+        }
+    }
+
+    previous = written;
+    post(job.generation, previous, true);
+}
+
+void SymbolIndex::post(quint64 jobGeneration, std::shared_ptr<const Snapshot> result, bool done) {
+    QMetaObject::invokeMethod(this, [this, jobGeneration, result, done]() {
+        apply(jobGeneration, result, done);
+    }, Qt::QueuedConnection);
+}
+
+void SymbolIndex::apply(quint64 jobGeneration, const std::shared_ptr<const Snapshot> &result, bool done) {
+    if (jobGeneration != generation) return;
+
+    if (done) --passes;
+    if (!result || result == snapshot) {
+        if (done) emit changed();
+        return;
+    }
+    snapshot = result;
+    emit changed();
+}
@@ -0,0 +1,126 @@
+#ifndef SYMBOLINDEX_H
+#define SYMBOLINDEX_H
+
+#pragma once
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+#include "symbolscanner.h"
+
+class QThread;
+class QTimer;
+
+// Definitions and references of the C and C++ files under a folder, for go
+// to definition and the outline.
+//
+// A worker thread crawls the folder, runs SymbolScanner over every file the
+// highlighter would treat as C or C++, and writes the result to one file in
+// the cache directory. The GUI thread only ever reads a memory mapping of
+// that file: symbols are sorted by name, so a lookup is a binary search and
+// touches a handful of pages. Indexing again reuses every file whose mtime
+// and size, or failing that whose contents, match the previous index, so
+// after the first run only edited files are read and scanned.
+class SymbolIndex : public QObject {
+    Q_OBJECT
+
+public:
+    struct Definition {
+        QString name;
+        QString scope;
+        QString filePath;
+        // Zero based; the column counts UTF-16 units.
+        qint64 line = 0;
+        int column = 0;
+        SymbolScanner::Kind kind = SymbolScanner::Function;
+        bool declaration = false;
+    };
+
+    explicit SymbolIndex(QObject *parent = nullptr);
+    // Stops indexing and waits for the worker.
+    ~SymbolIndex() override;
+
+    // Shows the index last written for rootPath, if any, and brings it up
+    // to date in the background.
+    void setRoot(const QString &rootPath);
+    QString root() const;
+
+    // Looks at the whole folder again soon, for files that came or went.
+    void refresh();
+    // Scans filePath again soon, as after it was saved, without walking the
+    // folder. Calls in quick succession, e.g. from autosave, are folded
+    // into one pass.
+    void refreshFile(const QString &filePath);
+
+    bool isIndexing() const;
+    qint64 fileCount() const;
+
+    // Where the symbol called name is defined or declared, definitions
+    // first.
+    QVector<Definition> definitions(const QString &name) const;
+    // What filePath defines, in the order it does.
+    QVector<Definition> outline(const QString &filePath) const;
+    // The files that mention name at all, absolute.
+    QStringList filesReferencing(const QString &name) const;
+
+    // Defaults to a "symbols" directory under the application cache.
+    void setCacheDirectory(const QString &path);
+
+    static constexpr qint64 MaxFiles = 200000;
+    // Generated sources and amalgamations are not worth scanning.
+    static constexpr qint64 MaxFileSize = 4 * 1024 * 1024;
+
+signals:
+    // The index now reflects a newer state of the folder.
+    void changed();
+
+private:
+    class Snapshot;
+
+    struct Job {
+        QString root;
+        QString cacheFile;
+        quint64 generation;
+        // Relative paths to look at again; empty to walk the whole folder.
+        QList<QByteArray> changedFiles;
+    };
+
+    void run();
+    void build(const Job &job);
+    // done marks the end of a pass; the index it carries may be unchanged.
+    void post(quint64 generation, std::shared_ptr<const Snapshot> snapshot, bool done);
+    void enqueue();
+    void apply(quint64 generation, const std::shared_ptr<const Snapshot> &snapshot, bool done);
+    QString cacheFileFor(const QString &rootPath) const;
+    Definition definitionAt(quint32 index) const;
+
+    QString rootPath;
+    QString cacheDirectory;
+    // Read by the GUI thread only; the worker keeps a reference of its own
+    // to reuse files from.
+    std::shared_ptr<const Snapshot> snapshot;
+    // Passes queued or running.
+    int passes;
+    QTimer *refreshTimer;
+    // What the next pass is for, gathered until refreshTimer fires.
+    bool refreshAll;
+    QList<QByteArray> changedFiles;
+
+    QThread *thread;
+    QMutex mutex;
+    QWaitCondition jobAvailable;
+    QList<Job> jobs;
+    bool stopping;
+    // Bumped by setRoot; work for an older root stops early and is dropped.
+    std::atomic<quint64> generation;
+    std::shared_ptr<const Snapshot> previous;
+};
+
+#endif // SYMBOLINDEX_H
@@ -0,0 +1,882 @@
+#include "symbolscanner.h"
+
+#include <QSet>
+
+#include <cstring>
+
+namespace {
+
+// Words that are never a symbol of their own. C++ adds to the C ones; in C
+// "class" or "new" are ordinary names.
+const Lexer::KeywordTable &keywords(Lexer::Dialect dialect) {
+    static const Lexer::KeywordTable c{
+        {"auto", Lexer::Keyword}, {"break", Lexer::Keyword}, {"case", Lexer::Keyword},
+        {"char", Lexer::Keyword}, {"const", Lexer::Keyword}, {"continue", Lexer::Keyword},
+        {"default", Lexer::Keyword}, {"do", Lexer::Keyword}, {"double", Lexer::Keyword},
+        {"else", Lexer::Keyword}, {"enum", Lexer::Keyword}, {"extern", Lexer::Keyword},
+        {"float", Lexer::Keyword}, {"for", Lexer::Keyword}, {"goto", Lexer::Keyword},
+        {"if", Lexer::Keyword}, {"inline", Lexer::Keyword}, {"int", Lexer::Keyword},
+        {"long", Lexer::Keyword}, {"register", Lexer::Keyword}, {"restrict", Lexer::Keyword},
+        {"return", Lexer::Keyword}, {"short", Lexer::Keyword}, {"signed", Lexer::Keyword},
+        {"sizeof", Lexer::Keyword}, {"static", Lexer::Keyword}, {"struct", Lexer::Keyword},
+        {"switch", Lexer::Keyword}, {"typedef", Lexer::Keyword}, {"union", Lexer::Keyword},
+        {"unsigned", Lexer::Keyword}, {"void", Lexer::Keyword}, {"volatile", Lexer::Keyword},
+        {"while", Lexer::Keyword}, {"_Bool", Lexer::Keyword}, {"_Static_assert", Lexer::Keyword},
+        {"_Alignof", Lexer::Keyword}, {"_Alignas", Lexer::Keyword}, {"_Noreturn", Lexer::Keyword},
+        {"_Atomic", Lexer::Keyword}, {"_Thread_local", Lexer::Keyword}, {"_Generic", Lexer::Keyword},
+        {"__attribute__", Lexer::Keyword}, {"__declspec", Lexer::Keyword}, {"asm", Lexer::Keyword},
+        {"__asm__", Lexer::Keyword}, {"defined", Lexer::Keyword}
+    };
+    static const Lexer::KeywordTable cpp{
+        {"auto", Lexer::Keyword}, {"break", Lexer::Keyword}, {"case", Lexer::Keyword},
+        {"char", Lexer::Keyword}, {"const", Lexer::Keyword}, {"continue", Lexer::Keyword},
+        {"default", Lexer::Keyword}, {"do", Lexer::Keyword}, {"double", Lexer::Keyword},
+        {"else", Lexer::Keyword}, {"enum", Lexer::Keyword}, {"extern", Lexer::Keyword},
+        {"float", Lexer::Keyword}, {"for", Lexer::Keyword}, {"goto", Lexer::Keyword},
+        {"if", Lexer::Keyword}, {"inline", Lexer::Keyword}, {"int", Lexer::Keyword},
+        {"long", Lexer::Keyword}, {"register", Lexer::Keyword}, {"return", Lexer::Keyword},
+        {"short", Lexer::Keyword}, {"signed", Lexer::Keyword}, {"sizeof", Lexer::Keyword},
+        {"static", Lexer::Keyword}, {"struct", Lexer::Keyword}, {"switch", Lexer::Keyword},
+        {"typedef", Lexer::Keyword}, {"union", Lexer::Keyword}, {"unsigned", Lexer::Keyword},
+        {"void", Lexer::Keyword}, {"volatile", Lexer::Keyword}, {"while", Lexer::Keyword},
+        {"alignas", Lexer::Keyword}, {"alignof", Lexer::Keyword}, {"bool", Lexer::Keyword},
+        {"catch", Lexer::Keyword}, {"char8_t", Lexer::Keyword}, {"char16_t", Lexer::Keyword},
+        {"char32_t", Lexer::Keyword}, {"class", Lexer::Keyword}, {"concept", Lexer::Keyword},
+        {"consteval", Lexer::Keyword}, {"constexpr", Lexer::Keyword}, {"constinit", Lexer::Keyword},
+        {"const_cast", Lexer::Keyword}, {"co_await", Lexer::Keyword}, {"co_return", Lexer::Keyword},
+        {"co_yield", Lexer::Keyword}, {"decltype", Lexer::Keyword}, {"delete", Lexer::Keyword},
+        {"dynamic_cast", Lexer::Keyword}, {"explicit", Lexer::Keyword}, {"export", Lexer::Keyword},
+        {"false", Lexer::Keyword}, {"final", Lexer::Keyword}, {"friend", Lexer::Keyword},
+        {"mutable", Lexer::Keyword}, {"namespace", Lexer::Keyword}, {"new", Lexer::Keyword},
+        {"noexcept", Lexer::Keyword}, {"nullptr", Lexer::Keyword}, {"operator", Lexer::Keyword},
+        {"override", Lexer::Keyword}, {"private", Lexer::Keyword}, {"protected", Lexer::Keyword},
+        {"public", Lexer::Keyword}, {"reinterpret_cast", Lexer::Keyword}, {"requires", Lexer::Keyword},
+        {"static_assert", Lexer::Keyword}, {"static_cast", Lexer::Keyword}, {"template", Lexer::Keyword},
+        {"this", Lexer::Keyword}, {"thread_local", Lexer::Keyword}, {"throw", Lexer::Keyword},
+        {"true", Lexer::Keyword}, {"try", Lexer::Keyword}, {"typeid", Lexer::Keyword},
+        {"typename", Lexer::Keyword}, {"using", Lexer::Keyword}, {"virtual", Lexer::Keyword},
+        {"wchar_t", Lexer::Keyword}, {"__attribute__", Lexer::Keyword}, {"__declspec", Lexer::Keyword},
+        {"asm", Lexer::Keyword}, {"__asm__", Lexer::Keyword}, {"defined", Lexer::Keyword}
+    };
+    return dialect == Lexer::C ? c : cpp;
+}
+
+inline bool isIdentifierStart(uchar c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+}
+
+inline bool isIdentifierChar(uchar c) {
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+struct Token {
+    enum Type { End, Identifier, Define, Literal, Punct };
+
+    Type type = End;
+    const char *text = nullptr;
+    int length = 0;
+    quint32 line = 0;
+    // Where the token's line starts, for its column.
+    const char *lineStart = nullptr;
+
+    bool is(char c) const {
+        return type == Punct && length == 1 && text[0] == c;
+    }
+    bool is(const char *word) const {
+        return type == Identifier && int(std::strlen(word)) == length
+            && std::memcmp(text, word, size_t(length)) == 0;
+    }
+    bool isScope() const {
+        return type == Punct && length == 2 && text[0] == ':';
+    }
+    bool isArrow() const {
+        return type == Punct && length == 2 && text[0] == '-';
+    }
+    QByteArray bytes() const {
+        return QByteArray(text, length);
+    }
+    quint32 column() const {
+        // UTF-16 units: one per character, two for those past the BMP.
+        quint32 units = 0;
+        for (const char *p = lineStart; p < text; ++p) {
+            const uchar c = uchar(*p);
+            if ((c & 0xC0) != 0x80) units += c >= 0xF0 ? 2 : 1;
+        }
+        return units;
+    }
+};
+
+// Splits source into identifiers, literals and punctuation. Comments and
+// preprocessor lines are dropped, except that "#define NAME" comes out as a
+// Define token.
+class Tokenizer {
+public:
+    Tokenizer(const char *data, qint64 size)
+        : p(data), end(data + size), lineStart(data), line(0), atLineStart(true) {}
+
+    Token next() {
+        while (p < end) {
+            const uchar c = uchar(*p);
+            if (c == '\n') {
+                newLine(p + 1);
+                ++p;
+                continue;
+            }
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+                ++p;
+                continue;
+            }
+            if (c == '/' && p + 1 < end && p[1] == '/') {
+                skipLineComment();
+                continue;
+            }
+            if (c == '/' && p + 1 < end && p[1] == '*') {
+                skipBlockComment();
+                continue;
+            }
+            if (c == '#' && atLineStart) {
+                Token define = directive();
+                if (define.type == Token::Define) return define;
+                continue;
+            }
+
+            atLineStart = false;
+            Token token = start();
+            if (c == '"' || c == '\'') {
+                skipQuoted(c);
+                return finish(token, Token::Literal);
+            }
+            if ((c >= '0' && c <= '9') || (c == '.' && p + 1 < end && p[1] >= '0' && p[1] <= '9')) {
+                skipNumber();
+                return finish(token, Token::Literal);
+            }
+            if (isIdentifierStart(c)) {
+                while (p < end && isIdentifierChar(uchar(*p))) ++p;
+                // Encoding prefixes and raw strings: u8"", L'x', R"(...)".
+                if (p < end && (*p == '"' || *p == '\'') && isLiteralPrefix(token.text, p)) {
+                    if (p[-1] == 'R' && *p == '"') {
+                        skipRawString();
+                    } else {
+                        skipQuoted(uchar(*p));
+                    }
+                    return finish(token, Token::Literal);
+                }
+                return finish(token, Token::Identifier);
+            }
+            if ((c == ':' && p + 1 < end && p[1] == ':') || (c == '-' && p + 1 < end && p[1] == '>')) {
+                p += 2;
+                return finish(token, Token::Punct);
+            }
+            ++p;
+            return finish(token, Token::Punct);
+        }
+        Token token = start();
+        token.type = Token::End;
+        return token;
+    }
+
+private:
+    Token start() const {
+        Token token;
+        token.text = p;
+        token.line = line;
+        token.lineStart = lineStart;
+        return token;
+    }
+
+    Token finish(Token token, Token::Type type) const {
+        token.type = type;
+        token.length = int(p - token.text);
+        return token;
+    }
+
+    void newLine(const char *next) {
+        ++line;
+        lineStart = next;
+        atLineStart = true;
+    }
+
+    static bool isLiteralPrefix(const char *from, const char *to) {
+        const QByteArray prefix = QByteArray::fromRawData(from, to - from);
+        return prefix == "u8" || prefix == "u" || prefix == "U" || prefix == "L"
+            || prefix == "R" || prefix == "u8R" || prefix == "uR" || prefix == "UR" || prefix == "LR";
+    }
+
+    void skipLineComment() {
+        while (p < end && *p != '\n') ++p;
+    }
+
+    void skipBlockComment() {
+        p += 2;
+        while (p < end && !(*p == '*' && p + 1 < end && p[1] == '/')) {
+            if (*p == '\n') newLine(p + 1);
+            ++p;
+        }
+        p = qMin(end, p + 2);
+    }
+
+    // An unterminated literal ends with its line.
+    void skipQuoted(uchar quote) {
+        ++p;
+        while (p < end && uchar(*p) != quote && *p != '\n') {
+            p += *p == '\\' && p + 1 < end ? 2 : 1;
+        }
+        if (p < end && uchar(*p) == quote) ++p;
+    }
+
+    void skipRawString() {
+        const char *delimiter = ++p;
+        while (p < end && *p != '(' && *p != '\n') ++p;
+        const QByteArray closing = ')' + QByteArray(delimiter, p - delimiter) + '"';
+        const char *found = std::search(p, end, closing.cbegin(), closing.cend());
+        for (; p < found; ++p) {
+            if (*p == '\n') newLine(p + 1);
+        }
+        p = qMin(end, found + closing.size());
+    }
+
+    void skipNumber() {
+        while (p < end) {
+            const uchar c = uchar(*p);
+            if ((c == '+' || c == '-') && (p[-1] == 'e' || p[-1] == 'E' || p[-1] == 'p' || p[-1] == 'P')) {
+                ++p;
+            } else if (isIdentifierChar(c) || c == '.' || (c == '\'' && p + 1 < end && isIdentifierChar(uchar(p[1])))) {
+                ++p;
+            } else {
+                break;
+            }
+        }
+    }
+
+    // Skips a preprocessor line, continuations included.
+    Token directive() {
+        ++p;
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+        const char *word = p;
+        while (p < end && isIdentifierChar(uchar(*p))) ++p;
+
+        Token define;
+        if (p - word == 6 && std::memcmp(word, "define", 6) == 0) {
+            while (p < end && (*p == ' ' || *p == '\t')) ++p;
+            if (p < end && isIdentifierStart(uchar(*p))) {
+                define = start();
+                while (p < end && isIdentifierChar(uchar(*p))) ++p;
+                define = finish(define, Token::Define);
+            }
+        }
+
+        while (p < end && *p != '\n') {
+            if (*p == '\\' && p + 1 < end && (p[1] == '\n' || (p[1] == '\r' && p + 2 < end && p[2] == '\n'))) {
+                p += p[1] == '\r' ? 2 : 1;
+                newLine(p + 1);
+                ++p;
+            } else if (*p == '/' && p + 1 < end && p[1] == '*') {
+                skipBlockComment();
+            } else if (*p == '/' && p + 1 < end && p[1] == '/') {
+                skipLineComment();
+            } else if (*p == '"' || *p == '\'') {
+                skipQuoted(uchar(*p));
+            } else {
+                ++p;
+            }
+        }
+        return define;
+    }
+
+    const char *p;
+    const char *end;
+    const char *lineStart;
+    quint32 line;
+    bool atLineStart;
+};
+
+class Parser {
+public:
+    Parser(const char *data, qint64 size, Lexer::Dialect dialect)
+        : tokenizer(data, size), table(keywords(dialect)), cpp(dialect != Lexer::C)
+    {
+        scopes.append(Scope{});
+    }
+
+    SymbolScanner::Result run() {
+        for (Token token = tokenizer.next(); token.type != Token::End; token = tokenizer.next()) {
+            if (token.type == Token::Define) {
+                define(token, SymbolScanner::Macro, QByteArray(), false);
+                continue;
+            }
+            if (token.type == Token::Identifier) reference(token);
+
+            switch (scopes.last().kind) {
+            case Declarations:
+            case ClassBody:
+                declarationToken(token);
+                break;
+            case EnumBody:
+                enumToken(token);
+                break;
+            case Body:
+                bodyToken(token);
+                break;
+            }
+        }
+
+        result.identifiers.reserve(identifiers.size());
+        for (const QByteArray &identifier : std::as_const(identifiers)) {
+            result.identifiers.append(identifier);
+        }
+        return std::move(result);
+    }
+
+private:
+    enum ScopeKind { Declarations, ClassBody, EnumBody, Body };
+
+    // What closing a brace does to the statement it was opened in.
+    enum Close { EndStatement, ContinueStatement, EndTypeBody };
+
+    enum Phase {
+        Declaring,
+        // Inside the parameter list of what may be a function.
+        Parameters,
+        // After the parameters: qualifiers, then a body or a semicolon.
+        AfterParameters,
+        // "-> type", or "= 0", "= default": anything up to the end.
+        Trailing,
+        ConstructorInitializers,
+        // After "=": nothing more to find before the semicolon.
+        Initializer
+    };
+
+    enum Keyword { NoKeyword, TypeKeyword, NamespaceKeyword, TypedefKeyword, UsingKeyword,
+                   FriendKeyword, ExternKeyword };
+
+    struct Statement {
+        Phase phase = Declaring;
+        Keyword keyword = NoKeyword;
+        int depth = 0;
+        int templateDepth = 0;
+        // Identifiers outside parentheses.
+        int identifiers = 0;
+        // The last few tokens outside parentheses, newest first.
+        Token last;
+        Token previous;
+        Token beforePrevious;
+        Token earlier;
+        Token lastIdentifier;
+        // class/struct/enum/namespace name, fixed at a base clause.
+        Token typeName;
+        bool typeNameFixed = false;
+        bool sawTypeKeyword = false;
+        // Template arguments after the type name, as in "struct hash<Foo>".
+        int angle = 0;
+        bool isEnum = false;
+        bool isExtern = false;
+        // After "} " of a class body: what follows declares variables.
+        bool afterTypeBody = false;
+        bool variableDone = false;
+        bool declaration = false;
+        // The function this may be, once a parameter list opens.
+        Token candidate;
+        QByteArray candidateName;
+        QByteArray candidateScope;
+        Token operatorToken;
+        QByteArray operatorName;
+        // "typedef void (*Name)(...)".
+        Token typedefName;
+    };
+
+    struct Scope {
+        ScopeKind kind = Declarations;
+        QByteArray name;
+        Close close = EndStatement;
+        Statement statement;
+        bool expectEnumerator = true;
+        int depth = 0;
+    };
+
+    bool isKeyword(const Token &token) const {
+        return table.lookup(token.text, token.length) >= 0;
+    }
+
+    void reference(const Token &token) {
+        if (token.length < 2 || isKeyword(token)) return;
+        const QByteArray raw = QByteArray::fromRawData(token.text, token.length);
+        if (!identifiers.contains(raw)) identifiers.insert(token.bytes());
+    }
+
+    QByteArray enclosingName() const {
+        for (qsizetype i = scopes.size() - 1; i >= 0; --i) {
+            if (scopes[i].kind == Body) return QByteArray();
+            if (!scopes[i].name.isEmpty()) return scopes[i].name;
+            // Members of an anonymous struct have no name to go under.
+            if (scopes[i].kind != Declarations) return QByteArray();
+        }
+        return QByteArray();
+    }
+
+    void define(const Token &token, SymbolScanner::Kind kind, const QByteArray &name, bool declaration) {
+        SymbolScanner::Definition definition;
+        definition.name = name.isEmpty() ? token.bytes() : name;
+        definition.line = token.line;
+        definition.column = token.column();
+        definition.kind = kind;
+        definition.declaration = declaration;
+        if (kind != SymbolScanner::Macro) definition.scope = enclosingName();
+        result.definitions.append(definition);
+    }
+
+    void defineFunction(Statement &s, bool declaration) {
+        if (s.candidate.type == Token::End) return;
+        define(s.candidate, SymbolScanner::Function, s.candidateName, declaration || s.declaration);
+        if (!s.candidateScope.isEmpty()) result.definitions.last().scope = s.candidateScope;
+    }
+
+    void defineVariable(Statement &s) {
+        if (s.variableDone || s.lastIdentifier.type == Token::End) return;
+        if (s.identifiers < 2 && !(s.afterTypeBody && s.identifiers >= 1)) return;
+        s.variableDone = true;
+        define(s.lastIdentifier, SymbolScanner::Variable, QByteArray(), s.isExtern);
+    }
+
+    void push(ScopeKind kind, const QByteArray &name, Close close) {
+        Scope scope;
+        scope.kind = kind;
+        scope.name = name;
+        scope.close = close;
+        scopes.append(scope);
+    }
+
+    void pop(const Token &brace) {
+        if (scopes.size() == 1) return;
+        const Close close = scopes.takeLast().close;
+        Statement &s = scopes.last().statement;
+        switch (close) {
+        case EndStatement:
+            s = Statement();
+            break;
+        case ContinueStatement:
+            remember(s, brace);
+            break;
+        case EndTypeBody: {
+            Statement next;
+            next.keyword = s.keyword;
+            next.afterTypeBody = true;
+            s = next;
+            break;
+        }
+        }
+    }
+
+    static bool endsParameters(const Token &token) {
+        static const char *const qualifiers[] = {
+            "const", "volatile", "noexcept", "throw", "override", "final", "mutable",
+            "try", "__attribute__", "requires"
+        };
+        for (const char *qualifier : qualifiers) {
+            if (token.is(qualifier)) return true;
+        }
+        // Annotation macros such as Q_DECL_NOTHROW.
+        for (int i = 0; i < token.length; ++i) {
+            const char c = token.text[i];
+            if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) return false;
+        }
+        return token.length >= 2;
+    }
+
+    bool mayBeFunctionName(const Statement &s) const {
+        const Token &name = s.last;
+        if (name.type != Token::Identifier || isKeyword(name)) return false;
+        static const char *const notFunctions[] = {"if", "while", "for", "switch", "return", "sizeof",
+                                                   "static_assert", "_Static_assert", "alignof", "typeid"};
+        for (const char *word : notFunctions) {
+            if (name.is(word)) return false;
+        }
+        return !s.previous.is('.') && !s.previous.isArrow() && !s.previous.is('=');
+    }
+
+    void startStatementWith(const Token &token) {
+        scopes.last().statement = Statement();
+        declarationToken(token);
+    }
+
+    static void remember(Statement &s, const Token &token) {
+        s.earlier = s.beforePrevious;
+        s.beforePrevious = s.previous;
+        s.previous = s.last;
+        s.last = token;
+    }
+
+    void declarationToken(const Token &token) {
+        Scope &scope = scopes.last();
+        Statement &s = scope.statement;
+
+        if (s.templateDepth > 0) {
+            if (token.is('<')) ++s.templateDepth;
+            if (token.is('>')) --s.templateDepth;
+            if (token.is(';') || token.is('{') || token.is('}')) {
+                s.templateDepth = 0;
+            } else {
+                return;
+            }
+        }
+
+        if (token.is('}')) {
+            pop(token);
+            return;
+        }
+
+        if (s.depth > 0) {
+            if (token.is('(') || token.is('[')) ++s.depth;
+            if (token.is(')') || token.is(']')) --s.depth;
+            if (token.is('{')) {
+                push(Body, QByteArray(), ContinueStatement);
+                return;
+            }
+            if (s.keyword == TypedefKeyword && token.type == Token::Identifier
+                && s.previous.is('(') && s.last.is('*')) {
+                s.typedefName = token;
+            }
+            if (s.depth == 0 && s.phase == Parameters) s.phase = AfterParameters;
+            remember(s, token);
+            return;
+        }
+
+        switch (s.phase) {
+        case Parameters:
+            break;
+        case Initializer:
+            if (token.is(';')) {
+                scope.statement = Statement();
+            } else if (token.is('(') || token.is('[')) {
+                ++s.depth;
+            } else if (token.is('{')) {
+                push(Body, QByteArray(), ContinueStatement);
+            }
+            return;
+        case Trailing:
+            if (token.is(';')) {
+                defineFunction(s, true);
+                scope.statement = Statement();
+            } else if (token.is('{')) {
+                defineFunction(s, false);
+                push(Body, QByteArray(), EndStatement);
+            } else if (token.is('(') || token.is('[')) {
+                ++s.depth;
+            }
+            return;
+        case ConstructorInitializers:
+            if (token.is('{')) {
+                // "member{value}" initializes; "...) {" starts the body.
+                if (s.last.type == Token::Identifier || s.last.is('>')) {
+                    remember(s, token);
+                    push(Body, QByteArray(), ContinueStatement);
+                } else {
+                    defineFunction(s, false);
+                    push(Body, QByteArray(), EndStatement);
+                }
+                // push() may have moved s.
+                return;
+            } else if (token.is('(')) {
+                ++s.depth;
+            } else if (token.is(';')) {
+                scope.statement = Statement();
+            }
+            remember(s, token);
+            return;
+        case AfterParameters:
+            if (token.is('{')) {
+                defineFunction(s, false);
+                push(Body, QByteArray(), EndStatement);
+                return;
+            } else if (token.is(';')) {
+                defineFunction(s, true);
+                scope.statement = Statement();
+            } else if (token.is('=')) {
+                s.declaration = true;
+                s.phase = Trailing;
+            } else if (token.isArrow()) {
+                s.phase = Trailing;
+            } else if (token.is(':') && s.candidate.type != Token::End) {
+                s.phase = ConstructorInitializers;
+            } else if (token.is(',')) {
+                // "int a(1), b(2);" were variables after all.
+                s.phase = Initializer;
+            } else if (token.is('(') && s.last.type == Token::Identifier && endsParameters(s.last)) {
+                ++s.depth;
+            } else if (token.type == Token::Identifier && !endsParameters(token)) {
+                // A macro call without a semicolon; this starts something new.
+                startStatementWith(token);
+                return;
+            } else if (token.is('(')) {
+                startStatementWith(token);
+                return;
+            }
+            remember(s, token);
+            return;
+        case Declaring:
+            declaringToken(scope, token);
+            return;
+        }
+    }
+
+    void declaringToken(Scope &scope, const Token &token) {
+        Statement &s = scope.statement;
+
+        if (token.type == Token::Identifier) {
+            identifierInDeclaration(scope, token);
+            remember(s, token);
+            return;
+        }
+
+        if (!s.operatorName.isEmpty() && !token.is('(')) {
+            s.operatorName += token.bytes();
+            remember(s, token);
+            return;
+        }
+
+        if (token.is('<') && s.last.is("template")) {
+            s.templateDepth = 1;
+            return;
+        }
+        if (s.keyword == TypeKeyword) {
+            if (token.is('<')) ++s.angle;
+            if (token.is('>')) --s.angle;
+        }
+
+        if (token.is(';')) {
+            if (s.keyword == TypedefKeyword) {
+                const Token &name = s.typedefName.type != Token::End ? s.typedefName : s.lastIdentifier;
+                if (name.type != Token::End) define(name, SymbolScanner::Typedef, QByteArray(), false);
+            } else if (s.keyword == NoKeyword || s.keyword == ExternKeyword
+                       || (s.keyword == TypeKeyword && s.afterTypeBody)) {
+                defineVariable(s);
+            }
+            scope.statement = Statement();
+            return;
+        }
+
+        if (token.is('{')) {
+            openBrace(scope);
+            return;
+        }
+
+        if (token.is('(')) {
+            const bool callable = s.keyword == NoKeyword || s.keyword == FriendKeyword
+                || s.keyword == ExternKeyword || (s.keyword == TypeKeyword && !s.typeNameFixed);
+            if (callable && !s.operatorName.isEmpty()) {
+                // The first parentheses of "operator()(" are part of its name.
+                if (s.operatorName == "operator") {
+                    s.operatorName += '(';
+                    remember(s, token);
+                    return;
+                }
+                startCandidate(s, s.operatorName);
+            } else if (callable && mayBeFunctionName(s)) {
+                startCandidate(s, QByteArray());
+            } else {
+                ++s.depth;
+            }
+            remember(s, token);
+            return;
+        }
+
+        if (token.is('[')) {
+            if (s.keyword == NoKeyword || s.keyword == ExternKeyword) defineVariable(s);
+            ++s.depth;
+            remember(s, token);
+            return;
+        }
+
+        if (token.is('=')) {
+            if (s.keyword == UsingKeyword) {
+                if (s.identifiers == 2) define(s.lastIdentifier, SymbolScanner::Typedef, QByteArray(), false);
+            } else if (s.keyword == NoKeyword || s.keyword == ExternKeyword
+                       || (s.keyword == TypeKeyword && s.afterTypeBody)) {
+                defineVariable(s);
+            }
+            s.phase = Initializer;
+            return;
+        }
+
+        if (token.is(':')) {
+            static const char *const labels[] = {"public", "private", "protected", "signals", "slots",
+                                                 "Q_SIGNALS", "Q_SLOTS"};
+            for (const char *label : labels) {
+                if (s.last.is(label)) {
+                    scope.statement = Statement();
+                    return;
+                }
+            }
+            if (s.keyword == TypeKeyword && !s.afterTypeBody) {
+                s.typeNameFixed = true;
+            } else if (s.keyword == NoKeyword && scope.kind == ClassBody) {
+                // A bit-field.
+                defineVariable(s);
+                s.phase = Initializer;
+                return;
+            }
+        }
+
+        remember(s, token);
+    }
+
+    void identifierInDeclaration(Scope &scope, const Token &token) {
+        Statement &s = scope.statement;
+
+        if (!s.operatorName.isEmpty()) {
+            // Conversion operators: "operator bool".
+            s.operatorName += ' ' + token.bytes();
+            return;
+        }
+
+        if (cpp && token.is("operator")) {
+            s.operatorName = "operator";
+            s.operatorToken = token;
+            return;
+        }
+        if (token.is("typedef")) {
+            s.keyword = TypedefKeyword;
+            return;
+        }
+        if (token.is("extern") && s.keyword == NoKeyword) {
+            s.keyword = ExternKeyword;
+            s.isExtern = true;
+            return;
+        }
+        if (cpp) {
+            if (token.is("template")) return;
+            if (token.is("using") && s.identifiers == 0) {
+                s.keyword = UsingKeyword;
+            } else if (token.is("friend")) {
+                s.keyword = FriendKeyword;
+            } else if (token.is("namespace") && s.keyword != UsingKeyword) {
+                s.keyword = NamespaceKeyword;
+                return;
+            }
+        }
+
+        const bool typeKeyword = token.is("struct") || token.is("union") || token.is("enum")
+            || (cpp && token.is("class"));
+        if (typeKeyword) {
+            if (s.keyword == NoKeyword || s.keyword == ExternKeyword || s.keyword == TypedefKeyword) {
+                if (s.keyword != TypedefKeyword) s.keyword = TypeKeyword;
+                s.sawTypeKeyword = true;
+                s.isEnum = token.is("enum");
+                s.typeName = Token();
+                s.typeNameFixed = false;
+            }
+            return;
+        }
+
+        // "namespace std _GLIBCXX_VISIBILITY(default)" is std; "a::b" is b.
+        const bool namespaceNamed = s.keyword == NamespaceKeyword && s.typeName.type != Token::End
+            && !s.last.isScope();
+        if (!s.typeNameFixed && s.angle == 0 && !namespaceNamed && !token.is("final") && !isKeyword(token)) {
+            s.typeName = token;
+        }
+        ++s.identifiers;
+        s.lastIdentifier = token;
+    }
+
+    void startCandidate(Statement &s, const QByteArray &operatorName) {
+        Token name = s.last;
+        QByteArray text = operatorName;
+        QByteArray qualifier;
+        if (operatorName.isEmpty()) {
+            text = name.bytes();
+            // "Type Class::name(" and "Class::~Class(" belong to Class.
+            const bool destructor = s.previous.is('~');
+            if (destructor) text.prepend('~');
+            const Token &separator = destructor ? s.beforePrevious : s.previous;
+            const Token &owner = destructor ? s.earlier : s.beforePrevious;
+            if (separator.isScope() && owner.type == Token::Identifier) qualifier = owner.bytes();
+        } else {
+            name = s.operatorToken;
+        }
+
+        s.candidate = name;
+        s.candidateName = text;
+        s.candidateScope = qualifier;
+        s.operatorName.clear();
+        s.phase = Parameters;
+        s.depth = 1;
+    }
+
+    void openBrace(Scope &scope) {
+        Statement &s = scope.statement;
+
+        if ((s.keyword == TypeKeyword || (s.keyword == TypedefKeyword && s.sawTypeKeyword))
+            && !s.afterTypeBody) {
+            const bool named = s.typeName.type != Token::End;
+            if (named) define(s.typeName, s.isEnum ? SymbolScanner::Enum : SymbolScanner::Class,
+                              QByteArray(), false);
+            push(s.isEnum ? EnumBody : ClassBody, named ? s.typeName.bytes() : QByteArray(), EndTypeBody);
+            return;
+        }
+
+        if (s.keyword == NamespaceKeyword) {
+            const bool named = s.typeName.type != Token::End;
+            if (named) define(s.typeName, SymbolScanner::Namespace, QByteArray(), false);
+            push(Declarations, named ? s.typeName.bytes() : QByteArray(), EndStatement);
+            return;
+        }
+
+        // extern "C" { ... }
+        if (s.keyword == ExternKeyword && s.identifiers == 0 && s.last.type == Token::Literal) {
+            push(Declarations, QByteArray(), EndStatement);
+            return;
+        }
+
+        if (s.keyword == NoKeyword && s.identifiers >= 2) {
+            // "Type name{value};"
+            defineVariable(s);
+            push(Body, QByteArray(), ContinueStatement);
+            return;
+        }
+
+        push(Body, QByteArray(), EndStatement);
+    }
+
+    void enumToken(const Token &token) {
+        Scope &scope = scopes.last();
+        if (token.is('}')) {
+            pop(token);
+            return;
+        }
+        if (token.is('(') || token.is('[')) ++scope.depth;
+        if (token.is(')') || token.is(']')) --scope.depth;
+        if (token.is('{')) {
+            push(Body, QByteArray(), ContinueStatement);
+            return;
+        }
+        if (scope.depth > 0) return;
+
+        if (token.is(',')) {
+            scope.expectEnumerator = true;
+        } else if (token.type == Token::Identifier && scope.expectEnumerator) {
+            define(token, SymbolScanner::Enumerator, QByteArray(), false);
+            scope.expectEnumerator = false;
+        }
+    }
+
+    void bodyToken(const Token &token) {
+        if (token.is('{')) {
+            push(Body, QByteArray(), ContinueStatement);
+        } else if (token.is('}')) {
+            pop(token);
+        }
+    }
+
+    Tokenizer tokenizer;
+    const Lexer::KeywordTable &table;
+    const bool cpp;
+    QVector<Scope> scopes;
+    QSet<QByteArray> identifiers;
+    SymbolScanner::Result result;
+};
+
+} // namespace
+
+SymbolScanner::Result SymbolScanner::scan(const char *data, qint64 size, Lexer::Dialect dialect) {
+    Parser parser(data, size, dialect);
+    return parser.run();
+}
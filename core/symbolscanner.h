@@ -0,0 +1,56 @@
+#ifndef SYMBOLSCANNER_H
+#define SYMBOLSCANNER_H
+
+#pragma once
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+
+#include "highlighter/lexer.h"
+
+// Definitions and identifiers in one C or C++ source file.
+//
+// Not a compiler front end: one pass over the UTF-8 bytes that skips
+// comments, strings and preprocessor lines, keeps track of braces, and
+// recognizes the shapes definitions take at namespace and class scope.
+// Nothing inside a function body is a definition. Macros are not expanded,
+// so code that only makes sense after expansion may be misread; that costs
+// a missing or extra entry, never more.
+class SymbolScanner {
+public:
+    enum Kind : quint8 {
+        Macro,
+        Namespace,
+        Class,
+        Enum,
+        Enumerator,
+        Typedef,
+        Function,
+        Variable
+    };
+
+    struct Definition {
+        QByteArray name;
+        // The class or namespace it belongs to, innermost only; empty at
+        // file scope.
+        QByteArray scope;
+        // Zero based; the column counts UTF-16 units like the editor does.
+        quint32 line = 0;
+        quint32 column = 0;
+        Kind kind = Function;
+        // Declared here and defined elsewhere: prototypes, extern variables,
+        // pure virtual, defaulted and deleted functions.
+        bool declaration = false;
+    };
+
+    struct Result {
+        // In the order they appear.
+        QVector<Definition> definitions;
+        // Every identifier that is not a keyword, once each.
+        QVector<QByteArray> identifiers;
+    };
+
+    static Result scan(const char *data, qint64 size, Lexer::Dialect dialect);
+};
+
+#endif // SYMBOLSCANNER_H
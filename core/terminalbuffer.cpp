@@ -0,0 +1,127 @@
+#include "terminalbuffer.h"
+
+// Slots whose text grew beyond this are released instead of reused, so a
+// few very long lines do not pin their memory for good.
+static const qsizetype ReusableCapacity = 256;
+
+TerminalBuffer::TerminalBuffer(int capacity)
+    : lines(qMax(1, capacity))
+    , first(0)
+    , count(0)
+    , dropped(0)
+    , open(false)
+    , longest(0)
+{
+}
+
+int TerminalBuffer::capacity() const {
+    return int(lines.size());
+}
+
+int TerminalBuffer::lineCount() const {
+    return count;
+}
+
+const TerminalBuffer::Line &TerminalBuffer::line(int index) const {
+    return lines[(first + index) % lines.size()];
+}
+
+qint64 TerminalBuffer::droppedLines() const {
+    return dropped;
+}
+
+int TerminalBuffer::longestLine() const {
+    return longest;
+}
+
+void TerminalBuffer::clear() {
+    for (Line &line : lines) {
+        line.text = QString();
+    }
+    first = 0;
+    count = 0;
+    dropped = 0;
+    open = false;
+    longest = 0;
+}
+
+void TerminalBuffer::append(QStringView text, Style style) {
+    if (text.isEmpty()) return;
+
+    const qsizetype newlines = text.count(u'\n');
+    const qsizetype segments = newlines + (text.endsWith(u'\n') ? 0 : 1);
+    const bool continues = open && count > 0 && line(count - 1).style == style;
+    qsizetype position = 0;
+
+    if (segments > capacity()) {
+        // Nothing held now would survive this batch: drop everything and
+        // skip straight to the segments that will be kept.
+        // The skipped segments are still counted as the lines they would
+        // have wrapped into.
+        const qsizetype skipped = segments - capacity();
+        dropped += count;
+        for (qsizetype i = 0; i < skipped; ++i) {
+            const qsizetype end = text.indexOf(u'\n', position);
+            qsizetype length = end - position;
+            if (i == 0 && continues) length += line(count - 1).text.size();
+
+            const qsizetype wrapped = qMax<qsizetype>(1, (length + MaxLineLength - 1) / MaxLineLength);
+            dropped += wrapped - (i == 0 && continues ? 1 : 0);
+            position = end + 1;
+        }
+        first = 0;
+        count = 0;
+        open = false;
+    }
+
+    bool continuing = continues && position == 0;
+    while (position < text.size()) {
+        qsizetype end = text.indexOf(u'\n', position);
+        const bool terminated = end >= 0;
+        if (!terminated) end = text.size();
+
+        Line *target = continuing ? &lines[(first + count - 1) % lines.size()] : &push(style);
+        appendToLine(target, text.sliced(position, end - position), style);
+
+        open = !terminated;
+        continuing = false;
+        position = end + 1;
+    }
+}
+
+void TerminalBuffer::appendToLine(Line *line, QStringView text, Style style) {
+    for (;;) {
+        const qsizetype room = MaxLineLength - line->text.size();
+        if (text.size() <= room) {
+            line->text.append(text);
+            break;
+        }
+        line->text.append(text.first(room));
+        longest = MaxLineLength;
+        text = text.sliced(room);
+        line = &push(style);
+    }
+    longest = qMax(longest, int(line->text.size()));
+}
+
+TerminalBuffer::Line &TerminalBuffer::push(Style style) {
+    int index;
+    if (count < lines.size()) {
+        index = (first + count) % int(lines.size());
+        ++count;
+    } else {
+        index = first;
+        first = (first + 1) % int(lines.size());
+        ++dropped;
+    }
+
+    Line &line = lines[index];
+    if (line.text.capacity() > ReusableCapacity) {
+        line.text = QString();
+    } else {
+        // Keeps the allocation, so a full ring appends without allocating.
+        line.text.resize(0);
+    }
+    line.style = style;
+    return line;
+}
@@ -0,0 +1,58 @@
+#ifndef TERMINALBUFFER_H
+#define TERMINALBUFFER_H
+
+#pragma once
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+// Scrollback of the terminal panel: a ring of at most capacity lines. Once
+// it is full the oldest line's slot is reused for the newest one, so memory
+// stays flat however much output goes through it.
+//
+// A batch holding more lines than fit is not copied in full; only its last
+// capacity lines are stored and the rest are just counted.
+class TerminalBuffer {
+public:
+    enum Style : quint8 {
+        Output,
+        Error,
+        Warning
+    };
+
+    struct Line {
+        QString text;
+        Style style = Output;
+    };
+
+    explicit TerminalBuffer(int capacity = 10000);
+
+    int capacity() const;
+    int lineCount() const;
+    // Line 0 is the oldest line still held.
+    const Line &line(int index) const;
+
+    // Lines that have scrolled out since the buffer was created or cleared.
+    qint64 droppedLines() const;
+    int longestLine() const;
+
+    // Appends text; an unterminated last line is continued by the next call
+    // with the same style. Lines longer than MaxLineLength are wrapped.
+    void append(QStringView text, Style style);
+    void clear();
+
+    static constexpr int MaxLineLength = 4096;
+
+private:
+    Line &push(Style style);
+    void appendToLine(Line *line, QStringView text, Style style);
+
+    QVector<Line> lines;
+    int first;
+    int count;
+    qint64 dropped;
+    bool open;
+    int longest;
+};
+
+#endif // TERMINALBUFFER_H
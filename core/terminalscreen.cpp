@@ -0,0 +1,676 @@
+#include "terminalscreen.h"
+#include "terminalbuffer.h"
+
+#include <algorithm>
+
+// DEC special graphics for 0x60-0x7e, selected with ESC ( 0.
+static const char16_t LineDrawing[] = {
+    u'◆', u'▒', u'␉', u'␌', u'␍', u'␊', u'°', u'±', u'␤', u'␋', u'┘', u'┐', u'┌', u'└', u'┼', u'⎺',
+    u'⎻', u'─', u'⎼', u'⎽', u'├', u'┤', u'┴', u'┬', u'│', u'≤', u'≥', u'π', u'≠', u'£', u'·'
+};
+
+TerminalScreen::TerminalScreen(TerminalBuffer *scrollback, int columns, int rows)
+    : history(scrollback)
+    , parser(this)
+    , columnCount(qMax(1, columns))
+    , rowCount(qMax(1, rows))
+    , grid(&primary)
+{
+    reset();
+}
+
+TerminalBuffer *TerminalScreen::scrollback() const {
+    return history;
+}
+
+int TerminalScreen::columns() const {
+    return columnCount;
+}
+
+int TerminalScreen::rows() const {
+    return rowCount;
+}
+
+const TerminalScreen::Cell *TerminalScreen::row(int row) const {
+    return grid->cells.constData() + grid->rows[row] * columnCount;
+}
+
+QString TerminalScreen::rowText(int row) const {
+    const Cell *line = this->row(row);
+    int length = columnCount;
+    while (length > 0 && line[length - 1].character == u' ') {
+        --length;
+    }
+
+    QString text(length, Qt::Uninitialized);
+    for (int i = 0; i < length; ++i) {
+        text[i] = QChar(line[i].character);
+    }
+    return text;
+}
+
+int TerminalScreen::cursorX() const {
+    return cursorColumn;
+}
+
+int TerminalScreen::cursorY() const {
+    return cursorRow;
+}
+
+bool TerminalScreen::isCursorVisible() const {
+    return cursorVisible;
+}
+
+bool TerminalScreen::isAlternateScreen() const {
+    return grid == &alternate;
+}
+
+bool TerminalScreen::applicationCursorKeys() const {
+    return cursorKeys;
+}
+
+bool TerminalScreen::bracketedPaste() const {
+    return pasteBrackets;
+}
+
+QString TerminalScreen::title() const {
+    return windowTitle;
+}
+
+void TerminalScreen::feed(QByteArrayView bytes) {
+    parser.feed(bytes);
+}
+
+QByteArray TerminalScreen::takeResponses() {
+    QByteArray taken;
+    taken.swap(responses);
+    return taken;
+}
+
+void TerminalScreen::reset() {
+    grid = &primary;
+    pen = Cell();
+    resetGrid(&primary);
+    resetGrid(&alternate);
+
+    cursorColumn = 0;
+    cursorRow = 0;
+    wrapPending = false;
+    top = 0;
+    bottom = rowCount - 1;
+    saved = SavedCursor();
+    savedPrimary = SavedCursor();
+
+    autoWrap = true;
+    cursorVisible = true;
+    originMode = false;
+    insertMode = false;
+    cursorKeys = false;
+    pasteBrackets = false;
+    lineDrawing = false;
+}
+
+void TerminalScreen::resize(int columns, int rows) {
+    columns = qMax(1, columns);
+    rows = qMax(1, rows);
+    if (columns == columnCount && rows == rowCount) return;
+
+    // When the screen gets shorter the rows above the cursor go first, so
+    // the cursor line stays on screen; on the main screen they move into
+    // the scrollback.
+    const int removed = qMax(0, cursorRow - (rows - 1));
+    const bool onAlternate = grid == &alternate;
+    if (!onAlternate) {
+        for (int row = 0; row < removed; ++row) {
+            pushToScrollback(row);
+        }
+    }
+
+    auto reshape = [&](const Grid &from, int firstRow) {
+        Grid to;
+        to.cells.resize(columns * rows);
+        to.rows.resize(rows);
+        const int copyColumns = qMin(columns, columnCount);
+        for (int row = 0; row < rows; ++row) {
+            to.rows[row] = row;
+            if (firstRow + row >= rowCount) continue;
+            const Cell *source = from.cells.constData() + from.rows[firstRow + row] * columnCount;
+            std::copy(source, source + copyColumns, to.cells.data() + row * columns);
+        }
+        return to;
+    };
+    primary = reshape(primary, onAlternate ? 0 : removed);
+    alternate = reshape(alternate, onAlternate ? removed : 0);
+
+    columnCount = columns;
+    rowCount = rows;
+    top = 0;
+    bottom = rows - 1;
+    cursorColumn = qMin(cursorColumn, columns - 1);
+    cursorRow = qBound(0, cursorRow - removed, rows - 1);
+    saved.column = qMin(saved.column, columns - 1);
+    saved.row = qMin(saved.row, rows - 1);
+    wrapPending = false;
+}
+
+QRgb TerminalScreen::paletteColor(int index) {
+    static const QRgb system[16] = {
+        qRgb(0, 0, 0), qRgb(205, 0, 0), qRgb(0, 205, 0), qRgb(205, 205, 0),
+        qRgb(0, 0, 238), qRgb(205, 0, 205), qRgb(0, 205, 205), qRgb(229, 229, 229),
+        qRgb(127, 127, 127), qRgb(255, 0, 0), qRgb(0, 255, 0), qRgb(255, 255, 0),
+        qRgb(92, 92, 255), qRgb(255, 0, 255), qRgb(0, 255, 255), qRgb(255, 255, 255)
+    };
+
+    index = qBound(0, index, 255);
+    if (index < 16) return system[index];
+    if (index < 232) {
+        // 6x6x6 colour cube.
+        static const int levels[6] = {0, 95, 135, 175, 215, 255};
+        index -= 16;
+        return qRgb(levels[index / 36], levels[index / 6 % 6], levels[index % 6]);
+    }
+    const int gray = 8 + (index - 232) * 10;
+    return qRgb(gray, gray, gray);
+}
+
+TerminalScreen::Cell *TerminalScreen::at(int column, int row) {
+    return grid->cells.data() + grid->rows[row] * columnCount + column;
+}
+
+void TerminalScreen::resetGrid(Grid *target) const {
+    target->cells.fill(Cell(), columnCount * rowCount);
+    target->rows.resize(rowCount);
+    for (int row = 0; row < rowCount; ++row) {
+        target->rows[row] = row;
+    }
+}
+
+TerminalScreen::Cell TerminalScreen::blank() const {
+    // Erased cells take the current background, as in xterm.
+    Cell cell;
+    cell.attributes = DefaultForeground | (pen.attributes & DefaultBackground);
+    cell.background = pen.background;
+    return cell;
+}
+
+void TerminalScreen::fill(int column, int row, int count) {
+    count = qMin(count, columnCount - column);
+    if (count <= 0) return;
+    Cell *first = at(column, row);
+    std::fill(first, first + count, blank());
+}
+
+void TerminalScreen::fillRows(int first, int last) {
+    for (int row = first; row <= last; ++row) {
+        fill(0, row, columnCount);
+    }
+}
+
+void TerminalScreen::pushToScrollback(int row) {
+    const Cell *line = this->row(row);
+    int length = columnCount;
+    while (length > 0 && line[length - 1].character == u' ') {
+        --length;
+    }
+
+    // Built in a buffer kept between calls; the scrollback copies it.
+    lineText.resize(length + 1);
+    QChar *out = lineText.data();
+    for (int i = 0; i < length; ++i) {
+        out[i] = QChar(line[i].character);
+    }
+    out[length] = QLatin1Char('\n');
+    history->append(lineText, TerminalBuffer::Output);
+}
+
+void TerminalScreen::scrollUp(int first, int last, int count) {
+    if (first == 0 && grid == &primary) {
+        for (int row = 0; row < qMin(count, last + 1); ++row) {
+            pushToScrollback(row);
+        }
+    }
+    deleteRows(first, last, count);
+}
+
+void TerminalScreen::deleteRows(int first, int last, int count) {
+    count = qMin(count, last - first + 1);
+    if (count <= 0) return;
+
+    int *rows = grid->rows.data();
+    std::rotate(rows + first, rows + first + count, rows + last + 1);
+    fillRows(last - count + 1, last);
+}
+
+void TerminalScreen::scrollDown(int first, int last, int count) {
+    count = qMin(count, last - first + 1);
+    if (count <= 0) return;
+
+    int *rows = grid->rows.data();
+    std::rotate(rows + first, rows + last + 1 - count, rows + last + 1);
+    fillRows(first, first + count - 1);
+}
+
+void TerminalScreen::lineFeed() {
+    if (cursorRow == bottom) {
+        scrollUp(top, bottom, 1);
+    } else if (cursorRow < rowCount - 1) {
+        ++cursorRow;
+    }
+    wrapPending = false;
+}
+
+void TerminalScreen::reverseIndex() {
+    if (cursorRow == top) {
+        scrollDown(top, bottom, 1);
+    } else if (cursorRow > 0) {
+        --cursorRow;
+    }
+    wrapPending = false;
+}
+
+void TerminalScreen::moveCursor(int column, int row) {
+    const int minRow = originMode ? top : 0;
+    const int maxRow = originMode ? bottom : rowCount - 1;
+    cursorColumn = qBound(0, column, columnCount - 1);
+    cursorRow = qBound(minRow, row, maxRow);
+    wrapPending = false;
+}
+
+void TerminalScreen::print(QStringView text) {
+    for (QChar ch : text) {
+        char16_t character = ch.unicode();
+        if (lineDrawing && character >= 0x60 && character <= 0x7e) {
+            character = LineDrawing[character - 0x60];
+        }
+
+        if (wrapPending && autoWrap) {
+            cursorColumn = 0;
+            lineFeed();
+        }
+        wrapPending = false;
+
+        Cell *cell = at(cursorColumn, cursorRow);
+        if (insertMode) {
+            std::copy_backward(cell, at(columnCount - 1, cursorRow), at(columnCount - 1, cursorRow) + 1);
+        }
+        *cell = pen;
+        cell->character = character;
+
+        if (cursorColumn == columnCount - 1) {
+            wrapPending = true;
+        } else {
+            ++cursorColumn;
+        }
+    }
+}
+
+void TerminalScreen::execute(char control) {
+    switch (control) {
+    case '\b':
+        if (cursorColumn > 0) --cursorColumn;
+        wrapPending = false;
+        break;
+    case '\t':
+        cursorColumn = qMin(columnCount - 1, (cursorColumn / 8 + 1) * 8);
+        wrapPending = false;
+        break;
+    case '\n':
+    case '\v':
+    case '\f':
+        lineFeed();
+        break;
+    case '\r':
+        cursorColumn = 0;
+        wrapPending = false;
+        break;
+    default:
+        break;
+    }
+}
+
+void TerminalScreen::escDispatch(QByteArrayView intermediates, char final) {
+    if (intermediates == "(") {
+        lineDrawing = final == '0';
+        return;
+    }
+    if (!intermediates.isEmpty()) return;
+
+    switch (final) {
+    case '7':
+        saveCursor();
+        break;
+    case '8':
+        restoreCursor();
+        break;
+    case 'D':
+        lineFeed();
+        break;
+    case 'E':
+        cursorColumn = 0;
+        lineFeed();
+        break;
+    case 'M':
+        reverseIndex();
+        break;
+    case 'c':
+        reset();
+        break;
+    default:
+        break;
+    }
+}
+
+void TerminalScreen::csiDispatch(const VtParser::Params &params, QByteArrayView intermediates, char final) {
+    const char marker = intermediates.isEmpty() ? 0 : intermediates.front();
+    const bool isPrivate = marker == '?';
+    const int n = qMax(1, params.value(0, 1));
+
+    if (marker == '>') {
+        if (final == 'c') responses += "\x1b[>0;10;1c";
+        return;
+    }
+    if (marker && !isPrivate) return;
+    if (intermediates.size() > (isPrivate ? 1 : 0)) return;
+
+    if (final == 'h' || final == 'l') {
+        for (int i = 0; i < params.count; ++i) {
+            setMode(params.value(i, 0), isPrivate, final == 'h');
+        }
+        return;
+    }
+    if (isPrivate) return;
+
+    switch (final) {
+    case '@': {
+        const int count = qMin(n, columnCount - cursorColumn);
+        Cell *cell = at(cursorColumn, cursorRow);
+        Cell *end = at(0, cursorRow) + columnCount;
+        std::copy_backward(cell, end - count, end);
+        fill(cursorColumn, cursorRow, count);
+        break;
+    }
+    case 'A':
+        moveCursor(cursorColumn, qMax(cursorRow >= top ? top : 0, cursorRow - n));
+        break;
+    case 'B':
+    case 'e':
+        moveCursor(cursorColumn, qMin(cursorRow <= bottom ? bottom : rowCount - 1, cursorRow + n));
+        break;
+    case 'C':
+    case 'a':
+        moveCursor(cursorColumn + n, cursorRow);
+        break;
+    case 'D':
+        moveCursor(cursorColumn - n, cursorRow);
+        break;
+    case 'E':
+        moveCursor(0, qMin(cursorRow <= bottom ? bottom : rowCount - 1, cursorRow + n));
+        break;
+    case 'F':
+        moveCursor(0, qMax(cursorRow >= top ? top : 0, cursorRow - n));
+        break;
+    case 'G':
+    case '`':
+        moveCursor(n - 1, cursorRow);
+        break;
+    case 'H':
+    case 'f':
+        moveCursor(qMax(1, params.value(1, 1)) - 1, (originMode ? top : 0) + n - 1);
+        break;
+    case 'd':
+        moveCursor(cursorColumn, (originMode ? top : 0) + n - 1);
+        break;
+    case 'J':
+        switch (params.value(0, 0)) {
+        case 0:
+            fill(cursorColumn, cursorRow, columnCount);
+            fillRows(cursorRow + 1, rowCount - 1);
+            break;
+        case 1:
+            fillRows(0, cursorRow - 1);
+            fill(0, cursorRow, cursorColumn + 1);
+            break;
+        case 2:
+            fillRows(0, rowCount - 1);
+            break;
+        case 3:
+            history->clear();
+            break;
+        }
+        break;
+    case 'K':
+        switch (params.value(0, 0)) {
+        case 0:
+            fill(cursorColumn, cursorRow, columnCount);
+            break;
+        case 1:
+            fill(0, cursorRow, cursorColumn + 1);
+            break;
+        case 2:
+            fill(0, cursorRow, columnCount);
+            break;
+        }
+        break;
+    case 'L':
+        if (cursorRow >= top && cursorRow <= bottom) {
+            scrollDown(cursorRow, bottom, n);
+            cursorColumn = 0;
+        }
+        break;
+    case 'M':
+        if (cursorRow >= top && cursorRow <= bottom) {
+            // Deleted lines are gone, not scrolled into the scrollback.
+            deleteRows(cursorRow, bottom, n);
+            cursorColumn = 0;
+        }
+        break;
+    case 'P': {
+        const int count = qMin(n, columnCount - cursorColumn);
+        Cell *cell = at(cursorColumn, cursorRow);
+        std::copy(cell + count, at(0, cursorRow) + columnCount, cell);
+        fill(columnCount - count, cursorRow, count);
+        break;
+    }
+    case 'S':
+        scrollUp(top, bottom, n);
+        break;
+    case 'T':
+        scrollDown(top, bottom, n);
+        break;
+    case 'X':
+        fill(cursorColumn, cursorRow, n);
+        break;
+    case 'm':
+        selectGraphicRendition(params);
+        break;
+    case 'n':
+        if (params.value(0, 0) == 5) {
+            responses += "\x1b[0n";
+        } else if (params.value(0, 0) == 6) {
+            const int row = cursorRow + 1 - (originMode ? top : 0);
+            responses += "\x1b[" + QByteArray::number(row) + ';'
+                       + QByteArray::number(cursorColumn + 1) + 'R';
+        }
+        break;
+    case 'c':
+        responses += "\x1b[?1;2c";
+        break;
+    case 'r': {
+        const int first = qMax(1, params.value(0, 1)) - 1;
+        const int last = params.value(1, 0) > 0 ? params.value(1, 0) - 1 : rowCount - 1;
+        if (first < last && last < rowCount) {
+            top = first;
+            bottom = last;
+            moveCursor(0, originMode ? top : 0);
+        }
+        break;
+    }
+    case 's':
+        saveCursor();
+        break;
+    case 'u':
+        restoreCursor();
+        break;
+    default:
+        break;
+    }
+}
+
+void TerminalScreen::oscDispatch(QByteArrayView data) {
+    // 0 and 2 set the window title, which shells use to show the current
+    // command or directory.
+    const qsizetype separator = data.indexOf(';');
+    if (separator < 0) return;
+
+    const QByteArrayView command = data.first(separator);
+    if (command == "0" || command == "2") {
+        windowTitle = QString::fromUtf8(data.sliced(separator + 1));
+    }
+}
+
+void TerminalScreen::setMode(int mode, bool isPrivate, bool enabled) {
+    if (!isPrivate) {
+        if (mode == 4) insertMode = enabled;
+        return;
+    }
+
+    switch (mode) {
+    case 1:
+        cursorKeys = enabled;
+        break;
+    case 6:
+        originMode = enabled;
+        moveCursor(0, originMode ? top : 0);
+        break;
+    case 7:
+        autoWrap = enabled;
+        break;
+    case 25:
+        cursorVisible = enabled;
+        break;
+    case 47:
+    case 1047:
+        setAlternateScreen(enabled);
+        break;
+    case 1049:
+        // Saves the cursor, switches and clears; restores on the way back.
+        if (enabled) {
+            savedPrimary = {cursorColumn, cursorRow, pen, lineDrawing};
+            setAlternateScreen(true);
+        } else {
+            setAlternateScreen(false);
+            cursorColumn = qMin(savedPrimary.column, columnCount - 1);
+            cursorRow = qMin(savedPrimary.row, rowCount - 1);
+            pen = savedPrimary.pen;
+            lineDrawing = savedPrimary.lineDrawing;
+        }
+        break;
+    case 2004:
+        pasteBrackets = enabled;
+        break;
+    default:
+        break;
+    }
+}
+
+void TerminalScreen::setAlternateScreen(bool enabled) {
+    if (enabled == isAlternateScreen()) return;
+
+    grid = enabled ? &alternate : &primary;
+    if (enabled) {
+        fillRows(0, rowCount - 1);
+    }
+    wrapPending = false;
+}
+
+void TerminalScreen::selectGraphicRendition(const VtParser::Params &params) {
+    if (params.count == 0) {
+        pen = Cell();
+        return;
+    }
+
+    for (int i = 0; i < params.count; ++i) {
+        const int code = params.value(i, 0);
+        switch (code) {
+        case 0:
+            pen = Cell();
+            break;
+        case 1:
+            pen.attributes |= Bold;
+            break;
+        case 3:
+            pen.attributes |= Italic;
+            break;
+        case 4:
+            pen.attributes |= Underline;
+            break;
+        case 7:
+            pen.attributes |= Inverse;
+            break;
+        case 22:
+            pen.attributes &= ~Bold;
+            break;
+        case 23:
+            pen.attributes &= ~Italic;
+            break;
+        case 24:
+            pen.attributes &= ~Underline;
+            break;
+        case 27:
+            pen.attributes &= ~Inverse;
+            break;
+        case 39:
+            pen.attributes |= DefaultForeground;
+            pen.foreground = 0;
+            break;
+        case 49:
+            pen.attributes |= DefaultBackground;
+            pen.background = 0;
+            break;
+        case 38:
+        case 48: {
+            // 38;5;n picks from the palette, 38;2;r;g;b is true colour.
+            QRgb color;
+            if (params.value(i + 1, 0) == 5) {
+                color = paletteColor(params.value(i + 2, 0));
+                i += 2;
+            } else if (params.value(i + 1, 0) == 2) {
+                color = qRgb(qMin(params.value(i + 2, 0), 255), qMin(params.value(i + 3, 0), 255),
+                             qMin(params.value(i + 4, 0), 255));
+                i += 4;
+            } else {
+                return;
+            }
+            if (code == 38) {
+                pen.attributes &= ~DefaultForeground;
+                pen.foreground = color;
+            } else {
+                pen.attributes &= ~DefaultBackground;
+                pen.background = color;
+            }
+            break;
+        }
+        default:
+            if ((code >= 30 && code <= 37) || (code >= 90 && code <= 97)) {
+                pen.attributes &= ~DefaultForeground;
+                pen.foreground = paletteColor(code >= 90 ? code - 90 + 8 : code - 30);
+            } else if ((code >= 40 && code <= 47) || (code >= 100 && code <= 107)) {
+                pen.attributes &= ~DefaultBackground;
+                pen.background = paletteColor(code >= 100 ? code - 100 + 8 : code - 40);
+            }
+            break;
+        }
+    }
+}
+
+void TerminalScreen::saveCursor() {
+    saved = {cursorColumn, cursorRow, pen, lineDrawing};
+}
+
+void TerminalScreen::restoreCursor() {
+    cursorColumn = qMin(saved.column, columnCount - 1);
+    cursorRow = qMin(saved.row, rowCount - 1);
+    pen = saved.pen;
+    lineDrawing = saved.lineDrawing;
+    wrapPending = false;
+}
@@ -0,0 +1,143 @@
+#ifndef TERMINALSCREEN_H
+#define TERMINALSCREEN_H
+
+#pragma once
+#include <QByteArray>
+#include <QRgb>
+#include <QString>
+#include <QVector>
+
+#include "vtparser.h"
+
+class TerminalBuffer;
+
+// The visible part of a terminal: a grid of cells, each with its own
+// character, colours and attributes, driven by VtParser. Supports what
+// shells and common full-screen tools use from xterm: cursor movement,
+// erasing, scroll regions, insert/delete, 256-colour and true-colour SGR,
+// the alternate screen, DEC line drawing and status reports.
+//
+// Rows scrolled off the top of the main screen are moved into the
+// scrollback as plain text.
+class TerminalScreen : public VtParser::Handler {
+public:
+    enum Attribute : quint16 {
+        Bold = 1,
+        Italic = 2,
+        Underline = 4,
+        Inverse = 8,
+        DefaultForeground = 16,
+        DefaultBackground = 32
+    };
+
+    struct Cell {
+        char16_t character = u' ';
+        quint16 attributes = DefaultForeground | DefaultBackground;
+        QRgb foreground = 0;
+        QRgb background = 0;
+
+        bool sameStyle(const Cell &other) const {
+            return attributes == other.attributes && foreground == other.foreground
+                && background == other.background;
+        }
+    };
+
+    explicit TerminalScreen(TerminalBuffer *scrollback, int columns = 80, int rows = 24);
+
+    TerminalBuffer *scrollback() const;
+
+    int columns() const;
+    int rows() const;
+    const Cell *row(int y) const;
+    // Text of row y without trailing blanks.
+    QString rowText(int y) const;
+
+    int cursorX() const;
+    int cursorY() const;
+    bool isCursorVisible() const;
+    bool isAlternateScreen() const;
+    bool applicationCursorKeys() const;
+    bool bracketedPaste() const;
+    QString title() const;
+
+    void feed(QByteArrayView bytes);
+    void resize(int columns, int rows);
+    void reset();
+
+    // Replies the program asked for (cursor position, device attributes),
+    // to be written back to it.
+    QByteArray takeResponses();
+
+    static QRgb paletteColor(int index);
+
+    void print(QStringView text) override;
+    void execute(char control) override;
+    void csiDispatch(const VtParser::Params &params, QByteArrayView intermediates, char final) override;
+    void escDispatch(QByteArrayView intermediates, char final) override;
+    void oscDispatch(QByteArrayView data) override;
+
+private:
+    // Rows are reached through an index, so scrolling rotates the index
+    // instead of moving every cell on screen.
+    struct Grid {
+        QVector<Cell> cells;
+        QVector<int> rows;
+    };
+
+    struct SavedCursor {
+        int column = 0;
+        int row = 0;
+        Cell pen;
+        bool lineDrawing = false;
+    };
+
+    Cell *at(int column, int row);
+    Cell blank() const;
+    void fill(int column, int row, int count);
+    void fillRows(int first, int last);
+    void lineFeed();
+    void reverseIndex();
+    void scrollUp(int first, int last, int count);
+    void scrollDown(int first, int last, int count);
+    void deleteRows(int first, int last, int count);
+    void resetGrid(Grid *target) const;
+    void pushToScrollback(int row);
+    void moveCursor(int column, int row);
+    void setMode(int mode, bool isPrivate, bool enabled);
+    void setAlternateScreen(bool enabled);
+    void selectGraphicRendition(const VtParser::Params &params);
+    void saveCursor();
+    void restoreCursor();
+
+    TerminalBuffer *history;
+    VtParser parser;
+
+    int columnCount;
+    int rowCount;
+    Grid primary;
+    Grid alternate;
+    Grid *grid;
+
+    int cursorColumn;
+    int cursorRow;
+    bool wrapPending;
+    int top;
+    int bottom;
+    Cell pen;
+    SavedCursor saved;
+    SavedCursor savedPrimary;
+
+    bool autoWrap;
+    bool cursorVisible;
+    bool originMode;
+    bool insertMode;
+    bool cursorKeys;
+    bool pasteBrackets;
+    bool lineDrawing;
+
+    QByteArray responses;
+    QString windowTitle;
+    QString lineText;
+};
+
+#endif // TERMINALSCREEN_H
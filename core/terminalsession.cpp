@@ -0,0 +1,173 @@
+#include "terminalsession.h"
+#include "ptyprocess.h"
+
+#include <QFileInfo>
+
+static const int ScrollbackLines = 10000;
+
+TerminalSession::TerminalSession(Kind kind, const QString &command, QObject *parent)
+    : QObject(parent)
+    , sessionKind(kind)
+    , jobCommand(command)
+    , scrollback(ScrollbackLines)
+    , grid(&scrollback)
+    , process(new PtyProcess(this))
+    , exited(false)
+    , lastExitCode(0)
+{
+    connect(process, &PtyProcess::dataReceived, this, &TerminalSession::onOutput);
+    connect(process, &PtyProcess::finished, this, &TerminalSession::onFinished);
+}
+
+TerminalSession::~TerminalSession() {
+    // Hung up before the screen it writes to goes away.
+    delete process;
+}
+
+TerminalSession::Kind TerminalSession::kind() const {
+    return sessionKind;
+}
+
+QString TerminalSession::command() const {
+    return jobCommand;
+}
+
+TerminalScreen *TerminalSession::screen() {
+    return &grid;
+}
+
+bool TerminalSession::start(const QString &workingDirectory, int columns, int rows) {
+    if (process->isRunning()) return true;
+
+#ifdef Q_OS_WIN
+    const QString shell = "cmd.exe";
+    const QStringList arguments = sessionKind == Job ? QStringList{"/c", jobCommand} : QStringList();
+#else
+    const QString shell = qEnvironmentVariable("SHELL", "/bin/sh");
+    const QStringList arguments = sessionKind == Job ? QStringList{"-c", jobCommand} : QStringList();
+#endif
+
+    if (!process->start(shell, arguments, workingDirectory, columns, rows)) {
+        appendMessage("Could not start " + shell, TerminalBuffer::Error);
+        return false;
+    }
+    exited = false;
+    return true;
+}
+
+bool TerminalSession::isRunning() const {
+    return process->isRunning();
+}
+
+TerminalSession::Status TerminalSession::status() const {
+    if (process->isRunning()) {
+        return sessionKind == Job || process->isBusy() ? Running : Idle;
+    }
+    if (!exited) return Idle;
+    return lastExitCode == 0 ? Succeeded : Failed;
+}
+
+int TerminalSession::exitCode() const {
+    return lastExitCode;
+}
+
+QString TerminalSession::label() const {
+    if (sessionKind == Job) {
+        return jobCommand;
+    }
+    const QString foreground = process->foregroundCommand();
+    if (!foreground.isEmpty()) {
+        return foreground;
+    }
+    if (!grid.title().isEmpty()) {
+        return grid.title();
+    }
+#ifdef Q_OS_WIN
+    return "cmd";
+#else
+    return QFileInfo(qEnvironmentVariable("SHELL", "sh")).fileName();
+#endif
+}
+
+void TerminalSession::write(const QByteArray &bytes) {
+    process->write(bytes);
+}
+
+void TerminalSession::resize(int columns, int rows) {
+    flush();
+    grid.resize(columns, rows);
+    process->resize(columns, rows);
+}
+
+void TerminalSession::interrupt() {
+    process->write("\x03");
+}
+
+void TerminalSession::terminate() {
+    process->terminate();
+}
+
+bool TerminalSession::hasPendingOutput() const {
+    return !pendingOutput.isEmpty();
+}
+
+void TerminalSession::flush() {
+    if (pendingOutput.isEmpty()) return;
+
+    grid.feed(pendingOutput);
+    pendingOutput.clear();
+
+    // Status reports and the like the program asked for.
+    const QByteArray responses = grid.takeResponses();
+    if (!responses.isEmpty()) {
+        process->write(responses);
+    }
+}
+
+void TerminalSession::clear() {
+    pendingOutput.clear();
+    grid.feed("\x1b[H\x1b[2J\x1b[3J");
+}
+
+void TerminalSession::appendMessage(const QString &text, TerminalBuffer::Style style) {
+    // Messages of our own go after whatever output is still queued, on a
+    // line of their own.
+    flush();
+
+    QByteArray bytes = grid.cursorX() > 0 ? "\r\n" : "";
+    if (style == TerminalBuffer::Error) {
+        bytes += "\x1b[31m";
+    } else if (style == TerminalBuffer::Warning) {
+        bytes += "\x1b[33m";
+    }
+    bytes += text.toUtf8().replace('\n', "\r\n");
+    bytes += "\x1b[0m\r\n";
+    grid.feed(bytes);
+}
+
+void TerminalSession::onOutput(const QByteArray &bytes) {
+    const bool wasEmpty = pendingOutput.isEmpty();
+    if (wasEmpty) {
+        pendingOutput = bytes;
+    } else {
+        pendingOutput += bytes;
+    }
+
+    if (wasEmpty) {
+        emit outputPending();
+    }
+}
+
+void TerminalSession::onFinished(int exitCode, bool crashed) {
+    exited = true;
+    lastExitCode = exitCode;
+
+    if (crashed) {
+        appendMessage(QString("Process crashed (%1)").arg(exitCode), TerminalBuffer::Error);
+    } else if (exitCode != 0) {
+        appendMessage(QString("Process exited with code %1").arg(exitCode), TerminalBuffer::Warning);
+    } else {
+        appendMessage("Process exited", TerminalBuffer::Output);
+    }
+    emit finished(exitCode, crashed);
+}
@@ -0,0 +1,89 @@
+#ifndef TERMINALSESSION_H
+#define TERMINALSESSION_H
+
+#pragma once
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include "terminalbuffer.h"
+#include "terminalscreen.h"
+
+class PtyProcess;
+
+// One terminal: a process on its own pseudo-terminal, with the screen and
+// scrollback its output is drawn into.
+//
+// A Shell session runs an interactive shell and is started again when
+// something is typed after it exited. A Job session runs one command and
+// keeps its output and exit status once it is done.
+//
+// Output is queued as it arrives and fed to the screen by flush(), which
+// the owner calls once per frame for every session with output pending.
+class TerminalSession : public QObject {
+    Q_OBJECT
+
+public:
+    enum Kind {
+        Shell,
+        Job
+    };
+
+    enum Status {
+        Idle,
+        Running,
+        Succeeded,
+        Failed
+    };
+
+    TerminalSession(Kind kind, const QString &command, QObject *parent = nullptr);
+    ~TerminalSession() override;
+
+    Kind kind() const;
+    QString command() const;
+    TerminalScreen *screen();
+
+    bool start(const QString &workingDirectory, int columns, int rows);
+    bool isRunning() const;
+
+    // Idle is a shell waiting at its prompt; Running a job, or a shell
+    // running a command.
+    Status status() const;
+    int exitCode() const;
+    // A short name for tabs: the job's command or what the shell runs.
+    QString label() const;
+
+    void write(const QByteArray &bytes);
+    void resize(int columns, int rows);
+    // ^C through the terminal: SIGINT for the job in the foreground.
+    void interrupt();
+    void terminate();
+
+    bool hasPendingOutput() const;
+    void flush();
+    // Empties the screen and the scrollback; modes the program set stay.
+    void clear();
+    // A line of our own, coloured by style.
+    void appendMessage(const QString &text, TerminalBuffer::Style style);
+
+signals:
+    // Output arrived while none was pending.
+    void outputPending();
+    void finished(int exitCode, bool crashed);
+
+private slots:
+    void onOutput(const QByteArray &bytes);
+    void onFinished(int exitCode, bool crashed);
+
+private:
+    Kind sessionKind;
+    QString jobCommand;
+    TerminalBuffer scrollback;
+    TerminalScreen grid;
+    PtyProcess *process;
+    QByteArray pendingOutput;
+    bool exited;
+    int lastExitCode;
+};
+
+#endif // TERMINALSESSION_H
@@ -0,0 +1,710 @@
+#include "textbuffer.h"
+#include "mappedfile.h"
+
+#include <QIODevice>
+#include <QtEndian>
+#include <atomic>
+#include <cstring>
+#include <unordered_set>
+
+// Gaps between replaced ranges shorter than this are copied rather than
+// kept as pieces of their own.
+static const qint64 ReplaceCopyBytes = 256;
+
+static std::atomic<quint64> lastRevision{0};
+
+TextBuffer::TextBuffer()
+    : seed(0x9E3779B9u)
+    , edits(0)
+{
+}
+
+TextBuffer::TextBuffer(const QByteArray &original)
+    : seed(0x9E3779B9u)
+    , edits(0)
+{
+    if (original.isEmpty()) return;
+
+    // The shared copy is never modified, so its data pointer stays valid for
+    // as long as any piece refers to it.
+    auto owner = std::make_shared<const QByteArray>(original);
+    const char *data = owner->constData();
+    const qint64 total = owner->size();
+
+    std::vector<Piece> pieces;
+    pieces.reserve(size_t(total / MaxPieceSize + 1));
+    for (qint64 offset = 0; offset < total; offset += MaxPieceSize) {
+        Piece piece;
+        piece.data = data + offset;
+        piece.length = qMin(MaxPieceSize, total - offset);
+        piece.newlines = countNewlines(piece.data, piece.length);
+        piece.owner = owner;
+        pieces.push_back(piece);
+    }
+    root = build(pieces, 0, pieces.size(), 0);
+}
+
+TextBuffer::TextBuffer(const std::shared_ptr<MappedFile> &original)
+    : seed(0x9E3779B9u)
+    , edits(0)
+{
+    const qint64 total = original->size();
+    const char *data = original->data();
+
+    // One piece per index block, so the newline counts come straight from
+    // the line index and the file is not scanned again.
+    std::vector<Piece> pieces;
+    pieces.reserve(size_t(total / MaxPieceSize + 1));
+    for (qint64 offset = 0; offset < total; offset += MaxPieceSize) {
+        Piece piece;
+        piece.data = data + offset;
+        piece.length = qMin(MaxPieceSize, total - offset);
+        piece.newlines = original->countNewlines(offset, offset + piece.length);
+        piece.owner = original;
+        pieces.push_back(piece);
+    }
+    root = build(pieces, 0, pieces.size(), 0);
+}
+
+qint64 TextBuffer::size() const {
+    return bytesOf(root);
+}
+
+qint64 TextBuffer::lineCount() const {
+    return newlinesOf(root) + 1;
+}
+
+int TextBuffer::pieceCount() const {
+    int count = 0;
+    forEachSpan(0, size(), [&count](const char *, qint64) {
+        ++count;
+        return true;
+    });
+    return count;
+}
+
+qint64 TextBuffer::bytesNotIn(const TextBuffer &other) const {
+    std::vector<Piece> theirs;
+    collect(other.root.get(), &theirs);
+    std::unordered_set<const void*> owners;
+    for (const Piece &piece : theirs) owners.insert(piece.owner.get());
+
+    std::vector<Piece> ours;
+    collect(root.get(), &ours);
+    qint64 bytes = 0;
+    for (const Piece &piece : ours) {
+        if (owners.count(piece.owner.get()) == 0) bytes += piece.length;
+    }
+    return bytes;
+}
+
+quint64 TextBuffer::revision() const {
+    return edits;
+}
+
+namespace {
+
+const quint64 Prime1 = 0x9E3779B185EBCA87ull;
+const quint64 Prime2 = 0xC2B2AE3D27D4EB4Full;
+const quint64 Prime3 = 0x165667B19E3779F9ull;
+const quint64 Prime4 = 0x85EBCA77C2B2AE63ull;
+const quint64 Prime5 = 0x27D4EB2F165667C5ull;
+
+inline quint64 rotateLeft(quint64 value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline quint64 read64(const char *data) {
+    quint64 value;
+    std::memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+inline quint32 read32(const char *data) {
+    quint32 value;
+    std::memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+inline quint64 round(quint64 accumulator, quint64 input) {
+    accumulator += input * Prime2;
+    return rotateLeft(accumulator, 31) * Prime1;
+}
+
+inline quint64 mergeRound(quint64 accumulator, quint64 value) {
+    accumulator ^= round(0, value);
+    return accumulator * Prime1 + Prime4;
+}
+
+// Streaming XXH64 (seed 0), fed one piece at a time.
+class Hasher {
+public:
+    void update(const char *data, qint64 length) {
+        total += quint64(length);
+        const char *end = data + length;
+
+        if (pending > 0) {
+            const qint64 take = qMin<qint64>(32 - pending, length);
+            std::memcpy(stripe + pending, data, size_t(take));
+            pending += int(take);
+            data += take;
+            if (pending < 32) return;
+            consume(stripe);
+            pending = 0;
+        }
+
+        while (end - data >= 32) {
+            consume(data);
+            data += 32;
+        }
+
+        pending = int(end - data);
+        std::memcpy(stripe, data, size_t(pending));
+    }
+
+    quint64 finish() const {
+        quint64 hash;
+        if (total >= 32) {
+            hash = rotateLeft(v[0], 1) + rotateLeft(v[1], 7) + rotateLeft(v[2], 12) + rotateLeft(v[3], 18);
+            for (quint64 lane : v) {
+                hash = mergeRound(hash, lane);
+            }
+        } else {
+            hash = Prime5;
+        }
+        hash += total;
+
+        const char *data = stripe;
+        const char *end = stripe + pending;
+        for (; end - data >= 8; data += 8) {
+            hash ^= round(0, read64(data));
+            hash = rotateLeft(hash, 27) * Prime1 + Prime4;
+        }
+        if (end - data >= 4) {
+            hash ^= quint64(read32(data)) * Prime1;
+            hash = rotateLeft(hash, 23) * Prime2 + Prime3;
+            data += 4;
+        }
+        for (; data < end; ++data) {
+            hash ^= quint64(uchar(*data)) * Prime5;
+            hash = rotateLeft(hash, 11) * Prime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= Prime2;
+        hash ^= hash >> 29;
+        hash *= Prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+private:
+    void consume(const char *data) {
+        for (int lane = 0; lane < 4; ++lane) {
+            v[lane] = round(v[lane], read64(data + lane * 8));
+        }
+    }
+
+    quint64 v[4] = {Prime1 + Prime2, Prime2, 0, 0 - Prime1};
+    char stripe[32];
+    int pending = 0;
+    quint64 total = 0;
+};
+
+} // namespace
+
+quint64 TextBuffer::contentHash() const {
+    Hasher hasher;
+    forEachSpan(0, size(), [&hasher](const char *data, qint64 length) {
+        hasher.update(data, length);
+        return true;
+    });
+    return hasher.finish();
+}
+
+quint64 TextBuffer::hashOf(const char *data, qint64 length) {
+    Hasher hasher;
+    hasher.update(data, length);
+    return hasher.finish();
+}
+
+qint64 TextBuffer::lineStart(qint64 line) const {
+    if (line <= 0) return 0;
+    if (line > newlinesOf(root)) return size();
+
+    const Node *node = root.get();
+    qint64 remaining = line;
+    qint64 position = 0;
+
+    while (node) {
+        const qint64 leftNewlines = newlinesOf(node->left);
+        if (remaining <= leftNewlines) {
+            node = node->left.get();
+            continue;
+        }
+
+        remaining -= leftNewlines;
+        position += bytesOf(node->left);
+
+        const Piece &piece = node->piece;
+        if (remaining <= piece.newlines) {
+            const char *begin = piece.data;
+            const char *end = piece.data + piece.length;
+            while (begin < end) {
+                const char *hit = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+                if (--remaining == 0) {
+                    return position + (hit - piece.data) + 1;
+                }
+                begin = hit + 1;
+            }
+        }
+
+        remaining -= piece.newlines;
+        position += piece.length;
+        node = node->right.get();
+    }
+
+    return size();
+}
+
+qint64 TextBuffer::lineAt(qint64 offset) const {
+    offset = qBound<qint64>(0, offset, size());
+
+    const Node *node = root.get();
+    qint64 lines = 0;
+
+    while (node) {
+        const qint64 leftBytes = bytesOf(node->left);
+        if (offset < leftBytes) {
+            node = node->left.get();
+            continue;
+        }
+
+        lines += newlinesOf(node->left);
+        offset -= leftBytes;
+
+        if (offset < node->piece.length) {
+            return lines + countNewlines(node->piece.data, offset);
+        }
+
+        lines += node->piece.newlines;
+        offset -= node->piece.length;
+        node = node->right.get();
+    }
+
+    return lines;
+}
+
+void TextBuffer::insert(qint64 offset, const char *data, qint64 length) {
+    if (length <= 0) return;
+    offset = qBound<qint64>(0, offset, size());
+
+    std::vector<Piece> pieces = append(data, length);
+
+    NodePtr right;
+    NodePtr left = split(root, offset, &right);
+
+    // Typing appends to the add buffer right behind the previous keystroke,
+    // so the piece before the cursor can usually just grow.
+    size_t first = 0;
+    const Piece *last = lastPiece(left);
+    if (last && last->owner == pieces.front().owner
+        && last->data + last->length == pieces.front().data
+        && last->length + pieces.front().length <= MaxPieceSize) {
+        left = extendLast(left, pieces.front());
+        first = 1;
+    }
+
+    NodePtr middle;
+    if (pieces.size() - first == 1) {
+        middle = makeNode(nullptr, pieces[first], nullptr, nextPriority());
+    } else {
+        middle = build(pieces, first, pieces.size(), 0);
+    }
+
+    root = merge(merge(left, middle), right);
+    edits = ++lastRevision;
+}
+
+void TextBuffer::insert(qint64 offset, const QByteArray &bytes) {
+    insert(offset, bytes.constData(), bytes.size());
+}
+
+void TextBuffer::remove(qint64 offset, qint64 length) {
+    offset = qBound<qint64>(0, offset, size());
+    length = qMin(length, size() - offset);
+    if (length <= 0) return;
+
+    NodePtr tail;
+    NodePtr head = split(root, offset, &tail);
+    NodePtr rest;
+    split(tail, length, &rest);
+    root = merge(head, rest);
+    edits = ++lastRevision;
+}
+
+void TextBuffer::replace(const std::function<bool(Replacement *replacement)> &next) {
+    Replacement replacement;
+    if (!next(&replacement)) return;
+
+    std::vector<Piece> source;
+    collect(root.get(), &source);
+
+    std::vector<Piece> pieces;
+    pieces.reserve(source.size());
+
+    const qint64 total = size();
+    size_t index = 0;
+    qint64 pieceStart = 0;
+    qint64 position = 0;
+
+    // Carries the old contents over from position up to offset.
+    auto keep = [&](qint64 offset, bool copy) {
+        while (position < offset) {
+            while (pieceStart + source[index].length <= position) {
+                pieceStart += source[index].length;
+                ++index;
+            }
+
+            const Piece &piece = source[index];
+            const qint64 from = position - pieceStart;
+            const qint64 length = qMin(offset, pieceStart + piece.length) - position;
+            if (copy) {
+                appendTo(&pieces, piece.data + from, length);
+            } else if (from == 0 && length == piece.length) {
+                pieces.push_back(piece);
+            } else {
+                pieces.push_back(subPiece(piece, from, length));
+            }
+            position += length;
+        }
+    };
+
+    do {
+        const qint64 offset = qBound(position, replacement.offset, total);
+        keep(offset, offset - position < ReplaceCopyBytes);
+        position = qMin(total, offset + qMax<qint64>(0, replacement.length));
+        appendTo(&pieces, replacement.text.constData(), replacement.text.size());
+    } while (next(&replacement));
+    keep(total, false);
+
+    root = build(pieces, 0, pieces.size(), 0);
+    edits = ++lastRevision;
+}
+
+QByteArray TextBuffer::read(qint64 offset, qint64 length) const {
+    offset = qBound<qint64>(0, offset, size());
+    length = qMin(length, size() - offset);
+
+    QByteArray result;
+    if (length <= 0) return result;
+
+    result.reserve(length);
+    forEachSpan(offset, length, [&result](const char *data, qint64 spanLength) {
+        result.append(data, spanLength);
+        return true;
+    });
+    return result;
+}
+
+qint64 TextBuffer::advanceUtf16(qint64 offset, qint64 units) const {
+    offset = qBound<qint64>(0, offset, size());
+
+    qint64 position = offset;
+    qint64 remaining = units;
+    int continuation = 0;
+    bool afterCarriageReturn = false;
+
+    forEachSpan(offset, size() - offset, [&](const char *data, qint64 length) {
+        for (qint64 i = 0; i < length; ++i) {
+            const uchar c = uchar(data[i]);
+
+            if (continuation > 0 && (c & 0xC0) == 0x80) {
+                --continuation;
+                ++position;
+                continue;
+            }
+            continuation = 0;
+
+            if (afterCarriageReturn) {
+                afterCarriageReturn = false;
+                if (c == '\n') {
+                    ++position;
+                    continue;
+                }
+            }
+
+            if (remaining <= 0) return false;
+
+            if (c < 0x80) {
+                afterCarriageReturn = c == '\r';
+                remaining -= 1;
+            } else if (c < 0xC2) {
+                remaining -= 1;
+            } else if (c < 0xE0) {
+                remaining -= 1;
+                continuation = 1;
+            } else if (c < 0xF0) {
+                remaining -= 1;
+                continuation = 2;
+            } else if (c < 0xF5) {
+                remaining -= 2;
+                continuation = 3;
+            } else {
+                remaining -= 1;
+            }
+            ++position;
+        }
+        return true;
+    });
+
+    return position;
+}
+
+bool TextBuffer::writeTo(QIODevice *device) const {
+    bool ok = true;
+    bool pendingCarriageReturn = false;
+
+    // Small pieces and the fragments left between folded line endings are
+    // gathered into one reusable block, so the device sees few large writes
+    // and extra memory stays constant whatever the document size.
+    std::unique_ptr<char[]> block(new char[MaxPieceSize]);
+    qint64 blockUsed = 0;
+
+    auto flush = [device, &ok, &block, &blockUsed]() {
+        if (ok && blockUsed > 0) {
+            ok = device->write(block.get(), blockUsed) == blockUsed;
+        }
+        blockUsed = 0;
+    };
+
+    auto write = [&](const char *data, qint64 length) {
+        if (!ok || length <= 0) return ok;
+
+        if (blockUsed + length > MaxPieceSize) {
+            flush();
+        }
+        if (length >= MaxPieceSize) {
+            ok = ok && device->write(data, length) == length;
+        } else {
+            std::memcpy(block.get() + blockUsed, data, size_t(length));
+            blockUsed += length;
+        }
+        return ok;
+    };
+
+    forEachSpan(0, size(), [&](const char *data, qint64 length) {
+        const char *end = data + length;
+
+        if (pendingCarriageReturn) {
+            pendingCarriageReturn = false;
+            if (*data != '\n') write("\r", 1);
+        }
+
+        while (data < end) {
+            const char *cr = static_cast<const char*>(std::memchr(data, '\r', end - data));
+            if (!cr) {
+                return write(data, end - data);
+            }
+
+            write(data, cr - data);
+            if (cr + 1 == end) {
+                pendingCarriageReturn = true;
+                break;
+            }
+            if (cr[1] != '\n') {
+                write("\r", 1);
+            }
+            data = cr + 1;
+        }
+        return ok;
+    });
+
+    if (pendingCarriageReturn) {
+        write("\r", 1);
+    }
+    flush();
+    return ok;
+}
+
+void TextBuffer::foldLineEndings(QString &text) {
+    text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    text.replace(QLatin1Char('\r'), QChar(0x240D));
+}
+
+qint64 TextBuffer::bytesOf(const NodePtr &node) {
+    return node ? node->bytes : 0;
+}
+
+qint64 TextBuffer::newlinesOf(const NodePtr &node) {
+    return node ? node->newlines : 0;
+}
+
+qint64 TextBuffer::countNewlines(const char *data, qint64 length) {
+    qint64 count = 0;
+    const char *end = data + length;
+    while (data < end) {
+        const char *hit = static_cast<const char*>(std::memchr(data, '\n', end - data));
+        if (!hit) break;
+        ++count;
+        data = hit + 1;
+    }
+    return count;
+}
+
+TextBuffer::Piece TextBuffer::subPiece(const Piece &piece, qint64 from, qint64 length) {
+    Piece result;
+    result.data = piece.data + from;
+    result.length = length;
+    result.newlines = countNewlines(result.data, length);
+    result.owner = piece.owner;
+    return result;
+}
+
+TextBuffer::NodePtr TextBuffer::makeNode(const NodePtr &left, const Piece &piece,
+                                         const NodePtr &right, quint32 priority) {
+    auto node = std::make_shared<Node>();
+    node->left = left;
+    node->right = right;
+    node->piece = piece;
+    node->priority = priority;
+    node->bytes = bytesOf(left) + piece.length + bytesOf(right);
+    node->newlines = newlinesOf(left) + piece.newlines + newlinesOf(right);
+    return node;
+}
+
+TextBuffer::NodePtr TextBuffer::merge(const NodePtr &a, const NodePtr &b) {
+    if (!a) return b;
+    if (!b) return a;
+
+    if (a->priority > b->priority) {
+        return makeNode(a->left, a->piece, merge(a->right, b), a->priority);
+    }
+    return makeNode(merge(a, b->left), b->piece, b->right, b->priority);
+}
+
+const TextBuffer::Piece *TextBuffer::lastPiece(const NodePtr &node) {
+    const Node *current = node.get();
+    if (!current) return nullptr;
+    while (current->right) {
+        current = current->right.get();
+    }
+    return &current->piece;
+}
+
+TextBuffer::NodePtr TextBuffer::extendLast(const NodePtr &node, const Piece &extra) {
+    if (node->right) {
+        return makeNode(node->left, node->piece, extendLast(node->right, extra), node->priority);
+    }
+
+    Piece piece = node->piece;
+    piece.length += extra.length;
+    piece.newlines += extra.newlines;
+    return makeNode(node->left, piece, nullptr, node->priority);
+}
+
+TextBuffer::NodePtr TextBuffer::split(const NodePtr &node, qint64 offset, NodePtr *right) {
+    if (!node) {
+        *right = nullptr;
+        return nullptr;
+    }
+
+    const qint64 leftBytes = bytesOf(node->left);
+    const qint64 pieceLength = node->piece.length;
+
+    if (offset <= leftBytes) {
+        NodePtr rest;
+        NodePtr left = split(node->left, offset, &rest);
+        *right = makeNode(rest, node->piece, node->right, node->priority);
+        return left;
+    }
+
+    if (offset >= leftBytes + pieceLength) {
+        NodePtr rest;
+        NodePtr left = split(node->right, offset - leftBytes - pieceLength, &rest);
+        *right = rest;
+        return makeNode(node->left, node->piece, left, node->priority);
+    }
+
+    // The split point falls inside this piece.
+    const qint64 cut = offset - leftBytes;
+    Piece head = subPiece(node->piece, 0, cut);
+    Piece tail = node->piece;
+    tail.data += cut;
+    tail.length -= cut;
+    tail.newlines -= head.newlines;
+
+    *right = merge(makeNode(nullptr, tail, nullptr, nextPriority()), node->right);
+    return merge(node->left, makeNode(nullptr, head, nullptr, nextPriority()));
+}
+
+TextBuffer::NodePtr TextBuffer::build(const std::vector<Piece> &pieces, size_t from, size_t to, int depth) {
+    if (from >= to) return nullptr;
+
+    // Priorities shrink with depth so the balanced shape is a valid treap.
+    const int shift = qMin(depth, 31);
+    const quint32 high = 0xFFFFFFFFu >> shift;
+    const quint32 low = high >> 1;
+    const quint32 priority = low + nextPriority() % (high - low + 1u);
+
+    const size_t middle = from + (to - from) / 2;
+    NodePtr left = build(pieces, from, middle, depth + 1);
+    NodePtr right = build(pieces, middle + 1, to, depth + 1);
+    return makeNode(left, pieces[middle], right, priority);
+}
+
+std::vector<TextBuffer::Piece> TextBuffer::append(const char *data, qint64 length) {
+    std::vector<Piece> pieces;
+
+    while (length > 0) {
+        if (!addChunk || addChunk->used == addChunk->capacity) {
+            addChunk = std::make_shared<AddChunk>(MaxPieceSize);
+        }
+
+        const qint64 count = qMin(length, addChunk->capacity - addChunk->used);
+        char *target = addChunk->data.get() + addChunk->used;
+        std::memcpy(target, data, size_t(count));
+        addChunk->used += count;
+
+        Piece piece;
+        piece.data = target;
+        piece.length = count;
+        piece.newlines = countNewlines(target, count);
+        piece.owner = addChunk;
+        pieces.push_back(piece);
+
+        data += count;
+        length -= count;
+    }
+
+    return pieces;
+}
+
+void TextBuffer::appendTo(std::vector<Piece> *pieces, const char *data, qint64 length) {
+    if (length <= 0) return;
+
+    for (const Piece &piece : append(data, length)) {
+        Piece *last = pieces->empty() ? nullptr : &pieces->back();
+        if (last && last->owner == piece.owner && last->data + last->length == piece.data
+            && last->length + piece.length <= MaxPieceSize) {
+            last->length += piece.length;
+            last->newlines += piece.newlines;
+        } else {
+            pieces->push_back(piece);
+        }
+    }
+}
+
+void TextBuffer::collect(const Node *node, std::vector<Piece> *pieces) {
+    if (!node) return;
+    collect(node->left.get(), pieces);
+    pieces->push_back(node->piece);
+    collect(node->right.get(), pieces);
+}
+
+quint32 TextBuffer::nextPriority() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
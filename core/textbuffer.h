@@ -0,0 +1,170 @@
+#ifndef TEXTBUFFER_H
+#define TEXTBUFFER_H
+
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class MappedFile;
+class QIODevice;
+
+// Piece table over UTF-8 bytes. The original file stays read-only (mapped or
+// held in memory) and every insertion goes to an append-only add buffer.
+// Pieces live in a persistent treap whose nodes carry subtree byte and
+// newline counts, so edits, offset lookups and line lookups are O(log n).
+//
+// Nodes are immutable and shared: copying a TextBuffer is O(1) and the copy
+// is a snapshot that other threads may read while this one keeps editing.
+class TextBuffer {
+public:
+    TextBuffer();
+    explicit TextBuffer(const QByteArray &original);
+    // The file must be fully indexed (see MappedFile::buildLineIndex).
+    explicit TextBuffer(const std::shared_ptr<MappedFile> &original);
+
+    qint64 size() const;
+    qint64 lineCount() const;
+    int pieceCount() const;
+    // Bytes of this buffer's pieces whose storage other does not use at
+    // all: about what keeping this buffer around costs on top of other.
+    qint64 bytesNotIn(const TextBuffer &other) const;
+
+    // Changes with every edit that changes the contents. Snapshots keep the
+    // revision they were taken at. Revisions are never reused, not even by
+    // another buffer, so a snapshot put back by undo cannot be mistaken for
+    // a later state that happened to get the same number.
+    quint64 revision() const;
+    // XXH64 of the contents. O(n); meant for the writer thread, to tell
+    // whether a snapshot differs from what was last written.
+    quint64 contentHash() const;
+    // The same hash of bytes that are not in a buffer.
+    static quint64 hashOf(const char *data, qint64 length);
+
+    // Byte offset where line starts, or size() past the last line.
+    qint64 lineStart(qint64 line) const;
+    // Line containing the byte at offset.
+    qint64 lineAt(qint64 offset) const;
+
+    void insert(qint64 offset, const char *data, qint64 length);
+    void insert(qint64 offset, const QByteArray &bytes);
+    void remove(qint64 offset, qint64 length);
+
+    struct Replacement {
+        qint64 offset = 0;
+        qint64 length = 0;
+        QByteArray text;
+    };
+
+    // Replaces any number of ranges in one pass over the pieces and counts
+    // as a single edit. next() fills in the ranges in ascending order,
+    // without overlaps, and returns false after the last one. Long stretches
+    // between ranges keep their pieces; short ones are copied along with the
+    // replacement text, so dense replacements do not leave a piece per match.
+    void replace(const std::function<bool(Replacement *replacement)> &next);
+
+    QByteArray read(qint64 offset, qint64 length) const;
+
+    // Returns the offset reached after walking units UTF-16 code units from
+    // offset, treating "\r\n" as a single unit the way the editor shows it.
+    qint64 advanceUtf16(qint64 offset, qint64 units) const;
+
+    // Streams the whole buffer to device, folding "\r\n" into "\n".
+    bool writeTo(QIODevice *device) const;
+
+    // Turns decoded file text into what the editor shows: "\r\n" becomes
+    // "\n", and a lone '\r' becomes U+240D so QTextDocument does not treat
+    // it as a line break the buffer knows nothing about.
+    static void foldLineEndings(QString &text);
+
+    // Calls function(const char *data, qint64 length) for each contiguous
+    // span in [offset, offset + length), in order. Returning false stops.
+    template <typename Function>
+    void forEachSpan(qint64 offset, qint64 length, Function function) const;
+
+    static constexpr qint64 MaxPieceSize = 64 * 1024;
+
+private:
+    struct Piece {
+        const char *data = nullptr;
+        qint64 length = 0;
+        qint64 newlines = 0;
+        std::shared_ptr<const void> owner;
+    };
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node {
+        NodePtr left;
+        NodePtr right;
+        Piece piece;
+        quint32 priority;
+        qint64 bytes;
+        qint64 newlines;
+    };
+
+    struct AddChunk {
+        explicit AddChunk(qint64 capacity) : data(new char[capacity]), used(0), capacity(capacity) {}
+        std::unique_ptr<char[]> data;
+        qint64 used;
+        qint64 capacity;
+    };
+
+    static qint64 bytesOf(const NodePtr &node);
+    static qint64 newlinesOf(const NodePtr &node);
+    static qint64 countNewlines(const char *data, qint64 length);
+    static Piece subPiece(const Piece &piece, qint64 from, qint64 length);
+    static NodePtr makeNode(const NodePtr &left, const Piece &piece, const NodePtr &right, quint32 priority);
+    static NodePtr merge(const NodePtr &a, const NodePtr &b);
+    static const Piece *lastPiece(const NodePtr &node);
+    static NodePtr extendLast(const NodePtr &node, const Piece &extra);
+
+    NodePtr split(const NodePtr &node, qint64 offset, NodePtr *right);
+    NodePtr build(const std::vector<Piece> &pieces, size_t from, size_t to, int depth);
+    std::vector<Piece> append(const char *data, qint64 length);
+    void appendTo(std::vector<Piece> *pieces, const char *data, qint64 length);
+    static void collect(const Node *node, std::vector<Piece> *pieces);
+    quint32 nextPriority();
+
+    template <typename Function>
+    static bool visit(const Node *node, qint64 offset, qint64 end, qint64 base, Function &function);
+
+    NodePtr root;
+    std::shared_ptr<AddChunk> addChunk;
+    quint32 seed;
+    quint64 edits;
+};
+
+template <typename Function>
+void TextBuffer::forEachSpan(qint64 offset, qint64 length, Function function) const {
+    if (length <= 0 || !root) return;
+    visit(root.get(), offset, offset + length, 0, function);
+}
+
+template <typename Function>
+bool TextBuffer::visit(const Node *node, qint64 offset, qint64 end, qint64 base, Function &function) {
+    if (!node || base >= end || base + node->bytes <= offset) {
+        return true;
+    }
+
+    const qint64 leftBytes = bytesOf(node->left);
+    if (!visit(node->left.get(), offset, end, base, function)) {
+        return false;
+    }
+
+    const qint64 pieceStart = base + leftBytes;
+    const qint64 pieceEnd = pieceStart + node->piece.length;
+    const qint64 from = qMax(offset, pieceStart);
+    const qint64 to = qMin(end, pieceEnd);
+    if (from < to && !function(node->piece.data + (from - pieceStart), to - from)) {
+        return false;
+    }
+
+    return visit(node->right.get(), offset, end, pieceEnd, function);
+}
+
+#endif // TEXTBUFFER_H
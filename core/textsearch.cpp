@@ -0,0 +1,335 @@
+#include "textsearch.h"
+#include "textbuffer.h"
+
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTSEARCH_SSE2
+#endif
+
+// Longest stretch a regular expression window may grow to while looking for
+// the end of a line; a longer line is cut there.
+static const qint64 MaxWindowBytes = 64 * 1024 * 1024;
+
+static inline uchar foldAscii(uchar c) {
+    return c >= 'A' && c <= 'Z' ? uchar(c | 0x20) : c;
+}
+
+static inline uchar upperAscii(uchar c) {
+    return c >= 'a' && c <= 'z' ? uchar(c & ~0x20) : c;
+}
+
+TextSearch::TextSearch(const Query &query)
+    : searchQuery(query)
+    , valid(false)
+    , literal(false)
+    , foldCase(false)
+{
+    if (query.pattern.isEmpty()) return;
+
+    bool ascii = true;
+    for (QChar c : query.pattern) {
+        if (c.unicode() >= 0x80) {
+            ascii = false;
+            break;
+        }
+    }
+
+    if (!query.regularExpression && !query.wholeWords && (query.caseSensitive || ascii)) {
+        literal = true;
+        foldCase = !query.caseSensitive;
+        needle = query.pattern.toUtf8();
+        if (foldCase) {
+            for (char &c : needle) c = char(foldAscii(uchar(c)));
+        }
+        valid = true;
+        return;
+    }
+
+    QString pattern = query.regularExpression ? query.pattern : QRegularExpression::escape(query.pattern);
+    QRegularExpression::PatternOptions options = QRegularExpression::MultilineOption;
+    if (query.wholeWords) {
+        pattern = "\\b(?:" + pattern + ")\\b";
+        options |= QRegularExpression::UseUnicodePropertiesOption;
+    }
+    if (!query.caseSensitive) {
+        options |= QRegularExpression::CaseInsensitiveOption;
+    }
+
+    expression.setPattern(pattern);
+    expression.setPatternOptions(options);
+    if (!expression.isValid()) {
+        error = expression.errorString();
+        return;
+    }
+
+    // Compiles and JIT-optimizes now rather than on the first few matches.
+    expression.optimize();
+    valid = true;
+}
+
+const TextSearch::Query &TextSearch::query() const {
+    return searchQuery;
+}
+
+bool TextSearch::isValid() const {
+    return valid;
+}
+
+QString TextSearch::errorString() const {
+    return error;
+}
+
+bool TextSearch::isLiteral() const {
+    return literal;
+}
+
+qint64 TextSearch::literalLength() const {
+    return needle.size();
+}
+
+bool TextSearch::mayMatch(const char *data, qint64 length) const {
+    if (!valid) return false;
+    return !literal || findIn(data, data + length) != nullptr;
+}
+
+bool TextSearch::matchesAt(const char *data) const {
+    if (!foldCase) {
+        return std::memcmp(data, needle.constData(), size_t(needle.size())) == 0;
+    }
+    for (qsizetype i = 0; i < needle.size(); ++i) {
+        if (foldAscii(uchar(data[i])) != uchar(needle.at(i))) return false;
+    }
+    return true;
+}
+
+const char *TextSearch::findIn(const char *begin, const char *end) const {
+    const qsizetype length = needle.size();
+    if (end - begin < length) return nullptr;
+
+    // Candidates are [begin, last].
+    const char *last = end - length;
+    const char *p = begin;
+
+#ifdef TEXTSEARCH_SSE2
+    // Only positions whose first and last bytes both fit are compared in
+    // full; for text that is almost never more than the real matches.
+    const uchar firstByte = uchar(needle.at(0));
+    const uchar lastByte = uchar(needle.at(length - 1));
+    const __m128i firstLower = _mm_set1_epi8(char(firstByte));
+    const __m128i firstUpper = _mm_set1_epi8(char(foldCase ? upperAscii(firstByte) : firstByte));
+    const __m128i lastLower = _mm_set1_epi8(char(lastByte));
+    const __m128i lastUpper = _mm_set1_epi8(char(foldCase ? upperAscii(lastByte) : lastByte));
+
+    for (; last - p >= 15; p += 16) {
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + length - 1));
+        const __m128i headHits = _mm_or_si128(_mm_cmpeq_epi8(head, firstLower), _mm_cmpeq_epi8(head, firstUpper));
+        const __m128i tailHits = _mm_or_si128(_mm_cmpeq_epi8(tail, lastLower), _mm_cmpeq_epi8(tail, lastUpper));
+
+        quint32 mask = quint32(_mm_movemask_epi8(_mm_and_si128(headHits, tailHits)));
+        while (mask) {
+            const char *candidate = p + qCountTrailingZeroBits(mask);
+            if (matchesAt(candidate)) return candidate;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    if (!foldCase) {
+        while (p <= last) {
+            p = static_cast<const char*>(std::memchr(p, needle.at(0), size_t(last - p + 1)));
+            if (!p) return nullptr;
+            if (matchesAt(p)) return p;
+            ++p;
+        }
+        return nullptr;
+    }
+
+    for (; p <= last; ++p) {
+        if (matchesAt(p)) return p;
+    }
+    return nullptr;
+}
+
+TextSearch::Scanner::Scanner(const TextSearch &search, const TextBuffer &buffer, qint64 from, qint64 to)
+    : search(search)
+    , buffer(buffer)
+    , from(qBound<qint64>(0, from, buffer.size()))
+    , end(qMin(to, buffer.size()))
+    , blockStart(-1)
+    , position(0)
+    , mappedUnits(0)
+    , mappedBytes(0)
+    , lineBreak(-2)
+{
+}
+
+bool TextSearch::Scanner::next(Match *match) {
+    if (!search.valid) return false;
+    return search.literal ? nextLiteral(match) : nextExpression(match);
+}
+
+bool TextSearch::Scanner::nextLiteral(Match *match) {
+    const qint64 length = search.needle.size();
+    if (blockStart < 0 && !loadBlock(from)) return false;
+
+    for (;;) {
+        const char *data = block.constData();
+        const char *hit = search.findIn(data + position, data + block.size());
+        if (hit) {
+            const qint64 offset = blockStart + (hit - data);
+            if (offset >= end) return false;
+
+            match->offset = offset;
+            match->length = length;
+            position = (hit - data) + length;
+            return true;
+        }
+
+        // Every start up to the last length - 1 bytes has been tried; those
+        // are tried again at the front of the next block.
+        if (!loadBlock(blockStart + qMax<qint64>(position, block.size() - length + 1))) {
+            return false;
+        }
+    }
+}
+
+bool TextSearch::Scanner::loadBlock(qint64 start) {
+    const qint64 length = search.needle.size();
+    const qint64 readEnd = qMin(buffer.size(), end + length - 1);
+    if (start >= end || readEnd - start < length) return false;
+
+    const qint64 count = qMin(BlockBytes + length - 1, readEnd - start);
+    block.resize(0);
+    block.reserve(count);
+    buffer.forEachSpan(start, count, [this](const char *data, qint64 spanLength) {
+        block.append(data, spanLength);
+        return true;
+    });
+
+    blockStart = start;
+    position = 0;
+    return true;
+}
+
+bool TextSearch::Scanner::nextExpression(Match *match) {
+    if (blockStart < 0 && !loadWindow(from)) return false;
+
+    for (;;) {
+        current = position <= text.size() ? search.expression.match(text, position) : QRegularExpressionMatch();
+        if (!current.hasMatch()) {
+            if (!loadWindow(blockStart + block.size())) return false;
+            continue;
+        }
+
+        const qsizetype start = current.capturedStart();
+        const qsizetype stop = current.capturedEnd();
+        if (lineBreak == -2 || (lineBreak >= 0 && lineBreak < start)) {
+            lineBreak = text.indexOf(QLatin1Char('\n'), start);
+        }
+
+        // Empty matches are skipped, and one that runs past the end of its
+        // line is dropped; the search goes on from the next line.
+        if (stop == start) {
+            position = start + 1;
+            continue;
+        }
+        if (lineBreak >= 0 && lineBreak < stop) {
+            position = lineBreak + 1;
+            continue;
+        }
+
+        const qint64 offset = byteOffsetOf(start);
+        if (offset >= end) return false;
+
+        match->offset = offset;
+        match->length = byteOffsetOf(stop) - offset;
+        position = stop;
+        return true;
+    }
+}
+
+bool TextSearch::Scanner::loadWindow(qint64 start) {
+    const qint64 size = buffer.size();
+    if (start >= end) return false;
+
+    // Windows hold whole lines, so no line is split between two of them.
+    qint64 windowStart = buffer.lineStart(buffer.lineAt(start));
+    if (start - windowStart > BlockBytes) {
+        windowStart = start;
+    }
+    qint64 windowEnd = buffer.lineStart(buffer.lineAt(qMin(size, windowStart + BlockBytes)) + 1);
+    if (windowEnd - windowStart > MaxWindowBytes) {
+        windowEnd = windowStart + MaxWindowBytes;
+        while (windowEnd > start + 1 && (uchar(buffer.read(windowEnd, 1).at(0)) & 0xC0) == 0x80) {
+            --windowEnd;
+        }
+    }
+
+    block = buffer.read(windowStart, windowEnd - windowStart);
+    text = QString::fromUtf8(block);
+    blockStart = windowStart;
+    mappedUnits = 0;
+    mappedBytes = 0;
+    lineBreak = -2;
+
+    // The search starts at start, which may be in the middle of a line.
+    const uchar *data = reinterpret_cast<const uchar*>(block.constData());
+    while (mappedBytes < start - windowStart) {
+        const uchar c = data[mappedBytes];
+        const int sequence = c < 0xC0 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        mappedUnits += sequence == 4 ? 2 : 1;
+        mappedBytes += sequence;
+    }
+    position = mappedUnits;
+    return true;
+}
+
+qint64 TextSearch::Scanner::byteOffsetOf(qsizetype units) {
+    // Matches come in order, so the mapping from UTF-16 positions back to
+    // bytes only ever moves forward through the window.
+    const uchar *data = reinterpret_cast<const uchar*>(block.constData());
+    const qint64 size = block.size();
+    while (mappedUnits < units && mappedBytes < size) {
+        const uchar c = data[mappedBytes];
+        const int sequence = c < 0xC0 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+        mappedUnits += sequence == 4 ? 2 : 1;
+        mappedBytes = qMin(size, mappedBytes + sequence);
+    }
+    return blockStart + mappedBytes;
+}
+
+QByteArray TextSearch::Scanner::replacement(const QString &text) {
+    if (!search.searchQuery.regularExpression) {
+        if (replacementBytes.isNull() || text != replacementSource) {
+            replacementSource = text;
+            replacementBytes = text.toUtf8();
+        }
+        return replacementBytes;
+    }
+
+    QString result;
+    result.reserve(text.size());
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (c != QLatin1Char('\\') || i + 1 == text.size()) {
+            result += c;
+            continue;
+        }
+
+        const QChar escaped = text.at(++i);
+        if (escaped.isDigit()) {
+            result += current.captured(escaped.digitValue());
+        } else if (escaped == QLatin1Char('n')) {
+            result += QLatin1Char('\n');
+        } else if (escaped == QLatin1Char('t')) {
+            result += QLatin1Char('\t');
+        } else {
+            result += escaped;
+        }
+    }
+    return result.toUtf8();
+}
@@ -0,0 +1,114 @@
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#pragma once
+#include <QByteArray>
+#include <QRegularExpression>
+#include <QString>
+#include <QtGlobal>
+
+class TextBuffer;
+
+// A compiled find query over the UTF-8 bytes of a TextBuffer.
+//
+// Plain patterns are searched for as bytes: candidates are filtered sixteen
+// positions at a time on the pattern's first and last byte with SSE2 where
+// available (memchr otherwise) and only those are compared in full. ASCII
+// patterns ignore case the same way. Regular expressions, whole-word
+// searches and case-insensitive patterns with non-ASCII letters go through
+// QRegularExpression, compiled and JIT-optimized once per query.
+//
+// Matches never overlap, and regular expression matches never cross a line
+// break, so an edit only ever affects the matches on the lines it touches.
+class TextSearch {
+public:
+    struct Query {
+        QString pattern;
+        bool caseSensitive = false;
+        bool wholeWords = false;
+        bool regularExpression = false;
+
+        bool operator==(const Query &) const = default;
+    };
+
+    struct Match {
+        qint64 offset = 0;
+        qint64 length = 0;
+    };
+
+    explicit TextSearch(const Query &query);
+
+    const Query &query() const;
+    // False for an empty pattern or one that does not compile.
+    bool isValid() const;
+    QString errorString() const;
+
+    // True when matches are found by the byte kernel; they are then exactly
+    // literalLength() bytes long.
+    bool isLiteral() const;
+    qint64 literalLength() const;
+
+    // False only when data cannot contain a match: exact for plain
+    // patterns, always true for regular expressions. Lets a caller skip
+    // building a TextBuffer over text that has nothing to find.
+    bool mayMatch(const char *data, qint64 length) const;
+
+    // Walks the matches starting in [from, to) in order. Matches may end
+    // past to. The buffer must outlive the scanner and stay unchanged.
+    class Scanner {
+    public:
+        Scanner(const TextSearch &search, const TextBuffer &buffer, qint64 from, qint64 to);
+
+        bool next(Match *match);
+
+        // What the last match is replaced with. For regular expressions \0
+        // to \9 insert captures and \n, \t and \\ are escapes; otherwise the
+        // text is used as is.
+        QByteArray replacement(const QString &text);
+
+    private:
+        bool nextLiteral(Match *match);
+        bool nextExpression(Match *match);
+        bool loadBlock(qint64 start);
+        bool loadWindow(qint64 start);
+        qint64 byteOffsetOf(qsizetype position);
+
+        const TextSearch &search;
+        const TextBuffer &buffer;
+        qint64 from;
+        qint64 end;
+
+        QByteArray block;
+        qint64 blockStart;
+        qsizetype position;
+
+        QString text;
+        QRegularExpressionMatch current;
+        qsizetype mappedUnits;
+        qint64 mappedBytes;
+        // Next '\n' in text at or after the last match, -1 for none, -2
+        // when not looked up yet.
+        qsizetype lineBreak;
+
+        QString replacementSource;
+        QByteArray replacementBytes;
+    };
+
+    // Bytes the literal kernel looks at per block; a block overlaps the
+    // previous one by the pattern length minus one.
+    static constexpr qint64 BlockBytes = 1024 * 1024;
+
+private:
+    bool matchesAt(const char *data) const;
+    const char *findIn(const char *begin, const char *end) const;
+
+    Query searchQuery;
+    QString error;
+    bool valid;
+    bool literal;
+    bool foldCase;
+    QByteArray needle;
+    QRegularExpression expression;
+};
+
+#endif // TEXTSEARCH_H
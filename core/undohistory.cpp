@@ -0,0 +1,320 @@
+#include "undohistory.h"
+
+#include <QDir>
+#include <QTemporaryFile>
+
+static const qint64 CopyChunkBytes = 1024 * 1024;
+
+// One character as typed: a single UTF-8 sequence.
+static bool isKeystroke(const QByteArray &text) {
+    if (text.isEmpty()) return false;
+    const uchar lead = uchar(text[0]);
+    const int length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+    return text.size() == length;
+}
+
+// Indentation, as inserted after a new line.
+static bool isBlank(const QByteArray &text) {
+    for (char c : text) {
+        if (c != ' ' && c != '\t') return false;
+    }
+    return true;
+}
+
+static std::unique_ptr<QTemporaryFile> openSpillFile() {
+    auto file = std::make_unique<QTemporaryFile>(QDir::tempPath() + "/chora-undo-XXXXXX");
+    if (!file->open()) return nullptr;
+    return file;
+}
+
+UndoHistory::UndoHistory()
+    : current(0)
+    , spilled(0)
+    , cleanIndex(-1)
+    , swapCount(0)
+    , resident(0)
+    , liveFileBytes(0)
+    , mergeOpen(false)
+{
+}
+
+UndoHistory::~UndoHistory() = default;
+
+void UndoHistory::recordEdit(qint64 offset, const QByteArray &removed, const QByteArray &inserted) {
+    if (removed.isEmpty() && inserted.isEmpty()) return;
+    truncate(current);
+
+    if (merge(offset, removed, inserted)) {
+        // The step the text was clean after now holds more.
+        if (cleanIndex == current) cleanIndex = -1;
+    } else {
+        Entry entry;
+        entry.offset = offset;
+        entry.removedLength = removed.size();
+        entry.insertedLength = inserted.size();
+        entry.removed = removed;
+        entry.inserted = inserted;
+        entries.append(entry);
+        ++current;
+    }
+    resident += removed.size() + inserted.size();
+    mergeOpen = true;
+    lastEdit.start();
+
+    spillExcess();
+}
+
+bool UndoHistory::merge(qint64 offset, const QByteArray &removed, const QByteArray &inserted) {
+    if (!mergeOpen || current == 0 || lastEdit.elapsed() > MergeMilliseconds) return false;
+    Entry &last = entries[current - 1];
+    if (last.swap || last.fileOffset >= 0) return false;
+
+    if (removed.isEmpty()) {
+        // Typing on where the last step left off. A new line and the indent
+        // after it join the word before; the next word starts a new step.
+        if (last.insertedLength == 0 || offset != last.offset + last.insertedLength) return false;
+        if (!isKeystroke(inserted) && !isBlank(inserted)) return false;
+        if (last.inserted.contains('\n') && !isBlank(inserted)) return false;
+        last.inserted += inserted;
+        last.insertedLength += inserted.size();
+        return true;
+    }
+
+    if (inserted.isEmpty() && last.insertedLength == 0 && isKeystroke(removed)) {
+        if (offset + removed.size() == last.offset) {
+            // Backspace.
+            last.removed.prepend(removed);
+            last.offset = offset;
+        } else if (offset == last.offset) {
+            // Delete.
+            last.removed += removed;
+        } else {
+            return false;
+        }
+        last.removedLength += removed.size();
+        return true;
+    }
+    return false;
+}
+
+void UndoHistory::recordSwap(const TextBuffer &before, const TextBuffer &after) {
+    truncate(current);
+
+    Entry entry;
+    entry.swap = std::make_shared<const BufferSwap>(BufferSwap{before, after});
+    // What the two buffers hold that the other does not: the replacement
+    // text on one side, the text it replaced on the other.
+    entry.swapBytes = after.bytesNotIn(before) + before.bytesNotIn(after);
+    entries.append(entry);
+    ++current;
+    ++swapCount;
+    resident += entry.swapBytes;
+    mergeOpen = false;
+
+    if (swapCount > MaxSwaps) dropOldest(oldestSwap() + 1);
+    spillExcess();
+}
+
+bool UndoHistory::canUndo() const {
+    return current > 0;
+}
+
+bool UndoHistory::canRedo() const {
+    return current < entries.size();
+}
+
+bool UndoHistory::undo(Step *step) {
+    if (!canUndo() || !read(entries[current - 1], step)) return false;
+    --current;
+    mergeOpen = false;
+    return true;
+}
+
+bool UndoHistory::redo(Step *step) {
+    if (!canRedo() || !read(entries[current], step)) return false;
+    ++current;
+    mergeOpen = false;
+    return true;
+}
+
+bool UndoHistory::read(const Entry &entry, Step *step) const {
+    *step = Step();
+    if (entry.swap) {
+        step->isSwap = true;
+        step->before = entry.swap->before;
+        step->after = entry.swap->after;
+        return true;
+    }
+
+    step->offset = entry.offset;
+    if (entry.fileOffset < 0) {
+        step->removed = entry.removed;
+        step->inserted = entry.inserted;
+        return true;
+    }
+    if (!file || !file->seek(entry.fileOffset)) return false;
+    step->removed = file->read(entry.removedLength);
+    step->inserted = file->read(entry.insertedLength);
+    return step->removed.size() == entry.removedLength && step->inserted.size() == entry.insertedLength;
+}
+
+void UndoHistory::markClean() {
+    cleanIndex = current;
+    mergeOpen = false;
+}
+
+bool UndoHistory::isClean() const {
+    return cleanIndex == current;
+}
+
+void UndoHistory::clear() {
+    entries.clear();
+    current = 0;
+    spilled = 0;
+    cleanIndex = -1;
+    swapCount = 0;
+    resident = 0;
+    liveFileBytes = 0;
+    file.reset();
+    mergeOpen = false;
+}
+
+void UndoHistory::release() {
+    for (int i = current; i < entries.size(); ++i) {
+        if (entries[i].swap) {
+            truncate(i);
+            break;
+        }
+    }
+    for (int i = current - 1; i >= 0; --i) {
+        if (entries[i].swap) {
+            dropOldest(i + 1);
+            break;
+        }
+    }
+
+    while (spilled < entries.size() && spill(entries[spilled])) {
+        ++spilled;
+    }
+    mergeOpen = false;
+}
+
+qint64 UndoHistory::residentBytes() const {
+    return resident;
+}
+
+void UndoHistory::truncate(int index) {
+    if (index >= entries.size()) return;
+    if (cleanIndex > index) cleanIndex = -1;
+
+    for (int i = index; i < entries.size(); ++i) {
+        forget(entries[i]);
+    }
+    entries.resize(index);
+    current = qMin(current, index);
+    spilled = qMin(spilled, index);
+    compact();
+}
+
+void UndoHistory::dropOldest(int count) {
+    for (int i = 0; i < count; ++i) {
+        forget(entries[i]);
+    }
+    entries.remove(0, count);
+    current -= count;
+    spilled = qMax(0, spilled - count);
+    cleanIndex = cleanIndex >= count ? cleanIndex - count : -1;
+    compact();
+}
+
+int UndoHistory::oldestSwap() const {
+    for (int i = 0; i < entries.size(); ++i) {
+        if (entries[i].swap) return i;
+    }
+    return -1;
+}
+
+void UndoHistory::forget(const Entry &entry) {
+    if (entry.swap) {
+        --swapCount;
+        resident -= entry.swapBytes;
+    } else if (entry.fileOffset >= 0) {
+        liveFileBytes -= entry.removedLength + entry.insertedLength;
+    } else {
+        resident -= entry.removed.size() + entry.inserted.size();
+    }
+}
+
+bool UndoHistory::spill(Entry &entry) {
+    if (entry.swap || entry.fileOffset >= 0) return true;
+
+    if (!file) {
+        file = openSpillFile();
+        if (!file) return false;
+    }
+    // Appended at the end; a failed write leaves the entry in memory and
+    // whatever was written counts as dead text.
+    const qint64 at = file->size();
+    if (!file->seek(at)
+        || file->write(entry.removed) != entry.removed.size()
+        || file->write(entry.inserted) != entry.inserted.size()) {
+        return false;
+    }
+
+    entry.fileOffset = at;
+    resident -= entry.removed.size() + entry.inserted.size();
+    liveFileBytes += entry.removedLength + entry.insertedLength;
+    entry.removed = QByteArray();
+    entry.inserted = QByteArray();
+    return true;
+}
+
+void UndoHistory::spillExcess() {
+    // Oldest first, so the spilled entries are always the first ones.
+    while (resident > MaxResidentBytes && spilled < entries.size() && spill(entries[spilled])) {
+        ++spilled;
+    }
+    // Whatever is left is mostly held by swaps, which cannot be spilled:
+    // the steps up to the oldest one go, though never the newest step, so
+    // a replace larger than the whole budget can still be undone until the
+    // next edit.
+    for (int oldest = oldestSwap(); resident > MaxResidentBytes && oldest >= 0 && oldest < entries.size() - 1;
+         oldest = oldestSwap()) {
+        dropOldest(oldest + 1);
+    }
+}
+
+void UndoHistory::compact() {
+    if (!file) return;
+    if (liveFileBytes == 0) {
+        file.reset();
+        return;
+    }
+    const qint64 dead = file->size() - liveFileBytes;
+    if (dead < CompactThreshold || dead < liveFileBytes) return;
+
+    // The live text is copied to a new file in order; the old one stays in
+    // use if anything fails.
+    std::unique_ptr<QTemporaryFile> compacted = openSpillFile();
+    if (!compacted) return;
+
+    QVector<qint64> offsets(spilled, -1);
+    for (int i = 0; i < spilled; ++i) {
+        const Entry &entry = entries[i];
+        if (entry.fileOffset < 0) continue;
+        if (!file->seek(entry.fileOffset)) return;
+
+        offsets[i] = compacted->pos();
+        qint64 remaining = entry.removedLength + entry.insertedLength;
+        while (remaining > 0) {
+            const QByteArray chunk = file->read(qMin(remaining, CopyChunkBytes));
+            if (chunk.isEmpty() || compacted->write(chunk) != chunk.size()) return;
+            remaining -= chunk.size();
+        }
+    }
+
+    for (int i = 0; i < spilled; ++i) {
+        if (offsets[i] >= 0) entries[i].fileOffset = offsets[i];
+    }
+    file = std::move(compacted);
+}
@@ -0,0 +1,129 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#pragma once
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QVector>
+#include <memory>
+
+#include "textbuffer.h"
+
+class QTemporaryFile;
+
+// Undo and redo for one editor, kept as edits to the buffer's bytes rather
+// than in QTextDocument's undo stack, which holds every step in memory for
+// as long as the document lives.
+//
+// Typing and deleting at one place merge into a single step. Once the steps
+// hold more than MaxResidentBytes of text, the oldest have it appended to a
+// temporary file and read back when they are undone, so the history has no
+// depth limit while what it keeps in memory does. Redo steps cut off by a
+// new edit leave their text behind in the file; it is compacted once that
+// outweighs the text still reachable.
+class UndoHistory {
+public:
+    struct Step {
+        // A text edit: removed, at offset, was replaced with inserted.
+        qint64 offset = 0;
+        QByteArray removed;
+        QByteArray inserted;
+        // An edit made to the whole buffer at once, such as replace all:
+        // the buffer before and after it.
+        bool isSwap = false;
+        TextBuffer before;
+        TextBuffer after;
+    };
+
+    UndoHistory();
+    ~UndoHistory();
+
+    UndoHistory(const UndoHistory &) = delete;
+    UndoHistory &operator=(const UndoHistory &) = delete;
+
+    // Drops whatever could be redone and records the edit, merged into the
+    // last step when it carries on the same typing or deleting.
+    void recordEdit(qint64 offset, const QByteArray &removed, const QByteArray &inserted);
+    void recordSwap(const TextBuffer &before, const TextBuffer &after);
+
+    bool canUndo() const;
+    bool canRedo() const;
+    // Fills step with the edit to revert or repeat and moves past it. False
+    // when there is none, or its text could not be read back from the file.
+    bool undo(Step *step);
+    bool redo(Step *step);
+
+    // The text as it is now is what the file on disk holds, so undoing or
+    // redoing back here can tell it is saved again.
+    void markClean();
+    bool isClean() const;
+
+    void clear();
+    // Moves the text of every step to the file and drops the steps up to
+    // the last swap, whose buffers would keep old text in memory. For a tab
+    // that gives up its text but keeps its history.
+    void release();
+
+    // Bytes of step text held in memory, and of what the buffers of each
+    // swap hold that the other does not.
+    qint64 residentBytes() const;
+
+    static constexpr qint64 MaxResidentBytes = 8 * 1024 * 1024;
+    // Dead text the file may collect before it is compacted.
+    static constexpr qint64 CompactThreshold = 16 * 1024 * 1024;
+    // Swaps are never spilled. Past this many, or when they alone keep the
+    // steps over MaxResidentBytes, the steps up to the oldest are dropped.
+    static constexpr int MaxSwaps = 100;
+    // A pause in typing longer than this starts a new step.
+    static constexpr int MergeMilliseconds = 2000;
+
+private:
+    struct BufferSwap {
+        TextBuffer before;
+        TextBuffer after;
+    };
+
+    struct Entry {
+        qint64 offset = 0;
+        qint64 removedLength = 0;
+        qint64 insertedLength = 0;
+        // Where the removed and then the inserted text are in the file, or
+        // -1 while they are held in removed and inserted.
+        qint64 fileOffset = -1;
+        QByteArray removed;
+        QByteArray inserted;
+        std::shared_ptr<const BufferSwap> swap;
+        // Counted in resident for a swap.
+        qint64 swapBytes = 0;
+    };
+
+    bool merge(qint64 offset, const QByteArray &removed, const QByteArray &inserted);
+    bool read(const Entry &entry, Step *step) const;
+    // Drops the entries from index on.
+    void truncate(int index);
+    void dropOldest(int count);
+    // Index of the first swap, or -1.
+    int oldestSwap() const;
+    void forget(const Entry &entry);
+    bool spill(Entry &entry);
+    void spillExcess();
+    void compact();
+
+    // Entries before current can be undone, the rest redone. The first
+    // spilled ones are in the file.
+    QVector<Entry> entries;
+    int current;
+    int spilled;
+    // Where current was when markClean() was called; -1 once that can no
+    // longer be reached.
+    int cleanIndex;
+    int swapCount;
+    qint64 resident;
+    qint64 liveFileBytes;
+    std::unique_ptr<QTemporaryFile> file;
+
+    bool mergeOpen;
+    QElapsedTimer lastEdit;
+};
+
+#endif // UNDOHISTORY_H
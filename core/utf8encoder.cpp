@@ -0,0 +1,79 @@
+#include "utf8encoder.h"
+
+#include <QChar>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTF8ENCODER_SSE2
+#endif
+
+Utf8Encoder::Utf8Encoder(qsizetype capacity)
+    : data(new char[qMax<qsizetype>(capacity, 16)])
+    , capacity(qMax<qsizetype>(capacity, 16))
+    , used(0)
+    , pendingSurrogate(0)
+{
+}
+
+void Utf8Encoder::encodeRun(const char16_t *&source, const char16_t *end,
+                            char *&output, char *outputEnd, bool final) {
+    const char16_t *in = source;
+    char *out = output;
+
+    while (in < end) {
+#ifdef UTF8ENCODER_SSE2
+        // Eight ASCII code units become eight bytes with one pack.
+        const __m128i highBits = _mm_set1_epi16(short(0xFF80));
+        while (end - in >= 8 && outputEnd - out >= 8) {
+            const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+            const __m128i nonAscii = _mm_and_si128(units, highBits);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, _mm_setzero_si128())) != 0xFFFF) {
+                break;
+            }
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(units, units));
+            in += 8;
+            out += 8;
+        }
+#endif
+        while (in < end && *in < 0x80 && out < outputEnd) {
+            *out++ = char(*in++);
+        }
+        if (in == end || out == outputEnd) break;
+        if (*in < 0x80) continue;
+
+        char32_t codePoint = *in;
+        int units = 1;
+        if (QChar::isHighSurrogate(codePoint)) {
+            if (in + 1 == end) {
+                if (!final) break;
+                codePoint = QChar::ReplacementCharacter;
+            } else if (QChar::isLowSurrogate(in[1])) {
+                codePoint = QChar::surrogateToUcs4(in[0], in[1]);
+                units = 2;
+            } else {
+                codePoint = QChar::ReplacementCharacter;
+            }
+        } else if (QChar::isLowSurrogate(codePoint)) {
+            codePoint = QChar::ReplacementCharacter;
+        }
+
+        const int bytes = codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+        if (outputEnd - out < bytes) break;
+
+        if (bytes == 2) {
+            *out++ = char(0xC0 | (codePoint >> 6));
+        } else if (bytes == 3) {
+            *out++ = char(0xE0 | (codePoint >> 12));
+            *out++ = char(0x80 | ((codePoint >> 6) & 0x3F));
+        } else {
+            *out++ = char(0xF0 | (codePoint >> 18));
+            *out++ = char(0x80 | ((codePoint >> 12) & 0x3F));
+            *out++ = char(0x80 | ((codePoint >> 6) & 0x3F));
+        }
+        *out++ = char(0x80 | (codePoint & 0x3F));
+        in += units;
+    }
+
+    source = in;
+    output = out;
+}
@@ -0,0 +1,100 @@
+#ifndef UTF8ENCODER_H
+#define UTF8ENCODER_H
+
+#pragma once
+#include <QChar>
+#include <QStringView>
+#include <QtGlobal>
+#include <memory>
+
+// Incremental UTF-16 to UTF-8 encoder that works through a fixed, reusable
+// output buffer. Text can be fed in any number of pieces (a surrogate pair
+// may even be split between them) and the encoded bytes are handed to a sink
+// whenever the buffer fills up, so memory use does not depend on input size.
+//
+// Runs of ASCII are converted eight code units at a time with SSE2 where
+// available. Unpaired surrogates are encoded as U+FFFD, as QString::toUtf8
+// does.
+class Utf8Encoder {
+public:
+    explicit Utf8Encoder(qsizetype capacity = 64 * 1024);
+
+    // sink(const char *data, qint64 length) receives the encoded bytes.
+    template <typename Sink>
+    void encode(QStringView text, Sink &&sink);
+
+    // Emits anything still buffered, including a dangling high surrogate.
+    template <typename Sink>
+    void finish(Sink &&sink);
+
+    // Encodes as much of [source, end) as fits into [output, outputEnd) and
+    // advances both pointers. Stops before a code point that does not fit.
+    // Unless final is set, a high surrogate at the very end is left alone,
+    // since its partner may still follow.
+    static void encodeRun(const char16_t *&source, const char16_t *end,
+                          char *&output, char *outputEnd, bool final = false);
+
+private:
+    std::unique_ptr<char[]> data;
+    qsizetype capacity;
+    qsizetype used;
+    char16_t pendingSurrogate;
+};
+
+template <typename Sink>
+void Utf8Encoder::encode(QStringView text, Sink &&sink) {
+    const char16_t *source = text.utf16();
+    const char16_t *end = source + text.size();
+
+    if (pendingSurrogate && source < end) {
+        const char16_t pair[2] = {pendingSurrogate, *source};
+        const char16_t *from = pair;
+        char *output = data.get() + used;
+        if (capacity - used < 4) {
+            sink(data.get(), qint64(used));
+            output = data.get();
+        }
+        encodeRun(from, pair + 2, output, data.get() + capacity);
+        used = output - data.get();
+        // A high surrogate not followed by a low one was encoded on its own.
+        source += from - pair - 1;
+        pendingSurrogate = 0;
+    }
+
+    while (source < end) {
+        char *output = data.get() + used;
+        encodeRun(source, end, output, data.get() + capacity);
+        used = output - data.get();
+
+        if (source + 1 == end && QChar::isHighSurrogate(*source)) {
+            pendingSurrogate = *source++;
+        } else if (source < end) {
+            sink(data.get(), qint64(used));
+            used = 0;
+        }
+    }
+}
+
+template <typename Sink>
+void Utf8Encoder::finish(Sink &&sink) {
+    if (pendingSurrogate) {
+        // Encoded as U+FFFD.
+        const char16_t single[1] = {pendingSurrogate};
+        const char16_t *from = single;
+        char *output = data.get() + used;
+        if (capacity - used < 3) {
+            sink(data.get(), qint64(used));
+            output = data.get();
+        }
+        encodeRun(from, single + 1, output, data.get() + capacity, true);
+        used = output - data.get();
+        pendingSurrogate = 0;
+    }
+
+    if (used > 0) {
+        sink(data.get(), qint64(used));
+        used = 0;
+    }
+}
+
+#endif // UTF8ENCODER_H
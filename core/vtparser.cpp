@@ -0,0 +1,224 @@
+#include "vtparser.h"
+
+#include <array>
+#include <cstring>
+
+namespace {
+
+using Table = std::array<std::array<quint8, 256>, VtParser::StateCount>;
+
+constexpr quint8 pack(VtParser::Action action, VtParser::State state) {
+    return quint8(action | state << 4);
+}
+
+constexpr Table buildTable() {
+    Table table{};
+    auto range = [&table](VtParser::State from, int low, int high, VtParser::Action action, VtParser::State to) {
+        for (int byte = low; byte <= high; ++byte) {
+            table[from][byte] = pack(action, to);
+        }
+    };
+
+    for (int i = 0; i < VtParser::StateCount; ++i) {
+        const auto state = VtParser::State(i);
+        const bool string = state == VtParser::OscString || state == VtParser::IgnoreString;
+
+        // C0 controls take effect in the middle of a sequence, except
+        // inside strings where they are dropped.
+        range(state, 0x00, 0x1f, string ? VtParser::Ignore : VtParser::Execute, state);
+        range(state, 0x20, 0xff, VtParser::Ignore, state);
+
+        // These interrupt anything.
+        range(state, 0x18, 0x18, VtParser::Execute, VtParser::Ground);
+        range(state, 0x1a, 0x1a, VtParser::Execute, VtParser::Ground);
+        range(state, 0x1b, 0x1b, VtParser::None, VtParser::Escape);
+    }
+
+    // Bytes from 0x80 up are UTF-8 text, not C1 controls.
+    range(VtParser::Ground, 0x20, 0xff, VtParser::Print, VtParser::Ground);
+    range(VtParser::Ground, 0x7f, 0x7f, VtParser::Ignore, VtParser::Ground);
+
+    range(VtParser::Escape, 0x20, 0x2f, VtParser::Collect, VtParser::EscapeIntermediate);
+    range(VtParser::Escape, 0x30, 0x7e, VtParser::EscDispatch, VtParser::Ground);
+    range(VtParser::Escape, '[', '[', VtParser::None, VtParser::CsiEntry);
+    range(VtParser::Escape, ']', ']', VtParser::None, VtParser::OscString);
+    range(VtParser::Escape, 'P', 'P', VtParser::None, VtParser::IgnoreString);
+    range(VtParser::Escape, 'X', 'X', VtParser::None, VtParser::IgnoreString);
+    range(VtParser::Escape, '^', '_', VtParser::None, VtParser::IgnoreString);
+
+    range(VtParser::EscapeIntermediate, 0x20, 0x2f, VtParser::Collect, VtParser::EscapeIntermediate);
+    range(VtParser::EscapeIntermediate, 0x30, 0x7e, VtParser::EscDispatch, VtParser::Ground);
+
+    // Colons separate sub-parameters (38:2:r:g:b); they are read like ';'.
+    range(VtParser::CsiEntry, 0x20, 0x2f, VtParser::Collect, VtParser::CsiIntermediate);
+    range(VtParser::CsiEntry, 0x30, 0x3b, VtParser::Param, VtParser::CsiParam);
+    range(VtParser::CsiEntry, 0x3c, 0x3f, VtParser::Collect, VtParser::CsiParam);
+    range(VtParser::CsiEntry, 0x40, 0x7e, VtParser::CsiDispatch, VtParser::Ground);
+
+    range(VtParser::CsiParam, 0x20, 0x2f, VtParser::Collect, VtParser::CsiIntermediate);
+    range(VtParser::CsiParam, 0x30, 0x3b, VtParser::Param, VtParser::CsiParam);
+    range(VtParser::CsiParam, 0x3c, 0x3f, VtParser::Ignore, VtParser::CsiIgnore);
+    range(VtParser::CsiParam, 0x40, 0x7e, VtParser::CsiDispatch, VtParser::Ground);
+
+    range(VtParser::CsiIntermediate, 0x20, 0x2f, VtParser::Collect, VtParser::CsiIntermediate);
+    range(VtParser::CsiIntermediate, 0x30, 0x3f, VtParser::Ignore, VtParser::CsiIgnore);
+    range(VtParser::CsiIntermediate, 0x40, 0x7e, VtParser::CsiDispatch, VtParser::Ground);
+
+    range(VtParser::CsiIgnore, 0x40, 0x7e, VtParser::Ignore, VtParser::Ground);
+
+    // BEL ends an OSC as well as ST does; xterm accepts both.
+    range(VtParser::OscString, 0x20, 0xff, VtParser::OscPut, VtParser::OscString);
+    range(VtParser::OscString, 0x07, 0x07, VtParser::None, VtParser::Ground);
+    range(VtParser::IgnoreString, 0x07, 0x07, VtParser::None, VtParser::Ground);
+
+    return table;
+}
+
+constexpr Table transitions = buildTable();
+
+// Returns the first C0 control or DEL at or after p.
+const uchar *scanText(const uchar *p, const uchar *end) {
+    constexpr quint64 ones = 0x0101010101010101ULL;
+    constexpr quint64 highs = 0x8080808080808080ULL;
+
+    while (end - p >= 8) {
+        quint64 word;
+        std::memcpy(&word, p, sizeof(word));
+        // Nonzero exactly when some byte is below 0x20 or equal to 0x7f.
+        const quint64 del = word ^ (ones * 0x7f);
+        const quint64 stops = ((word - ones * 0x20) & ~word & highs) | ((del - ones) & ~del & highs);
+        if (stops) break;
+        p += 8;
+    }
+    while (p < end && *p >= 0x20 && *p != 0x7f) {
+        ++p;
+    }
+    return p;
+}
+
+} // namespace
+
+VtParser::VtParser(Handler *parserHandler)
+    : handler(parserHandler)
+    , state(Ground)
+    , intermediateCount(0)
+    , overflowed(false)
+    , decoder(QStringConverter::Utf8)
+{
+}
+
+void VtParser::reset() {
+    state = Ground;
+    params.count = 0;
+    intermediateCount = 0;
+    overflowed = false;
+    osc.clear();
+    decoder.resetState();
+}
+
+void VtParser::feed(QByteArrayView bytes) {
+    const uchar *p = reinterpret_cast<const uchar*>(bytes.data());
+    const uchar *end = p + bytes.size();
+
+    while (p < end) {
+        if (state == Ground) {
+            const uchar *run = p;
+            p = scanText(p, end);
+            if (p > run) {
+                print(run, p);
+                continue;
+            }
+        }
+
+        const quint8 entry = transitions[state][*p];
+        const State next = State(entry >> 4);
+        perform(Action(entry & 0x0f), *p);
+        // ESC restarts a sequence even from the escape state.
+        if (next != state || *p == 0x1b) {
+            enter(next);
+        }
+        ++p;
+    }
+}
+
+void VtParser::print(const uchar *begin, const uchar *end) {
+    const QByteArrayView bytes(begin, end - begin);
+    const qsizetype space = decoder.requiredSpace(bytes.size());
+    if (text.size() < space) {
+        text.resize(space);
+    }
+
+    // Decoded into a buffer kept between calls; a sequence split across
+    // two reads is completed by the decoder's state.
+    QChar *out = text.data();
+    QChar *last = decoder.appendToBuffer(out, bytes);
+    if (last > out) {
+        handler->print(QStringView(out, last - out));
+    }
+}
+
+void VtParser::perform(Action action, uchar byte) {
+    switch (action) {
+    case Print:
+        print(&byte, &byte + 1);
+        break;
+    case Execute:
+        handler->execute(char(byte));
+        break;
+    case Collect:
+        if (intermediateCount < MaxIntermediates) {
+            intermediates[intermediateCount++] = char(byte);
+        } else {
+            overflowed = true;
+        }
+        break;
+    case Param:
+        if (params.count == 0) {
+            params.values[0] = -1;
+            params.count = 1;
+        }
+        if (byte == ';' || byte == ':') {
+            if (params.count < MaxParams) {
+                params.values[params.count++] = -1;
+            } else {
+                overflowed = true;
+            }
+        } else {
+            int &value = params.values[params.count - 1];
+            value = qMin(qMax(value, 0) * 10 + (byte - '0'), 0xffff);
+        }
+        break;
+    case EscDispatch:
+        if (!overflowed) {
+            handler->escDispatch(QByteArrayView(intermediates, intermediateCount), char(byte));
+        }
+        break;
+    case CsiDispatch:
+        if (!overflowed) {
+            handler->csiDispatch(params, QByteArrayView(intermediates, intermediateCount), char(byte));
+        }
+        break;
+    case OscPut:
+        if (osc.size() < MaxOscLength) {
+            osc.append(char(byte));
+        }
+        break;
+    case None:
+    case Ignore:
+        break;
+    }
+}
+
+void VtParser::enter(State next) {
+    if (state == OscString) {
+        handler->oscDispatch(osc);
+        osc.clear();
+    }
+
+    state = next;
+    if (next == Escape || next == CsiEntry) {
+        params.count = 0;
+        intermediateCount = 0;
+        overflowed = false;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef VTPARSER_H
+#define VTPARSER_H
+
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QStringDecoder>
+#include <QStringView>
+
+// Splits a VT100/xterm byte stream into printable text, control characters
+// and escape sequences, following the DEC ANSI parser state machine. Every
+// state change is a lookup in a transition table built at compile time.
+//
+// Almost all terminal output is plain text, so in the ground state the
+// parser does not walk the table byte by byte: it scans eight bytes at a
+// time for the next control byte and hands the whole run to print() at
+// once, decoded from UTF-8.
+class VtParser {
+public:
+    static constexpr int MaxParams = 16;
+    static constexpr int MaxIntermediates = 4;
+    static constexpr qsizetype MaxOscLength = 4096;
+
+    struct Params {
+        int values[MaxParams];
+        int count = 0;
+
+        // Parameter index, or fallback when it was left out.
+        int value(int index, int fallback) const {
+            return index < count && values[index] >= 0 ? values[index] : fallback;
+        }
+    };
+
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+
+        virtual void print(QStringView text) = 0;
+        virtual void execute(char control) = 0;
+        // intermediates starts with the private marker ('?', '>'...) if any.
+        virtual void csiDispatch(const Params &params, QByteArrayView intermediates, char final) = 0;
+        virtual void escDispatch(QByteArrayView intermediates, char final) = 0;
+        virtual void oscDispatch(QByteArrayView data) = 0;
+    };
+
+    explicit VtParser(Handler *handler);
+
+    void feed(QByteArrayView bytes);
+    void reset();
+
+    enum State : quint8 {
+        Ground,
+        Escape,
+        EscapeIntermediate,
+        CsiEntry,
+        CsiParam,
+        CsiIntermediate,
+        CsiIgnore,
+        OscString,
+        IgnoreString,
+        StateCount
+    };
+
+    enum Action : quint8 {
+        None,
+        Print,
+        Execute,
+        Collect,
+        Param,
+        EscDispatch,
+        CsiDispatch,
+        OscPut,
+        Ignore
+    };
+
+private:
+    void print(const uchar *begin, const uchar *end);
+    void perform(Action action, uchar byte);
+    void enter(State next);
+
+    Handler *handler;
+    State state;
+    Params params;
+    char intermediates[MaxIntermediates];
+    int intermediateCount;
+    bool overflowed;
+    QByteArray osc;
+    QStringDecoder decoder;
+    QString text;
+};
+
+#endif // VTPARSER_H
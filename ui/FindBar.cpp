@@ -0,0 +1,218 @@
+#include "FindBar.h"
+#include "../core/codeeditor.h"
+
+#include <QGridLayout>
+#include <QGuiApplication>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QToolButton>
+
+FindBar::FindBar(QWidget *parent) : QWidget(parent) {
+    setupUI();
+    hide();
+}
+
+void FindBar::setupUI() {
+    QGridLayout *layout = new QGridLayout(this);
+    layout->setContentsMargins(5, 2, 5, 2);
+    layout->setHorizontalSpacing(4);
+    layout->setVerticalSpacing(2);
+
+    auto makeButton = [this](const QString &text, const QString &toolTip, bool checkable) {
+        QToolButton *button = new QToolButton(this);
+        button->setText(text);
+        button->setToolTip(toolTip);
+        button->setCheckable(checkable);
+        button->setAutoRaise(true);
+        return button;
+    };
+
+    findEdit = new QLineEdit(this);
+    findEdit->setPlaceholderText("Find");
+    findEdit->setClearButtonEnabled(true);
+    connect(findEdit, &QLineEdit::textChanged, this, &FindBar::applyQuery);
+    connect(findEdit, &QLineEdit::returnPressed, this, [this]() {
+        if (QGuiApplication::keyboardModifiers() & Qt::ShiftModifier) {
+            findPrevious();
+        } else {
+            findNext();
+        }
+    });
+
+    caseButton = makeButton("Aa", "Match Case", true);
+    wordButton = makeButton("W", "Whole Words", true);
+    regexButton = makeButton(".*", "Regular Expression", true);
+    connect(caseButton, &QToolButton::toggled, this, &FindBar::applyQuery);
+    connect(wordButton, &QToolButton::toggled, this, &FindBar::applyQuery);
+    connect(regexButton, &QToolButton::toggled, this, &FindBar::applyQuery);
+
+    statusLabel = new QLabel(this);
+    statusLabel->setMinimumWidth(110);
+
+    previousButton = makeButton("↑", "Find Previous (Shift+Enter)", false);
+    nextButton = makeButton("↓", "Find Next (Enter)", false);
+    closeButton = makeButton("×", "Close (Esc)", false);
+    connect(previousButton, &QToolButton::clicked, this, &FindBar::findPrevious);
+    connect(nextButton, &QToolButton::clicked, this, &FindBar::findNext);
+    connect(closeButton, &QToolButton::clicked, this, &FindBar::closeBar);
+
+    replaceEdit = new QLineEdit(this);
+    replaceEdit->setPlaceholderText("Replace");
+    connect(replaceEdit, &QLineEdit::returnPressed, this, &FindBar::replaceNext);
+
+    replaceButton = makeButton("Replace", "Replace and Find Next", false);
+    replaceAllButton = makeButton("All", "Replace All", false);
+    connect(replaceButton, &QToolButton::clicked, this, &FindBar::replaceNext);
+    connect(replaceAllButton, &QToolButton::clicked, this, &FindBar::replaceAll);
+
+    layout->addWidget(findEdit, 0, 0);
+    layout->addWidget(caseButton, 0, 1);
+    layout->addWidget(wordButton, 0, 2);
+    layout->addWidget(regexButton, 0, 3);
+    layout->addWidget(statusLabel, 0, 4);
+    layout->addWidget(previousButton, 0, 5);
+    layout->addWidget(nextButton, 0, 6);
+    layout->addWidget(closeButton, 0, 7);
+    layout->addWidget(replaceEdit, 1, 0);
+    layout->addWidget(replaceButton, 1, 1, 1, 3);
+    layout->addWidget(replaceAllButton, 1, 4, Qt::AlignLeft);
+    layout->setColumnStretch(0, 1);
+
+    setReplaceVisible(false);
+}
+
+void FindBar::setEditor(CodeEditor *newEditor) {
+    if (editor == newEditor) return;
+
+    if (editor) {
+        disconnect(editor, &CodeEditor::searchResultsChanged, this, &FindBar::updateStatus);
+        editor->clearSearch();
+    }
+    editor = newEditor;
+    if (editor) {
+        connect(editor, &CodeEditor::searchResultsChanged, this, &FindBar::updateStatus);
+    }
+
+    if (isVisible()) {
+        applyQuery();
+    }
+    updateStatus();
+}
+
+void FindBar::showFind() {
+    setReplaceVisible(false);
+    show();
+
+    // Starts from the selection when it is a single line.
+    if (editor) {
+        const QString selected = editor->textCursor().selectedText();
+        if (!selected.isEmpty() && !selected.contains(QChar::ParagraphSeparator)) {
+            findEdit->setText(selected);
+        }
+    }
+    findEdit->setFocus();
+    findEdit->selectAll();
+    applyQuery();
+}
+
+void FindBar::showReplace() {
+    showFind();
+    setReplaceVisible(true);
+}
+
+void FindBar::findNext() {
+    if (!isVisible()) {
+        showFind();
+        return;
+    }
+    if (editor) {
+        editor->findNext(false);
+    }
+}
+
+void FindBar::findPrevious() {
+    if (!isVisible()) {
+        showFind();
+        return;
+    }
+    if (editor) {
+        editor->findNext(true);
+    }
+}
+
+void FindBar::closeBar() {
+    hide();
+    if (editor) {
+        editor->clearSearch();
+        editor->setFocus();
+    }
+}
+
+void FindBar::keyPressEvent(QKeyEvent *event) {
+    if (event->key() == Qt::Key_Escape) {
+        closeBar();
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
+
+void FindBar::applyQuery() {
+    if (!editor) return;
+
+    if (findEdit->text().isEmpty()) {
+        editor->clearSearch();
+        updateStatus();
+        return;
+    }
+
+    TextSearch::Query query;
+    query.pattern = findEdit->text();
+    query.caseSensitive = caseButton->isChecked();
+    query.wholeWords = wordButton->isChecked();
+    query.regularExpression = regexButton->isChecked();
+    editor->setSearchQuery(query);
+}
+
+void FindBar::replaceNext() {
+    if (editor) {
+        editor->replaceNext(replaceEdit->text());
+    }
+}
+
+void FindBar::replaceAll() {
+    if (!editor) return;
+
+    const qint64 count = editor->replaceAll(replaceEdit->text());
+    emit replacedAll(count);
+}
+
+void FindBar::updateStatus() {
+    if (!editor || !editor->hasSearch()) {
+        statusLabel->clear();
+        return;
+    }
+
+    const QString error = editor->searchError();
+    if (!error.isEmpty()) {
+        statusLabel->setText("Invalid pattern");
+        statusLabel->setToolTip(error);
+        return;
+    }
+    statusLabel->setToolTip(QString());
+
+    const qint64 count = editor->searchMatchCount();
+    if (editor->isSearchTruncated()) {
+        statusLabel->setText(QString("%1+ matches").arg(count));
+    } else if (!editor->isSearchComplete()) {
+        statusLabel->setText(QString("%1 matches…").arg(count));
+    } else {
+        statusLabel->setText(count == 1 ? QString("1 match") : QString("%1 matches").arg(count));
+    }
+}
+
+void FindBar::setReplaceVisible(bool visible) {
+    replaceEdit->setVisible(visible);
+    replaceButton->setVisible(visible);
+    replaceAllButton->setVisible(visible);
+}
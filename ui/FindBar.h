@@ -0,0 +1,62 @@
+#ifndef FINDBAR_H
+#define FINDBAR_H
+
+#pragma once
+#include <QWidget>
+#include <QPointer>
+
+class CodeEditor;
+class QLabel;
+class QLineEdit;
+class QToolButton;
+
+// Find and replace for the current tab, shown under the editor tabs. The
+// query is applied as it is typed; counting and highlighting run in the
+// editor, so the bar only shows where they are.
+class FindBar : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit FindBar(QWidget *parent = nullptr);
+
+    void setEditor(CodeEditor *editor);
+
+signals:
+    void replacedAll(qint64 count);
+
+public slots:
+    void showFind();
+    void showReplace();
+    void findNext();
+    void findPrevious();
+    void closeBar();
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void applyQuery();
+    void replaceNext();
+    void replaceAll();
+    void updateStatus();
+
+private:
+    void setupUI();
+    void setReplaceVisible(bool visible);
+
+    QPointer<CodeEditor> editor;
+
+    QLineEdit *findEdit;
+    QLineEdit *replaceEdit;
+    QToolButton *caseButton;
+    QToolButton *wordButton;
+    QToolButton *regexButton;
+    QToolButton *previousButton;
+    QToolButton *nextButton;
+    QToolButton *replaceButton;
+    QToolButton *replaceAllButton;
+    QToolButton *closeButton;
+    QLabel *statusLabel;
+};
+
+#endif //FINDBAR_H
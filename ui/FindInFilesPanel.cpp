@@ -0,0 +1,239 @@
+#include "FindInFilesPanel.h"
+
+#include <QDir>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QToolButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include <utility>
+
+// Where a hit item keeps its position; file items keep their path.
+static const int LineRole = Qt::UserRole;
+static const int ColumnRole = Qt::UserRole + 1;
+static const int LengthRole = Qt::UserRole + 2;
+static const int PathRole = Qt::UserRole + 3;
+
+FindInFilesPanel::FindInFilesPanel(QWidget *parent)
+    : QWidget(parent)
+    , hitCount(0)
+{
+    setupUI();
+    hide();
+}
+
+void FindInFilesPanel::setupUI() {
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(2, 2, 2, 2);
+    mainLayout->setSpacing(2);
+
+    QWidget *headerWidget = new QWidget(this);
+    QHBoxLayout *headerLayout = new QHBoxLayout(headerWidget);
+    headerLayout->setContentsMargins(5, 2, 5, 2);
+
+    QLabel *titleLabel = new QLabel("Find in Files", headerWidget);
+    QFont titleFont = titleLabel->font();
+    titleFont.setBold(true);
+    titleLabel->setFont(titleFont);
+
+    auto makeButton = [headerWidget](const QString &text, const QString &toolTip, bool checkable) {
+        QToolButton *button = new QToolButton(headerWidget);
+        button->setText(text);
+        button->setToolTip(toolTip);
+        button->setCheckable(checkable);
+        button->setAutoRaise(true);
+        return button;
+    };
+
+    queryEdit = new QLineEdit(headerWidget);
+    queryEdit->setPlaceholderText("Search the folder");
+    queryEdit->setClearButtonEnabled(true);
+    connect(queryEdit, &QLineEdit::returnPressed, this, &FindInFilesPanel::startSearch);
+
+    caseButton = makeButton("Aa", "Match Case", true);
+    wordButton = makeButton("W", "Whole Words", true);
+    regexButton = makeButton(".*", "Regular Expression", true);
+
+    searchButton = makeButton("Search", "Search (Enter)", false);
+    connect(searchButton, &QToolButton::clicked, this, [this]() {
+        if (currentSearch && currentSearch->isRunning()) {
+            stopSearch();
+        } else {
+            startSearch();
+        }
+    });
+
+    closeButton = makeButton("×", "Close (Esc)", false);
+    connect(closeButton, &QToolButton::clicked, this, &FindInFilesPanel::closePanel);
+
+    rootLabel = new QLabel(headerWidget);
+    rootLabel->setStyleSheet("color: gray;");
+
+    statusLabel = new QLabel(headerWidget);
+
+    headerLayout->addWidget(titleLabel);
+    headerLayout->addWidget(queryEdit, 1);
+    headerLayout->addWidget(caseButton);
+    headerLayout->addWidget(wordButton);
+    headerLayout->addWidget(regexButton);
+    headerLayout->addWidget(searchButton);
+    headerLayout->addWidget(statusLabel);
+    headerLayout->addWidget(rootLabel);
+    headerLayout->addWidget(closeButton);
+
+    results = new QTreeWidget(this);
+    results->setHeaderHidden(true);
+    results->setColumnCount(1);
+    results->setUniformRowHeights(true);
+    results->setRootIsDecorated(true);
+    results->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    connect(results, &QTreeWidget::itemClicked, this, &FindInFilesPanel::onItemClicked);
+    connect(results, &QTreeWidget::itemActivated, this, &FindInFilesPanel::onItemClicked);
+
+    mainLayout->addWidget(headerWidget);
+    mainLayout->addWidget(results, 1);
+}
+
+void FindInFilesPanel::showFor(const QString &root, const QString &text) {
+    rootPath = root;
+    rootLabel->setText(QDir::toNativeSeparators(root));
+    if (!text.isEmpty()) {
+        queryEdit->setText(text);
+    }
+
+    show();
+    queryEdit->setFocus();
+    queryEdit->selectAll();
+}
+
+void FindInFilesPanel::showReferences(const QString &root, const QString &name, const QStringList &files) {
+    showFor(root, name);
+    caseButton->setChecked(true);
+    wordButton->setChecked(true);
+    regexButton->setChecked(false);
+    referencingFiles = files;
+    startSearch();
+}
+
+void FindInFilesPanel::startSearch() {
+    const QStringList files = std::exchange(referencingFiles, QStringList());
+
+    // Deleting the previous search cancels it and waits for its workers.
+    delete currentSearch;
+    results->clear();
+    fileItems.clear();
+    hitCount = 0;
+    searchButton->setText("Search");
+
+    if (queryEdit->text().isEmpty() || rootPath.isEmpty()) {
+        updateStatus();
+        return;
+    }
+
+    TextSearch::Query query;
+    query.pattern = queryEdit->text();
+    query.caseSensitive = caseButton->isChecked();
+    query.wholeWords = wordButton->isChecked();
+    query.regularExpression = regexButton->isChecked();
+
+    const TextSearch check(query);
+    if (!check.isValid()) {
+        statusLabel->setText("Invalid pattern");
+        statusLabel->setToolTip(check.errorString());
+        return;
+    }
+    statusLabel->setToolTip(QString());
+
+    currentSearch = new FindInFiles(rootPath, query, this);
+    currentSearch->setFiles(files);
+    connect(currentSearch, &FindInFiles::hitsFound, this, &FindInFilesPanel::onHitsFound);
+    connect(currentSearch, &FindInFiles::finished, this, &FindInFilesPanel::onSearchFinished);
+    searchClock.start();
+    currentSearch->start();
+
+    searchButton->setText("Stop");
+    updateStatus();
+}
+
+void FindInFilesPanel::stopSearch() {
+    if (currentSearch) {
+        currentSearch->cancel();
+    }
+}
+
+void FindInFilesPanel::closePanel() {
+    stopSearch();
+    hide();
+}
+
+void FindInFilesPanel::keyPressEvent(QKeyEvent *event) {
+    if (event->key() == Qt::Key_Escape) {
+        closePanel();
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
+
+void FindInFilesPanel::onHitsFound(const QVector<FindInFiles::Hit> &hits) {
+    const QDir root(rootPath);
+    results->setUpdatesEnabled(false);
+    for (const FindInFiles::Hit &hit : hits) {
+        QTreeWidgetItem *&fileItem = fileItems[hit.filePath];
+        if (!fileItem) {
+            fileItem = new QTreeWidgetItem(results);
+            fileItem->setData(0, PathRole, hit.filePath);
+            fileItem->setExpanded(true);
+        }
+
+        QTreeWidgetItem *item = new QTreeWidgetItem(fileItem);
+        item->setText(0, QString("%1: %2").arg(hit.line + 1).arg(hit.text.trimmed()));
+        item->setData(0, LineRole, hit.line);
+        item->setData(0, ColumnRole, hit.column);
+        item->setData(0, LengthRole, hit.length);
+        fileItem->setText(0, QString("%1 (%2)")
+            .arg(QDir::toNativeSeparators(root.relativeFilePath(hit.filePath)))
+            .arg(fileItem->childCount()));
+    }
+    results->setUpdatesEnabled(true);
+
+    hitCount += hits.size();
+    updateStatus();
+}
+
+void FindInFilesPanel::onSearchFinished() {
+    searchButton->setText("Search");
+    updateStatus();
+}
+
+void FindInFilesPanel::onItemClicked(QTreeWidgetItem *item) {
+    QTreeWidgetItem *fileItem = item ? item->parent() : nullptr;
+    if (!fileItem) return;
+
+    emit openRequested(fileItem->data(0, PathRole).toString(),
+                       item->data(0, LineRole).toLongLong(),
+                       item->data(0, ColumnRole).toInt(),
+                       item->data(0, LengthRole).toInt());
+}
+
+void FindInFilesPanel::updateStatus() {
+    if (!currentSearch) {
+        statusLabel->clear();
+        return;
+    }
+
+    QString status = QString("%1 hits in %2 files").arg(hitCount).arg(fileItems.size());
+    if (currentSearch->isTruncated()) {
+        status = QString("First %1 hits in %2 files").arg(hitCount).arg(fileItems.size());
+    }
+    if (currentSearch->isRunning()) {
+        status += QString(", searching… (%1 files)").arg(currentSearch->filesSearched());
+    } else {
+        status += QString(" (%1 files searched in %2 ms)")
+            .arg(currentSearch->filesSearched()).arg(searchClock.elapsed());
+    }
+    statusLabel->setText(status);
+}
@@ -0,0 +1,73 @@
+#ifndef FINDINFILESPANEL_H
+#define FINDINFILESPANEL_H
+
+#pragma once
+#include <QWidget>
+#include <QHash>
+#include <QPointer>
+#include <QStringList>
+#include <QElapsedTimer>
+
+#include "../core/findinfiles.h"
+
+class QLabel;
+class QLineEdit;
+class QToolButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+// Results of a search across the open folder, grouped by file. Hits are
+// added as the workers find them; clicking one opens the file at the hit.
+class FindInFilesPanel : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit FindInFilesPanel(QWidget *parent = nullptr);
+
+    // Shows the panel for searching under rootPath, starting from text
+    // when it is not empty.
+    void showFor(const QString &rootPath, const QString &text = QString());
+    // Searches files, the ones the symbol index says mention name, for name
+    // as a whole, case-sensitive word.
+    void showReferences(const QString &rootPath, const QString &name, const QStringList &files);
+
+signals:
+    void openRequested(const QString &filePath, qint64 line, int column, int length);
+
+public slots:
+    void startSearch();
+    void stopSearch();
+    void closePanel();
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void onHitsFound(const QVector<FindInFiles::Hit> &hits);
+    void onSearchFinished();
+    void onItemClicked(QTreeWidgetItem *item);
+
+private:
+    void setupUI();
+    void updateStatus();
+
+    QString rootPath;
+    // Set by showReferences() for the one search it starts.
+    QStringList referencingFiles;
+    QPointer<FindInFiles> currentSearch;
+    QHash<QString, QTreeWidgetItem*> fileItems;
+    qint64 hitCount;
+    QElapsedTimer searchClock;
+
+    QLineEdit *queryEdit;
+    QToolButton *caseButton;
+    QToolButton *wordButton;
+    QToolButton *regexButton;
+    QToolButton *searchButton;
+    QToolButton *closeButton;
+    QLabel *rootLabel;
+    QLabel *statusLabel;
+    QTreeWidget *results;
+};
+
+#endif //FINDINFILESPANEL_H
@@ -4,22 +4,51 @@
 #include "AboutDialog.h"
 #include "StatusBar.h"
 #include "TerminalWidget.h"
+#include "FindBar.h"
+#include "FindInFilesPanel.h"
+#include "QuickOpenDialog.h"
+#include "OutlinePanel.h"
+#include "TabPlaceholder.h"
 #include "../core/codeeditor.h"
+#include "../core/mappedfile.h"
+#include "../core/documentwriter.h"
+#include "../core/pathindex.h"
+#include "../core/filetreemodel.h"
+#include "../core/symbolindex.h"
+#include "../core/highlighter/highlightcache.h"
 
-#include <QFileSystemModel>
 #include <QTreeView>
 #include <QTabWidget>
 #include <QSplitter>
+#include <QVBoxLayout>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileDialog>
 #include <QSettings>
 #include <QKeyEvent>
+#include <QMenu>
+#include <QStandardPaths>
+#include <QSet>
+#include <QUuid>
+
+#include <algorithm>
+
+// How often the tabs are weighed against the memory budget.
+static const int MemoryCheckMilliseconds = 2000;
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     autoSaveEnabled = true;
     autoSaveInterval = 3;
+    largeFileThreshold = 64;
+    saveSyncPolicy = DocumentWriter::SyncFile;
+    followMaxLines = 100000;
+    memoryBudget = 1024;
+    hydrationPaused = false;
+    tabUseCounter = 0;
+    snapshotDirectory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/snapshots";
+
+    documentWriter = new DocumentWriter(this);
 
     setupUI();
     setupConnections();
@@ -27,34 +56,51 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 
     autoSaveTimer = new QTimer(this);
     autoSaveTimer->setSingleShot(true);
-    connect(autoSaveTimer, &QTimer::timeout, this, &MainWindow::autoSaveCurrentFile);
+    connect(autoSaveTimer, &QTimer::timeout, this, &MainWindow::autoSaveAllFiles);
+
+    connect(documentWriter, &DocumentWriter::saved, this, &MainWindow::onDocumentSaved);
+
+    memoryTimer = new QTimer(this);
+    memoryTimer->setInterval(MemoryCheckMilliseconds);
+    connect(memoryTimer, &QTimer::timeout, this, &MainWindow::checkMemoryBudget);
+    memoryTimer->start();
 }
 
 MainWindow::~MainWindow() {
     saveSettings();
+
+    autoSaveAllFiles();
+    documentWriter->flush();
+    disconnect(documentWriter, nullptr, this, nullptr);
 }
 
 void MainWindow::setupUI() {
-    fileSystemModel = new QFileSystemModel(this);
-    fileSystemModel->setRootPath("");
-    fileSystemModel->setFilter(QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot);
+    // Lists nothing until restoreSettings gives it a folder.
+    fileTreeModel = new FileTreeModel(this);
 
     // Налаштування дерева файлів
     treeView = new QTreeView(this);
-    treeView->setModel(fileSystemModel);
-    treeView->setRootIndex(fileSystemModel->index(QDir::homePath()));
-
-    treeView->setColumnHidden(1, true);
-    treeView->setColumnHidden(2, true);
-    treeView->setColumnHidden(3, true);
+    treeView->setModel(fileTreeModel);
     treeView->setHeaderHidden(true);
 
-    treeView->setMaximumWidth(300);
-    treeView->setMinimumWidth(150);
-
     treeView->setAnimated(true);
     treeView->setIndentation(20);
-    treeView->setSortingEnabled(true);
+    // The model keeps its rows in order itself.
+    treeView->setUniformRowHeights(true);
+
+    symbolIndex = new SymbolIndex(this);
+    highlightCache = new HighlightCache(this);
+    outlinePanel = new OutlinePanel(symbolIndex, this);
+    outlinePanel->hide();
+
+    // The outline sits under the tree and keeps its width limits.
+    sideSplitter = new QSplitter(Qt::Vertical, this);
+    sideSplitter->addWidget(treeView);
+    sideSplitter->addWidget(outlinePanel);
+    sideSplitter->setStretchFactor(0, 2);
+    sideSplitter->setStretchFactor(1, 1);
+    sideSplitter->setMaximumWidth(300);
+    sideSplitter->setMinimumWidth(150);
 
     tabWidget = new QTabWidget(this);
     tabWidget->setTabsClosable(true);
@@ -64,14 +110,30 @@ void MainWindow::setupUI() {
     terminal = new TerminalWidget(this);
     terminal->setWorkingDirectory(QDir::homePath());
 
+    // The find bar sits under the tabs and follows the current one.
+    findBar = new FindBar(this);
+    QWidget *editorArea = new QWidget(this);
+    QVBoxLayout *editorLayout = new QVBoxLayout(editorArea);
+    editorLayout->setContentsMargins(0, 0, 0, 0);
+    editorLayout->setSpacing(0);
+    editorLayout->addWidget(tabWidget);
+    editorLayout->addWidget(findBar);
+
+    findInFilesPanel = new FindInFilesPanel(this);
+
+    pathIndex = new PathIndex(this);
+    quickOpenDialog = new QuickOpenDialog(pathIndex, this);
+
     editorSplitter = new QSplitter(Qt::Vertical, this);
-    editorSplitter->addWidget(tabWidget);
+    editorSplitter->addWidget(editorArea);
+    editorSplitter->addWidget(findInFilesPanel);
     editorSplitter->addWidget(terminal);
     editorSplitter->setStretchFactor(0, 3);
     editorSplitter->setStretchFactor(1, 1);
+    editorSplitter->setStretchFactor(2, 1);
 
     mainSplitter = new QSplitter(Qt::Horizontal, this);
-    mainSplitter->addWidget(treeView);
+    mainSplitter->addWidget(sideSplitter);
     mainSplitter->addWidget(editorSplitter);
     mainSplitter->setStretchFactor(0, 1);
     mainSplitter->setStretchFactor(1, 4);
@@ -82,7 +144,7 @@ void MainWindow::setupUI() {
     statusBar = new StatusBar(this);
     setStatusBar(statusBar);
 
-    menuBar = new MenuBar(this, tabWidget, treeView, statusBar, fileSystemModel);
+    menuBar = new MenuBar(this, tabWidget, treeView, statusBar, fileTreeModel);
 
     editorFont = QFont("JetBrains Mono", 14);
     editorFont.setFixedPitch(true);
@@ -91,22 +153,59 @@ void MainWindow::setupUI() {
 void MainWindow::setupConnections() {
     connect(tabWidget, &QTabWidget::tabCloseRequested, this, &MainWindow::closeTab);
     connect(treeView, &QTreeView::doubleClicked, this, &MainWindow::onTreeViewDoubleClicked);
+    connect(treeView, &QTreeView::expanded, this, [this](const QModelIndex &index) {
+        fileTreeModel->setExpanded(index, true);
+    });
+    connect(treeView, &QTreeView::collapsed, this, [this](const QModelIndex &index) {
+        fileTreeModel->setExpanded(index, false);
+    });
 
     connect(menuBar, &MenuBar::newFileRequested, this, &MainWindow::onNewFile);
     connect(menuBar, &MenuBar::fileOpenRequested, this, &MainWindow::onOpenFile);
+    connect(menuBar, &MenuBar::fileFollowRequested, this, &MainWindow::onFollowFile);
     connect(menuBar, &MenuBar::saveFileRequested, this, &MainWindow::onSaveFile);
     connect(menuBar, &MenuBar::settingsRequested, this, &MainWindow::onShowSettings);
     connect(menuBar, &MenuBar::aboutRequested, this, &MainWindow::onShowAbout);
 
+    connect(menuBar, &MenuBar::findRequested, findBar, &FindBar::showFind);
+    connect(menuBar, &MenuBar::replaceRequested, findBar, &FindBar::showReplace);
+    connect(menuBar, &MenuBar::findNextRequested, findBar, &FindBar::findNext);
+    connect(menuBar, &MenuBar::findPreviousRequested, findBar, &FindBar::findPrevious);
+    connect(menuBar, &MenuBar::findInFilesRequested, this, &MainWindow::onFindInFiles);
+    connect(findInFilesPanel, &FindInFilesPanel::openRequested, this, &MainWindow::onOpenFileAt);
+
+    connect(menuBar, &MenuBar::quickOpenRequested, this, &MainWindow::onQuickOpen);
+    connect(menuBar, &MenuBar::folderOpened, pathIndex, &PathIndex::setRoot);
+    // Saves only rescan the saved file; files that come or go are noticed
+    // by the path index's watcher.
+    connect(pathIndex, &PathIndex::filesChanged, symbolIndex, &SymbolIndex::refresh);
+    connect(quickOpenDialog, &QuickOpenDialog::fileChosen, this, &MainWindow::onQuickOpenFile);
+
+    connect(menuBar, &MenuBar::folderOpened, symbolIndex, &SymbolIndex::setRoot);
+    connect(menuBar, &MenuBar::goToDefinitionRequested, this, &MainWindow::onGoToDefinition);
+    connect(menuBar, &MenuBar::findReferencesRequested, this, &MainWindow::onFindReferences);
+    connect(menuBar, &MenuBar::outlineRequested, this, &MainWindow::onShowOutline);
+    connect(outlinePanel, &OutlinePanel::openRequested, this, &MainWindow::onOpenFileAt);
+
     connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onTabChanged);
+
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+    if (customStatusBar) {
+        connect(customStatusBar, &StatusBar::loadCancelRequested, this, &MainWindow::cancelLoading);
+        connect(findBar, &FindBar::replacedAll, this, [customStatusBar](qint64 count) {
+            customStatusBar->showMessage(QString("Replaced %1 occurrences").arg(count), 3000);
+        });
+    }
 }
 
-CodeEditor* MainWindow::createEditorTab(const QString &title, const QString &content, const QString &filePath) {
+CodeEditor* MainWindow::createEditorTab(const QString &title, const QString &content, const QString &filePath,
+                                        int tabIndex) {
     CodeEditor *editor = new CodeEditor;
     editor->setFont(editorFont);
     editor->setPlainText(content);
     editor->setProperty("filePath", filePath);
     editor->setLineWrapMode(QPlainTextEdit::NoWrap);
+    editor->setHighlightCache(highlightCache);
 
     if (!filePath.isEmpty()) {
         editor->detectAndApplySyntaxHighlighting(filePath);
@@ -118,7 +217,7 @@ CodeEditor* MainWindow::createEditorTab(const QString &title, const QString &con
     connect(editor, &QPlainTextEdit::textChanged,
             this, &MainWindow::onTextChanged);
 
-    int index = tabWidget->addTab(editor, title);
+    int index = tabIndex < 0 ? tabWidget->addTab(editor, title) : tabWidget->insertTab(tabIndex, editor, title);
     tabWidget->setCurrentIndex(index);
 
     onCursorPositionChanged();
@@ -128,8 +227,19 @@ CodeEditor* MainWindow::createEditorTab(const QString &title, const QString &con
 
 void MainWindow::closeTab(int index) {
     QWidget *page = tabWidget->widget(index);
+    CodeEditor *editor = dynamic_cast<CodeEditor*>(page);
+    if (editor && autoSaveEnabled) {
+        autoSaveEditor(editor);
+    }
+    // Unsaved text of a released tab goes with it, as it would from the
+    // editor itself.
+    TabPlaceholder *placeholder = qobject_cast<TabPlaceholder*>(page);
+    if (placeholder && !placeholder->snapshotPath().isEmpty()) {
+        QFile::remove(placeholder->snapshotPath());
+    }
     tabWidget->removeTab(index);
     delete page;
+    updateLoadProgress();
 }
 
 void MainWindow::onNewFile() {
@@ -137,21 +247,418 @@ void MainWindow::onNewFile() {
 }
 
 void MainWindow::onOpenFile(const QString &fileName) {
-    QFile file(fileName);
-    if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QFileInfo fileInfo(fileName);
-        QString tabName = fileInfo.fileName();
-        createEditorTab(tabName, file.readAll(), fileName);
+    openFile(fileName, -1);
+}
+
+void MainWindow::openFile(const QString &fileName, int tabIndex) {
+    QFileInfo fileInfo(fileName);
+    if (fileInfo.size() >= qint64(largeFileThreshold) * 1024 * 1024) {
+        openLargeFile(fileName, tabIndex);
+        return;
+    }
 
+    if (!fileInfo.isFile() || !fileInfo.isReadable()) {
         StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
         if (customStatusBar) {
-            customStatusBar->showMessage("Opened: " + fileName, 5000);
+            customStatusBar->showMessage("Failed to open file!", 5000);
+        }
+        return;
+    }
+
+    // Reading and decoding happen on a worker; the tab fills in as chunks
+    // arrive so other tabs stay responsive while big files load.
+    CodeEditor *editor = createEditorTab(fileInfo.fileName(), "", fileName, tabIndex);
+    connect(editor, &CodeEditor::loadProgress, this, &MainWindow::updateLoadProgress);
+    connect(editor, &CodeEditor::loadFinished, this, &MainWindow::onEditorLoadFinished);
+    loadingEditors.append(editor);
+    editor->loadFile(fileName);
+
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+    if (customStatusBar) {
+        customStatusBar->showMessage("Opening: " + fileName);
+    }
+}
+
+CodeEditor *MainWindow::activateFile(const QString &fileName) {
+    // A file that is already open is reused rather than opened again.
+    const QString canonical = QFileInfo(fileName).canonicalFilePath();
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        CodeEditor *candidate = dynamic_cast<CodeEditor*>(tabWidget->widget(i));
+        if (candidate && !candidate->isFollowing()
+            && QFileInfo(candidate->property("filePath").toString()).canonicalFilePath() == canonical) {
+            tabWidget->setCurrentIndex(i);
+            return candidate;
+        }
+
+        TabPlaceholder *placeholder = qobject_cast<TabPlaceholder*>(tabWidget->widget(i));
+        if (placeholder && QFileInfo(placeholder->filePath()).canonicalFilePath() == canonical) {
+            tabWidget->setCurrentIndex(i);
+            hydrateTab(i);
+            return dynamic_cast<CodeEditor*>(tabWidget->currentWidget());
+        }
+    }
+    return nullptr;
+}
+
+void MainWindow::hydrateTab(int index) {
+    TabPlaceholder *placeholder = qobject_cast<TabPlaceholder*>(tabWidget->widget(index));
+    if (!placeholder) return;
+
+    // The file opens in a tab of its own in front of the placeholder, which
+    // then goes; opening checks and reports a file that is gone. The insert
+    // makes the placeholder current again at its new index, which must not
+    // open the file a second time.
+    const int tabsBefore = tabWidget->count();
+    hydrationPaused = true;
+    if (placeholder->snapshotPath().isEmpty()) {
+        openFile(placeholder->filePath(), index);
+    } else {
+        openSnapshot(placeholder->filePath(), placeholder->snapshotPath(), index);
+    }
+    hydrationPaused = false;
+    if (tabWidget->count() > tabsBefore) {
+        CodeEditor *editor = dynamic_cast<CodeEditor*>(tabWidget->widget(index));
+        if (editor) {
+            editor->setUndoHistory(placeholder->takeUndoHistory(), placeholder->undoHistoryHash());
+            editor->restoreView(placeholder->line(), placeholder->column(), placeholder->firstVisibleLine());
+        }
+    }
+    tabWidget->removeTab(tabWidget->indexOf(placeholder));
+    delete placeholder;
+}
+
+void MainWindow::openSnapshot(const QString &filePath, const QString &snapshotPath, int tabIndex) {
+    // The tab is the file's; only the text comes from the snapshot, and it
+    // still has to be saved.
+    CodeEditor *editor = createEditorTab(QFileInfo(filePath).fileName(), "", filePath, tabIndex);
+    editor->setProperty("snapshotPath", snapshotPath);
+    connect(editor, &CodeEditor::loadProgress, this, &MainWindow::updateLoadProgress);
+    connect(editor, &CodeEditor::loadFinished, this, &MainWindow::onEditorLoadFinished);
+    loadingEditors.append(editor);
+    editor->loadFile(snapshotPath, true);
+}
+
+bool MainWindow::canReleaseTab(CodeEditor *editor) const {
+    if (editor->isLoading() || editor->isFollowing()) return false;
+    if (editor->property("filePath").toString().isEmpty()) return false;
+    // A snapshot is written on this thread and read back into a document,
+    // which a large file must never be; those tabs stay until saved.
+    if (editor->hasUnsavedChanges()
+        && (editor->isPaged()
+            || editor->textBuffer().size() >= qint64(largeFileThreshold) * 1024 * 1024)) {
+        return false;
+    }
+    // With autosave on, unsaved changes are on disk within seconds and the
+    // tab can be released on a later check without a snapshot.
+    return !editor->hasUnsavedChanges() || !autoSaveEnabled;
+}
+
+bool MainWindow::releaseTab(int index) {
+    CodeEditor *editor = dynamic_cast<CodeEditor*>(tabWidget->widget(index));
+    if (!editor) return false;
+
+    QString snapshotPath;
+    if (editor->hasUnsavedChanges()) {
+        snapshotPath = snapshotDirectory + QLatin1Char('/')
+                     + QUuid::createUuid().toString(QUuid::WithoutBraces) + ".snapshot";
+        if (!QDir().mkpath(snapshotDirectory)
+            || !DocumentWriter::writeFile(snapshotPath, editor->textBuffer(), DocumentWriter::NoSync)) {
+            QFile::remove(snapshotPath);
+            return false;
+        }
+    }
+
+    const QTextCursor cursor = editor->textCursor();
+    auto *placeholder = new TabPlaceholder(editor->property("filePath").toString(),
+                                           editor->lineNumberOffset() + cursor.blockNumber(),
+                                           cursor.positionInBlock(),
+                                           editor->firstVisibleLine(),
+                                           snapshotPath);
+    quint64 contentHash = 0;
+    std::unique_ptr<UndoHistory> history = editor->takeUndoHistory(&contentHash);
+    placeholder->setUndoHistory(std::move(history), contentHash);
+    hydrationPaused = true;
+    tabWidget->insertTab(index, placeholder, tabWidget->tabText(index));
+    tabWidget->setTabToolTip(index, placeholder->filePath());
+    tabWidget->removeTab(index + 1);
+    hydrationPaused = false;
+    delete editor;
+    return true;
+}
+
+void MainWindow::checkMemoryBudget() {
+    const qint64 budget = qint64(memoryBudget) * 1024 * 1024;
+    qint64 total = 0;
+    QList<CodeEditor*> candidates;
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        CodeEditor *editor = dynamic_cast<CodeEditor*>(tabWidget->widget(i));
+        if (!editor) continue;
+        total += editor->memoryUsage();
+        if (i != tabWidget->currentIndex() && canReleaseTab(editor)) {
+            candidates.append(editor);
+        }
+    }
+
+    // Least recently used first.
+    std::sort(candidates.begin(), candidates.end(), [](CodeEditor *a, CodeEditor *b) {
+        return a->property("lastUsed").toULongLong() < b->property("lastUsed").toULongLong();
+    });
+    int released = 0;
+    for (CodeEditor *editor : std::as_const(candidates)) {
+        if (total <= budget) break;
+        const qint64 usage = editor->memoryUsage();
+        if (releaseTab(tabWidget->indexOf(editor))) {
+            total -= usage;
+            ++released;
+        }
+    }
+
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+    if (customStatusBar) {
+        CodeEditor *currentEditor = dynamic_cast<CodeEditor*>(tabWidget->currentWidget());
+        customStatusBar->setMemoryInfo(currentEditor ? currentEditor->memoryUsage() : 0, total, budget);
+        if (released > 0) {
+            customStatusBar->showMessage(QString("Released %1 tabs to stay under the memory budget").arg(released), 3000);
         }
+    }
+}
+
+void MainWindow::onOpenFileAt(const QString &fileName, qint64 line, int column, int length) {
+    CodeEditor *editor = activateFile(fileName);
+    if (!editor) {
+        const int tabsBefore = tabWidget->count();
+        onOpenFile(fileName);
+        if (tabWidget->count() == tabsBefore) return;
+        editor = dynamic_cast<CodeEditor*>(tabWidget->currentWidget());
+    }
+
+    if (editor) {
+        editor->goToLine(line, column, length);
+        editor->setFocus();
+    }
+}
+
+void MainWindow::onFindInFiles() {
+    QString root = fileTreeModel->rootPath();
+    if (root.isEmpty()) {
+        QSettings settings("ChoraEditor", "Chora");
+        root = settings.value("lastFolder", QDir::homePath()).toString();
+    }
+
+    // Starts from the editor's selection when it is a single line.
+    QString text;
+    CodeEditor *currentEditor = dynamic_cast<CodeEditor*>(tabWidget->currentWidget());
+    if (currentEditor) {
+        text = currentEditor->textCursor().selectedText();
+        if (text.contains(QChar::ParagraphSeparator)) text.clear();
+    }
+    findInFilesPanel->showFor(root, text);
+}
+
+void MainWindow::onQuickOpen() {
+    quickOpenDialog->popup();
+}
+
+void MainWindow::onQuickOpenFile(const QString &fileName) {
+    CodeEditor *editor = activateFile(fileName);
+    if (editor) {
+        editor->setFocus();
     } else {
+        onOpenFile(fileName);
+    }
+}
+
+void MainWindow::onGoToDefinition() {
+    CodeEditor *currentEditor = dynamic_cast<CodeEditor*>(tabWidget->currentWidget());
+    if (!currentEditor) return;
+
+    QTextCursor cursor = currentEditor->textCursor();
+    if (!cursor.hasSelection()) {
+        cursor.select(QTextCursor::WordUnderCursor);
+    }
+    const QString word = cursor.selectedText().trimmed();
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+    if (word.isEmpty() || word.contains(QChar::ParagraphSeparator)) return;
+
+    // On a definition itself, the others (usually its declaration) are
+    // where F12 should go.
+    const QString filePath = currentEditor->property("filePath").toString();
+    const qint64 line = currentEditor->lineNumberOffset() + currentEditor->textCursor().blockNumber();
+    QVector<SymbolIndex::Definition> targets;
+    QVector<SymbolIndex::Definition> declarations;
+    for (const SymbolIndex::Definition &definition : symbolIndex->definitions(word)) {
+        if (definition.line == line && QFileInfo(definition.filePath) == QFileInfo(filePath)) continue;
+        if (definition.declaration) {
+            declarations.append(definition);
+        } else {
+            targets.append(definition);
+        }
+    }
+    if (targets.isEmpty()) targets = declarations;
+
+    if (targets.isEmpty()) {
+        if (customStatusBar) {
+            customStatusBar->showMessage(symbolIndex->isIndexing()
+                ? "Still indexing; no definition of " + word + " yet"
+                : "No definition found for " + word, 5000);
+        }
+        return;
+    }
+    if (targets.size() == 1) {
+        const SymbolIndex::Definition &target = targets.first();
+        onOpenFileAt(target.filePath, target.line, target.column, int(target.name.size()));
+        return;
+    }
+
+    QMenu menu(this);
+    const QDir root(symbolIndex->root());
+    for (const SymbolIndex::Definition &target : std::as_const(targets)) {
+        const QString name = target.scope.isEmpty() ? target.name : target.scope + "::" + target.name;
+        QAction *action = menu.addAction(QString("%1  %2:%3")
+                                             .arg(name, root.relativeFilePath(target.filePath))
+                                             .arg(target.line + 1));
+        connect(action, &QAction::triggered, this, [this, target]() {
+            onOpenFileAt(target.filePath, target.line, target.column, int(target.name.size()));
+        });
+    }
+    const QRect rect = currentEditor->cursorRect();
+    menu.exec(currentEditor->viewport()->mapToGlobal(rect.bottomLeft()));
+}
+
+void MainWindow::onFindReferences() {
+    CodeEditor *currentEditor = dynamic_cast<CodeEditor*>(tabWidget->currentWidget());
+    if (!currentEditor) return;
+
+    QTextCursor cursor = currentEditor->textCursor();
+    if (!cursor.hasSelection()) {
+        cursor.select(QTextCursor::WordUnderCursor);
+    }
+    const QString word = cursor.selectedText().trimmed();
+    if (word.isEmpty() || word.contains(QChar::ParagraphSeparator)) return;
+
+    // The index narrows the search to the files that mention the name;
+    // the panel then finds where.
+    const QStringList files = symbolIndex->filesReferencing(word);
+    if (files.isEmpty()) {
         StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+        if (customStatusBar) {
+            customStatusBar->showMessage(symbolIndex->isIndexing()
+                ? "Still indexing; no references to " + word + " yet"
+                : "No references found to " + word, 5000);
+        }
+        return;
+    }
+    findInFilesPanel->showReferences(symbolIndex->root(), word, files);
+}
+
+void MainWindow::onShowOutline() {
+    outlinePanel->showAndFocus();
+}
+
+void MainWindow::onFollowFile(const QString &fileName) {
+    QFileInfo fileInfo(fileName);
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+
+    if (!fileInfo.isFile() || !fileInfo.isReadable()) {
         if (customStatusBar) {
             customStatusBar->showMessage("Failed to open file!", 5000);
         }
+        return;
+    }
+
+    CodeEditor *editor = createEditorTab(fileInfo.fileName(), "", fileName);
+    editor->followFile(fileName, followMaxLines);
+
+    if (customStatusBar) {
+        customStatusBar->showMessage("Following: " + fileName, 5000);
+    }
+}
+
+void MainWindow::onEditorLoadFinished(bool ok) {
+    CodeEditor *editor = qobject_cast<CodeEditor*>(sender());
+    if (!editor) return;
+
+    loadingEditors.removeAll(editor);
+    updateLoadProgress();
+
+    const QString filePath = editor->property("filePath").toString();
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+
+    if (ok) {
+        // A snapshot read back is not what the file holds, so it is not
+        // remembered and autosave writes it.
+        const QString snapshotPath = editor->property("snapshotPath").toString();
+        if (!snapshotPath.isEmpty()) {
+            QFile::remove(snapshotPath);
+            editor->setProperty("snapshotPath", QVariant());
+        } else {
+            // Lets the writer skip autosaves that would rewrite identical bytes.
+            documentWriter->remember(filePath, editor->textBuffer());
+        }
+        checkMemoryBudget();
+        if (customStatusBar) {
+            customStatusBar->showMessage("Opened: " + filePath, 5000);
+        }
+        return;
+    }
+
+    // A partially loaded tab must never be saved over the original file.
+    int index = tabWidget->indexOf(editor);
+    if (index >= 0) {
+        tabWidget->removeTab(index);
+    }
+    editor->deleteLater();
+
+    if (customStatusBar) {
+        customStatusBar->showMessage("Not opened: " + filePath, 5000);
+    }
+}
+
+void MainWindow::updateLoadProgress() {
+    loadingEditors.removeAll(nullptr);
+
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+    if (!customStatusBar) return;
+
+    if (loadingEditors.isEmpty()) {
+        customStatusBar->clearLoadProgress();
+        return;
+    }
+
+    qint64 bytesRead = 0;
+    qint64 totalBytes = 0;
+    for (const QPointer<CodeEditor> &editor : loadingEditors) {
+        bytesRead += editor->loadedBytes();
+        totalBytes += editor->totalLoadBytes();
+    }
+    customStatusBar->setLoadProgress(bytesRead, totalBytes);
+}
+
+void MainWindow::cancelLoading() {
+    for (const QPointer<CodeEditor> &editor : loadingEditors) {
+        if (editor) {
+            editor->cancelLoading();
+        }
+    }
+}
+
+void MainWindow::openLargeFile(const QString &fileName, int tabIndex) {
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+
+    auto mappedFile = std::make_shared<MappedFile>(fileName);
+    if (!mappedFile->open()) {
+        if (customStatusBar) {
+            customStatusBar->showMessage("Failed to open file!", 5000);
+        }
+        return;
+    }
+
+    CodeEditor *editor = createEditorTab(QFileInfo(fileName).fileName(), "", fileName, tabIndex);
+    editor->openPagedFile(mappedFile);
+    onCursorPositionChanged();
+
+    if (customStatusBar) {
+        customStatusBar->showMessage("Opened large file (editable once indexed): " + fileName, 5000);
     }
 }
 
@@ -159,6 +666,15 @@ void MainWindow::onSaveFile(bool saveAs) {
     CodeEditor *currentEditor = dynamic_cast<CodeEditor*>(tabWidget->currentWidget());
     if (!currentEditor) return;
 
+    if (currentEditor->isReadOnly()) {
+        StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+        if (customStatusBar) {
+            customStatusBar->showMessage(currentEditor->isFollowing()
+                ? "Followed files are read-only" : "File is still loading", 5000);
+        }
+        return;
+    }
+
     QString filePath = currentEditor->property("filePath").toString();
 
     if (filePath.isEmpty() || saveAs) {
@@ -168,14 +684,11 @@ void MainWindow::onSaveFile(bool saveAs) {
             QFileInfo fileInfo(filePath);
             initialDir = fileInfo.absolutePath();
         } else {
-            QModelIndex rootIndex = treeView->rootIndex();
-            if (rootIndex.isValid()) {
-                initialDir = fileSystemModel->filePath(rootIndex);
-            }
+            initialDir = fileTreeModel->rootPath();
 
             QModelIndex currentIndex = treeView->currentIndex();
             if (currentIndex.isValid()) {
-                QString currentPath = fileSystemModel->filePath(currentIndex);
+                QString currentPath = fileTreeModel->filePath(currentIndex);
                 QFileInfo pathInfo(currentPath);
 
                 if (pathInfo.isFile()) {
@@ -195,13 +708,27 @@ void MainWindow::onSaveFile(bool saveAs) {
     }
 
     if (!filePath.isEmpty()) {
-        QFile file(filePath);
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-            file.write(currentEditor->toPlainText().toUtf8());
-            file.close();
+        // Written to a temporary file and renamed over the target: a paged
+        // editor still reads from a mapping of the original file. Pending
+        // autosaves hold older snapshots and must not land after this one.
+        documentWriter->flush();
+        const TextBuffer snapshot = currentEditor->textBuffer();
+        const bool created = !QFileInfo::exists(filePath);
+        if (DocumentWriter::writeFile(filePath, snapshot,
+                                      DocumentWriter::SyncPolicy(saveSyncPolicy))) {
+            documentWriter->remember(filePath, snapshot);
+            // Directories past the watch limit would not notice the new file.
+            const QString relativePath = QDir(pathIndex->root()).relativeFilePath(filePath);
+            if (created && !pathIndex->root().isEmpty() && !relativePath.startsWith(QLatin1String(".."))) {
+                pathIndex->insert(QStringList{relativePath});
+            }
+            symbolIndex->refreshFile(filePath);
+            highlightCache->store(filePath, snapshot);
+            currentEditor->markSaved(snapshot.revision());
             QFileInfo fileInfo(filePath);
             tabWidget->setTabText(tabWidget->currentIndex(), fileInfo.fileName());
             currentEditor->setProperty("filePath", filePath);
+            outlinePanel->setFilePath(filePath);
 
             StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
             if (customStatusBar) {
@@ -231,24 +758,11 @@ void MainWindow::onTreeViewDoubleClicked(const QModelIndex &index) {
         return;
     }
 
-    QString filePath = fileSystemModel->filePath(index);
+    QString filePath = fileTreeModel->filePath(index);
     QFileInfo fileInfo(filePath);
 
     if (fileInfo.isFile()) {
-        QFile file(filePath);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            createEditorTab(fileInfo.fileName(), file.readAll(), filePath);
-
-            StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
-            if (customStatusBar) {
-                customStatusBar->showMessage("Opened: " + filePath, 5000);
-            }
-        } else {
-            StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
-            if (customStatusBar) {
-                customStatusBar->showMessage("Failed to open: " + filePath, 5000);
-            }
-        }
+        onOpenFile(filePath);
     } else if (fileInfo.isDir()) {
         terminal->setWorkingDirectory(filePath);
     }
@@ -259,7 +773,7 @@ void MainWindow::onCursorPositionChanged() {
     if (!currentEditor) return;
 
     QTextCursor cursor = currentEditor->textCursor();
-    int line = cursor.blockNumber() + 1;
+    int line = int(currentEditor->lineNumberOffset()) + cursor.blockNumber() + 1;
     int column = cursor.columnNumber() + 1;
 
     StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
@@ -269,6 +783,19 @@ void MainWindow::onCursorPositionChanged() {
 }
 
 void MainWindow::onTabChanged(int index) {
+    // A restored tab is read the first time it is shown; opening it makes
+    // the new editor current, which comes back here.
+    if (!hydrationPaused && qobject_cast<TabPlaceholder*>(tabWidget->widget(index))) {
+        hydrateTab(index);
+        return;
+    }
+
+    CodeEditor *editor = dynamic_cast<CodeEditor*>(tabWidget->widget(index));
+    if (editor) {
+        editor->setProperty("lastUsed", ++tabUseCounter);
+    }
+    findBar->setEditor(editor);
+    outlinePanel->setFilePath(editor ? editor->property("filePath").toString() : QString());
     if (index >= 0) {
         onCursorPositionChanged();
     }
@@ -285,34 +812,76 @@ void MainWindow::startAutoSaveTimer() {
     autoSaveTimer->start(autoSaveInterval * 1000);
 }
 
-void MainWindow::autoSaveCurrentFile() {
-    CodeEditor *currentEditor = dynamic_cast<CodeEditor*>(tabWidget->currentWidget());
-    if (!currentEditor) return;
+void MainWindow::changeEvent(QEvent *event) {
+    QMainWindow::changeEvent(event);
 
-    QString filePath = currentEditor->property("filePath").toString();
+    if (event->type() == QEvent::ActivationChange && !isActiveWindow()) {
+        autoSaveAllFiles();
+    }
+}
+
+void MainWindow::autoSaveAllFiles() {
+    if (!autoSaveEnabled) return;
+
+    // Every modified tab is queued in one pass; the writer works through
+    // them in order and skips any whose contents match the file on disk.
+    documentWriter->setSyncPolicy(DocumentWriter::SyncPolicy(saveSyncPolicy));
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        CodeEditor *editor = dynamic_cast<CodeEditor*>(tabWidget->widget(i));
+        if (editor) {
+            autoSaveEditor(editor);
+        }
+    }
+}
 
+void MainWindow::autoSaveEditor(CodeEditor *editor) {
+    if (editor->isReadOnly() || !editor->hasUnsavedChanges()) return;
+
+    QString filePath = editor->property("filePath").toString();
     if (filePath.isEmpty()) {
         return;
     }
 
-    QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        file.write(currentEditor->toPlainText().toUtf8());
-        file.close();
+    // Copying the buffer is O(1); encoding and disk I/O happen on the
+    // writer thread.
+    documentWriter->save(filePath, editor->textBuffer());
+}
 
-        StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+void MainWindow::onDocumentSaved(const QString &filePath, quint64 revision, bool ok, bool written, const QString &errorString) {
+    StatusBar *customStatusBar = dynamic_cast<StatusBar*>(statusBar);
+
+    if (!ok) {
         if (customStatusBar) {
-            customStatusBar->showMessage("Auto-saved: " + filePath, 2000);
+            customStatusBar->showMessage("Auto-save failed: " + filePath + " (" + errorString + ")", 5000);
+        }
+        return;
+    }
+
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        CodeEditor *editor = dynamic_cast<CodeEditor*>(tabWidget->widget(i));
+        if (editor && editor->property("filePath").toString() == filePath) {
+            editor->markSaved(revision);
+            // Only a tab still at the saved revision has the saved text.
+            if (written && editor->textBuffer().revision() == revision) {
+                highlightCache->store(filePath, editor->textBuffer());
+            }
         }
     }
+    // The file already held this text; nothing on disk changed.
+    if (!written) return;
+
+    symbolIndex->refreshFile(filePath);
+
+    if (customStatusBar) {
+        customStatusBar->showMessage("Auto-saved: " + filePath, 2000);
+    }
 }
 
 void MainWindow::saveSettings() {
     QSettings settings("ChoraEditor", "Chora");
 
-    QModelIndex rootIndex = treeView->rootIndex();
-    if (rootIndex.isValid()) {
-        QString currentPath = fileSystemModel->filePath(rootIndex);
+    const QString currentPath = fileTreeModel->rootPath();
+    if (!currentPath.isEmpty()) {
         settings.setValue("lastFolder", currentPath);
     }
 
@@ -320,24 +889,32 @@ void MainWindow::saveSettings() {
     settings.setValue("windowState", saveState());
 
     settings.setValue("terminalVisible", terminal->isVisible());
+    settings.setValue("outlineVisible", outlinePanel->isVisible());
 
     settings.setValue("autoSaveEnabled", autoSaveEnabled);
     settings.setValue("autoSaveInterval", autoSaveInterval);
+    settings.setValue("largeFileThreshold", largeFileThreshold);
+    settings.setValue("saveSyncPolicy", saveSyncPolicy);
+    settings.setValue("followMaxLines", followMaxLines);
+    settings.setValue("memoryBudget", memoryBudget);
+
+    saveSession(settings);
 }
 
 void MainWindow::restoreSettings() {
     QSettings settings("ChoraEditor", "Chora");
 
-    QString lastFolder = settings.value("lastFolder", QDir::homePath()).toString();
+    QString lastFolder = settings.value("lastFolder").toString();
 
-    QDir dir(lastFolder);
-    if (dir.exists()) {
-        fileSystemModel->setRootPath(lastFolder);
-        treeView->setRootIndex(fileSystemModel->index(lastFolder));
+    // Only a folder that was actually opened is indexed; crawling all of
+    // $HOME on a first start would be of no use to anyone.
+    if (!lastFolder.isEmpty() && QDir(lastFolder).exists()) {
+        fileTreeModel->setRootPath(lastFolder);
         terminal->setWorkingDirectory(lastFolder);
+        pathIndex->setRoot(lastFolder);
+        symbolIndex->setRoot(lastFolder);
     } else {
-        fileSystemModel->setRootPath(QDir::homePath());
-        treeView->setRootIndex(fileSystemModel->index(QDir::homePath()));
+        fileTreeModel->setRootPath(QDir::homePath());
         terminal->setWorkingDirectory(QDir::homePath());
     }
 
@@ -346,7 +923,94 @@ void MainWindow::restoreSettings() {
 
     bool terminalVisible = settings.value("terminalVisible", true).toBool();
     terminal->setVisible(terminalVisible);
+    outlinePanel->setVisible(settings.value("outlineVisible", false).toBool());
 
     autoSaveEnabled = settings.value("autoSaveEnabled", true).toBool();
     autoSaveInterval = settings.value("autoSaveInterval", 3).toInt();
+    largeFileThreshold = settings.value("largeFileThreshold", 64).toInt();
+    saveSyncPolicy = settings.value("saveSyncPolicy", int(DocumentWriter::SyncFile)).toInt();
+    followMaxLines = settings.value("followMaxLines", 100000).toInt();
+    memoryBudget = settings.value("memoryBudget", 1024).toInt();
+
+    restoreSession(settings);
+}
+
+void MainWindow::saveSession(QSettings &settings) {
+    // Untitled and followed tabs are not put back.
+    int current = -1;
+    int saved = 0;
+    settings.beginWriteArray("session");
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        QString filePath;
+        QString snapshotPath;
+        qint64 line = 0;
+        int column = 0;
+        qint64 firstVisibleLine = 0;
+
+        if (TabPlaceholder *placeholder = qobject_cast<TabPlaceholder*>(tabWidget->widget(i))) {
+            filePath = placeholder->filePath();
+            snapshotPath = placeholder->snapshotPath();
+            line = placeholder->line();
+            column = placeholder->column();
+            firstVisibleLine = placeholder->firstVisibleLine();
+        } else if (CodeEditor *editor = dynamic_cast<CodeEditor*>(tabWidget->widget(i))) {
+            if (editor->isFollowing()) continue;
+            filePath = editor->property("filePath").toString();
+            const QTextCursor cursor = editor->textCursor();
+            line = editor->lineNumberOffset() + cursor.blockNumber();
+            column = cursor.positionInBlock();
+            firstVisibleLine = editor->firstVisibleLine();
+        }
+        if (filePath.isEmpty()) continue;
+
+        if (i == tabWidget->currentIndex()) current = saved;
+        settings.setArrayIndex(saved++);
+        settings.setValue("filePath", filePath);
+        settings.setValue("line", line);
+        settings.setValue("column", column);
+        settings.setValue("firstVisibleLine", firstVisibleLine);
+        settings.setValue("snapshotPath", snapshotPath);
+    }
+    settings.endArray();
+    settings.setValue("sessionCurrent", current);
+}
+
+void MainWindow::restoreSession(QSettings &settings) {
+    hydrationPaused = true;
+    QSet<QString> snapshots;
+    const int count = settings.beginReadArray("session");
+    for (int i = 0; i < count; ++i) {
+        settings.setArrayIndex(i);
+        const QString filePath = settings.value("filePath").toString();
+        if (filePath.isEmpty()) continue;
+
+        const QString snapshotPath = settings.value("snapshotPath").toString();
+        if (!snapshotPath.isEmpty()) snapshots.insert(QFileInfo(snapshotPath).fileName());
+
+        auto *placeholder = new TabPlaceholder(filePath,
+                                               settings.value("line").toLongLong(),
+                                               settings.value("column").toInt(),
+                                               settings.value("firstVisibleLine").toLongLong(),
+                                               snapshotPath);
+        const int index = tabWidget->addTab(placeholder, QFileInfo(filePath).fileName());
+        tabWidget->setTabToolTip(index, filePath);
+    }
+    settings.endArray();
+
+    // Snapshots no restored tab refers to are left from a crash.
+    const QDir snapshotDir(snapshotDirectory);
+    for (const QString &name : snapshotDir.entryList({"*.snapshot"}, QDir::Files)) {
+        if (!snapshots.contains(name)) QFile::remove(snapshotDir.filePath(name));
+    }
+
+    const int current = settings.value("sessionCurrent", 0).toInt();
+    if (current >= 0 && current < tabWidget->count()) {
+        tabWidget->setCurrentIndex(current);
+    }
+    hydrationPaused = false;
+
+    // Only the current tab is read, once the window is up.
+    QTimer::singleShot(0, this, [this]() {
+        hydrateTab(tabWidget->currentIndex());
+    });
 }
\ No newline at end of file
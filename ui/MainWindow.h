@@ -7,8 +7,10 @@
 #include <QFont>
 #include <QSettings>
 #include <QTimer>
+#include <QPointer>
+#include <QList>
 
-class QFileSystemModel;
+class FileTreeModel;
 class QTreeView;
 class QTabWidget;
 class QStatusBar;
@@ -17,6 +19,14 @@ class MenuBar;
 class CodeEditor;
 class QModelIndex;
 class TerminalWidget;
+class DocumentWriter;
+class FindBar;
+class FindInFilesPanel;
+class PathIndex;
+class QuickOpenDialog;
+class SymbolIndex;
+class OutlinePanel;
+class HighlightCache;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -29,11 +39,28 @@ public:
 
     bool autoSaveEnabled;
     int autoSaveInterval;
+    int largeFileThreshold;
+    int saveSyncPolicy;
+    int followMaxLines;
+    // MB the tabs together may keep resident before the least recently used
+    // ones are released.
+    int memoryBudget;
+
+protected:
+    void changeEvent(QEvent *event) override;
 
 private slots:
     void closeTab(int index);
     void onNewFile();
     void onOpenFile(const QString &fileName);
+    void onOpenFileAt(const QString &fileName, qint64 line, int column, int length);
+    void onFindInFiles();
+    void onQuickOpen();
+    void onQuickOpenFile(const QString &fileName);
+    void onGoToDefinition();
+    void onFindReferences();
+    void onShowOutline();
+    void onFollowFile(const QString &fileName);
     void onSaveFile(bool saveAs);
     void onShowSettings();
     void onShowAbout();
@@ -41,29 +68,64 @@ private slots:
     void onCursorPositionChanged();
     void onTabChanged(int index);
     void onTextChanged();
-    void autoSaveCurrentFile();
+    void autoSaveAllFiles();
+    void onEditorLoadFinished(bool ok);
+    void updateLoadProgress();
+    void checkMemoryBudget();
+    void cancelLoading();
+    void onDocumentSaved(const QString &filePath, quint64 revision, bool ok, bool written, const QString &errorString);
 
 private:
     void setupUI();
     void setupConnections();
     void saveSettings();
     void restoreSettings();
+    // Open tabs with their cursor and scroll position. Restored tabs are
+    // TabPlaceholders until they are first shown.
+    void saveSession(QSettings &settings);
+    void restoreSession(QSettings &settings);
+    void hydrateTab(int index);
+    void openSnapshot(const QString &filePath, const QString &snapshotPath, int tabIndex);
+    bool canReleaseTab(CodeEditor *editor) const;
+    bool releaseTab(int index);
     void startAutoSaveTimer();
+    void autoSaveEditor(CodeEditor *editor);
+    void openFile(const QString &fileName, int tabIndex);
+    void openLargeFile(const QString &fileName, int tabIndex);
+    CodeEditor *activateFile(const QString &fileName);
 
+    // tabIndex -1 adds the tab at the end.
     CodeEditor* createEditorTab(const QString &title, const QString &content = "",
-                                const QString &filePath = "");
+                                const QString &filePath = "", int tabIndex = -1);
 
-    QFileSystemModel *fileSystemModel;
+    FileTreeModel *fileTreeModel;
     QTreeView *treeView;
     QTabWidget *tabWidget;
     QStatusBar *statusBar;
     MenuBar *menuBar;
+    FindBar *findBar;
+    FindInFilesPanel *findInFilesPanel;
+    PathIndex *pathIndex;
+    QuickOpenDialog *quickOpenDialog;
+    SymbolIndex *symbolIndex;
+    OutlinePanel *outlinePanel;
+    HighlightCache *highlightCache;
     QFont editorFont;
 
     QSplitter *mainSplitter;
+    QSplitter *sideSplitter;
     QSplitter *editorSplitter;
 
     QTimer *autoSaveTimer;
+    DocumentWriter *documentWriter;
+
+    QList<QPointer<CodeEditor>> loadingEditors;
+    bool hydrationPaused;
+
+    QTimer *memoryTimer;
+    // Stamped on a tab each time it is made current.
+    quint64 tabUseCounter;
+    QString snapshotDirectory;
 };
 
 #endif //MAINWINDOW_H
\ No newline at end of file
@@ -1,11 +1,13 @@
 #include "MenuBar.h"
+#include "../core/filetreemodel.h"
+#include <QDir>
 #include <QObject>
 #include <QSettings>
 
 MenuBar::MenuBar(QMainWindow *parent, QTabWidget *tabs, QTreeView *tree,
-                 QStatusBar *statusBar, QFileSystemModel *model)
+                 QStatusBar *statusBar, FileTreeModel *model)
     : mainWindow(parent), tabWidget(tabs), treeView(tree),
-      statusBar(statusBar), fileSystemModel(model)
+      statusBar(statusBar), fileTreeModel(model)
 {
     menuBar = parent->menuBar();
 
@@ -30,11 +32,19 @@ void MenuBar::setupFileMenu() {
     QObject::connect(newFile, &QAction::triggered, this, &MenuBar::onNewFile);
 
     QAction *openFileAction = fileMenu->addAction("&Open File");
-    openFileAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_F));
+    openFileAction->setShortcut(QKeySequence::Open);
     QObject::connect(openFileAction, &QAction::triggered, this, &MenuBar::onOpenFile);
 
+    QAction *quickOpenAction = fileMenu->addAction("&Quick Open...");
+    quickOpenAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_P));
+    QObject::connect(quickOpenAction, &QAction::triggered, this, &MenuBar::quickOpenRequested);
+
+    QAction *followFileAction = fileMenu->addAction("Fo&llow File");
+    followFileAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::CTRL | Qt::Key_L));
+    QObject::connect(followFileAction, &QAction::triggered, this, &MenuBar::onFollowFile);
+
     QAction *openFolderAction = fileMenu->addAction("&Open Folder");
-    openFolderAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::CTRL | Qt::Key_F));
+    openFolderAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_K, Qt::CTRL | Qt::Key_O));
     QObject::connect(openFolderAction, &QAction::triggered, this, &MenuBar::onOpenFolder);
 
     fileMenu->addSeparator();
@@ -51,6 +61,42 @@ void MenuBar::setupEditMenu() {
 
     editMenu->addSeparator();
 
+    QAction *findAction = editMenu->addAction("&Find...");
+    findAction->setShortcut(QKeySequence::Find);
+    QObject::connect(findAction, &QAction::triggered, this, &MenuBar::findRequested);
+
+    QAction *replaceAction = editMenu->addAction("&Replace...");
+    replaceAction->setShortcut(QKeySequence::Replace);
+    QObject::connect(replaceAction, &QAction::triggered, this, &MenuBar::replaceRequested);
+
+    QAction *findNextAction = editMenu->addAction("Find &Next");
+    findNextAction->setShortcut(QKeySequence::FindNext);
+    QObject::connect(findNextAction, &QAction::triggered, this, &MenuBar::findNextRequested);
+
+    QAction *findPreviousAction = editMenu->addAction("Find &Previous");
+    findPreviousAction->setShortcut(QKeySequence::FindPrevious);
+    QObject::connect(findPreviousAction, &QAction::triggered, this, &MenuBar::findPreviousRequested);
+
+    QAction *findInFilesAction = editMenu->addAction("Find in F&iles...");
+    findInFilesAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::CTRL | Qt::Key_F));
+    QObject::connect(findInFilesAction, &QAction::triggered, this, &MenuBar::findInFilesRequested);
+
+    editMenu->addSeparator();
+
+    QAction *goToDefinitionAction = editMenu->addAction("Go to &Definition");
+    goToDefinitionAction->setShortcut(QKeySequence(Qt::Key_F12));
+    QObject::connect(goToDefinitionAction, &QAction::triggered, this, &MenuBar::goToDefinitionRequested);
+
+    QAction *findReferencesAction = editMenu->addAction("Find &References");
+    findReferencesAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::Key_F12));
+    QObject::connect(findReferencesAction, &QAction::triggered, this, &MenuBar::findReferencesRequested);
+
+    QAction *outlineAction = editMenu->addAction("&Outline");
+    outlineAction->setShortcut(QKeySequence(Qt::SHIFT | Qt::CTRL | Qt::Key_O));
+    QObject::connect(outlineAction, &QAction::triggered, this, &MenuBar::outlineRequested);
+
+    editMenu->addSeparator();
+
     QAction *saveFileAction = editMenu->addAction("&Save File");
     saveFileAction->setShortcut(QKeySequence::Save);
     QObject::connect(saveFileAction, &QAction::triggered, this, &MenuBar::onSaveFile);
@@ -70,7 +116,7 @@ void MenuBar::setupPluginsMenu() {
 
 void MenuBar::setupSettingsMenu() {
     QAction *preferencesAction = menuBar->addAction("&Settings");
-    preferencesAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_P));
+    preferencesAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_Comma));
     QObject::connect(preferencesAction, &QAction::triggered, this, &MenuBar::onOpenSettings);
 }
 
@@ -91,16 +137,23 @@ void MenuBar::onOpenFile() {
     }
 }
 
+void MenuBar::onFollowFile() {
+    QString fileName = QFileDialog::getOpenFileName(mainWindow, "Follow File", "", "All Files (*.*)");
+    if (!fileName.isEmpty()) {
+        emit fileFollowRequested(fileName);
+    }
+}
+
 void MenuBar::onOpenFolder() {
     QSettings settings("ChoraEditor", "Chora");
     QString lastFolder = settings.value("lastFolder", QDir::homePath()).toString();
 
     QString folderName = QFileDialog::getExistingDirectory(mainWindow, "Open Folder", lastFolder);
     if (!folderName.isEmpty()) {
-        fileSystemModel->setRootPath(folderName);
-        treeView->setRootIndex(fileSystemModel->index(folderName));
+        fileTreeModel->setRootPath(folderName);
         statusBar->showMessage("Opened folder: " + folderName, 5000);
         settings.setValue("lastFolder", folderName);
+        emit folderOpened(folderName);
     }
 }
 
@@ -8,29 +8,42 @@
 #include <QTabWidget>
 #include <QTreeView>
 #include <QStatusBar>
-#include <QFileSystemModel>
 #include <QFileDialog>
 #include <QApplication>
 #include <QDebug>
 
+class FileTreeModel;
+
 class MenuBar : public QObject {
     Q_OBJECT
 
 public:
     explicit MenuBar(QMainWindow *parent, QTabWidget *tabs, QTreeView *tree,
-                     QStatusBar *statusBar, QFileSystemModel *model);
+                     QStatusBar *statusBar, FileTreeModel *model);
     ~MenuBar();
 
     signals:
         void newFileRequested();
     void fileOpenRequested(const QString &filePath);
+    void fileFollowRequested(const QString &filePath);
+    void folderOpened(const QString &folderPath);
+    void quickOpenRequested();
     void saveFileRequested(bool saveAs);
     void settingsRequested();
     void aboutRequested();
+    void findRequested();
+    void replaceRequested();
+    void findNextRequested();
+    void findPreviousRequested();
+    void findInFilesRequested();
+    void goToDefinitionRequested();
+    void findReferencesRequested();
+    void outlineRequested();
 
 private slots:
     void onNewFile();
     void onOpenFile();
+    void onFollowFile();
     void onOpenFolder();
     void onSaveFile();
     void onSaveFileAs();
@@ -50,7 +63,7 @@ private:
     QTabWidget *tabWidget;
     QTreeView *treeView;
     QStatusBar *statusBar;
-    QFileSystemModel *fileSystemModel;
+    FileTreeModel *fileTreeModel;
 };
 
 #endif //MENUBAR_H
\ No newline at end of file
@@ -0,0 +1,150 @@
+#include "OutlinePanel.h"
+#include "../core/symbolindex.h"
+
+#include <QHBoxLayout>
+#include <QHash>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QToolButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+// Where an entry keeps its position.
+static const int LineRole = Qt::UserRole;
+static const int ColumnRole = Qt::UserRole + 1;
+static const int LengthRole = Qt::UserRole + 2;
+
+static QString kindName(SymbolScanner::Kind kind) {
+    switch (kind) {
+    case SymbolScanner::Macro: return "Macro";
+    case SymbolScanner::Namespace: return "Namespace";
+    case SymbolScanner::Class: return "Class";
+    case SymbolScanner::Enum: return "Enum";
+    case SymbolScanner::Enumerator: return "Enumerator";
+    case SymbolScanner::Typedef: return "Type alias";
+    case SymbolScanner::Function: return "Function";
+    case SymbolScanner::Variable: return "Variable";
+    }
+    return QString();
+}
+
+OutlinePanel::OutlinePanel(SymbolIndex *index, QWidget *parent)
+    : QWidget(parent)
+    , symbolIndex(index)
+{
+    setupUI();
+    connect(symbolIndex, &SymbolIndex::changed, this, &OutlinePanel::refresh);
+}
+
+void OutlinePanel::setupUI() {
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(2, 2, 2, 2);
+    mainLayout->setSpacing(2);
+
+    QWidget *headerWidget = new QWidget(this);
+    QHBoxLayout *headerLayout = new QHBoxLayout(headerWidget);
+    headerLayout->setContentsMargins(5, 2, 5, 2);
+
+    QLabel *titleLabel = new QLabel("Outline", headerWidget);
+    QFont titleFont = titleLabel->font();
+    titleFont.setBold(true);
+    titleLabel->setFont(titleFont);
+
+    statusLabel = new QLabel(headerWidget);
+    statusLabel->setStyleSheet("color: gray;");
+
+    closeButton = new QToolButton(headerWidget);
+    closeButton->setText("×");
+    closeButton->setToolTip("Close (Esc)");
+    closeButton->setAutoRaise(true);
+    connect(closeButton, &QToolButton::clicked, this, &QWidget::hide);
+
+    headerLayout->addWidget(titleLabel);
+    headerLayout->addStretch(1);
+    headerLayout->addWidget(statusLabel);
+    headerLayout->addWidget(closeButton);
+
+    entries = new QTreeWidget(this);
+    entries->setHeaderHidden(true);
+    entries->setColumnCount(1);
+    entries->setUniformRowHeights(true);
+    connect(entries, &QTreeWidget::itemClicked, this, &OutlinePanel::onItemClicked);
+    connect(entries, &QTreeWidget::itemActivated, this, &OutlinePanel::onItemClicked);
+
+    mainLayout->addWidget(headerWidget);
+    mainLayout->addWidget(entries, 1);
+}
+
+void OutlinePanel::setFilePath(const QString &path) {
+    filePath = path;
+    refresh();
+}
+
+void OutlinePanel::showAndFocus() {
+    show();
+    entries->setFocus();
+    if (!entries->currentItem() && entries->topLevelItemCount() > 0) {
+        entries->setCurrentItem(entries->topLevelItem(0));
+    }
+}
+
+void OutlinePanel::refresh() {
+    entries->clear();
+
+    if (filePath.isEmpty()) {
+        statusLabel->clear();
+        return;
+    }
+
+    const QVector<SymbolIndex::Definition> definitions = symbolIndex->outline(filePath);
+    if (definitions.isEmpty()) {
+        statusLabel->setText(symbolIndex->isIndexing() ? "Indexing..." : QString());
+        return;
+    }
+    statusLabel->clear();
+
+    // A member goes under the last namespace, class or enum of its scope's
+    // name seen before it; members defined out of line stay at the top.
+    QHash<QString, QTreeWidgetItem*> containers;
+    for (const SymbolIndex::Definition &definition : definitions) {
+        QTreeWidgetItem *parent = containers.value(definition.scope);
+        QTreeWidgetItem *item = parent ? new QTreeWidgetItem(parent) : new QTreeWidgetItem(entries);
+
+        QString text = definition.name;
+        if (definition.kind == SymbolScanner::Function) text += "()";
+        if (!parent && !definition.scope.isEmpty()) text = definition.scope + "::" + text;
+        item->setText(0, text);
+        item->setToolTip(0, QString("%1, line %2%3")
+                                .arg(kindName(definition.kind))
+                                .arg(definition.line + 1)
+                                .arg(definition.declaration ? " (declaration)" : ""));
+        item->setData(0, LineRole, definition.line);
+        item->setData(0, ColumnRole, definition.column);
+        item->setData(0, LengthRole, definition.name.size());
+        if (definition.declaration) {
+            item->setForeground(0, palette().color(QPalette::Disabled, QPalette::Text));
+        }
+
+        if (definition.kind == SymbolScanner::Namespace || definition.kind == SymbolScanner::Class
+            || definition.kind == SymbolScanner::Enum) {
+            containers.insert(definition.name, item);
+        }
+    }
+    entries->expandAll();
+}
+
+void OutlinePanel::onItemClicked(QTreeWidgetItem *item) {
+    if (!item) return;
+    emit openRequested(filePath,
+                       item->data(0, LineRole).toLongLong(),
+                       item->data(0, ColumnRole).toInt(),
+                       item->data(0, LengthRole).toInt());
+}
+
+void OutlinePanel::keyPressEvent(QKeyEvent *event) {
+    if (event->key() == Qt::Key_Escape) {
+        hide();
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
@@ -0,0 +1,47 @@
+#ifndef OUTLINEPANEL_H
+#define OUTLINEPANEL_H
+
+#pragma once
+#include <QWidget>
+#include <QString>
+
+class QLabel;
+class QToolButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+class SymbolIndex;
+
+// What the current file defines, from the symbol index: namespaces and
+// classes hold their members. Clicking an entry goes to it.
+class OutlinePanel : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit OutlinePanel(SymbolIndex *index, QWidget *parent = nullptr);
+
+    // Follows the current tab; an empty path shows nothing.
+    void setFilePath(const QString &filePath);
+    void showAndFocus();
+
+signals:
+    void openRequested(const QString &filePath, qint64 line, int column, int length);
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void refresh();
+    void onItemClicked(QTreeWidgetItem *item);
+
+private:
+    void setupUI();
+
+    SymbolIndex *symbolIndex;
+    QString filePath;
+
+    QLabel *statusLabel;
+    QToolButton *closeButton;
+    QTreeWidget *entries;
+};
+
+#endif //OUTLINEPANEL_H
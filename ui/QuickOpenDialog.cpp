@@ -0,0 +1,121 @@
+#include "QuickOpenDialog.h"
+#include "../core/pathindex.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
+
+// Where a result item keeps its path relative to the root.
+static const int PathRole = Qt::UserRole;
+
+QuickOpenDialog::QuickOpenDialog(PathIndex *index, QWidget *parent)
+    : QDialog(parent, Qt::Popup)
+    , pathIndex(index)
+{
+    setupUI();
+
+    // Results fill in while the folder is still being indexed.
+    connect(pathIndex, &PathIndex::changed, this, [this]() {
+        if (isVisible()) updateResults();
+    });
+}
+
+void QuickOpenDialog::setupUI() {
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(4, 4, 4, 4);
+    mainLayout->setSpacing(2);
+
+    queryEdit = new QLineEdit(this);
+    queryEdit->setPlaceholderText("Search files by name");
+    connect(queryEdit, &QLineEdit::textChanged, this, &QuickOpenDialog::updateResults);
+    connect(queryEdit, &QLineEdit::returnPressed, this, &QuickOpenDialog::openCurrent);
+
+    results = new QListWidget(this);
+    results->setUniformItemSizes(true);
+    connect(results, &QListWidget::itemActivated, this, &QuickOpenDialog::openCurrent);
+
+    statusLabel = new QLabel(this);
+    statusLabel->setStyleSheet("color: gray;");
+
+    mainLayout->addWidget(queryEdit);
+    mainLayout->addWidget(results, 1);
+    mainLayout->addWidget(statusLabel);
+}
+
+void QuickOpenDialog::popup() {
+    QWidget *window = parentWidget();
+    if (window) {
+        const int width = qMin(600, window->width() - 40);
+        resize(width, qMin(400, window->height() - 80));
+        move(window->mapToGlobal(QPoint((window->width() - width) / 2, 40)));
+    }
+
+    queryEdit->clear();
+    updateResults();
+    show();
+    queryEdit->setFocus();
+}
+
+void QuickOpenDialog::keyPressEvent(QKeyEvent *event) {
+    // The query keeps the focus; moving through the list goes to the list.
+    switch (event->key()) {
+    case Qt::Key_Up:
+    case Qt::Key_Down:
+    case Qt::Key_PageUp:
+    case Qt::Key_PageDown:
+        QApplication::sendEvent(results, event);
+        return;
+    default:
+        QDialog::keyPressEvent(event);
+    }
+}
+
+void QuickOpenDialog::updateResults() {
+    QElapsedTimer clock;
+    clock.start();
+    const QVector<PathIndex::Result> matches = pathIndex->query(queryEdit->text(), MaxResults);
+    const qint64 elapsed = clock.elapsed();
+
+    results->setUpdatesEnabled(false);
+    results->clear();
+    for (const PathIndex::Result &match : matches) {
+        const int slash = int(match.path.lastIndexOf(QLatin1Char('/')));
+        const QString name = match.path.mid(slash + 1);
+        const QString directory = slash > 0 ? match.path.left(slash) : QString();
+
+        QListWidgetItem *item = new QListWidgetItem(results);
+        item->setText(directory.isEmpty() ? name : name + "    " + QDir::toNativeSeparators(directory));
+        item->setToolTip(QDir::toNativeSeparators(match.path));
+        item->setData(PathRole, match.path);
+    }
+    if (results->count() > 0) {
+        results->setCurrentRow(0);
+    }
+    results->setUpdatesEnabled(true);
+
+    QString status = QString("%1 files").arg(pathIndex->count());
+    if (pathIndex->isTruncated()) {
+        status = QString("First %1 files").arg(pathIndex->count());
+    }
+    if (pathIndex->isIndexing()) {
+        status += ", indexing…";
+    }
+    if (!queryEdit->text().isEmpty()) {
+        status += QString(" (%1 ms)").arg(elapsed);
+    }
+    statusLabel->setText(status);
+}
+
+void QuickOpenDialog::openCurrent() {
+    QListWidgetItem *item = results->currentItem();
+    if (!item) return;
+
+    const QString path = pathIndex->root() + QLatin1Char('/') + item->data(PathRole).toString();
+    hide();
+    emit fileChosen(QDir::cleanPath(path));
+}
@@ -0,0 +1,45 @@
+#ifndef QUICKOPENDIALOG_H
+#define QUICKOPENDIALOG_H
+
+#pragma once
+#include <QDialog>
+
+class PathIndex;
+class QLabel;
+class QLineEdit;
+class QListWidget;
+
+// Ctrl+P: type a few characters of a path, pick a file. Results come from
+// the folder's PathIndex and are requeried on every keystroke.
+class QuickOpenDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit QuickOpenDialog(PathIndex *index, QWidget *parent = nullptr);
+
+    // Shows the dialog near the top of parent with an empty query.
+    void popup();
+
+    static constexpr int MaxResults = 50;
+
+signals:
+    void fileChosen(const QString &filePath);
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+
+private slots:
+    void updateResults();
+    void openCurrent();
+
+private:
+    void setupUI();
+
+    PathIndex *pathIndex;
+
+    QLineEdit *queryEdit;
+    QListWidget *results;
+    QLabel *statusLabel;
+};
+
+#endif //QUICKOPENDIALOG_H
@@ -42,6 +42,10 @@ void SettingsDialog::setupInterfaceGroup() {
     lineNumbersCheckBox->setChecked(currentEditor ? currentEditor->areLineNumbersVisible() : true);
     interfaceLayout->addWidget(lineNumbersCheckBox);
 
+    minimapCheckBox = new QCheckBox("Show Minimap", interfaceGroup);
+    minimapCheckBox->setChecked(currentEditor ? currentEditor->isMinimapVisible() : true);
+    interfaceLayout->addWidget(minimapCheckBox);
+
     statusBarCheckBox = new QCheckBox("Show Status Bar", interfaceGroup);
     statusBarCheckBox->setChecked(!statusBar->isHidden());
     interfaceLayout->addWidget(statusBarCheckBox);
@@ -100,6 +104,72 @@ void SettingsDialog::setupEditorGroup() {
     autoSaveLayout->addStretch();
     editorLayout->addLayout(autoSaveLayout);
 
+    QHBoxLayout *largeFileLayout = new QHBoxLayout();
+    largeFileLayout->addWidget(new QLabel("Large File Threshold (MB):", editorGroup));
+
+    largeFileThresholdSpinBox = new QSpinBox(editorGroup);
+    largeFileThresholdSpinBox->setRange(1, 65536);
+    if (mainWindow) {
+        largeFileThresholdSpinBox->setValue(mainWindow->largeFileThreshold);
+    } else {
+        largeFileThresholdSpinBox->setValue(64);
+    }
+
+    largeFileLayout->addWidget(largeFileThresholdSpinBox);
+    largeFileLayout->addStretch();
+    editorLayout->addLayout(largeFileLayout);
+
+    QHBoxLayout *followLayout = new QHBoxLayout();
+    followLayout->addWidget(new QLabel("Followed File Line Limit:", editorGroup));
+
+    followMaxLinesSpinBox = new QSpinBox(editorGroup);
+    followMaxLinesSpinBox->setRange(1000, 10000000);
+    followMaxLinesSpinBox->setSingleStep(10000);
+    if (mainWindow) {
+        followMaxLinesSpinBox->setValue(mainWindow->followMaxLines);
+    } else {
+        followMaxLinesSpinBox->setValue(100000);
+    }
+
+    followLayout->addWidget(followMaxLinesSpinBox);
+    followLayout->addStretch();
+    editorLayout->addLayout(followLayout);
+
+    QHBoxLayout *memoryBudgetLayout = new QHBoxLayout();
+    memoryBudgetLayout->addWidget(new QLabel("Tab Memory Budget (MB):", editorGroup));
+
+    memoryBudgetSpinBox = new QSpinBox(editorGroup);
+    memoryBudgetSpinBox->setRange(64, 1048576);
+    memoryBudgetSpinBox->setSingleStep(256);
+    memoryBudgetSpinBox->setToolTip("Tabs not used for the longest time are released past this");
+    if (mainWindow) {
+        memoryBudgetSpinBox->setValue(mainWindow->memoryBudget);
+    } else {
+        memoryBudgetSpinBox->setValue(1024);
+    }
+
+    memoryBudgetLayout->addWidget(memoryBudgetSpinBox);
+    memoryBudgetLayout->addStretch();
+    editorLayout->addLayout(memoryBudgetLayout);
+
+    QHBoxLayout *saveSyncLayout = new QHBoxLayout();
+    saveSyncLayout->addWidget(new QLabel("Flush Saves to Disk:", editorGroup));
+
+    // Item order follows DocumentWriter::SyncPolicy.
+    saveSyncComboBox = new QComboBox(editorGroup);
+    saveSyncComboBox->addItem("Never");
+    saveSyncComboBox->addItem("File");
+    saveSyncComboBox->addItem("File and Folder");
+    if (mainWindow) {
+        saveSyncComboBox->setCurrentIndex(mainWindow->saveSyncPolicy);
+    } else {
+        saveSyncComboBox->setCurrentIndex(1);
+    }
+
+    saveSyncLayout->addWidget(saveSyncComboBox);
+    saveSyncLayout->addStretch();
+    editorLayout->addLayout(saveSyncLayout);
+
     mainLayout->addWidget(editorGroup);
 }
 
@@ -150,18 +220,23 @@ void SettingsDialog::applySettings() {
     if (mainWindow) {
         mainWindow->autoSaveEnabled = autoSaveCheckBox->isChecked();
         mainWindow->autoSaveInterval = autoSaveIntervalSpinBox->value();
+        mainWindow->largeFileThreshold = largeFileThresholdSpinBox->value();
+        mainWindow->followMaxLines = followMaxLinesSpinBox->value();
+        mainWindow->memoryBudget = memoryBudgetSpinBox->value();
+        mainWindow->saveSyncPolicy = saveSyncComboBox->currentIndex();
     }
 
     for (int i = 0; i < tabWidget->count(); ++i) {
         CodeEditor *editor = dynamic_cast<CodeEditor*>(tabWidget->widget(i));
         if (editor) {
             editor->setLineNumbersVisible(lineNumbersCheckBox->isChecked());
+            editor->setMinimapVisible(minimapCheckBox->isChecked());
 
             QFont editorFont = editor->font();
             editorFont.setPointSize(fontSizeSpinBox->value());
             editor->setFont(editorFont);
 
-            if (wordWrapCheckBox->isChecked()) {
+            if (wordWrapCheckBox->isChecked() && !editor->isPaged()) {
                 editor->setLineWrapMode(QPlainTextEdit::WidgetWidth);
             } else {
                 editor->setLineWrapMode(QPlainTextEdit::NoWrap);
@@ -8,6 +8,7 @@
 #include <QGroupBox>
 #include <QCheckBox>
 #include <QSpinBox>
+#include <QComboBox>
 #include <QPushButton>
 #include <QLabel>
 #include <QTabWidget>
@@ -45,12 +46,17 @@ private:
 
     QCheckBox *treeViewCheckBox;
     QCheckBox *lineNumbersCheckBox;
+    QCheckBox *minimapCheckBox;
     QCheckBox *statusBarCheckBox;
     QCheckBox *terminalCheckBox;
     QCheckBox *wordWrapCheckBox;
     QCheckBox *autoSaveCheckBox;
     QSpinBox *fontSizeSpinBox;
     QSpinBox *autoSaveIntervalSpinBox;
+    QSpinBox *largeFileThresholdSpinBox;
+    QSpinBox *followMaxLinesSpinBox;
+    QSpinBox *memoryBudgetSpinBox;
+    QComboBox *saveSyncComboBox;
 
     QPushButton *okButton;
     QPushButton *cancelButton;
@@ -1,5 +1,7 @@
 #include "StatusBar.h"
 #include <QTimer>
+#include <QProgressBar>
+#include <QToolButton>
 
 StatusBar::StatusBar(QWidget *parent) : QStatusBar(parent) {
     // Create permanent widgets for the status bar
@@ -7,6 +9,23 @@ StatusBar::StatusBar(QWidget *parent) : QStatusBar(parent) {
     messageLabel->setText("Ready");
     addWidget(messageLabel, 1); // Stretch factor 1 to take available space
 
+    loadProgressBar = new QProgressBar(this);
+    loadProgressBar->setRange(0, 100);
+    loadProgressBar->setMaximumWidth(150);
+    loadProgressBar->setTextVisible(true);
+    loadProgressBar->hide();
+    addPermanentWidget(loadProgressBar);
+
+    cancelLoadButton = new QToolButton(this);
+    cancelLoadButton->setText("Cancel");
+    cancelLoadButton->setToolTip("Cancel loading");
+    cancelLoadButton->hide();
+    addPermanentWidget(cancelLoadButton);
+    connect(cancelLoadButton, &QToolButton::clicked, this, &StatusBar::loadCancelRequested);
+
+    memoryLabel = new QLabel(this);
+    addPermanentWidget(memoryLabel);
+
     lineColumnLabel = new QLabel(this);
     lineColumnLabel->setText("Ln 1, Col 1");
     lineColumnLabel->setMinimumWidth(100);
@@ -25,4 +44,25 @@ void StatusBar::showMessage(const QString &message, int timeout) {
 
 void StatusBar::setLineColumnInfo(int line, int column) {
     lineColumnLabel->setText(QString::asprintf("Ln %d, Col %d", line, column));
+}
+
+void StatusBar::setMemoryInfo(qint64 tabBytes, qint64 totalBytes, qint64 budgetBytes) {
+    auto megabytes = [](qint64 bytes) {
+        return QString::number(double(bytes) / (1024.0 * 1024.0), 'f', 1);
+    };
+    memoryLabel->setText(QString("%1 MB").arg(megabytes(tabBytes)));
+    memoryLabel->setToolTip(QString("This tab: %1 MB\nAll tabs: %2 MB of %3 MB")
+                                .arg(megabytes(tabBytes), megabytes(totalBytes), megabytes(budgetBytes)));
+}
+
+void StatusBar::setLoadProgress(qint64 bytesRead, qint64 totalBytes) {
+    const int percent = totalBytes > 0 ? int(bytesRead * 100 / totalBytes) : 0;
+    loadProgressBar->setValue(percent);
+    loadProgressBar->show();
+    cancelLoadButton->show();
+}
+
+void StatusBar::clearLoadProgress() {
+    loadProgressBar->hide();
+    cancelLoadButton->hide();
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include <QStatusBar>
 #include <QLabel>
 
+class QProgressBar;
+class QToolButton;
+
 class StatusBar : public QStatusBar {
     Q_OBJECT
 public:
@@ -14,9 +17,22 @@ public:
     void showMessage(const QString &message, int timeout = 0);
     void setLineColumnInfo(int line, int column);
 
+    void setLoadProgress(qint64 bytesRead, qint64 totalBytes);
+    void clearLoadProgress();
+
+    // What the current tab and all tabs are estimated to keep in memory,
+    // against the budget tabs are released at.
+    void setMemoryInfo(qint64 tabBytes, qint64 totalBytes, qint64 budgetBytes);
+
+signals:
+    void loadCancelRequested();
+
 private:
     QLabel *messageLabel;
     QLabel *lineColumnLabel;
+    QLabel *memoryLabel;
+    QProgressBar *loadProgressBar;
+    QToolButton *cancelLoadButton;
 };
 
 #endif //STATUSBAR_H
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "TabPlaceholder.h"
+
+TabPlaceholder::TabPlaceholder(const QString &filePath, qint64 line, int column, qint64 firstVisibleLine,
+                               const QString &snapshotPath, QWidget *parent)
+    : QWidget(parent)
+    , path(filePath)
+    , snapshot(snapshotPath)
+    , cursorLine(line)
+    , cursorColumn(column)
+    , topLine(firstVisibleLine)
+    , historyHash(0)
+{
+}
+
+QString TabPlaceholder::filePath() const {
+    return path;
+}
+
+QString TabPlaceholder::snapshotPath() const {
+    return snapshot;
+}
+
+qint64 TabPlaceholder::line() const {
+    return cursorLine;
+}
+
+int TabPlaceholder::column() const {
+    return cursorColumn;
+}
+
+qint64 TabPlaceholder::firstVisibleLine() const {
+    return topLine;
+}
+
+void TabPlaceholder::setUndoHistory(std::unique_ptr<UndoHistory> released, quint64 contentHash) {
+    history = std::move(released);
+    historyHash = contentHash;
+}
+
+std::unique_ptr<UndoHistory> TabPlaceholder::takeUndoHistory() {
+    return std::move(history);
+}
+
+quint64 TabPlaceholder::undoHistoryHash() const {
+    return historyHash;
+}
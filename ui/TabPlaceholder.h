@@ -0,0 +1,48 @@
+#ifndef TABPLACEHOLDER_H
+#define TABPLACEHOLDER_H
+
+#pragma once
+#include <QWidget>
+#include <QString>
+#include <memory>
+
+#include "../core/undohistory.h"
+
+// Stands in for a tab restored from the last session, or released to stay
+// under the memory budget, until it is next made current. It only remembers
+// where the tab was, and a released tab's undo history with its text on
+// disk; the file is not touched, so restoring many tabs costs about as much
+// as restoring none.
+class TabPlaceholder : public QWidget {
+    Q_OBJECT
+
+public:
+    TabPlaceholder(const QString &filePath, qint64 line, int column, qint64 firstVisibleLine,
+                   const QString &snapshotPath = QString(), QWidget *parent = nullptr);
+
+    QString filePath() const;
+    // Where the unsaved text of a released tab was written; empty when the
+    // tab matched its file.
+    QString snapshotPath() const;
+    // 0-based, like CodeEditor::goToLine().
+    qint64 line() const;
+    int column() const;
+    qint64 firstVisibleLine() const;
+
+    // A released tab's undo history, kept for the editor that takes its
+    // place, and CodeEditor::takeUndoHistory()'s hash of the text it fits.
+    void setUndoHistory(std::unique_ptr<UndoHistory> released, quint64 contentHash);
+    std::unique_ptr<UndoHistory> takeUndoHistory();
+    quint64 undoHistoryHash() const;
+
+private:
+    QString path;
+    QString snapshot;
+    qint64 cursorLine;
+    int cursorColumn;
+    qint64 topLine;
+    std::unique_ptr<UndoHistory> history;
+    quint64 historyHash;
+};
+
+#endif //TABPLACEHOLDER_H
@@ -0,0 +1,482 @@
+#include "TerminalView.h"
+#include "../core/terminalbuffer.h"
+#include "../core/terminalscreen.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QInputMethodEvent>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include <utility>
+
+static const int LeftMargin = 4;
+
+TerminalView::TerminalView(TerminalScreen *screen, QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , terminal(screen)
+    , scrollback(screen->scrollback())
+    , droppedSeen(scrollback->droppedLines())
+    , rowHeight(1)
+    , charWidth(1)
+    , ascent(0)
+{
+    setFocusPolicy(Qt::ClickFocus);
+    setAttribute(Qt::WA_InputMethodEnabled);
+    viewport()->setCursor(Qt::IBeamCursor);
+
+    stylePens[TerminalBuffer::Output] = QPen(palette().color(QPalette::Text));
+    stylePens[TerminalBuffer::Error] = QPen(QColor(170, 0, 0));
+    stylePens[TerminalBuffer::Warning] = QPen(QColor(170, 85, 0));
+
+    updateMetrics();
+}
+
+const TerminalBuffer *TerminalView::buffer() const {
+    return scrollback;
+}
+
+const TerminalScreen *TerminalView::screen() const {
+    return terminal;
+}
+
+void TerminalView::bufferChanged() {
+    QScrollBar *bar = verticalScrollBar();
+    const bool atBottom = bar->value() >= bar->maximum();
+    const int value = bar->value();
+
+    // Lines that scrolled out of the ring shift every index down; moving the
+    // scroll bar by as much keeps the same text on screen.
+    const qint64 newlyDropped = qMax<qint64>(0, scrollback->droppedLines() - droppedSeen);
+    droppedSeen = scrollback->droppedLines();
+
+    updateScrollBars();
+    bar->setValue(atBottom ? bar->maximum() : int(qMax<qint64>(0, value - newlyDropped)));
+    viewport()->update();
+}
+
+QString TerminalView::selectedText() const {
+    if (anchor.line < 0) return QString();
+
+    const Position from = qMin(anchor, cursor);
+    const Position to = qMax(anchor, cursor);
+    const qint64 dropped = scrollback->droppedLines();
+
+    QString text;
+    for (qint64 line = qMax(from.line, dropped); line <= to.line; ++line) {
+        const qint64 index = line - dropped;
+        if (index >= totalRows()) break;
+
+        const QString lineText = rowText(int(index));
+        const int start = line == from.line ? from.column : 0;
+        const int end = line == to.line ? to.column : int(lineText.size());
+        if (line > qMax(from.line, dropped)) text += QLatin1Char('\n');
+        text += QStringView(lineText).mid(start, qMax(0, end - start));
+    }
+    return text;
+}
+
+int TerminalView::visibleColumns() const {
+    return qMax(1, (viewport()->width() - LeftMargin * 2) / charWidth);
+}
+
+int TerminalView::visibleRows() const {
+    return qMax(1, viewport()->height() / rowHeight);
+}
+
+void TerminalView::updateMetrics() {
+    const QFontMetrics metrics(font());
+    rowHeight = qMax(1, metrics.height());
+    charWidth = qMax(1, metrics.horizontalAdvance(QLatin1Char('M')));
+    ascent = metrics.ascent();
+
+    // Indexed by the cell's Bold and Italic attributes.
+    for (int i = 0; i < 4; ++i) {
+        fonts[i] = font();
+        fonts[i].setBold(i & TerminalScreen::Bold);
+        fonts[i].setItalic(i & TerminalScreen::Italic);
+    }
+    updateScrollBars();
+}
+
+void TerminalView::updateScrollBars() {
+    const int rows = visibleRows();
+    verticalScrollBar()->setRange(0, qMax(0, totalRows() - rows));
+    verticalScrollBar()->setPageStep(rows);
+    verticalScrollBar()->setSingleStep(1);
+
+    const int width = viewport()->width();
+    const int longest = qMax(scrollback->longestLine(), terminal->columns());
+    horizontalScrollBar()->setRange(0, qMax(0, LeftMargin * 2 + longest * charWidth - width));
+    horizontalScrollBar()->setPageStep(width);
+    horizontalScrollBar()->setSingleStep(charWidth);
+}
+
+int TerminalView::totalRows() const {
+    return scrollback->lineCount() + terminal->rows();
+}
+
+QString TerminalView::rowText(int index) const {
+    if (index < scrollback->lineCount()) {
+        return scrollback->line(index).text;
+    }
+    return terminal->rowText(index - scrollback->lineCount());
+}
+
+TerminalView::Position TerminalView::positionAt(const QPoint &point) const {
+    Position position;
+    const int index = qBound(0, verticalScrollBar()->value() + point.y() / rowHeight, totalRows() - 1);
+    const int x = point.x() - LeftMargin + horizontalScrollBar()->value();
+    const int length = int(rowText(index).size());
+
+    position.line = scrollback->droppedLines() + index;
+    position.column = qBound(0, (x + charWidth / 2) / charWidth, length);
+    return position;
+}
+
+void TerminalView::paintEvent(QPaintEvent *event) {
+    QPainter painter(viewport());
+    const QRect area = event->rect();
+    painter.fillRect(area, palette().color(QPalette::Base));
+    painter.setFont(font());
+
+    const int firstLine = verticalScrollBar()->value();
+    const int scrollX = horizontalScrollBar()->value();
+    const int firstColumn = scrollX / charWidth;
+    const int columns = viewport()->width() / charWidth + 2;
+    const int x = LeftMargin - scrollX + firstColumn * charWidth;
+    const int scrollbackRows = scrollback->lineCount();
+
+    const bool selecting = anchor.line >= 0 && (anchor < cursor || cursor < anchor);
+    const Position from = qMin(anchor, cursor);
+    const Position to = qMax(anchor, cursor);
+    const qint64 dropped = scrollback->droppedLines();
+    QColor highlight = palette().color(QPalette::Highlight);
+    highlight.setAlpha(110);
+
+    int currentStyle = -1;
+    for (int row = area.top() / rowHeight; row <= area.bottom() / rowHeight; ++row) {
+        const int index = firstLine + row;
+        if (index >= totalRows()) break;
+
+        const int y = row * rowHeight;
+        if (index < scrollbackRows) {
+            const TerminalBuffer::Line &line = scrollback->line(index);
+            if (line.text.size() > firstColumn) {
+                if (line.style != currentStyle) {
+                    painter.setPen(stylePens[line.style]);
+                    currentStyle = line.style;
+                }
+                // Only the columns on screen are shaped.
+                painter.drawText(QPoint(x, y + ascent), line.text.mid(firstColumn, columns));
+            }
+        } else {
+            paintScreenRow(painter, index - scrollbackRows, y, x, firstColumn, columns);
+            currentStyle = -1;
+            painter.setFont(font());
+        }
+
+        // Drawn over the text, since screen cells paint their own background.
+        const qint64 absolute = dropped + index;
+        if (selecting && absolute >= from.line && absolute <= to.line) {
+            const int start = absolute == from.line ? from.column : 0;
+            const int end = absolute == to.line ? to.column : int(rowText(index).size()) + 1;
+            painter.fillRect(LeftMargin - scrollX + start * charWidth, y,
+                             (end - start) * charWidth, rowHeight, highlight);
+        }
+    }
+
+    const int cursorRow = scrollbackRows + terminal->cursorY() - firstLine;
+    if (terminal->isCursorVisible() && cursorRow >= 0 && cursorRow * rowHeight <= area.bottom()) {
+        const QRect cell(LeftMargin - scrollX + terminal->cursorX() * charWidth, cursorRow * rowHeight,
+                         charWidth, rowHeight);
+        if (hasFocus()) {
+            painter.fillRect(cell, palette().color(QPalette::Text));
+            painter.setPen(palette().color(QPalette::Base));
+            const TerminalScreen::Cell &under = terminal->row(terminal->cursorY())[terminal->cursorX()];
+            painter.drawText(QPoint(cell.left(), cell.top() + ascent), QString(QChar(under.character)));
+        } else {
+            painter.setPen(palette().color(QPalette::Text));
+            painter.drawRect(cell.adjusted(0, 0, -1, -1));
+        }
+    }
+}
+
+void TerminalView::paintScreenRow(QPainter &painter, int screenRow, int y, int x, int firstColumn, int columns) {
+    const TerminalScreen::Cell *cells = terminal->row(screenRow);
+    const int last = qMin(terminal->columns(), firstColumn + columns);
+    const QColor text = palette().color(QPalette::Text);
+    const QColor base = palette().color(QPalette::Base);
+
+    // One fill and one drawText per run of cells with the same style.
+    int column = firstColumn;
+    while (column < last) {
+        const TerminalScreen::Cell &style = cells[column];
+        bool blank = style.character == u' ';
+        int end = column + 1;
+        while (end < last && cells[end].sameStyle(style)) {
+            blank = blank && cells[end].character == u' ';
+            ++end;
+        }
+
+        QColor foreground = style.attributes & TerminalScreen::DefaultForeground ? text : QColor(style.foreground);
+        QColor background = style.attributes & TerminalScreen::DefaultBackground ? base : QColor(style.background);
+        if (style.attributes & TerminalScreen::Inverse) {
+            std::swap(foreground, background);
+        }
+
+        const int left = x + (column - firstColumn) * charWidth;
+        const int width = (end - column) * charWidth;
+        if (background != base) {
+            painter.fillRect(left, y, width, rowHeight, background);
+        }
+        if (!blank) {
+            runText.resize(end - column);
+            QChar *out = runText.data();
+            for (int i = column; i < end; ++i) {
+                *out++ = QChar(cells[i].character);
+            }
+            painter.setFont(fonts[style.attributes & (TerminalScreen::Bold | TerminalScreen::Italic)]);
+            painter.setPen(foreground);
+            painter.drawText(QPoint(left, y + ascent), runText);
+        }
+        if (style.attributes & TerminalScreen::Underline) {
+            painter.fillRect(left, y + ascent + 1, width, 1, foreground);
+        }
+        column = end;
+    }
+}
+
+void TerminalView::resizeEvent(QResizeEvent *event) {
+    QAbstractScrollArea::resizeEvent(event);
+
+    QScrollBar *bar = verticalScrollBar();
+    const bool atBottom = bar->value() >= bar->maximum();
+    emit sizeChanged(visibleColumns(), visibleRows());
+    updateScrollBars();
+    if (atBottom) bar->setValue(bar->maximum());
+}
+
+void TerminalView::changeEvent(QEvent *event) {
+    QAbstractScrollArea::changeEvent(event);
+
+    if (event->type() == QEvent::FontChange) {
+        updateMetrics();
+        emit sizeChanged(visibleColumns(), visibleRows());
+    } else if (event->type() == QEvent::PaletteChange) {
+        stylePens[TerminalBuffer::Output] = QPen(palette().color(QPalette::Text));
+    }
+}
+
+void TerminalView::mousePressEvent(QMouseEvent *event) {
+    if (event->button() != Qt::LeftButton) {
+        QAbstractScrollArea::mousePressEvent(event);
+        return;
+    }
+    anchor = cursor = positionAt(event->position().toPoint());
+    viewport()->update();
+}
+
+void TerminalView::mouseMoveEvent(QMouseEvent *event) {
+    if (!(event->buttons() & Qt::LeftButton) || anchor.line < 0) {
+        QAbstractScrollArea::mouseMoveEvent(event);
+        return;
+    }
+    cursor = positionAt(event->position().toPoint());
+    viewport()->update();
+}
+
+bool TerminalView::event(QEvent *event) {
+    if (event->type() == QEvent::ShortcutOverride) {
+        // Ctrl+letter belongs to the program (Ctrl+C, Ctrl+R, Ctrl+W...),
+        // not to the menu shortcuts.
+        QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
+        if (keyEvent->modifiers() == Qt::ControlModifier
+            && keyEvent->key() >= Qt::Key_A && keyEvent->key() <= Qt::Key_Z) {
+            event->accept();
+            return true;
+        }
+    } else if (event->type() == QEvent::KeyPress) {
+        // Tab completes in the shell instead of moving the focus.
+        QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
+        if (keyEvent->key() == Qt::Key_Tab || keyEvent->key() == Qt::Key_Backtab) {
+            keyPressEvent(keyEvent);
+            return true;
+        }
+    }
+    return QAbstractScrollArea::event(event);
+}
+
+void TerminalView::keyPressEvent(QKeyEvent *event) {
+    const Qt::KeyboardModifiers modifiers = event->modifiers();
+    const bool controlShift = (modifiers & (Qt::ControlModifier | Qt::ShiftModifier))
+                           == (Qt::ControlModifier | Qt::ShiftModifier);
+
+    // Ctrl+C is an interrupt for the program, so copying takes Ctrl+Shift+C
+    // unless there is a selection to copy.
+    const QString selection = selectedText();
+    if ((controlShift && event->key() == Qt::Key_C)
+        || (event->matches(QKeySequence::Copy) && !selection.isEmpty())) {
+        if (!selection.isEmpty()) {
+            QApplication::clipboard()->setText(selection);
+        }
+        anchor = cursor = Position();
+        viewport()->update();
+        return;
+    }
+    if (controlShift && event->key() == Qt::Key_V) {
+        paste();
+        return;
+    }
+    if (controlShift && event->key() == Qt::Key_A) {
+        const int last = totalRows() - 1;
+        anchor = {scrollback->droppedLines(), 0};
+        cursor = {scrollback->droppedLines() + last, int(rowText(last).size())};
+        viewport()->update();
+        return;
+    }
+    if (modifiers == Qt::ShiftModifier
+        && (event->key() == Qt::Key_PageUp || event->key() == Qt::Key_PageDown)) {
+        QScrollBar *bar = verticalScrollBar();
+        bar->setValue(bar->value() + (event->key() == Qt::Key_PageUp ? -1 : 1) * bar->pageStep());
+        return;
+    }
+
+    const QByteArray bytes = keyBytes(event);
+    if (bytes.isEmpty()) {
+        QAbstractScrollArea::keyPressEvent(event);
+        return;
+    }
+
+    // Typing brings the view back to the prompt.
+    verticalScrollBar()->setValue(verticalScrollBar()->maximum());
+    emit input(bytes);
+}
+
+void TerminalView::inputMethodEvent(QInputMethodEvent *event) {
+    if (!event->commitString().isEmpty()) {
+        emit input(event->commitString().toUtf8());
+    }
+    event->accept();
+}
+
+QByteArray TerminalView::keyBytes(const QKeyEvent *event) const {
+    const Qt::KeyboardModifiers modifiers = event->modifiers();
+    // xterm's modifier parameter: 1 plus Shift 1, Alt 2, Control 4.
+    const int modifierCode = 1 + (modifiers & Qt::ShiftModifier ? 1 : 0)
+                               + (modifiers & Qt::AltModifier ? 2 : 0)
+                               + (modifiers & Qt::ControlModifier ? 4 : 0);
+
+    auto cursorKey = [&](char final) -> QByteArray {
+        if (modifierCode > 1) {
+            return "\x1b[1;" + QByteArray::number(modifierCode) + final;
+        }
+        return QByteArray(terminal->applicationCursorKeys() ? "\x1bO" : "\x1b[") + final;
+    };
+    auto tildeKey = [&](int code) -> QByteArray {
+        QByteArray bytes = "\x1b[" + QByteArray::number(code);
+        if (modifierCode > 1) bytes += ';' + QByteArray::number(modifierCode);
+        return bytes + '~';
+    };
+
+    switch (event->key()) {
+    case Qt::Key_Up:
+        return cursorKey('A');
+    case Qt::Key_Down:
+        return cursorKey('B');
+    case Qt::Key_Right:
+        return cursorKey('C');
+    case Qt::Key_Left:
+        return cursorKey('D');
+    case Qt::Key_Home:
+        return cursorKey('H');
+    case Qt::Key_End:
+        return cursorKey('F');
+    case Qt::Key_Insert:
+        return tildeKey(2);
+    case Qt::Key_Delete:
+        return tildeKey(3);
+    case Qt::Key_PageUp:
+        return tildeKey(5);
+    case Qt::Key_PageDown:
+        return tildeKey(6);
+    case Qt::Key_F1:
+    case Qt::Key_F2:
+    case Qt::Key_F3:
+    case Qt::Key_F4:
+        return QByteArray("\x1bO") + char('P' + event->key() - Qt::Key_F1);
+    case Qt::Key_F5:
+    case Qt::Key_F6:
+    case Qt::Key_F7:
+    case Qt::Key_F8:
+    case Qt::Key_F9:
+    case Qt::Key_F10:
+    case Qt::Key_F11:
+    case Qt::Key_F12: {
+        static const int codes[] = {15, 17, 18, 19, 20, 21, 23, 24};
+        return tildeKey(codes[event->key() - Qt::Key_F5]);
+    }
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        return "\r";
+    case Qt::Key_Backspace:
+        return modifiers & Qt::ControlModifier ? "\x08" : "\x7f";
+    case Qt::Key_Tab:
+        return "\t";
+    case Qt::Key_Backtab:
+        return "\x1b[Z";
+    case Qt::Key_Escape:
+        return "\x1b";
+    default:
+        break;
+    }
+
+    if (modifiers & Qt::ControlModifier) {
+        const int key = event->key();
+        if (key >= Qt::Key_A && key <= Qt::Key_Z) {
+            return QByteArray(1, char(key - Qt::Key_A + 1));
+        }
+        switch (key) {
+        case Qt::Key_Space:
+        case Qt::Key_At:
+            return QByteArray(1, '\0');
+        case Qt::Key_BracketLeft:
+            return "\x1b";
+        case Qt::Key_Backslash:
+            return "\x1c";
+        case Qt::Key_BracketRight:
+            return "\x1d";
+        case Qt::Key_AsciiCircum:
+            return "\x1e";
+        case Qt::Key_Underscore:
+        case Qt::Key_Minus:
+            return "\x1f";
+        default:
+            break;
+        }
+    }
+
+    QByteArray bytes = event->text().toUtf8();
+    if (!bytes.isEmpty() && (modifiers & Qt::AltModifier)) {
+        bytes.prepend('\x1b');
+    }
+    return bytes;
+}
+
+void TerminalView::paste() {
+    QByteArray bytes = QApplication::clipboard()->text().toUtf8();
+    if (bytes.isEmpty()) return;
+
+    bytes.replace("\r\n", "\r");
+    bytes.replace('\n', '\r');
+    // With bracketed paste on, the shell inserts the text instead of
+    // running each pasted line. ESC is dropped, as xterm does, so the text
+    // cannot end the bracket early with its own "\x1b[201~".
+    if (terminal->bracketedPaste()) {
+        bytes.replace('\x1b', QByteArray());
+        bytes = "\x1b[200~" + bytes + "\x1b[201~";
+    }
+    emit input(bytes);
+}
@@ -0,0 +1,90 @@
+#ifndef TERMINALVIEW_H
+#define TERMINALVIEW_H
+
+#pragma once
+#include <QAbstractScrollArea>
+#include <QByteArray>
+#include <QFont>
+#include <QPen>
+
+class TerminalBuffer;
+class TerminalScreen;
+
+// View of a terminal: the scrollback followed by the live screen. Only the
+// rows on screen are painted, so the cost of a repaint does not depend on
+// the scrollback size. The view stays on the last line while it is there,
+// and otherwise keeps showing the same lines as older ones scroll out of
+// the buffer.
+//
+// Keys typed into the view are translated to what an xterm would send and
+// reported through input(); the screen size follows the widget's.
+class TerminalView : public QAbstractScrollArea {
+    Q_OBJECT
+
+public:
+    explicit TerminalView(TerminalScreen *screen, QWidget *parent = nullptr);
+
+    const TerminalBuffer *buffer() const;
+    const TerminalScreen *screen() const;
+
+    // Call after changing the screen or scrollback; schedules a single
+    // repaint.
+    void bufferChanged();
+
+    QString selectedText() const;
+
+    // The screen size that fits the viewport.
+    int visibleColumns() const;
+    int visibleRows() const;
+
+signals:
+    void input(const QByteArray &bytes);
+    void sizeChanged(int columns, int rows);
+
+protected:
+    bool event(QEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void inputMethodEvent(QInputMethodEvent *event) override;
+
+private:
+    // A position in the output: line counts from the first line ever
+    // appended, so it stays put while the ring rotates. Screen rows come
+    // after the scrollback and keep their number as they scroll into it.
+    struct Position {
+        qint64 line = -1;
+        int column = 0;
+        bool operator<(const Position &other) const {
+            return line < other.line || (line == other.line && column < other.column);
+        }
+    };
+
+    void updateMetrics();
+    void updateScrollBars();
+    int totalRows() const;
+    QString rowText(int index) const;
+    Position positionAt(const QPoint &point) const;
+    void paintScreenRow(QPainter &painter, int screenRow, int y, int x, int firstColumn, int columns);
+    QByteArray keyBytes(const QKeyEvent *event) const;
+    void paste();
+
+    TerminalScreen *terminal;
+    TerminalBuffer *scrollback;
+    qint64 droppedSeen;
+    int rowHeight;
+    int charWidth;
+    int ascent;
+
+    QPen stylePens[3];
+    QFont fonts[4];
+    QString runText;
+
+    Position anchor;
+    Position cursor;
+};
+
+#endif // TERMINALVIEW_H
@@ -1,29 +1,84 @@
 #include "TerminalWidget.h"
+#include "TerminalView.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QPushButton>
+#include <QStackedWidget>
+#include <QTabBar>
+#include <QToolButton>
 #include <QDir>
-#include <QTextCursor>
-#include <QTextCharFormat>
 #include <QKeyEvent>
+#include <QTimer>
+
+static const int FrameMilliseconds = 16;
+// How often tabs check whether their shell is running something.
+static const int StatusMilliseconds = 500;
+static const int MaxTabLabel = 24;
+
+#ifdef Q_OS_WIN
+static const char *const Enter = "\r\n";
+#else
+static const char *const Enter = "\r";
+#endif
+
+// Quotes a path for the shell running in the terminal.
+static QString shellQuote(const QString &path) {
+#ifdef Q_OS_WIN
+    return "\"" + path + "\"";
+#else
+    QString quoted = path;
+    quoted.replace("'", "'\\''");
+    return "'" + quoted + "'";
+#endif
+}
 
 TerminalWidget::TerminalWidget(QWidget *parent) 
-    : QWidget(parent), historyIndex(0) {
+    : QWidget(parent)
+    , historyIndex(0) {
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FrameMilliseconds);
+    connect(flushTimer, &QTimer::timeout, this, &TerminalWidget::flushOutput);
+
+    statusTimer = new QTimer(this);
+    statusTimer->setInterval(StatusMilliseconds);
+    connect(statusTimer, &QTimer::timeout, this, &TerminalWidget::updateSessionStatus);
+    statusTimer->start();
+
+    currentDir = QDir::homePath();
     setupUI();
-    setupProcess();
+    addSession(TerminalSession::Shell, QString());
+    updatePrompt();
 }
 
 TerminalWidget::~TerminalWidget() {
-    if (process && process->state() != QProcess::NotRunning) {
-        process->kill();
-        process->waitForFinished();
+    // Sessions hang up on their programs; they go before the views that
+    // show their screens.
+    for (const Session &entry : sessions) {
+        delete entry.session;
     }
+    sessions.clear();
 }
 
 void TerminalWidget::setWorkingDirectory(const QString &dir) {
     currentDir = dir;
-    if (process) {
-        process->setWorkingDirectory(dir);
+
+    TerminalSession *session = currentSession();
+    if (session && session->kind() == TerminalSession::Shell && session->isRunning()) {
+#ifdef Q_OS_WIN
+        // Windows has no foreground process group to tell an idle shell
+        // from a busy one, so the cd is always sent.
+        session->write("cd /d " + shellQuote(dir).toLocal8Bit() + Enter);
+#else
+        // Only a shell waiting at its prompt is sent the cd; anything else
+        // running would take it as keystrokes, so it keeps its directory.
+        // ^E^U drops whatever is typed at the prompt first (^E is harmless
+        // where only the tty's ^U applies). The leading space keeps the cd
+        // out of the shell's history.
+        if (session->status() == TerminalSession::Idle) {
+            session->write("\x05\x15 cd -- " + shellQuote(dir).toLocal8Bit() + Enter);
+        }
+#endif
     }
     updatePrompt();
 }
@@ -33,53 +88,76 @@ QString TerminalWidget::getWorkingDirectory() const {
 }
 
 void TerminalWidget::clear() {
-    outputText->clear();
+    const int index = sessionTabs->currentIndex();
+    if (index < 0) return;
+
+    sessions[index].session->clear();
+    sessions[index].view->bufferChanged();
+}
+
+void TerminalWidget::newSession() {
+    const int index = addSession(TerminalSession::Shell, QString());
+    sessionTabs->setCurrentIndex(index);
+    startSession(sessions[index]);
+    sessions[index].view->setFocus();
+}
+
+void TerminalWidget::runJob(const QString &command) {
+    // Started in the background: the current tab stays in front.
+    const int index = addSession(TerminalSession::Job, command);
+    startSession(sessions[index]);
+    updateSessionStatus();
 }
 
 void TerminalWidget::onCommandEntered() {
     QString command = inputLine->text().trimmed();
-    if (command.isEmpty()) return;
-
-    commandHistory.append(command);
-    historyIndex = commandHistory.size();
+    inputLine->clear();
 
-    appendOutput(currentPrompt + command, palette().color(QPalette::Text));
+    if (!command.isEmpty()) {
+        commandHistory.append(command);
+        historyIndex = commandHistory.size();
+    }
 
+    // Cleared here rather than by the shell, so it works whatever TERM
+    // the system knows about; the shell then draws a fresh prompt.
     if (command == "clear") {
         clear();
-        inputLine->clear();
+        sendToShell(Enter);
         return;
     }
 
-    if (command.startsWith("cd ")) {
-        QString newDir = command.mid(3).trimmed();
-        changeDirectory(newDir);
-        inputLine->clear();
-        return;
+    // The shell changes directory itself; this only keeps the prompt label
+    // in step with it.
+    if (command == "cd" || command.startsWith("cd ")) {
+        changeDirectory(command.mid(3).trimmed());
     }
 
-    executeCommand(command);
-    inputLine->clear();
+    sendToShell(command.toLocal8Bit() + Enter);
 }
 
-void TerminalWidget::onProcessOutput() {
-    QString output = QString::fromUtf8(process->readAllStandardOutput());
-    appendOutput(output, palette().color(QPalette::Text));
+void TerminalWidget::onSessionOutput() {
+    if (!flushTimer->isActive()) {
+        flushTimer->start();
+    }
 }
 
-void TerminalWidget::onProcessError() {
-    QString error = QString::fromUtf8(process->readAllStandardError());
-    appendOutput(error, QColor(170, 0, 0));
+void TerminalWidget::onSessionFinished() {
+    flushOutput();
+    updateSessionStatus();
 }
 
-void TerminalWidget::onProcessFinished(int exitCode, QProcess::ExitStatus status) {
-    if (status == QProcess::CrashExit) {
-        appendOutput("Process crashed!", QColor(170, 0, 0));
-    } else if (exitCode != 0) {
-        appendOutput(QString("Process exited with code %1").arg(exitCode),
-                    QColor(170, 85, 0));
+void TerminalWidget::onTabCloseRequested(int index) {
+    const Session entry = sessions.takeAt(index);
+    views->removeWidget(entry.view);
+    sessionTabs->removeTab(index);
+    delete entry.session;
+    delete entry.view;
+
+    // There is always a shell to type into.
+    if (sessions.isEmpty()) {
+        newSession();
     }
-    updatePrompt();
+    updateSessionStatus();
 }
 
 void TerminalWidget::onUpPressed() {
@@ -100,10 +178,68 @@ void TerminalWidget::onDownPressed() {
 }
 
 void TerminalWidget::onKillProcess() {
-    if (process && process->state() != QProcess::NotRunning) {
-        process->kill();
-        appendOutput("^C", QColor(170, 0, 0));
+    // ^C through the terminal: its line discipline turns it into SIGINT for
+    // whatever job is in the foreground, leaving the shell itself alone.
+    TerminalSession *session = currentSession();
+    if (session && session->isRunning()) {
+        session->interrupt();
+    }
+}
+
+void TerminalWidget::flushOutput() {
+    flushTimer->stop();
+    for (const Session &entry : sessions) {
+        if (entry.session->hasPendingOutput()) {
+            entry.session->flush();
+            entry.view->bufferChanged();
+        }
+    }
+}
+
+void TerminalWidget::updateSessionStatus() {
+    int running = 0;
+    int failed = 0;
+
+    for (int i = 0; i < sessions.size(); ++i) {
+        TerminalSession *session = sessions[i].session;
+        const TerminalSession::Status status = session->status();
+        if (session->kind() == TerminalSession::Job) {
+            if (status == TerminalSession::Running) ++running;
+            if (status == TerminalSession::Failed) ++failed;
+        }
+
+        QString label = session->label();
+        if (label.size() > MaxTabLabel) {
+            label = label.left(MaxTabLabel - 1) + QChar(0x2026);
+        }
+        switch (status) {
+        case TerminalSession::Running:
+            label.prepend(QString(QChar(0x25CF)) + ' ');
+            break;
+        case TerminalSession::Succeeded:
+            label.prepend(QString(QChar(0x2713)) + ' ');
+            break;
+        case TerminalSession::Failed:
+            label.prepend(QString(QChar(0x2717)) + ' ');
+            label += QString(" (%1)").arg(session->exitCode());
+            break;
+        case TerminalSession::Idle:
+            break;
+        }
+
+        if (sessionTabs->tabText(i) != label) {
+            sessionTabs->setTabText(i, label);
+        }
+        if (session->kind() == TerminalSession::Job) {
+            sessionTabs->setTabToolTip(i, session->command());
+        }
     }
+
+    QStringList summary;
+    if (running > 0) summary << QString("%1 running").arg(running);
+    if (failed > 0) summary << QString("%1 failed").arg(failed);
+    jobStatusLabel->setText(summary.isEmpty() ? QString() : "Jobs: " + summary.join(", "));
+    jobStatusLabel->setVisible(!summary.isEmpty());
 }
 
 void TerminalWidget::setupUI() {
@@ -120,17 +256,36 @@ void TerminalWidget::setupUI() {
     titleFont.setBold(true);
     titleLabel->setFont(titleFont);
 
+    sessionTabs = new QTabBar(headerWidget);
+    sessionTabs->setTabsClosable(true);
+    sessionTabs->setDocumentMode(true);
+    sessionTabs->setExpanding(false);
+    sessionTabs->setDrawBase(false);
+    connect(sessionTabs, &QTabBar::tabCloseRequested, this, &TerminalWidget::onTabCloseRequested);
+
+    newSessionButton = new QToolButton(headerWidget);
+    newSessionButton->setText("+");
+    newSessionButton->setToolTip("New Terminal");
+    newSessionButton->setAutoRaise(true);
+    connect(newSessionButton, &QToolButton::clicked, this, &TerminalWidget::newSession);
+
+    jobStatusLabel = new QLabel(headerWidget);
+    jobStatusLabel->setVisible(false);
+
     headerLayout->addWidget(titleLabel);
+    headerLayout->addWidget(sessionTabs);
+    headerLayout->addWidget(newSessionButton);
     headerLayout->addStretch();
+    headerLayout->addWidget(jobStatusLabel);
 
     mainLayout->addWidget(headerWidget);
 
-    outputText = new QTextEdit(this);
-    outputText->setReadOnly(true);
-    QFont monoFont("Monospace", 9);
+    views = new QStackedWidget(this);
+    connect(sessionTabs, &QTabBar::currentChanged, views, &QStackedWidget::setCurrentIndex);
+    mainLayout->addWidget(views);
+
+    monoFont = QFont("Monospace", 9);
     monoFont.setStyleHint(QFont::TypeWriter);
-    outputText->setFont(monoFont);
-    mainLayout->addWidget(outputText);
 
     QWidget *inputWidget = new QWidget(this);
     QHBoxLayout *inputLayout = new QHBoxLayout(inputWidget);
@@ -144,6 +299,8 @@ void TerminalWidget::setupUI() {
 
     inputLine = new QLineEdit(inputWidget);
     inputLine->setFont(monoFont);
+    inputLine->setToolTip("Enter runs the command in the current terminal, "
+                          "Ctrl+Enter runs it as a background job");
     connect(inputLine, &QLineEdit::returnPressed, this, &TerminalWidget::onCommandEntered);
     inputLine->installEventFilter(this);
 
@@ -155,42 +312,91 @@ void TerminalWidget::setupUI() {
     inputLine->setFocus();
 }
 
-void TerminalWidget::setupProcess() {
-    process = new QProcess(this);
-    currentDir = QDir::homePath();
-    process->setWorkingDirectory(currentDir);
+int TerminalWidget::addSession(TerminalSession::Kind kind, const QString &command) {
+    TerminalSession *session = new TerminalSession(kind, command, this);
+    TerminalView *view = new TerminalView(session->screen(), views);
+    view->setFont(monoFont);
 
-    connect(process, &QProcess::readyReadStandardOutput, this, &TerminalWidget::onProcessOutput);
-    connect(process, &QProcess::readyReadStandardError, this, &TerminalWidget::onProcessError);
-    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, &TerminalWidget::onProcessFinished);
+    // New screens start at the size of the one on show.
+    if (TerminalView *current = qobject_cast<TerminalView*>(views->currentWidget())) {
+        session->resize(current->visibleColumns(), current->visibleRows());
+    }
 
-    updatePrompt();
+    connect(session, &TerminalSession::outputPending, this, &TerminalWidget::onSessionOutput);
+    connect(session, &TerminalSession::finished, this, &TerminalWidget::onSessionFinished);
+    connect(view, &TerminalView::input, session, [this, session, view](const QByteArray &bytes) {
+        // A shell that exited is started again by the next thing typed.
+        if (session->kind() == TerminalSession::Job || startSession({session, view})) {
+            session->write(bytes);
+        }
+    });
+    connect(view, &TerminalView::sizeChanged, session, [session, view](int columns, int rows) {
+        session->resize(columns, rows);
+        view->bufferChanged();
+    });
+
+    sessions.append({session, view});
+    views->addWidget(view);
+    const int index = sessionTabs->addTab(QString());
+    updateSessionStatus();
+    return index;
 }
 
-void TerminalWidget::executeCommand(const QString &command) {
-#ifdef Q_OS_WIN
-    process->start("cmd.exe", QStringList() << "/c" << command);
-#else
-    process->start("sh", QStringList() << "-c" << command);
-#endif
+bool TerminalWidget::startSession(const Session &entry) {
+    if (entry.session->isRunning()) return true;
+
+    const TerminalScreen *screen = entry.session->screen();
+    const bool started = entry.session->start(currentDir, screen->columns(), screen->rows());
+    entry.view->bufferChanged();
+    return started;
+}
+
+TerminalSession *TerminalWidget::currentSession() const {
+    const int index = sessionTabs->currentIndex();
+    return index >= 0 ? sessions[index].session : nullptr;
+}
+
+void TerminalWidget::sendToShell(const QByteArray &bytes) {
+    int index = sessionTabs->currentIndex();
+
+    // A finished job takes no input; it goes to a shell instead.
+    if (index >= 0 && sessions[index].session->kind() == TerminalSession::Job
+        && !sessions[index].session->isRunning()) {
+        index = -1;
+        for (int i = 0; i < sessions.size(); ++i) {
+            if (sessions[i].session->kind() == TerminalSession::Shell) {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0) {
+            index = addSession(TerminalSession::Shell, QString());
+        }
+        sessionTabs->setCurrentIndex(index);
+    }
+    if (index < 0) return;
+
+    // A shell that exited is started again by the next thing typed.
+    const Session &entry = sessions[index];
+    if (entry.session->kind() == TerminalSession::Job || startSession(entry)) {
+        entry.session->write(bytes);
+    }
 }
 
 void TerminalWidget::changeDirectory(const QString &dir) {
     QDir newDir(currentDir);
 
-    if (dir == "~") {
+    if (dir.isEmpty() || dir == "~") {
         currentDir = QDir::homePath();
     } else if (dir.startsWith("/")) {
         currentDir = dir;
     } else if (newDir.cd(dir)) {
         currentDir = newDir.absolutePath();
     } else {
-        appendOutput("cd: no such directory: " + dir, QColor(170, 0, 0));
+        // The shell reports the error.
         return;
     }
 
-    process->setWorkingDirectory(currentDir);
     updatePrompt();
 }
 
@@ -209,29 +415,39 @@ void TerminalWidget::updatePrompt() {
     promptLabel->setText(currentPrompt);
 }
 
-void TerminalWidget::appendOutput(const QString &text, const QColor &color) {
-    QTextCursor cursor = outputText->textCursor();
-    cursor.movePosition(QTextCursor::End);
-    
-    QTextCharFormat format;
-    format.setForeground(color);
-    cursor.setCharFormat(format);
-    cursor.insertText(text + "\n");
-    
-    outputText->setTextCursor(cursor);
-    outputText->ensureCursorVisible();
-}
-
 bool TerminalWidget::eventFilter(QObject *obj, QEvent *event) {
     if (obj == inputLine && event->type() == QEvent::KeyPress) {
         QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
+        const bool control = keyEvent->modifiers() & Qt::ControlModifier;
         if (keyEvent->key() == Qt::Key_Up) {
             onUpPressed();
             return true;
         } else if (keyEvent->key() == Qt::Key_Down) {
             onDownPressed();
             return true;
+        } else if (control && (keyEvent->key() == Qt::Key_Return || keyEvent->key() == Qt::Key_Enter)) {
+            const QString command = inputLine->text().trimmed();
+            if (!command.isEmpty()) {
+                commandHistory.append(command);
+                historyIndex = commandHistory.size();
+                inputLine->clear();
+                runJob(command);
+            }
+            return true;
+        } else if (keyEvent->key() == Qt::Key_C && keyEvent->modifiers() == Qt::ControlModifier
+                   && !inputLine->hasSelectedText()) {
+            onKillProcess();
+            return true;
         }
     }
     return QWidget::eventFilter(obj, event);
-}
\ No newline at end of file
+}
+
+void TerminalWidget::showEvent(QShowEvent *event) {
+    QWidget::showEvent(event);
+
+    const int index = sessionTabs->currentIndex();
+    if (index >= 0 && sessions[index].session->kind() == TerminalSession::Shell) {
+        startSession(sessions[index]);
+    }
+}
@@ -3,13 +3,25 @@
 
 #pragma once
 #include <QWidget>
-#include <QTextEdit>
 #include <QLineEdit>
-#include <QProcess>
 #include <QLabel>
 #include <QString>
 #include <QStringList>
+#include <QByteArray>
+#include <QVector>
 
+#include "../core/terminalsession.h"
+
+class TerminalView;
+class QStackedWidget;
+class QTabBar;
+class QTimer;
+class QToolButton;
+
+// The terminal panel: any number of sessions, one tab each, all served by
+// the same reader thread. Jobs started from the command line with
+// Ctrl+Enter run in a tab of their own in the background; their status
+// is shown in the tab bar and summed up in the header.
 class TerminalWidget : public QWidget {
     Q_OBJECT
 
@@ -22,36 +34,54 @@ public:
 
 public slots:
     void clear();
+    void newSession();
+    void runJob(const QString &command);
 
 private slots:
     void onCommandEntered();
-    void onProcessOutput();
-    void onProcessError();
-    void onProcessFinished(int exitCode, QProcess::ExitStatus status);
+    void onSessionOutput();
+    void onSessionFinished();
+    void onTabCloseRequested(int index);
     void onUpPressed();
     void onDownPressed();
     void onKillProcess();
+    void flushOutput();
+    void updateSessionStatus();
 
 private:
+    struct Session {
+        TerminalSession *session;
+        TerminalView *view;
+    };
+
     void setupUI();
-    void setupProcess();
-    void executeCommand(const QString &command);
+    int addSession(TerminalSession::Kind kind, const QString &command);
+    bool startSession(const Session &entry);
+    TerminalSession *currentSession() const;
+    void sendToShell(const QByteArray &bytes);
     void changeDirectory(const QString &dir);
     void updatePrompt();
-    void appendOutput(const QString &text, const QColor &color);
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
+    void showEvent(QShowEvent *event) override;
 
 private:
-    QTextEdit *outputText;
+    QVector<Session> sessions;
+    QTabBar *sessionTabs;
+    QStackedWidget *views;
+    QToolButton *newSessionButton;
+    QLabel *jobStatusLabel;
+    QFont monoFont;
+    // Output is queued as it arrives and fed to the screens once per frame.
+    QTimer *flushTimer;
+    QTimer *statusTimer;
     QLineEdit *inputLine;
     QLabel *promptLabel;
-    QProcess *process;
     QString currentDir;
     QString currentPrompt;
     QStringList commandHistory;
     int historyIndex;
 };
 
-#endif // TERMINALWIDGET
\ No newline at end of file
+#endif // TERMINALWIDGET